@@ -19,6 +19,7 @@
 # include <errno.h>
 # include <string.h>
 # include <ctype.h>
+# include <utime.h>
 # include <sys/stat.h>
 
 /*
@@ -33,6 +34,7 @@
 # endif
 
 # include "internal/o_dir.h"
+# include "internal/hashdir_index.h"
 
 # ifdef __VMS
 #  pragma names restore
@@ -76,6 +78,8 @@ typedef struct hentry_st {
     unsigned short old_id;
     unsigned char need_symlink;
     unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned char *der;
+    int derlen;
 } HENTRY;
 
 typedef struct bucket_st {
@@ -86,6 +90,15 @@ typedef struct bucket_st {
     unsigned short num_needed;
 } BUCKET;
 
+/* An object to be listed in the directory index */
+typedef struct index_entry_st {
+    unsigned int hash;
+    unsigned short type;
+    unsigned short id;
+    unsigned char *der;
+    int derlen;
+} INDEX_ENTRY;
+
 enum Type {
     /* Keep in sync with |suffixes|, below. */
     TYPE_CERT=0, TYPE_CRL=1
@@ -99,6 +112,7 @@ enum Hash {
 static int evpmdsize;
 static const EVP_MD *evpmd;
 static int remove_links = 1;
+static int write_index = 0;
 static int verbose = 0;
 static BUCKET *hash_table[257];
 
@@ -121,8 +135,8 @@ static int bit_isset(unsigned char *set, unsigned int bit)
  * Process an entry; return number of errors.
  */
 static int add_entry(enum Type type, unsigned int hash, const char *filename,
-                      const unsigned char *digest, int need_symlink,
-                      unsigned short old_id)
+                      const unsigned char *digest, const unsigned char *der,
+                      int derlen, int need_symlink, unsigned short old_id)
 {
     static BUCKET nilbucket;
     static HENTRY nilhentry;
@@ -187,6 +201,11 @@ static int add_entry(enum Type type, unsigned int hash, const char *filename,
         ep->need_symlink = 1;
         bp->num_needed++;
         memcpy(ep->digest, digest, evpmdsize);
+        if (der != NULL) {
+            ep->der = app_malloc(derlen, "index entry");
+            memcpy(ep->der, der, derlen);
+            ep->derlen = derlen;
+        }
     }
     return 0;
 }
@@ -228,7 +247,7 @@ static int handle_symlink(const char *filename, const char *fullpath)
         return -1;
     linktarget[n] = 0;
 
-    return add_entry(type, hash, linktarget, NULL, 0, id);
+    return add_entry(type, hash, linktarget, NULL, NULL, 0, 0, id);
 }
 
 /*
@@ -241,8 +260,8 @@ static int do_file(const char *filename, const char *fullpath, enum Hash h)
     const X509_NAME *name = NULL;
     BIO *b;
     const char *ext;
-    unsigned char digest[EVP_MAX_MD_SIZE];
-    int type, errs = 0;
+    unsigned char digest[EVP_MAX_MD_SIZE], *der = NULL;
+    int type, derlen = 0, errs = 0;
     size_t i;
 
     /* Does it end with a recognized extension? */
@@ -296,6 +315,17 @@ static int do_file(const char *filename, const char *fullpath, enum Hash h)
         ++errs;
         goto end;
     }
+    if (write_index) {
+        /* Keep any trust settings, as loading the file would */
+        derlen = type == TYPE_CERT ? i2d_X509_AUX(x->x509, &der)
+                                   : i2d_X509_CRL(x->crl, &der);
+        if (derlen <= 0) {
+            BIO_printf(bio_err, "%s: error: cannot encode %s for the index\n",
+                       opt_getprog(), filename);
+            ++errs;
+            goto end;
+        }
+    }
     if (name != NULL) {
         if (h == HASH_NEW || h == HASH_BOTH) {
             int ok;
@@ -304,7 +334,8 @@ static int do_file(const char *filename, const char *fullpath, enum Hash h)
                                   app_get0_libctx(), app_get0_propq(), &ok);
 
             if (ok) {
-                errs += add_entry(type, hash_value, filename, digest, 1, ~0);
+                errs += add_entry(type, hash_value, filename, digest,
+                                  der, derlen, 1, ~0);
             } else {
                 BIO_printf(bio_err, "%s: error calculating SHA1 hash value\n",
                            opt_getprog());
@@ -313,10 +344,11 @@ static int do_file(const char *filename, const char *fullpath, enum Hash h)
         }
         if ((h == HASH_OLD) || (h == HASH_BOTH))
             errs += add_entry(type, X509_NAME_hash_old(name),
-                              filename, digest, 1, ~0);
+                              filename, digest, NULL, 0, 1, ~0);
     }
 
 end:
+    OPENSSL_free(der);
     sk_X509_INFO_pop_free(inf, X509_INFO_free);
     return errs;
 }
@@ -345,6 +377,94 @@ static int sk_strcmp(const char * const *a, const char * const *b)
     return strcmp(*a, *b);
 }
 
+static int index_entry_cmp(const void *a, const void *b)
+{
+    const INDEX_ENTRY *x = a, *y = b;
+
+    if (x->type != y->type)
+        return x->type < y->type ? -1 : 1;
+    if (x->hash != y->hash)
+        return x->hash < y->hash ? -1 : 1;
+    return x->id < y->id ? -1 : x->id > y->id;
+}
+
+static int put_u32(BIO *b, size_t v)
+{
+    unsigned char buf[4];
+
+    buf[0] = (unsigned char)(v >> 24);
+    buf[1] = (unsigned char)(v >> 16);
+    buf[2] = (unsigned char)(v >> 8);
+    buf[3] = (unsigned char)v;
+    return BIO_write(b, buf, sizeof(buf)) == (int)sizeof(buf);
+}
+
+/*
+ * Write the index of the directory, for the hashed directory lookup method to
+ * use instead of reading the linked files; return number of errors.
+ */
+static int write_dir_index(const char *dirname, const char *pathsep,
+                           INDEX_ENTRY *entries, size_t num)
+{
+    char path[PATH_MAX], tmppath[PATH_MAX];
+    size_t i, offset;
+    BIO *b = NULL;
+    int ok;
+
+    if (BIO_snprintf(path, sizeof(path), "%s%s%s", dirname, pathsep,
+                     OSSL_HASHDIR_INDEX_NAME) >= (int)sizeof(path)
+            || BIO_snprintf(tmppath, sizeof(tmppath), "%s.tmp", path)
+               >= (int)sizeof(tmppath)) {
+        BIO_printf(bio_err, "%s: error: index path too long in %s\n",
+                   opt_getprog(), dirname);
+        return 1;
+    }
+
+    qsort(entries, num, sizeof(*entries), index_entry_cmp);
+    offset = OSSL_HASHDIR_INDEX_HEADER_LEN + num * OSSL_HASHDIR_INDEX_ENTRY_LEN;
+    ok = (b = BIO_new_file(tmppath, "wb")) != NULL
+        && BIO_write(b, OSSL_HASHDIR_INDEX_MAGIC,
+                     OSSL_HASHDIR_INDEX_MAGIC_LEN)
+           == OSSL_HASHDIR_INDEX_MAGIC_LEN
+        && put_u32(b, num);
+    for (i = 0; ok && i < num; i++) {
+        if (offset > 0xffffffffU - (size_t)entries[i].derlen) {
+            BIO_printf(bio_err, "%s: error: index too large for %s\n",
+                       opt_getprog(), dirname);
+            ok = 0;
+            break;
+        }
+        ok = put_u32(b, entries[i].hash)
+            && put_u32(b, entries[i].type == TYPE_CRL
+                          ? OSSL_HASHDIR_INDEX_TYPE_CRL
+                          : OSSL_HASHDIR_INDEX_TYPE_CERT)
+            && put_u32(b, offset)
+            && put_u32(b, entries[i].derlen);
+        offset += entries[i].derlen;
+    }
+    for (i = 0; ok && i < num; i++)
+        ok = BIO_write(b, entries[i].der, entries[i].derlen)
+             == entries[i].derlen;
+    ok = ok && BIO_flush(b) > 0;
+    BIO_free(b);
+
+    /*
+     * Replace any old index in one step, so that processes still using it keep
+     * a consistent view, and make sure the index is no older than the
+     * directory, which the rename has just modified.
+     */
+    if (!ok || rename(tmppath, path) < 0 || utime(path, NULL) < 0) {
+        BIO_printf(bio_err, "%s: error: cannot write index %s, %s\n",
+                   opt_getprog(), path, strerror(errno));
+        unlink(tmppath);
+        return 1;
+    }
+    if (verbose)
+        BIO_printf(bio_out, "index %s with %zu entries\n",
+                   OSSL_HASHDIR_INDEX_NAME, num);
+    return 0;
+}
+
 /*
  * Process a directory; return number of errors found.
  */
@@ -356,11 +476,12 @@ static int do_dir(const char *dirname, enum Hash h)
     struct stat st;
     unsigned char idmask[MAX_COLLISIONS / 8];
     int n, numfiles, nextid, dirlen, buflen, errs = 0;
-    size_t i;
+    size_t i, num_index = 0, alloc_index = 0;
     const char *pathsep = "";
     const char *filename;
     char *buf, *copy = NULL;
     STACK_OF(OPENSSL_STRING) *files = NULL;
+    INDEX_ENTRY *index = NULL;
 
     if (app_access(dirname, W_OK) < 0) {
         BIO_printf(bio_err, "Skipping %s, can't write\n", dirname);
@@ -450,6 +571,7 @@ static int do_dir(const char *dirname, enum Hash h)
                         errs++;
                     }
                     bit_set(idmask, nextid);
+                    ep->old_id = nextid;
                 } else if (remove_links) {
                     /* Link to be deleted */
                     BIO_snprintf(buf, buflen, "%s%s%08x.%s%d",
@@ -465,6 +587,25 @@ static int do_dir(const char *dirname, enum Hash h)
                         errs++;
                     }
                 }
+                if (write_index && ep->der != NULL) {
+                    if (num_index == alloc_index) {
+                        alloc_index = alloc_index == 0 ? 64 : alloc_index * 2;
+                        index = OPENSSL_realloc(index,
+                                                alloc_index * sizeof(*index));
+                        if (index == NULL) {
+                            BIO_puts(bio_err, "out of memory\n");
+                            exit(1);
+                        }
+                    }
+                    index[num_index].hash = bp->hash;
+                    index[num_index].type = bp->type;
+                    index[num_index].id = ep->old_id;
+                    index[num_index].der = ep->der;
+                    index[num_index].derlen = ep->derlen;
+                    num_index++;
+                    ep->der = NULL;
+                }
+                OPENSSL_free(ep->der);
                 OPENSSL_free(ep->filename);
                 OPENSSL_free(ep);
             }
@@ -473,7 +614,23 @@ static int do_dir(const char *dirname, enum Hash h)
         hash_table[i] = NULL;
     }
 
+    if (write_index) {
+        errs += write_dir_index(dirname, pathsep, index, num_index);
+    } else {
+        /* Any existing index no longer describes the directory */
+        BIO_snprintf(buf, buflen, "%s%s%s", dirname, pathsep,
+                     OSSL_HASHDIR_INDEX_NAME);
+        if (unlink(buf) < 0 && errno != ENOENT) {
+            BIO_printf(bio_err, "%s: Can't unlink %s, %s\n",
+                       opt_getprog(), buf, strerror(errno));
+            errs++;
+        }
+    }
+
  err:
+    for (i = 0; i < num_index; i++)
+        OPENSSL_free(index[i].der);
+    OPENSSL_free(index);
     sk_OPENSSL_STRING_pop_free(files, str_free);
     OPENSSL_free(buf);
     return errs;
@@ -481,7 +638,7 @@ static int do_dir(const char *dirname, enum Hash h)
 
 typedef enum OPTION_choice {
     OPT_COMMON,
-    OPT_COMPAT, OPT_OLD, OPT_N, OPT_VERBOSE,
+    OPT_COMPAT, OPT_OLD, OPT_N, OPT_INDEX, OPT_VERBOSE,
     OPT_PROV_ENUM
 } OPTION_CHOICE;
 
@@ -494,6 +651,8 @@ const OPTIONS rehash_options[] = {
     {"compat", OPT_COMPAT, '-', "Create both new- and old-style hash links"},
     {"old", OPT_OLD, '-', "Use old-style hash to generate links"},
     {"n", OPT_N, '-', "Do not remove existing links"},
+    {"index", OPT_INDEX, '-',
+     "Also write an index of the directory for faster lookups"},
 
     OPT_SECTION("Output"),
     {"v", OPT_VERBOSE, '-', "Verbose output"},
@@ -533,6 +692,9 @@ int rehash_main(int argc, char **argv)
         case OPT_N:
             remove_links = 0;
             break;
+        case OPT_INDEX:
+            write_index = 1;
+            break;
         case OPT_VERBOSE:
             verbose = 1;
             break;
@@ -547,6 +709,13 @@ int rehash_main(int argc, char **argv)
     argc = opt_num_rest();
     argv = opt_rest();
 
+    /* The index is looked up by new-style hash only */
+    if (write_index && h == HASH_OLD) {
+        BIO_printf(bio_err, "%s: -index cannot be used with -old\n", prog);
+        errs = 1;
+        goto end;
+    }
+
     evpmd = EVP_sha1();
     evpmdsize = EVP_MD_get_size(evpmd);
 
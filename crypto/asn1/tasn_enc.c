@@ -1,5 +1,5 @@
 /*
- * Copyright 2000-2021 The OpenSSL Project Authors. All Rights Reserved.
+ * Copyright 2000-2023 The OpenSSL Project Authors. All Rights Reserved.
  *
  * Licensed under the Apache License 2.0 (the "License").  You may not use
  * this file except in compliance with the License.  You can obtain a copy
@@ -16,19 +16,139 @@
 #include "crypto/asn1.h"
 #include "asn1_local.h"
 
+/*
+ * Content lengths of the constructed encodings in an item, in the order the
+ * encoder writes their headers.  Without these, writing each SEQUENCE, SET OF
+ * or EXPLICIT tag recomputes the lengths of everything inside it, so that
+ * items nested n deep are traversed n times.  Instead a first pass records
+ * the lengths, which the pass doing the writing then consumes.
+ */
+#define ASN1_ENC_LENS_INLINE 64
+
+typedef struct {
+    int *lens;
+    size_t num, alloc, pos;
+    int inline_lens[ASN1_ENC_LENS_INLINE];
+} ASN1_ENC_LENS;
+
+static int asn1_item_ex_i2d_int(const ASN1_VALUE **pval, unsigned char **out,
+                                const ASN1_ITEM *it, int tag, int aclass,
+                                ASN1_ENC_LENS *lens);
 static int asn1_i2d_ex_primitive(const ASN1_VALUE **pval, unsigned char **out,
                                  const ASN1_ITEM *it, int tag, int aclass);
 static int asn1_set_seq_out(STACK_OF(const_ASN1_VALUE) *sk,
                             unsigned char **out,
                             int skcontlen, const ASN1_ITEM *item,
-                            int do_sort, int iclass);
+                            int do_sort, int iclass, ASN1_ENC_LENS *lens);
 static int asn1_template_ex_i2d(const ASN1_VALUE **pval, unsigned char **out,
-                                const ASN1_TEMPLATE *tt, int tag, int aclass);
+                                const ASN1_TEMPLATE *tt, int tag, int aclass,
+                                ASN1_ENC_LENS *lens);
 static int asn1_item_flags_i2d(const ASN1_VALUE *val, unsigned char **out,
                                const ASN1_ITEM *it, int flags);
 static int asn1_ex_i2c(const ASN1_VALUE **pval, unsigned char *cout, int *putype,
                        const ASN1_ITEM *it);
 
+static void asn1_enc_lens_init(ASN1_ENC_LENS *lens)
+{
+    lens->lens = lens->inline_lens;
+    lens->num = lens->pos = 0;
+    lens->alloc = ASN1_ENC_LENS_INLINE;
+}
+
+static void asn1_enc_lens_cleanup(ASN1_ENC_LENS *lens)
+{
+    if (lens->lens != lens->inline_lens)
+        OPENSSL_free(lens->lens);
+}
+
+/* Returns the index of a new slot for a length to be recorded in, or -1 */
+static int asn1_enc_lens_reserve(ASN1_ENC_LENS *lens)
+{
+    int *tmp;
+
+    if (lens->num == lens->alloc) {
+        if (lens->alloc > INT_MAX / 2)
+            return -1;
+        if (lens->lens == lens->inline_lens) {
+            if ((tmp = OPENSSL_malloc(2 * lens->alloc * sizeof(*tmp))) == NULL)
+                return -1;
+            memcpy(tmp, lens->inline_lens, sizeof(lens->inline_lens));
+        } else if ((tmp = OPENSSL_realloc(lens->lens, 2 * lens->alloc
+                                                      * sizeof(*tmp)))
+                   == NULL) {
+            return -1;
+        }
+        lens->lens = tmp;
+        lens->alloc *= 2;
+    }
+    return (int)lens->num++;
+}
+
+/*
+ * Records in |slot| that the length pass gave up on its item, returning |ret|
+ * (0 or -1), and forgets the lengths recorded inside it.  The write pass then
+ * returns the same for the item without writing anything.
+ */
+static int asn1_enc_lens_abandon(ASN1_ENC_LENS *lens, int slot, int ret)
+{
+    if (lens != NULL) {
+        lens->num = slot + 1;
+        lens->lens[slot] = ret - 1;
+    }
+    return ret;
+}
+
+/*
+ * Gets the next recorded length.  If it is negative the item was abandoned
+ * and |*len| + 1 is what to return for it.
+ */
+static int asn1_enc_lens_next(ASN1_ENC_LENS *lens, int *len)
+{
+    if (!ossl_assert(lens->pos < lens->num))
+        return 0;
+    *len = lens->lens[lens->pos++];
+    return 1;
+}
+
+/*
+ * Encode in two passes sharing recorded lengths, the first of which just
+ * works out the length.  If |*out| is NULL the output buffer is allocated.
+ */
+static int asn1_item_ex_i2d_lens(const ASN1_VALUE **pval, unsigned char **out,
+                                 const ASN1_ITEM *it, int tag, int aclass)
+{
+    ASN1_ENC_LENS lens;
+    unsigned char *p, *start, *buf = NULL;
+    int len;
+
+    asn1_enc_lens_init(&lens);
+    len = asn1_item_ex_i2d_int(pval, NULL, it, tag, aclass, &lens);
+    if (len > 0) {
+        if (*out == NULL) {
+            if ((buf = OPENSSL_malloc(len)) == NULL) {
+                len = -1;
+                goto end;
+            }
+            p = buf;
+        } else {
+            p = *out;
+        }
+        start = p;
+        /* Both passes must agree, or the output is not to be trusted */
+        if (asn1_item_ex_i2d_int(pval, &p, it, tag, aclass, &lens) != len
+            || p - start != len || lens.pos != lens.num) {
+            ERR_raise(ERR_LIB_ASN1, ERR_R_INTERNAL_ERROR);
+            OPENSSL_free(buf);
+            len = -1;
+            goto end;
+        }
+        *out = buf != NULL ? buf : p;
+    }
+ end:
+    asn1_enc_lens_cleanup(&lens);
+    return len;
+}
+
 /*
  * Top level i2d equivalents: the 'ndef' variant instructs the encoder to use
  * indefinite length constructed encoding, where appropriate
@@ -55,22 +175,9 @@ int ASN1_item_i2d(const ASN1_VALUE *val, unsigned char **out, const ASN1_ITEM *i
 static int asn1_item_flags_i2d(const ASN1_VALUE *val, unsigned char **out,
                                const ASN1_ITEM *it, int flags)
 {
-    if (out != NULL && *out == NULL) {
-        unsigned char *p, *buf;
-        int len;
-
-        len = ASN1_item_ex_i2d(&val, NULL, it, -1, flags);
-        if (len <= 0)
-            return len;
-        if ((buf = OPENSSL_malloc(len)) == NULL)
-            return -1;
-        p = buf;
-        ASN1_item_ex_i2d(&val, &p, it, -1, flags);
-        *out = buf;
-        return len;
-    }
-
-    return ASN1_item_ex_i2d(&val, out, it, -1, flags);
+    if (out == NULL)
+        return asn1_item_ex_i2d_int(&val, NULL, it, -1, flags, NULL);
+    return asn1_item_ex_i2d_lens(&val, out, it, -1, flags);
 }
 
 /*
@@ -80,6 +187,16 @@ static int asn1_item_flags_i2d(const ASN1_VALUE *val, unsigned char **out,
 
 int ASN1_item_ex_i2d(const ASN1_VALUE **pval, unsigned char **out,
                      const ASN1_ITEM *it, int tag, int aclass)
+{
+    /* Unlike the top level functions this never allocates the output */
+    if (out == NULL || *out == NULL)
+        return asn1_item_ex_i2d_int(pval, out, it, tag, aclass, NULL);
+    return asn1_item_ex_i2d_lens(pval, out, it, tag, aclass);
+}
+
+static int asn1_item_ex_i2d_int(const ASN1_VALUE **pval, unsigned char **out,
+                                const ASN1_ITEM *it, int tag, int aclass,
+                                ASN1_ENC_LENS *lens)
 {
     const ASN1_TEMPLATE *tt = NULL;
     int i, seqcontlen, seqlen, ndef = 1;
@@ -100,7 +217,7 @@ int ASN1_item_ex_i2d(const ASN1_VALUE **pval, unsigned char **out,
     case ASN1_ITYPE_PRIMITIVE:
         if (it->templates)
             return asn1_template_ex_i2d(pval, out, it->templates,
-                                        tag, aclass);
+                                        tag, aclass, lens);
         return asn1_i2d_ex_primitive(pval, out, it, tag, aclass);
 
     case ASN1_ITYPE_MSTRING:
@@ -131,7 +248,8 @@ int ASN1_item_ex_i2d(const ASN1_VALUE **pval, unsigned char **out,
             const ASN1_TEMPLATE *chtt;
             chtt = it->templates + i;
             pchval = ossl_asn1_get_const_field_ptr(pval, chtt);
-            return asn1_template_ex_i2d(pchval, out, chtt, -1, aclass);
+            return asn1_template_ex_i2d(pchval, out, chtt, -1, aclass,
+                                        lens);
         }
         /* Fixme: error condition if selector out of range */
         if (asn1_cb && !asn1_cb(ASN1_OP_I2D_POST, pval, it, NULL))
@@ -168,19 +286,33 @@ int ASN1_item_ex_i2d(const ASN1_VALUE **pval, unsigned char **out,
         }
         if (asn1_cb && !asn1_cb(ASN1_OP_I2D_PRE, pval, it, NULL))
             return 0;
-        /* First work out sequence content length */
-        for (i = 0, tt = it->templates; i < it->tcount; tt++, i++) {
-            const ASN1_TEMPLATE *seqtt;
-            const ASN1_VALUE **pseqval;
-            int tmplen;
-            seqtt = ossl_asn1_do_adb(*pval, tt, 1);
-            if (!seqtt)
-                return 0;
-            pseqval = ossl_asn1_get_const_field_ptr(pval, seqtt);
-            tmplen = asn1_template_ex_i2d(pseqval, NULL, seqtt, -1, aclass);
-            if (tmplen == -1 || (tmplen > INT_MAX - seqcontlen))
+        /* First work out sequence content length, unless already known */
+        if (lens != NULL && out != NULL) {
+            if (!asn1_enc_lens_next(lens, &seqcontlen))
+                return -1;
+            if (seqcontlen < 0)
+                return seqcontlen + 1;
+        } else {
+            int slot = lens != NULL ? asn1_enc_lens_reserve(lens) : 0;
+
+            if (slot < 0)
                 return -1;
-            seqcontlen += tmplen;
+            for (i = 0, tt = it->templates; i < it->tcount; tt++, i++) {
+                const ASN1_TEMPLATE *seqtt;
+                const ASN1_VALUE **pseqval;
+                int tmplen;
+                seqtt = ossl_asn1_do_adb(*pval, tt, 1);
+                if (!seqtt)
+                    return asn1_enc_lens_abandon(lens, slot, 0);
+                pseqval = ossl_asn1_get_const_field_ptr(pval, seqtt);
+                tmplen = asn1_template_ex_i2d(pseqval, NULL, seqtt, -1, aclass,
+                                              lens);
+                if (tmplen == -1 || (tmplen > INT_MAX - seqcontlen))
+                    return asn1_enc_lens_abandon(lens, slot, -1);
+                seqcontlen += tmplen;
+            }
+            if (lens != NULL)
+                lens->lens[slot] = seqcontlen;
         }
 
         seqlen = ASN1_object_size(ndef, seqcontlen, tag);
@@ -191,13 +323,20 @@ int ASN1_item_ex_i2d(const ASN1_VALUE **pval, unsigned char **out,
         for (i = 0, tt = it->templates; i < it->tcount; tt++, i++) {
             const ASN1_TEMPLATE *seqtt;
             const ASN1_VALUE **pseqval;
+            int tmplen;
             seqtt = ossl_asn1_do_adb(*pval, tt, 1);
             if (!seqtt)
-                return 0;
+                return -1;
             pseqval = ossl_asn1_get_const_field_ptr(pval, seqtt);
-            /* FIXME: check for errors in enhanced version */
-            asn1_template_ex_i2d(pseqval, out, seqtt, -1, aclass);
+            /* The header is out, so the content must be as long as it says */
+            tmplen = asn1_template_ex_i2d(pseqval, out, seqtt, -1, aclass,
+                                          lens);
+            if (tmplen < 0 || tmplen > seqcontlen)
+                return -1;
+            seqcontlen -= tmplen;
         }
+        if (seqcontlen != 0)
+            return -1;
         if (ndef == 2)
             ASN1_put_eoc(out);
         if (asn1_cb && !asn1_cb(ASN1_OP_I2D_POST, pval, it, NULL))
@@ -212,7 +351,8 @@ int ASN1_item_ex_i2d(const ASN1_VALUE **pval, unsigned char **out,
 }
 
 static int asn1_template_ex_i2d(const ASN1_VALUE **pval, unsigned char **out,
-                                const ASN1_TEMPLATE *tt, int tag, int iclass)
+                                const ASN1_TEMPLATE *tt, int tag, int iclass,
+                                ASN1_ENC_LENS *lens)
 {
     const int flags = tt->flags;
     int i, ret, ttag, tclass, ndef, len;
@@ -298,19 +438,33 @@ static int asn1_template_ex_i2d(const ASN1_VALUE **pval, unsigned char **out,
                 sktag = V_ASN1_SEQUENCE;
         }
 
-        /* Determine total length of items */
+        /* Determine total length of items, unless already known */
         skcontlen = 0;
-        for (i = 0; i < sk_const_ASN1_VALUE_num(sk); i++) {
-            skitem = sk_const_ASN1_VALUE_value(sk, i);
-            len = ASN1_item_ex_i2d(&skitem, NULL, ASN1_ITEM_ptr(tt->item),
-                                   -1, iclass);
-            if (len == -1 || (skcontlen > INT_MAX - len))
+        if (lens != NULL && out != NULL) {
+            if (!asn1_enc_lens_next(lens, &skcontlen))
                 return -1;
-            if (len == 0 && (tt->flags & ASN1_TFLG_OPTIONAL) == 0) {
-                ERR_raise(ERR_LIB_ASN1, ASN1_R_ILLEGAL_ZERO_CONTENT);
+            if (skcontlen < 0)
+                return skcontlen + 1;
+        } else {
+            int slot = lens != NULL ? asn1_enc_lens_reserve(lens) : 0;
+
+            if (slot < 0)
                 return -1;
+            for (i = 0; i < sk_const_ASN1_VALUE_num(sk); i++) {
+                skitem = sk_const_ASN1_VALUE_value(sk, i);
+                len = asn1_item_ex_i2d_int(&skitem, NULL,
+                                           ASN1_ITEM_ptr(tt->item),
+                                           -1, iclass, lens);
+                if (len == -1 || (skcontlen > INT_MAX - len))
+                    return asn1_enc_lens_abandon(lens, slot, -1);
+                if (len == 0 && (tt->flags & ASN1_TFLG_OPTIONAL) == 0) {
+                    ERR_raise(ERR_LIB_ASN1, ASN1_R_ILLEGAL_ZERO_CONTENT);
+                    return asn1_enc_lens_abandon(lens, slot, -1);
+                }
+                skcontlen += len;
             }
-            skcontlen += len;
+            if (lens != NULL)
+                lens->lens[slot] = skcontlen;
         }
         sklen = ASN1_object_size(ndef, skcontlen, sktag);
         if (sklen == -1)
@@ -331,8 +485,9 @@ static int asn1_template_ex_i2d(const ASN1_VALUE **pval, unsigned char **out,
         /* SET or SEQUENCE and IMPLICIT tag */
         ASN1_put_object(out, ndef, skcontlen, sktag, skaclass);
         /* And the stuff itself */
-        asn1_set_seq_out(sk, out, skcontlen, ASN1_ITEM_ptr(tt->item),
-                         isset, iclass);
+        if (!asn1_set_seq_out(sk, out, skcontlen, ASN1_ITEM_ptr(tt->item),
+                              isset, iclass, lens))
+            return -1;
         if (ndef == 2) {
             ASN1_put_eoc(out);
             if (flags & ASN1_TFLG_EXPTAG)
@@ -344,21 +499,36 @@ static int asn1_template_ex_i2d(const ASN1_VALUE **pval, unsigned char **out,
 
     if (flags & ASN1_TFLG_EXPTAG) {
         /* EXPLICIT tagging */
-        /* Find length of tagged item */
-        i = ASN1_item_ex_i2d(pval, NULL, ASN1_ITEM_ptr(tt->item), -1, iclass);
-        if (i == 0) {
-            if ((tt->flags & ASN1_TFLG_OPTIONAL) == 0) {
-                ERR_raise(ERR_LIB_ASN1, ASN1_R_ILLEGAL_ZERO_CONTENT);
+        /* Find length of tagged item, unless already known */
+        if (lens != NULL && out != NULL) {
+            if (!asn1_enc_lens_next(lens, &i))
+                return -1;
+            if (i < 0)
+                return i + 1;
+        } else {
+            int slot = lens != NULL ? asn1_enc_lens_reserve(lens) : 0;
+
+            if (slot < 0)
                 return -1;
+            i = asn1_item_ex_i2d_int(pval, NULL, ASN1_ITEM_ptr(tt->item),
+                                     -1, iclass, lens);
+            if (i == 0 && (tt->flags & ASN1_TFLG_OPTIONAL) == 0) {
+                ERR_raise(ERR_LIB_ASN1, ASN1_R_ILLEGAL_ZERO_CONTENT);
+                i = -1;
             }
-            return 0;
+            if (i <= 0)
+                return asn1_enc_lens_abandon(lens, slot, i);
+            if (lens != NULL)
+                lens->lens[slot] = i;
         }
         /* Find length of EXPLICIT tag */
         ret = ASN1_object_size(ndef, i, ttag);
         if (out && ret != -1) {
             /* Output tag and item */
             ASN1_put_object(out, ndef, i, ttag, tclass);
-            ASN1_item_ex_i2d(pval, out, ASN1_ITEM_ptr(tt->item), -1, iclass);
+            if (asn1_item_ex_i2d_int(pval, out, ASN1_ITEM_ptr(tt->item), -1,
+                                     iclass, lens) != i)
+                return -1;
             if (ndef == 2)
                 ASN1_put_eoc(out);
         }
@@ -366,8 +536,8 @@ static int asn1_template_ex_i2d(const ASN1_VALUE **pval, unsigned char **out,
     }
 
     /* Either normal or IMPLICIT tagging: combine class and flags */
-    len = ASN1_item_ex_i2d(pval, out, ASN1_ITEM_ptr(tt->item),
-                              ttag, tclass | iclass);
+    len = asn1_item_ex_i2d_int(pval, out, ASN1_ITEM_ptr(tt->item),
+                               ttag, tclass | iclass, lens);
     if (len == 0 && (tt->flags & ASN1_TFLG_OPTIONAL) == 0) {
         ERR_raise(ERR_LIB_ASN1, ASN1_R_ILLEGAL_ZERO_CONTENT);
         return -1;
@@ -394,67 +564,87 @@ static int der_cmp(const void *a, const void *b)
     return d1->length - d2->length;
 }
 
-/* Output the content octets of SET OF or SEQUENCE OF */
+/*
+ * Output the content octets of SET OF or SEQUENCE OF, which must come to
+ * |skcontlen| bytes
+ */
 
 static int asn1_set_seq_out(STACK_OF(const_ASN1_VALUE) *sk,
                             unsigned char **out,
                             int skcontlen, const ASN1_ITEM *item,
-                            int do_sort, int iclass)
+                            int do_sort, int iclass, ASN1_ENC_LENS *lens)
 {
-    int i, ret = 0;
+    int i, len, sorted = 1, ret = 0;
     const ASN1_VALUE *skitem;
-    unsigned char *tmpdat = NULL, *p = NULL;
-    DER_ENC *derlst = NULL, *tder;
-
-    if (do_sort) {
-        /* Don't need to sort less than 2 items */
-        if (sk_const_ASN1_VALUE_num(sk) < 2)
-            do_sort = 0;
-        else {
-            derlst = OPENSSL_malloc(sk_const_ASN1_VALUE_num(sk)
-                                    * sizeof(*derlst));
-            if (derlst == NULL)
-                return 0;
-            tmpdat = OPENSSL_malloc(skcontlen);
-            if (tmpdat == NULL)
-                goto err;
-        }
-    }
+    unsigned char *tmpdat = NULL, *p;
+    DER_ENC derbuf[16], *derlst = derbuf, *tder;
+
+    /* Don't need to sort less than 2 items */
+    if (sk_const_ASN1_VALUE_num(sk) < 2)
+        do_sort = 0;
     /* If not sorting just output each item */
     if (!do_sort) {
-        for (i = 0; i < sk_const_ASN1_VALUE_num(sk); i++) {
+        for (i = 0, len = 0; i < sk_const_ASN1_VALUE_num(sk); i++) {
             skitem = sk_const_ASN1_VALUE_value(sk, i);
-            ASN1_item_ex_i2d(&skitem, out, item, -1, iclass);
+            ret = asn1_item_ex_i2d_int(&skitem, out, item, -1, iclass, lens);
+            if (ret < 0 || ret > skcontlen - len)
+                return 0;
+            len += ret;
         }
-        return 1;
+        return len == skcontlen;
+    }
+    if (sk_const_ASN1_VALUE_num(sk) > (int)OSSL_NELEM(derbuf)) {
+        derlst = OPENSSL_malloc(sk_const_ASN1_VALUE_num(sk) * sizeof(*derlst));
+        if (derlst == NULL)
+            return 0;
     }
-    p = tmpdat;
 
-    /* Doing sort: build up a list of each member's DER encoding */
+    /*
+     * Doing sort: output each member's DER encoding in place, noting where it
+     * is.  Members are often in order already, which needs nothing more.
+     */
+    p = *out;
     for (i = 0, tder = derlst; i < sk_const_ASN1_VALUE_num(sk); i++, tder++) {
         skitem = sk_const_ASN1_VALUE_value(sk, i);
         tder->data = p;
-        tder->length = ASN1_item_ex_i2d(&skitem, &p, item, -1, iclass);
+        tder->length = asn1_item_ex_i2d_int(&skitem, &p, item, -1, iclass,
+                                            lens);
         tder->field = skitem;
+        if (tder->length < 0 || p - *out > skcontlen)
+            goto err;
+        if (i > 0 && sorted && der_cmp(tder - 1, tder) > 0)
+            sorted = 0;
     }
-
-    /* Now sort them */
-    qsort(derlst, sk_const_ASN1_VALUE_num(sk), sizeof(*derlst), der_cmp);
-    /* Output sorted DER encoding */
-    p = *out;
-    for (i = 0, tder = derlst; i < sk_const_ASN1_VALUE_num(sk); i++, tder++) {
-        memcpy(p, tder->data, tder->length);
-        p += tder->length;
-    }
-    *out = p;
-    /* If do_sort is 2 then reorder the STACK */
-    if (do_sort == 2) {
+    if (p - *out != skcontlen)
+        goto err;
+
+    if (!sorted) {
+        /* Now sort copies of them and output the sorted DER encoding */
+        tmpdat = OPENSSL_malloc(skcontlen);
+        if (tmpdat == NULL)
+            goto err;
+        memcpy(tmpdat, *out, skcontlen);
         for (i = 0, tder = derlst; i < sk_const_ASN1_VALUE_num(sk); i++, tder++)
-            (void)sk_const_ASN1_VALUE_set(sk, i, tder->field);
+            tder->data = tmpdat + (tder->data - *out);
+        qsort(derlst, sk_const_ASN1_VALUE_num(sk), sizeof(*derlst), der_cmp);
+        p = *out;
+        for (i = 0, tder = derlst; i < sk_const_ASN1_VALUE_num(sk);
+             i++, tder++) {
+            memcpy(p, tder->data, tder->length);
+            p += tder->length;
+        }
+        /* If do_sort is 2 then reorder the STACK */
+        if (do_sort == 2) {
+            for (i = 0, tder = derlst; i < sk_const_ASN1_VALUE_num(sk);
+                 i++, tder++)
+                (void)sk_const_ASN1_VALUE_set(sk, i, tder->field);
+        }
     }
+    *out = p;
     ret = 1;
 err:
-    OPENSSL_free(derlst);
+    if (derlst != derbuf)
+        OPENSSL_free(derlst);
     OPENSSL_free(tmpdat);
     return ret;
 }
@@ -0,0 +1,208 @@
+/*
+ * Copyright 2023 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * Fixed base modular exponentiation with the comb method of Lim and Lee.
+ * An exponent of up to |bits| bits is cut into COMB_TEETH rows of d bits, so
+ * that column c of the comb picks bits c, d + c, 2d + c, ... of it.  Entry j
+ * of the table is g raised to the sum of 2^(i * d) over the bits i set in j,
+ * and g^e is then d squarings and d multiplications by table entries, where
+ * a variable base costs about |bits| squarings.
+ */
+
+#include "internal/cryptlib.h"
+#include "internal/constant_time.h"
+#include "bn_local.h"
+
+#define COMB_TEETH      5
+#define COMB_SIZE       (1 << COMB_TEETH)
+
+struct bn_comb_st {
+    BN_MONT_CTX *mont;
+    int bits;
+    /* The number of columns, the rows are this many bits apart */
+    int d;
+    /* The size of the modulus, and of each entry, in words */
+    int top;
+    /*
+     * The entries in Montgomery form, with word i of entry j at
+     * table[i * COMB_SIZE + j] so that every lookup touches the same
+     * cache lines, as in BN_mod_exp_mont_consttime().
+     */
+    BN_ULONG *table;
+};
+
+static void comb_scatter(BN_COMB *comb, const BIGNUM *a, int idx)
+{
+    int i, top = a->top < comb->top ? a->top : comb->top;
+
+    for (i = 0; i < top; i++)
+        comb->table[i * COMB_SIZE + idx] = a->d[i];
+}
+
+static int comb_gather(BIGNUM *r, const BN_COMB *comb, int idx)
+{
+    int i, j;
+    /* volatile for the same reason as in MOD_EXP_CTIME_COPY_FROM_PREBUF() */
+    const volatile BN_ULONG *table = comb->table;
+
+    if (bn_wexpand(r, comb->top) == NULL)
+        return 0;
+
+    for (i = 0; i < comb->top; i++, table += COMB_SIZE) {
+        BN_ULONG acc = 0;
+
+        for (j = 0; j < COMB_SIZE; j++)
+            acc |= table[j]
+                   & ((BN_ULONG)0 - (constant_time_eq_int(j, idx) & 1));
+        r->d[i] = acc;
+    }
+    r->top = comb->top;
+    r->neg = 0;
+    r->flags |= BN_FLG_FIXED_TOP;
+    return 1;
+}
+
+/*
+ * Builds the table for exponentiations of |g| modulo the odd modulus |m|
+ * with exponents of up to |bits| bits.
+ */
+BN_COMB *ossl_bn_comb_new(const BIGNUM *g, const BIGNUM *m, int bits,
+                          BN_CTX *ctx)
+{
+    BN_COMB *comb;
+    BIGNUM *gi, *t;
+    int i, j, k;
+
+    if (bits <= 0 || BN_is_zero(m)) {
+        ERR_raise(ERR_LIB_BN, ERR_R_PASSED_INVALID_ARGUMENT);
+        return NULL;
+    }
+
+    if ((comb = OPENSSL_zalloc(sizeof(*comb))) == NULL)
+        return NULL;
+
+    BN_CTX_start(ctx);
+    gi = BN_CTX_get(ctx);
+    t = BN_CTX_get(ctx);
+    if (t == NULL)
+        goto err;
+
+    if ((comb->mont = BN_MONT_CTX_new()) == NULL
+        || !BN_MONT_CTX_set(comb->mont, m, ctx))
+        goto err;
+    comb->bits = bits;
+    comb->d = (bits + COMB_TEETH - 1) / COMB_TEETH;
+    comb->top = m->top;
+    comb->table = OPENSSL_zalloc(sizeof(*comb->table) * comb->top * COMB_SIZE);
+    if (comb->table == NULL)
+        goto err;
+
+    /* The base is public, so none of this needs to be constant time */
+    if (!bn_to_mont_fixed_top(t, BN_value_one(), comb->mont, ctx)
+        || !BN_nnmod(gi, g, m, ctx)
+        || !bn_to_mont_fixed_top(gi, gi, comb->mont, ctx))
+        goto err;
+    comb_scatter(comb, t, 0);
+
+    for (i = 0; i < COMB_TEETH; i++) {
+        /* gi = g^(2^(i * d)) */
+        for (k = 0; i > 0 && k < comb->d; k++)
+            if (!bn_mul_mont_fixed_top(gi, gi, gi, comb->mont, ctx))
+                goto err;
+        comb_scatter(comb, gi, 1 << i);
+        for (j = 1; j < 1 << i; j++) {
+            if (!comb_gather(t, comb, j)
+                || !bn_mul_mont_fixed_top(t, t, gi, comb->mont, ctx))
+                goto err;
+            comb_scatter(comb, t, (1 << i) + j);
+        }
+    }
+
+    BN_CTX_end(ctx);
+    return comb;
+
+ err:
+    BN_CTX_end(ctx);
+    ossl_bn_comb_free(comb);
+    return NULL;
+}
+
+void ossl_bn_comb_free(BN_COMB *comb)
+{
+    if (comb == NULL)
+        return;
+    BN_MONT_CTX_free(comb->mont);
+    OPENSSL_free(comb->table);
+    OPENSSL_free(comb);
+}
+
+int ossl_bn_comb_bits(const BN_COMB *comb)
+{
+    return comb->bits;
+}
+
+/*
+ * r = g^p mod m, for the |g| and |m| the table was built for.  p must not
+ * have more bits than the table was built for.  The time taken depends on
+ * the number of words of p but not on its value.
+ */
+int ossl_bn_mod_exp_comb(BIGNUM *r, const BIGNUM *p, const BN_COMB *comb,
+                         BN_CTX *ctx)
+{
+    BIGNUM *e, *acc, *t;
+    BN_ULONG *ed;
+    int ewords = (COMB_TEETH * comb->d + BN_BITS2 - 1) / BN_BITS2;
+    int i, col, bit, idx, ret = 0;
+
+    if (p->neg || BN_num_bits(p) > comb->bits) {
+        ERR_raise(ERR_LIB_BN, BN_R_BIGNUM_TOO_LONG);
+        return 0;
+    }
+
+    BN_CTX_start(ctx);
+    e = BN_CTX_get(ctx);
+    acc = BN_CTX_get(ctx);
+    t = BN_CTX_get(ctx);
+    if (t == NULL || bn_wexpand(e, ewords) == NULL)
+        goto err;
+
+    /* A copy of p, zero padded to cover every row of the comb */
+    ed = e->d;
+    memset(ed, 0, sizeof(*ed) * ewords);
+    if (p->top > 0)
+        memcpy(ed, p->d, sizeof(*ed) * (p->top < ewords ? p->top : ewords));
+
+    for (col = comb->d - 1; col >= 0; col--) {
+        idx = 0;
+        for (i = 0; i < COMB_TEETH; i++) {
+            bit = i * comb->d + col;
+            idx |= (int)((ed[bit / BN_BITS2] >> (bit % BN_BITS2)) & 1) << i;
+        }
+        if (col == comb->d - 1) {
+            if (!comb_gather(acc, comb, idx))
+                goto err;
+            continue;
+        }
+        if (!bn_mul_mont_fixed_top(acc, acc, acc, comb->mont, ctx)
+            || !comb_gather(t, comb, idx)
+            || !bn_mul_mont_fixed_top(acc, acc, t, comb->mont, ctx))
+            goto err;
+    }
+
+    if (!BN_from_montgomery(r, acc, comb->mont, ctx))
+        goto err;
+    ret = 1;
+
+ err:
+    if (e != NULL && e->d != NULL && e->dmax >= ewords)
+        OPENSSL_cleanse(e->d, sizeof(*e->d) * ewords);
+    BN_CTX_end(ctx);
+    return ret;
+}
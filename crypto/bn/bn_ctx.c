@@ -9,6 +9,8 @@
 
 #include <openssl/trace.h>
 #include "internal/cryptlib.h"
+#include "crypto/cryptlib.h"
+#include "crypto/context.h"
 #include "bn_local.h"
 
 /* How many bignums are in each "pool item"; */
@@ -38,6 +40,7 @@ static void BN_POOL_init(BN_POOL *);
 static void BN_POOL_finish(BN_POOL *);
 static BIGNUM *BN_POOL_get(BN_POOL *, int);
 static void BN_POOL_release(BN_POOL *, unsigned int);
+static void BN_POOL_wipe(BN_POOL *);
 
 /************/
 /* BN_STACK */
@@ -55,6 +58,31 @@ static void BN_STACK_finish(BN_STACK *);
 static int BN_STACK_push(BN_STACK *, unsigned int);
 static unsigned int BN_STACK_pop(BN_STACK *);
 
+/************/
+/* BN_ARENA */
+/************/
+
+/*
+ * In arena mode, a bignum of the pool gets its words, the first time it is
+ * handed out, from one block owned by the BN_CTX rather than an allocation of
+ * its own.  It keeps them over any number of frames, like the words it would
+ * have allocated, until the block is wiped and taken back as a whole.  A
+ * bignum that outgrows its words moves to the heap.
+ */
+typedef struct bignum_arena {
+    BN_ULONG *words;
+    /* The size of the block, and how much of it is taken, in words */
+    unsigned int size, used;
+    /* The words given to each bignum, 0 if not in arena mode */
+    unsigned int bn_words;
+    /* The size to make the block the next time it is entirely free */
+    unsigned int want;
+} BN_ARENA;
+static void BN_ARENA_init(BN_ARENA *);
+static void BN_ARENA_finish(BN_ARENA *, int);
+static void BN_ARENA_get(BN_ARENA *, BIGNUM *, int);
+static void BN_ARENA_reset(BN_ARENA *);
+
 /**********/
 /* BN_CTX */
 /**********/
@@ -65,6 +93,10 @@ struct bignum_ctx {
     BN_POOL pool;
     /* The "stack frames", if you will */
     BN_STACK stack;
+    /* The words of the bignums, in arena mode */
+    BN_ARENA arena;
+    /* Set for the BN_CTX of a thread, and while it's in use */
+    unsigned int thread_local:1, thread_busy:1;
     /* The number of bignums currently assigned */
     unsigned int used;
     /* Depth of stack overflow */
@@ -124,6 +156,7 @@ BN_CTX *BN_CTX_new_ex(OSSL_LIB_CTX *ctx)
     /* Initialise the structure */
     BN_POOL_init(&ret->pool);
     BN_STACK_init(&ret->stack);
+    BN_ARENA_init(&ret->arena);
     ret->libctx = ctx;
     return ret;
 }
@@ -173,6 +206,7 @@ void BN_CTX_free(BN_CTX *ctx)
 #endif
     BN_STACK_finish(&ctx->stack);
     BN_POOL_finish(&ctx->pool);
+    BN_ARENA_finish(&ctx->arena, ctx->flags);
     OPENSSL_free(ctx);
 }
 
@@ -229,6 +263,8 @@ BIGNUM *BN_CTX_get(BN_CTX *ctx)
     BN_zero(ret);
     /* clear BN_FLG_CONSTTIME if leaked from previous frames */
     ret->flags &= (~BN_FLG_CONSTTIME);
+    if (ctx->arena.bn_words != 0 && ret->d == NULL)
+        BN_ARENA_get(&ctx->arena, ret, ctx->flags);
     ctx->used++;
     CTXDBG("LEAVE BN_CTX_get()", ctx);
     return ret;
@@ -241,6 +277,129 @@ OSSL_LIB_CTX *ossl_bn_get_libctx(BN_CTX *ctx)
     return ctx->libctx;
 }
 
+/*
+ * Puts |ctx|, which must have no bignums in use, in arena mode, with room in
+ * each bignum for the product of two numbers of |bits| bits.
+ */
+int ossl_bn_ctx_set_arena(BN_CTX *ctx, int bits)
+{
+    if (bits <= 0 || bits > INT_MAX / 4 || ctx->stack.depth != 0
+        || ctx->used != 0) {
+        ERR_raise(ERR_LIB_BN, ERR_R_PASSED_INVALID_ARGUMENT);
+        return 0;
+    }
+    ctx->arena.bn_words = 2 * ((bits + BN_BITS2 - 1) / BN_BITS2) + 2;
+    if (ctx->arena.want < BN_CTX_POOL_SIZE * ctx->arena.bn_words)
+        ctx->arena.want = BN_CTX_POOL_SIZE * ctx->arena.bn_words;
+    return 1;
+}
+
+/*******************/
+/* Thread BN_CTXs  */
+/*******************/
+
+/*
+ * Most operations on keys create a BN_CTX, use it once and free it, so the
+ * words of its bignums are allocated anew every time.  Instead each thread
+ * keeps an arena mode BN_CTX per library context, which is wiped between
+ * operations but keeps its memory.
+ */
+
+void *ossl_bn_thread_ctx_new(OSSL_LIB_CTX *libctx)
+{
+    CRYPTO_THREAD_LOCAL *local = OPENSSL_zalloc(sizeof(*local));
+
+    if (local != NULL && !CRYPTO_THREAD_init_local(local, NULL)) {
+        OPENSSL_free(local);
+        local = NULL;
+    }
+    return local;
+}
+
+void ossl_bn_thread_ctx_free(void *vlocal)
+{
+    CRYPTO_THREAD_LOCAL *local = vlocal;
+
+    if (local == NULL)
+        return;
+    CRYPTO_THREAD_cleanup_local(local);
+    OPENSSL_free(local);
+}
+
+static void bn_thread_ctx_delete_thread_state(void *arg)
+{
+    OSSL_LIB_CTX *libctx = arg;
+    CRYPTO_THREAD_LOCAL *local
+        = ossl_lib_ctx_get_data(libctx, OSSL_LIB_CTX_BN_THREAD_CTX_INDEX);
+    BN_CTX *ctx;
+
+    if (local == NULL)
+        return;
+    ctx = CRYPTO_THREAD_get_local(local);
+    CRYPTO_THREAD_set_local(local, NULL);
+    BN_CTX_free(ctx);
+}
+
+/*
+ * Returns an arena mode BN_CTX for an operation on numbers of |bits| bits in
+ * |libctx|, to be given back with ossl_bn_ctx_thread_release().  It's the
+ * calling thread's own BN_CTX, unless that is already in use.
+ */
+BN_CTX *ossl_bn_ctx_thread_acquire(OSSL_LIB_CTX *libctx, int bits)
+{
+    CRYPTO_THREAD_LOCAL *local;
+    BN_CTX *ctx = NULL;
+
+    libctx = ossl_lib_ctx_get_concrete(libctx);
+    local = ossl_lib_ctx_get_data(libctx, OSSL_LIB_CTX_BN_THREAD_CTX_INDEX);
+    if (local != NULL && (ctx = CRYPTO_THREAD_get_local(local)) == NULL) {
+        /* This is the first time this thread needs one */
+        if ((ctx = BN_CTX_new_ex(libctx)) == NULL)
+            return NULL;
+        ctx->thread_local = 1;
+        if (!ossl_init_thread_start(NULL, libctx,
+                                    bn_thread_ctx_delete_thread_state)
+            || !CRYPTO_THREAD_set_local(local, ctx)) {
+            BN_CTX_free(ctx);
+            ctx = NULL;
+        }
+    }
+
+    if (ctx != NULL && !ctx->thread_busy) {
+        if (!ossl_bn_ctx_set_arena(ctx, bits))
+            return NULL;
+        ctx->thread_busy = 1;
+        return ctx;
+    }
+
+    /* Nested operations make do with a BN_CTX of their own */
+    if ((ctx = BN_CTX_new_ex(libctx)) == NULL)
+        return NULL;
+    if (!ossl_bn_ctx_set_arena(ctx, bits)) {
+        BN_CTX_free(ctx);
+        return NULL;
+    }
+    return ctx;
+}
+
+void ossl_bn_ctx_thread_release(BN_CTX *ctx)
+{
+    if (ctx == NULL)
+        return;
+    if (!ctx->thread_local) {
+        BN_CTX_free(ctx);
+        return;
+    }
+
+    /* End whatever frames the operation didn't, then wipe everything */
+    while (ctx->stack.depth > 0 || ctx->err_stack > 0)
+        BN_CTX_end(ctx);
+    ctx->too_many = 0;
+    BN_POOL_wipe(&ctx->pool);
+    BN_ARENA_reset(&ctx->arena);
+    ctx->thread_busy = 0;
+}
+
 /************/
 /* BN_STACK */
 /************/
@@ -362,3 +521,88 @@ static void BN_POOL_release(BN_POOL *p, unsigned int num)
             offset--;
     }
 }
+
+/* Wipes every bignum of the pool, and takes their words from the arena back */
+static void BN_POOL_wipe(BN_POOL *p)
+{
+    BN_POOL_ITEM *item;
+    unsigned int loop;
+    BIGNUM *bn;
+
+    for (item = p->head; item != NULL; item = item->next) {
+        for (loop = 0, bn = item->vals; loop++ < BN_CTX_POOL_SIZE; bn++) {
+            if (BN_get_flags(bn, BN_FLG_ARENA)) {
+                bn->d = NULL;
+                bn->dmax = 0;
+                bn->flags &= ~BN_FLG_ARENA;
+            } else if (bn->d != NULL) {
+                OPENSSL_cleanse(bn->d, bn->dmax * sizeof(*bn->d));
+            }
+            bn->top = 0;
+            bn->neg = 0;
+        }
+    }
+}
+
+/************/
+/* BN_ARENA */
+/************/
+
+static void BN_ARENA_init(BN_ARENA *a)
+{
+    a->words = NULL;
+    a->size = a->used = a->bn_words = a->want = 0;
+}
+
+static void BN_ARENA_finish(BN_ARENA *a, int flag)
+{
+    if (a->words == NULL)
+        return;
+    if ((flag & BN_FLG_SECURE) != 0)
+        OPENSSL_secure_clear_free(a->words, a->size * sizeof(*a->words));
+    else
+        OPENSSL_clear_free(a->words, a->size * sizeof(*a->words));
+    a->words = NULL;
+    a->size = a->used = 0;
+}
+
+/*
+ * Gives |bn|, which has no words, words from the arena.  When the arena is
+ * full, |bn| is left to allocate its own, and the arena is made bigger the
+ * next time it is entirely free.
+ */
+static void BN_ARENA_get(BN_ARENA *a, BIGNUM *bn, int flag)
+{
+    BN_ULONG *words;
+
+    if (a->used == 0 && (a->words == NULL || a->want > a->size)) {
+        if ((flag & BN_FLG_SECURE) != 0)
+            words = OPENSSL_secure_zalloc(a->want * sizeof(*words));
+        else
+            words = OPENSSL_zalloc(a->want * sizeof(*words));
+        if (words != NULL) {
+            BN_ARENA_finish(a, flag);
+            a->words = words;
+            a->size = a->want;
+        }
+    }
+
+    if (a->words == NULL || a->size - a->used < a->bn_words) {
+        if (a->size <= UINT_MAX / 2 && a->want < 2 * a->size)
+            a->want = 2 * a->size;
+        return;
+    }
+    bn->d = a->words + a->used;
+    bn->dmax = (int)a->bn_words;
+    bn->flags |= BN_FLG_ARENA;
+    a->used += a->bn_words;
+}
+
+/* Wipes the words given out and takes them back */
+static void BN_ARENA_reset(BN_ARENA *a)
+{
+    if (a->used > 0) {
+        OPENSSL_cleanse(a->words, a->used * sizeof(*a->words));
+        a->used = 0;
+    }
+}
@@ -1440,11 +1440,32 @@ int BN_mod_exp_simple(BIGNUM *r, const BIGNUM *a, const BIGNUM *p,
     return ret;
 }
 
+#if defined(RSAZ_ENABLED) || defined(BN_EXP_X2_ENABLED)
+/* Returns |in_mont| if set, or else a new Montgomery context for |m| */
+static BN_MONT_CTX *mont_ctx_x2(BN_MONT_CTX *in_mont, const BIGNUM *m,
+                                BN_CTX *ctx)
+{
+    BN_MONT_CTX *mont;
+
+    if (in_mont != NULL)
+        return in_mont;
+    if ((mont = BN_MONT_CTX_new()) == NULL)
+        return NULL;
+    if (!BN_MONT_CTX_set(mont, m, ctx)) {
+        BN_MONT_CTX_free(mont);
+        return NULL;
+    }
+    return mont;
+}
+#endif
+
 /*
  * This is a variant of modular exponentiation optimization that does
  * parallel 2-primes exponentiation using 256-bit (AVX512VL) AVX512_IFMA ISA
  * in 52-bit binary redundant representation.
- * If such instructions are not available, or input data size is not supported,
+ * Without Montgomery multiplication in assembler, the two exponentiations
+ * are interleaved in C instead.
+ * If neither is available, or input data size is not supported,
  * it falls back to two BN_mod_exp_mont_consttime() calls.
  */
 int BN_mod_exp_mont_consttime_x2(BIGNUM *rr1, const BIGNUM *a1, const BIGNUM *p1,
@@ -1455,10 +1476,12 @@ int BN_mod_exp_mont_consttime_x2(BIGNUM *rr1, const BIGNUM *a1, const BIGNUM *p1
 {
     int ret = 0;
 
-#ifdef RSAZ_ENABLED
+#if defined(RSAZ_ENABLED) || defined(BN_EXP_X2_ENABLED)
     BN_MONT_CTX *mont1 = NULL;
     BN_MONT_CTX *mont2 = NULL;
+#endif
 
+#ifdef RSAZ_ENABLED
     if (ossl_rsaz_avx512ifma_eligible() &&
         (((a1->top == 16) && (p1->top == 16) && (BN_num_bits(m1) == 1024) &&
           (a2->top == 16) && (p2->top == 16) && (BN_num_bits(m2) == 1024)) ||
@@ -1477,22 +1500,9 @@ int BN_mod_exp_mont_consttime_x2(BIGNUM *rr1, const BIGNUM *a1, const BIGNUM *p1
             goto err;
 
         /*  Ensure that montgomery contexts are initialized */
-        if (in_mont1 != NULL) {
-            mont1 = in_mont1;
-        } else {
-            if ((mont1 = BN_MONT_CTX_new()) == NULL)
-                goto err;
-            if (!BN_MONT_CTX_set(mont1, m1, ctx))
-                goto err;
-        }
-        if (in_mont2 != NULL) {
-            mont2 = in_mont2;
-        } else {
-            if ((mont2 = BN_MONT_CTX_new()) == NULL)
-                goto err;
-            if (!BN_MONT_CTX_set(mont2, m2, ctx))
-                goto err;
-        }
+        if ((mont1 = mont_ctx_x2(in_mont1, m1, ctx)) == NULL
+                || (mont2 = mont_ctx_x2(in_mont2, m2, ctx)) == NULL)
+            goto err;
 
         ret = ossl_rsaz_mod_exp_avx512_x2(rr1->d, a1->d, p1->d, m1->d,
                                           mont1->RR.d, mont1->n0[0],
@@ -1514,12 +1524,22 @@ int BN_mod_exp_mont_consttime_x2(BIGNUM *rr1, const BIGNUM *a1, const BIGNUM *p1
     }
 #endif
 
+#ifdef BN_EXP_X2_ENABLED
+    if (ossl_bn_mod_exp_mont_x2_eligible(a1, p1, m1, a2, p2, m2)) {
+        if ((mont1 = mont_ctx_x2(in_mont1, m1, ctx)) == NULL
+                || (mont2 = mont_ctx_x2(in_mont2, m2, ctx)) == NULL)
+            goto err;
+        ret = ossl_bn_mod_exp_mont_x2(rr1, a1, p1, mont1, rr2, a2, p2, mont2);
+        goto err;
+    }
+#endif
+
     /* rr1 = a1^p1 mod m1 */
     ret = BN_mod_exp_mont_consttime(rr1, a1, p1, m1, ctx, in_mont1);
     /* rr2 = a2^p2 mod m2 */
     ret &= BN_mod_exp_mont_consttime(rr2, a2, p2, m2, ctx, in_mont2);
 
-#ifdef RSAZ_ENABLED
+#if defined(RSAZ_ENABLED) || defined(BN_EXP_X2_ENABLED)
 err:
     if (in_mont2 == NULL)
         BN_MONT_CTX_free(mont2);
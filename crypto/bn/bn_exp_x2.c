@@ -0,0 +1,242 @@
+/*
+ * Copyright 2023 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * Portable C counterpart of rsaz_exp_x2.c: two constant time modular
+ * exponentiations with moduli of the same size, as needed by RSA-CRT, are
+ * run in lockstep so that the independent Montgomery multiplications of
+ * both can overlap in the pipeline.
+ */
+
+#include "internal/cryptlib.h"
+#include "internal/constant_time.h"
+#include "bn_local.h"
+
+#ifndef BN_EXP_X2_ENABLED
+NON_EMPTY_TRANSLATION_UNIT
+#else
+
+/* Fixed window size, and number of table entries, of the exponentiation */
+# define X2_WINDOW      5
+# define X2_TABLE_SIZE  (1 << X2_WINDOW)
+
+/* The largest supported modulus size in words, for 4096-bit RSA keys */
+# define X2_MAX_WORDS   32
+
+/*
+ * r1 = a1 * b1 / R mod n1 and r2 = a2 * b2 / R mod n2, where k1 and k2 are
+ * -1/n mod 2^BN_BITS2 and the inputs are fully reduced.  The steps of the
+ * two computations alternate, so that being independent they can overlap.
+ */
+static ossl_inline void mont_mul_x2(BN_ULONG *r1, const BN_ULONG *a1,
+                                    const BN_ULONG *b1, const BN_ULONG *n1,
+                                    BN_ULONG k1,
+                                    BN_ULONG *r2, const BN_ULONG *a2,
+                                    const BN_ULONG *b2, const BN_ULONG *n2,
+                                    BN_ULONG k2, int num)
+{
+    BN_ULONG t1[X2_MAX_WORDS + 2], t2[X2_MAX_WORDS + 2];
+    int i;
+
+    memset(t1, 0, sizeof(*t1) * (num + 1));
+    memset(t2, 0, sizeof(*t2) * (num + 1));
+    for (i = 0; i < num; i++) {
+        bn_mont_fixed_step(t1, a1, b1[i], n1, k1, num);
+        bn_mont_fixed_step(t2, a2, b2[i], n2, k2, num);
+    }
+    bn_mont_fixed_sub_cond(r1, t1, t1[num], n1, num);
+    bn_mont_fixed_sub_cond(r2, t2, t2[num], n2, num);
+}
+
+/* Reads entries |idx1| and |idx2| of the tables without leaking either */
+static ossl_inline void select_x2(BN_ULONG *r1, const BN_ULONG *table1,
+                                  unsigned int idx1,
+                                  BN_ULONG *r2, const BN_ULONG *table2,
+                                  unsigned int idx2, int num)
+{
+    BN_ULONG mask1, mask2;
+    unsigned int i;
+    int j;
+
+    memset(r1, 0, sizeof(*r1) * num);
+    memset(r2, 0, sizeof(*r2) * num);
+    for (i = 0; i < X2_TABLE_SIZE; i++) {
+        mask1 = (BN_ULONG)constant_time_is_zero_64(i ^ idx1);
+        mask2 = (BN_ULONG)constant_time_is_zero_64(i ^ idx2);
+        for (j = 0; j < num; j++) {
+            r1[j] |= table1[i * num + j] & mask1;
+            r2[j] |= table2[i * num + j] & mask2;
+        }
+    }
+}
+
+/* Returns the |bits| wide window of |e| that starts at bit |pos| */
+static ossl_inline unsigned int exp_window(const BN_ULONG *e, int pos, int bits)
+{
+    int i = pos / BN_BITS2, shift = pos % BN_BITS2;
+    BN_ULONG w = e[i] >> shift;
+
+    if (shift + bits > BN_BITS2)
+        w |= e[i + 1] << (BN_BITS2 - shift);
+    return (unsigned int)w & ((1U << bits) - 1);
+}
+
+/*
+ * res = base^exp mod m for both sets of arguments, all of which are |num|
+ * words long, with |RR| = R^2 mod m and |k0| = -1/m mod 2^BN_BITS2.
+ * |tmp| has room for the two tables of X2_TABLE_SIZE powers.
+ * Only the size of the arguments affects the sequence of operations.
+ */
+static ossl_inline void mod_exp_x2(BN_ULONG *res1, const BN_ULONG *base1,
+                                   const BN_ULONG *exp1, const BN_ULONG *m1,
+                                   const BN_ULONG *RR1, BN_ULONG k1,
+                                   BN_ULONG *res2, const BN_ULONG *base2,
+                                   const BN_ULONG *exp2, const BN_ULONG *m2,
+                                   const BN_ULONG *RR2, BN_ULONG k2,
+                                   BN_ULONG *tmp, int num)
+{
+    BN_ULONG *table1 = tmp, *table2 = tmp + X2_TABLE_SIZE * num;
+    BN_ULONG acc1[X2_MAX_WORDS], acc2[X2_MAX_WORDS];
+    BN_ULONG pw1[X2_MAX_WORDS], pw2[X2_MAX_WORDS];
+    int i, pos, bits;
+
+    /* table[i] = base^i in Montgomery form, starting from table[0] = R */
+    memset(acc1, 0, sizeof(acc1));
+    memset(acc2, 0, sizeof(acc2));
+    acc1[0] = acc2[0] = 1;
+    mont_mul_x2(table1, RR1, acc1, m1, k1, table2, RR2, acc2, m2, k2, num);
+    mont_mul_x2(table1 + num, base1, RR1, m1, k1,
+                table2 + num, base2, RR2, m2, k2, num);
+    for (i = 2; i < X2_TABLE_SIZE; i++)
+        mont_mul_x2(table1 + i * num, table1 + (i - 1) * num,
+                    table1 + num, m1, k1,
+                    table2 + i * num, table2 + (i - 1) * num,
+                    table2 + num, m2, k2, num);
+
+    /* The topmost window takes whatever bits don't make up a full window */
+    pos = num * BN_BITS2;
+    bits = pos % X2_WINDOW;
+    if (bits == 0)
+        bits = X2_WINDOW;
+    pos -= bits;
+    select_x2(acc1, table1, exp_window(exp1, pos, bits),
+              acc2, table2, exp_window(exp2, pos, bits), num);
+
+    while (pos > 0) {
+        pos -= X2_WINDOW;
+        for (i = 0; i < X2_WINDOW; i++)
+            mont_mul_x2(acc1, acc1, acc1, m1, k1, acc2, acc2, acc2, m2, k2,
+                        num);
+        select_x2(pw1, table1, exp_window(exp1, pos, X2_WINDOW),
+                  pw2, table2, exp_window(exp2, pos, X2_WINDOW), num);
+        mont_mul_x2(acc1, acc1, pw1, m1, k1, acc2, acc2, pw2, m2, k2, num);
+    }
+
+    /* Convert back from Montgomery form */
+    memset(pw1, 0, sizeof(pw1));
+    memset(pw2, 0, sizeof(pw2));
+    pw1[0] = pw2[0] = 1;
+    mont_mul_x2(res1, acc1, pw1, m1, k1, res2, acc2, pw2, m2, k2, num);
+
+    OPENSSL_cleanse(acc1, sizeof(acc1));
+    OPENSSL_cleanse(acc2, sizeof(acc2));
+}
+
+/*
+ * Specialisations for the modulus sizes of the RSA-CRT primes of 2048, 3072
+ * and 4096-bit keys, which let the compiler unroll the inner loops.
+ */
+# define DEFINE_MOD_EXP_X2(n)                                                \
+    static void mod_exp_x2_##n(BN_ULONG *res1, const BN_ULONG *base1,       \
+                               const BN_ULONG *exp1, const BN_ULONG *m1,    \
+                               const BN_ULONG *RR1, BN_ULONG k1,            \
+                               BN_ULONG *res2, const BN_ULONG *base2,       \
+                               const BN_ULONG *exp2, const BN_ULONG *m2,    \
+                               const BN_ULONG *RR2, BN_ULONG k2,            \
+                               BN_ULONG *tmp)                               \
+    {                                                                       \
+        mod_exp_x2(res1, base1, exp1, m1, RR1, k1,                          \
+                   res2, base2, exp2, m2, RR2, k2, tmp, n);                 \
+    }
+
+DEFINE_MOD_EXP_X2(16)
+DEFINE_MOD_EXP_X2(24)
+DEFINE_MOD_EXP_X2(32)
+
+int ossl_bn_mod_exp_mont_x2_eligible(const BIGNUM *a1, const BIGNUM *p1,
+                                     const BIGNUM *m1,
+                                     const BIGNUM *a2, const BIGNUM *p2,
+                                     const BIGNUM *m2)
+{
+    int num = m1->top;
+
+    return (num == 16 || num == 24 || num == 32)
+        && m2->top == num && BN_is_odd(m1) && BN_is_odd(m2)
+        && !a1->neg && !a2->neg && !p1->neg && !p2->neg
+        && p1->top <= num && p2->top <= num
+        && BN_ucmp(a1, m1) < 0 && BN_ucmp(a2, m2) < 0;
+}
+
+int ossl_bn_mod_exp_mont_x2(BIGNUM *rr1, const BIGNUM *a1, const BIGNUM *p1,
+                            const BN_MONT_CTX *mont1,
+                            BIGNUM *rr2, const BIGNUM *a2, const BIGNUM *p2,
+                            const BN_MONT_CTX *mont2)
+{
+    BN_ULONG base1[X2_MAX_WORDS], exp1[X2_MAX_WORDS], RR1[X2_MAX_WORDS];
+    BN_ULONG base2[X2_MAX_WORDS], exp2[X2_MAX_WORDS], RR2[X2_MAX_WORDS];
+    BN_ULONG *tmp;
+    size_t tmp_len;
+    int num = mont1->N.top;
+
+    tmp_len = sizeof(*tmp) * 2 * X2_TABLE_SIZE * num;
+    if (bn_wexpand(rr1, num) == NULL
+            || bn_wexpand(rr2, num) == NULL
+            || (tmp = OPENSSL_malloc(tmp_len)) == NULL)
+        return 0;
+
+    /* The inputs may well be shorter than the modulus */
+    if (!bn_copy_words(base1, a1, num) || !bn_copy_words(exp1, p1, num)
+            || !bn_copy_words(RR1, &mont1->RR, num)
+            || !bn_copy_words(base2, a2, num) || !bn_copy_words(exp2, p2, num)
+            || !bn_copy_words(RR2, &mont2->RR, num)) {
+        OPENSSL_free(tmp);
+        return 0;
+    }
+
+    switch (num) {
+    case 16:
+        mod_exp_x2_16(rr1->d, base1, exp1, mont1->N.d, RR1, mont1->n0[0],
+                      rr2->d, base2, exp2, mont2->N.d, RR2, mont2->n0[0], tmp);
+        break;
+    case 24:
+        mod_exp_x2_24(rr1->d, base1, exp1, mont1->N.d, RR1, mont1->n0[0],
+                      rr2->d, base2, exp2, mont2->N.d, RR2, mont2->n0[0], tmp);
+        break;
+    case 32:
+        mod_exp_x2_32(rr1->d, base1, exp1, mont1->N.d, RR1, mont1->n0[0],
+                      rr2->d, base2, exp2, mont2->N.d, RR2, mont2->n0[0], tmp);
+        break;
+    }
+
+    OPENSSL_clear_free(tmp, tmp_len);
+    OPENSSL_cleanse(base1, sizeof(base1));
+    OPENSSL_cleanse(exp1, sizeof(exp1));
+    OPENSSL_cleanse(base2, sizeof(base2));
+    OPENSSL_cleanse(exp2, sizeof(exp2));
+
+    rr1->top = rr2->top = num;
+    rr1->neg = rr2->neg = 0;
+    bn_correct_top_consttime(rr1);
+    bn_correct_top_consttime(rr2);
+    bn_check_top(rr1);
+    bn_check_top(rr2);
+    return 1;
+}
+
+#endif
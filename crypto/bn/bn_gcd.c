@@ -190,6 +190,236 @@ BIGNUM *bn_mod_inverse_no_branch(BIGNUM *in,
     return ret;
 }
 
+/* The number of divsteps done at a time on the bottom words of f and g */
+#define BN_DIVSTEPS (BN_BITS2 - 2)
+
+/*-
+ * Does BN_DIVSTEPS divsteps of Bernstein and Yang on f and g, the bottom
+ * words of the numbers, without branching on them, and returns the new
+ * delta.  t receives the transition matrix [u v; q r], as two's complement
+ * words, with
+ *      2^BN_DIVSTEPS * f' = u * f + v * g
+ *      2^BN_DIVSTEPS * g' = q * f + r * g
+ * Each of |u| + |v| and |q| + |r| is at most 2^BN_DIVSTEPS.
+ */
+static int bn_divsteps(int delta, BN_ULONG f, BN_ULONG g, BN_ULONG t[4])
+{
+    BN_ULONG u = 1, v = 0, q = 0, r = 1, odd, swap, x;
+    int i, neg;
+
+    for (i = 0; i < BN_DIVSTEPS; i++) {
+        /* if delta > 0 and g is odd: (f, g, delta) = (g, -f, -delta) */
+        odd = (BN_ULONG)0 - (g & 1);
+        swap = odd & ((BN_ULONG)0
+                      - (((unsigned int)-delta) >> (sizeof(delta) * 8 - 1)));
+        x = (f ^ g) & swap;
+        f ^= x;
+        g ^= x;
+        g = (g ^ swap) - swap;
+        x = (u ^ q) & swap;
+        u ^= x;
+        q ^= x;
+        q = (q ^ swap) - swap;
+        x = (v ^ r) & swap;
+        v ^= x;
+        r ^= x;
+        r = (r ^ swap) - swap;
+        neg = -(int)(swap & 1);
+        delta = (delta ^ neg) - neg;
+
+        /* if g is odd: g = g + f; then g = g / 2 */
+        g += f & odd;
+        q += u & odd;
+        r += v & odd;
+        g >>= 1;
+        u <<= 1;
+        v <<= 1;
+        delta++;
+    }
+    t[0] = u;
+    t[1] = v;
+    t[2] = q;
+    t[3] = r;
+    return delta;
+}
+
+/* r = a * w, for a of n words and w as two's complement numbers, in n + 1 */
+static void bn_smul_words(BN_ULONG *r, const BN_ULONG *a, int n, BN_ULONG w)
+{
+    BN_ULONG wneg = w >> (BN_BITS2 - 1), aneg = a[n - 1] >> (BN_BITS2 - 1);
+    BN_ULONG wabs = (w ^ ((BN_ULONG)0 - wneg)) + wneg;
+
+    r[n] = bn_mul_words(r, a, n, wabs) - (wabs & ((BN_ULONG)0 - aneg));
+    bn_cond_neg_words(r, n + 1, wneg);
+}
+
+/*-
+ * r = (u * a + v * b + k * m) / 2^BN_DIVSTEPS, for a, b and r of n words
+ * as two's complement numbers.  If m is NULL, k is 0 and the division must
+ * be exact; otherwise k < 2^BN_DIVSTEPS makes it exact, with minv = -1/m
+ * modulo 2^BN_BITS2.  r may be the same as a or b.  t needs 2 * n + 2 words.
+ */
+static void bn_divsteps_apply(BN_ULONG *r, const BN_ULONG *a,
+                              const BN_ULONG *b, BN_ULONG u, BN_ULONG v,
+                              const BN_ULONG *m, BN_ULONG minv, int n,
+                              BN_ULONG *t)
+{
+    BN_ULONG k;
+    int i;
+
+    bn_smul_words(t, a, n, u);
+    bn_smul_words(&t[n + 1], b, n, v);
+    bn_add_words(t, t, &t[n + 1], n + 1);
+    if (m != NULL) {
+        k = (t[0] * minv) & (((BN_ULONG)1 << BN_DIVSTEPS) - 1);
+        t[2 * n + 1] = bn_mul_words(&t[n + 1], m, n, k);
+        bn_add_words(t, t, &t[n + 1], n + 1);
+    }
+    for (i = 0; i < n; i++)
+        r[i] = (t[i] >> BN_DIVSTEPS) | (t[i + 1] << (BN_BITS2 - BN_DIVSTEPS));
+}
+
+/*
+ * Brings a of n words from (-2m, 2m) into (-m, m), and from (-m, m) into
+ * [0, m), without branching.  t needs n words.
+ */
+static void bn_divsteps_reduce(BN_ULONG *a, const BN_ULONG *m, int n,
+                               BN_ULONG *t)
+{
+    BN_ULONG mask = (BN_ULONG)0 - (a[n - 1] >> (BN_BITS2 - 1));
+    int i;
+
+    for (i = 0; i < n; i++)
+        t[i] = m[i] & mask;
+    bn_add_words(a, a, t, n);
+    bn_sub_words(t, a, m, n);
+    mask = (BN_ULONG)0 - (t[n - 1] >> (BN_BITS2 - 1));
+    for (i = 0; i < n; i++)
+        a[i] = (a[i] & mask) | (t[i] & ~mask);
+}
+
+/*-
+ * Constant time modular inverse for an odd modulus n, with the divsteps of
+ * Bernstein and Yang: https://eprint.iacr.org/2019/266.  As in libsecp256k1,
+ * the divsteps are done BN_DIVSTEPS at a time on the bottom words, and their
+ * transition matrix is then applied to the whole numbers:
+ *      f, g = |n|, a mod |n|
+ *      d, e = 0, 1
+ * with f == d * a and g == e * a (mod |n|).  After enough divsteps g is 0
+ * and f is +-gcd(a, n); how many are enough only depends on the size of n.
+ * Each number is kept in two's complement in one word more than n, with d
+ * and e in (-|n|, |n|).
+ *
+ * This is an internal function, we assume all callers pass valid arguments:
+ * all pointers passed here are assumed non-NULL and n is odd.
+ */
+BIGNUM *bn_mod_inverse_safegcd(BIGNUM *in,
+                               const BIGNUM *a, const BIGNUM *n, BN_CTX *ctx,
+                               int *pnoinv)
+{
+    BIGNUM *B, *T, *R = NULL, *ret = NULL;
+    const BIGNUM *b = a;
+    BN_ULONG *f, *g, *d, *e, *nf, *nd, *m, *t, *p, tm[4], minv, mask;
+    int len, bits, steps, delta = 1, i;
+
+    bn_check_top(a);
+    bn_check_top(n);
+
+    *pnoinv = 0;
+    if (in == n) {
+        ERR_raise(ERR_LIB_BN, ERR_R_PASSED_INVALID_ARGUMENT);
+        return NULL;
+    }
+
+    BN_CTX_start(ctx);
+    B = BN_CTX_get(ctx);
+    T = BN_CTX_get(ctx);
+    if (T == NULL)
+        goto err;
+
+    if (in == NULL)
+        R = BN_new();
+    else
+        R = in;
+    if (R == NULL)
+        goto err;
+
+    if (a->neg || BN_ucmp(a, n) >= 0) {
+        if (!BN_nnmod(B, a, n, ctx))
+            goto err;
+        b = B;
+    }
+
+    len = n->top + 1;
+    if (bn_wexpand(T, 9 * len + 2) == NULL
+        || bn_wexpand(R, n->top) == NULL)
+        goto err;
+    f = T->d;
+    g = f + len;
+    d = g + len;
+    e = d + len;
+    nf = e + len;
+    nd = nf + len;
+    m = nd + len;
+    t = m + len;
+    memset(f, 0, sizeof(*f) * 7 * len);
+    memcpy(m, n->d, sizeof(*m) * n->top);
+    memcpy(f, m, sizeof(*f) * len);
+    memcpy(g, b->d, sizeof(*g) * b->top);
+    e[0] = 1;
+
+    /* Newton's iteration doubles the correct low bits of 1/m, from 3 */
+    for (minv = m[0], i = 0; i < 5; i++)
+        minv *= 2 - m[0] * minv;
+    minv = 0 - minv;
+
+    /* The bound of Theorem 11.2 of the paper */
+    bits = BN_num_bits(n);
+    steps = bits < 46 ? (49 * bits + 80) / 17 : (49 * bits + 57) / 17;
+
+    for (i = 0; i < steps; i += BN_DIVSTEPS) {
+        delta = bn_divsteps(delta, f[0], g[0], tm);
+        bn_divsteps_apply(nf, f, g, tm[0], tm[1], NULL, 0, len, t);
+        bn_divsteps_apply(g, f, g, tm[2], tm[3], NULL, 0, len, t);
+        bn_divsteps_apply(nd, d, e, tm[0], tm[1], m, minv, len, t);
+        bn_divsteps_apply(e, d, e, tm[2], tm[3], m, minv, len, t);
+        bn_divsteps_reduce(nd, m, len, t);
+        bn_divsteps_reduce(e, m, len, t);
+        p = f;
+        f = nf;
+        nf = p;
+        p = d;
+        d = nd;
+        nd = p;
+    }
+
+    /* Make f positive, and d with it, then d * a == 1 (mod |n|) if f is 1 */
+    mask = f[len - 1] >> (BN_BITS2 - 1);
+    bn_cond_neg_words(f, len, mask);
+    bn_cond_neg_words(d, len, mask);
+    bn_divsteps_reduce(d, m, len, t);
+    for (mask = f[0] ^ 1, i = 1; i < len; i++)
+        mask |= f[i];
+    if (mask != 0) {
+        *pnoinv = 1;
+        /* caller sets the BN_R_NO_INVERSE error */
+        goto err;
+    }
+
+    memcpy(R->d, d, sizeof(*d) * n->top);
+    R->top = n->top;
+    R->neg = 0;
+    bn_correct_top_consttime(R);
+    ret = R;
+
+ err:
+    if ((ret == NULL) && (in == NULL))
+        BN_free(R);
+    BN_CTX_end(ctx);
+    bn_check_top(ret);
+    return ret;
+}
+
 /*
  * This is an internal function, we assume all callers pass valid arguments:
  * all pointers passed here are assumed non-NULL.
@@ -210,6 +440,16 @@ BIGNUM *int_bn_mod_inverse(BIGNUM *in,
 
     *pnoinv = 0;
 
+    /*
+     * For odd moduli of up to 4096 bits safegcd, although constant time, is
+     * faster than Euclid's algorithm
+     */
+    if (BN_is_odd(n)
+        && (BN_num_bits(n) <= 4096
+            || BN_get_flags(a, BN_FLG_CONSTTIME) != 0
+            || BN_get_flags(n, BN_FLG_CONSTTIME) != 0))
+        return bn_mod_inverse_safegcd(in, a, n, ctx, pnoinv);
+
     if ((BN_get_flags(a, BN_FLG_CONSTTIME) != 0)
         || (BN_get_flags(n, BN_FLG_CONSTTIME) != 0)) {
         return bn_mod_inverse_no_branch(in, a, n, ctx, pnoinv);
@@ -257,222 +497,125 @@ BIGNUM *int_bn_mod_inverse(BIGNUM *in,
      *      sign*Y*a  ==  A   (mod |n|).
      */
 
-    if (BN_is_odd(n) && (BN_num_bits(n) <= 2048)) {
-        /*
-         * Binary inversion algorithm; requires odd modulus. This is faster
-         * than the general algorithm if the modulus is sufficiently small
-         * (about 400 .. 500 bits on 32-bit systems, but much more on 64-bit
-         * systems)
-         */
-        int shift;
-
-        while (!BN_is_zero(B)) {
-            /*-
-             *      0 < B < |n|,
-             *      0 < A <= |n|,
-             * (1) -sign*X*a  ==  B   (mod |n|),
-             * (2)  sign*Y*a  ==  A   (mod |n|)
-             */
-
-            /*
-             * Now divide B by the maximum possible power of two in the
-             * integers, and divide X by the same value mod |n|. When we're
-             * done, (1) still holds.
-             */
-            shift = 0;
-            while (!BN_is_bit_set(B, shift)) { /* note that 0 < B */
-                shift++;
-
-                if (BN_is_odd(X)) {
-                    if (!BN_uadd(X, X, n))
-                        goto err;
-                }
-                /*
-                 * now X is even, so we can easily divide it by two
-                 */
-                if (!BN_rshift1(X, X))
-                    goto err;
-            }
-            if (shift > 0) {
-                if (!BN_rshift(B, B, shift))
-                    goto err;
-            }
-
-            /*
-             * Same for A and Y.  Afterwards, (2) still holds.
-             */
-            shift = 0;
-            while (!BN_is_bit_set(A, shift)) { /* note that 0 < A */
-                shift++;
+    /* Euclid's algorithm */
+    while (!BN_is_zero(B)) {
+        BIGNUM *tmp;
 
-                if (BN_is_odd(Y)) {
-                    if (!BN_uadd(Y, Y, n))
-                        goto err;
-                }
-                /* now Y is even */
-                if (!BN_rshift1(Y, Y))
-                    goto err;
-            }
-            if (shift > 0) {
-                if (!BN_rshift(A, A, shift))
-                    goto err;
-            }
+        /*-
+         *      0 < B < A,
+         * (*) -sign*X*a  ==  B   (mod |n|),
+         *      sign*Y*a  ==  A   (mod |n|)
+         */
 
-            /*-
-             * We still have (1) and (2).
-             * Both  A  and  B  are odd.
-             * The following computations ensure that
-             *
-             *     0 <= B < |n|,
-             *      0 < A < |n|,
-             * (1) -sign*X*a  ==  B   (mod |n|),
-             * (2)  sign*Y*a  ==  A   (mod |n|),
-             *
-             * and that either  A  or  B  is even in the next iteration.
-             */
-            if (BN_ucmp(B, A) >= 0) {
-                /* -sign*(X + Y)*a == B - A  (mod |n|) */
-                if (!BN_uadd(X, X, Y))
+        /* (D, M) := (A/B, A%B) ... */
+        if (BN_num_bits(A) == BN_num_bits(B)) {
+            if (!BN_one(D))
+                goto err;
+            if (!BN_sub(M, A, B))
+                goto err;
+        } else if (BN_num_bits(A) == BN_num_bits(B) + 1) {
+            /* A/B is 1, 2, or 3 */
+            if (!BN_lshift1(T, B))
+                goto err;
+            if (BN_ucmp(A, T) < 0) {
+                /* A < 2*B, so D=1 */
+                if (!BN_one(D))
                     goto err;
-                /*
-                 * NB: we could use BN_mod_add_quick(X, X, Y, n), but that
-                 * actually makes the algorithm slower
-                 */
-                if (!BN_usub(B, B, A))
+                if (!BN_sub(M, A, B))
                     goto err;
             } else {
-                /*  sign*(X + Y)*a == A - B  (mod |n|) */
-                if (!BN_uadd(Y, Y, X))
-                    goto err;
-                /*
-                 * as above, BN_mod_add_quick(Y, Y, X, n) would slow things down
-                 */
-                if (!BN_usub(A, A, B))
+                /* A >= 2*B, so D=2 or D=3 */
+                if (!BN_sub(M, A, T))
                     goto err;
+                if (!BN_add(D, T, B))
+                    goto err; /* use D (:= 3*B) as temp */
+                if (BN_ucmp(A, D) < 0) {
+                    /* A < 3*B, so D=2 */
+                    if (!BN_set_word(D, 2))
+                        goto err;
+                    /*
+                     * M (= A - 2*B) already has the correct value
+                     */
+                } else {
+                    /* only D=3 remains */
+                    if (!BN_set_word(D, 3))
+                        goto err;
+                    /*
+                     * currently M = A - 2*B, but we need M = A - 3*B
+                     */
+                    if (!BN_sub(M, M, B))
+                        goto err;
+                }
             }
+        } else {
+            if (!BN_div(D, M, A, B, ctx))
+                goto err;
         }
-    } else {
-        /* general inversion algorithm */
 
-        while (!BN_is_zero(B)) {
-            BIGNUM *tmp;
+        /*-
+         * Now
+         *      A = D*B + M;
+         * thus we have
+         * (**)  sign*Y*a  ==  D*B + M   (mod |n|).
+         */
 
-            /*-
-             *      0 < B < A,
-             * (*) -sign*X*a  ==  B   (mod |n|),
-             *      sign*Y*a  ==  A   (mod |n|)
-             */
+        tmp = A;    /* keep the BIGNUM object, the value does not matter */
 
-            /* (D, M) := (A/B, A%B) ... */
-            if (BN_num_bits(A) == BN_num_bits(B)) {
-                if (!BN_one(D))
-                    goto err;
-                if (!BN_sub(M, A, B))
+        /* (A, B) := (B, A mod B) ... */
+        A = B;
+        B = M;
+        /* ... so we have  0 <= B < A  again */
+
+        /*-
+         * Since the former  M  is now  B  and the former  B  is now  A,
+         * (**) translates into
+         *       sign*Y*a  ==  D*A + B    (mod |n|),
+         * i.e.
+         *       sign*Y*a - D*A  ==  B    (mod |n|).
+         * Similarly, (*) translates into
+         *      -sign*X*a  ==  A          (mod |n|).
+         *
+         * Thus,
+         *   sign*Y*a + D*sign*X*a  ==  B  (mod |n|),
+         * i.e.
+         *        sign*(Y + D*X)*a  ==  B  (mod |n|).
+         *
+         * So if we set  (X, Y, sign) := (Y + D*X, X, -sign), we arrive back at
+         *      -sign*X*a  ==  B   (mod |n|),
+         *       sign*Y*a  ==  A   (mod |n|).
+         * Note that  X  and  Y  stay non-negative all the time.
+         */
+
+        /*
+         * most of the time D is very small, so we can optimize tmp := D*X+Y
+         */
+        if (BN_is_one(D)) {
+            if (!BN_add(tmp, X, Y))
+                goto err;
+        } else {
+            if (BN_is_word(D, 2)) {
+                if (!BN_lshift1(tmp, X))
                     goto err;
-            } else if (BN_num_bits(A) == BN_num_bits(B) + 1) {
-                /* A/B is 1, 2, or 3 */
-                if (!BN_lshift1(T, B))
+            } else if (BN_is_word(D, 4)) {
+                if (!BN_lshift(tmp, X, 2))
                     goto err;
-                if (BN_ucmp(A, T) < 0) {
-                    /* A < 2*B, so D=1 */
-                    if (!BN_one(D))
-                        goto err;
-                    if (!BN_sub(M, A, B))
-                        goto err;
-                } else {
-                    /* A >= 2*B, so D=2 or D=3 */
-                    if (!BN_sub(M, A, T))
-                        goto err;
-                    if (!BN_add(D, T, B))
-                        goto err; /* use D (:= 3*B) as temp */
-                    if (BN_ucmp(A, D) < 0) {
-                        /* A < 3*B, so D=2 */
-                        if (!BN_set_word(D, 2))
-                            goto err;
-                        /*
-                         * M (= A - 2*B) already has the correct value
-                         */
-                    } else {
-                        /* only D=3 remains */
-                        if (!BN_set_word(D, 3))
-                            goto err;
-                        /*
-                         * currently M = A - 2*B, but we need M = A - 3*B
-                         */
-                        if (!BN_sub(M, M, B))
-                            goto err;
-                    }
-                }
-            } else {
-                if (!BN_div(D, M, A, B, ctx))
+            } else if (D->top == 1) {
+                if (!BN_copy(tmp, X))
                     goto err;
-            }
-
-            /*-
-             * Now
-             *      A = D*B + M;
-             * thus we have
-             * (**)  sign*Y*a  ==  D*B + M   (mod |n|).
-             */
-
-            tmp = A;    /* keep the BIGNUM object, the value does not matter */
-
-            /* (A, B) := (B, A mod B) ... */
-            A = B;
-            B = M;
-            /* ... so we have  0 <= B < A  again */
-
-            /*-
-             * Since the former  M  is now  B  and the former  B  is now  A,
-             * (**) translates into
-             *       sign*Y*a  ==  D*A + B    (mod |n|),
-             * i.e.
-             *       sign*Y*a - D*A  ==  B    (mod |n|).
-             * Similarly, (*) translates into
-             *      -sign*X*a  ==  A          (mod |n|).
-             *
-             * Thus,
-             *   sign*Y*a + D*sign*X*a  ==  B  (mod |n|),
-             * i.e.
-             *        sign*(Y + D*X)*a  ==  B  (mod |n|).
-             *
-             * So if we set  (X, Y, sign) := (Y + D*X, X, -sign), we arrive back at
-             *      -sign*X*a  ==  B   (mod |n|),
-             *       sign*Y*a  ==  A   (mod |n|).
-             * Note that  X  and  Y  stay non-negative all the time.
-             */
-
-            /*
-             * most of the time D is very small, so we can optimize tmp := D*X+Y
-             */
-            if (BN_is_one(D)) {
-                if (!BN_add(tmp, X, Y))
+                if (!BN_mul_word(tmp, D->d[0]))
                     goto err;
             } else {
-                if (BN_is_word(D, 2)) {
-                    if (!BN_lshift1(tmp, X))
-                        goto err;
-                } else if (BN_is_word(D, 4)) {
-                    if (!BN_lshift(tmp, X, 2))
-                        goto err;
-                } else if (D->top == 1) {
-                    if (!BN_copy(tmp, X))
-                        goto err;
-                    if (!BN_mul_word(tmp, D->d[0]))
-                        goto err;
-                } else {
-                    if (!BN_mul(tmp, D, X, ctx))
-                        goto err;
-                }
-                if (!BN_add(tmp, tmp, Y))
+                if (!BN_mul(tmp, D, X, ctx))
                     goto err;
             }
-
-            M = Y;      /* keep the BIGNUM object, the value does not matter */
-            Y = X;
-            X = tmp;
-            sign = -sign;
+            if (!BN_add(tmp, tmp, Y))
+                goto err;
         }
+
+        M = Y;      /* keep the BIGNUM object, the value does not matter */
+        Y = X;
+        X = tmp;
+        sign = -sign;
     }
 
     /*-
@@ -534,6 +677,107 @@ BIGNUM *BN_mod_inverse(BIGNUM *in,
     return rv;
 }
 
+static int bn_batch_mul(BIGNUM *r, const BIGNUM *a, const BIGNUM *b,
+                        const BIGNUM *m, BN_MONT_CTX *mont, BN_CTX *ctx)
+{
+    if (mont != NULL)
+        return BN_mod_mul_montgomery(r, a, b, mont, ctx);
+    return BN_mod_mul(r, a, b, m, ctx);
+}
+
+/* Returns a if it is in [0, |m|), and a reduced into tmp otherwise */
+static const BIGNUM *bn_batch_operand(BIGNUM *tmp, const BIGNUM *a,
+                                      const BIGNUM *m, BN_CTX *ctx)
+{
+    if (!a->neg && BN_ucmp(a, m) < 0)
+        return a;
+    return BN_nnmod(tmp, a, m, ctx) ? tmp : NULL;
+}
+
+/*-
+ * Inverts the num numbers a[i] modulo m with a single, constant time,
+ * modular inversion, using Montgomery's trick.  With p[i] the product of
+ * a[0] to a[i],
+ *      1/a[i] = p[i-1] * 1/p[i]
+ *      1/p[i-1] = a[i] * 1/p[i]
+ * For an odd m the products are Montgomery multiplications, without
+ * conversions: p[i] gets a factor 1/R for each of them, which the same
+ * number of factors R in 1/p[i] cancel.
+ */
+int BN_mod_inverse_batch(BIGNUM *r[], const BIGNUM *a[], size_t num,
+                         const BIGNUM *m, BN_CTX *ctx)
+{
+    BN_CTX *new_ctx = NULL;
+    BN_MONT_CTX *mont = NULL;
+    BIGNUM **p = NULL, *inv, *tmp;
+    const BIGNUM *x;
+    size_t i;
+    int noinv = 0, ret = 0;
+
+    if (num == 0)
+        return 1;
+    if (BN_abs_is_word(m, 1) || BN_is_zero(m)) {
+        ERR_raise(ERR_LIB_BN, BN_R_NO_INVERSE);
+        return 0;
+    }
+
+    if (ctx == NULL) {
+        ctx = new_ctx = BN_CTX_new_ex(NULL);
+        if (ctx == NULL) {
+            ERR_raise(ERR_LIB_BN, ERR_R_BN_LIB);
+            return 0;
+        }
+    }
+
+    BN_CTX_start(ctx);
+    inv = BN_CTX_get(ctx);
+    tmp = BN_CTX_get(ctx);
+    if (tmp == NULL || (p = OPENSSL_malloc(sizeof(*p) * num)) == NULL)
+        goto err;
+    for (i = 0; i < num; i++)
+        if ((p[i] = BN_CTX_get(ctx)) == NULL)
+            goto err;
+    if (BN_is_odd(m)) {
+        if ((mont = BN_MONT_CTX_new()) == NULL
+            || !BN_MONT_CTX_set(mont, m, ctx))
+            goto err;
+    }
+
+    for (i = 0; i < num; i++) {
+        if ((x = bn_batch_operand(tmp, a[i], m, ctx)) == NULL)
+            goto err;
+        if (i == 0 ? BN_copy(p[0], x) == NULL
+                   : !bn_batch_mul(p[i], p[i - 1], x, m, mont, ctx))
+            goto err;
+    }
+
+    BN_set_flags(p[num - 1], BN_FLG_CONSTTIME);
+    if (int_bn_mod_inverse(inv, p[num - 1], m, ctx, &noinv) == NULL) {
+        if (noinv)
+            ERR_raise(ERR_LIB_BN, BN_R_NO_INVERSE);
+        goto err;
+    }
+
+    /* r[i] may be a[i], so it is only set once a[i] has been used */
+    for (i = num - 1; i > 0; i--) {
+        if ((x = bn_batch_operand(tmp, a[i], m, ctx)) == NULL
+            || !bn_batch_mul(p[i], inv, p[i - 1], m, mont, ctx)
+            || !bn_batch_mul(inv, inv, x, m, mont, ctx)
+            || BN_copy(r[i], p[i]) == NULL)
+            goto err;
+    }
+    if (BN_copy(r[0], inv) == NULL)
+        goto err;
+    ret = 1;
+
+ err:
+    BN_MONT_CTX_free(mont);
+    OPENSSL_free(p);
+    BN_CTX_end(ctx);
+    BN_CTX_free(new_ctx);
+    return ret;
+}
+
 /*
  * The numbers a and b are coprime if the only positive integer that is a
  * divisor of both of them is 1.
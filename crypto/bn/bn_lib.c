@@ -214,7 +214,7 @@ void BN_clear_free(BIGNUM *a)
 {
     if (a == NULL)
         return;
-    if (a->d != NULL && !BN_get_flags(a, BN_FLG_STATIC_DATA))
+    if (a->d != NULL && !BN_get_flags(a, BN_FLG_STATIC_DATA | BN_FLG_ARENA))
         bn_free_d(a, 1);
     if (BN_get_flags(a, BN_FLG_MALLOCED)) {
         OPENSSL_cleanse(a, sizeof(*a));
@@ -226,7 +226,7 @@ void BN_free(BIGNUM *a)
 {
     if (a == NULL)
         return;
-    if (!BN_get_flags(a, BN_FLG_STATIC_DATA))
+    if (!BN_get_flags(a, BN_FLG_STATIC_DATA | BN_FLG_ARENA))
         bn_free_d(a, 0);
     if (a->flags & BN_FLG_MALLOCED)
         OPENSSL_free(a);
@@ -301,7 +301,10 @@ BIGNUM *bn_expand2(BIGNUM *b, int words)
         BN_ULONG *a = bn_expand_internal(b, words);
         if (!a)
             return NULL;
-        if (b->d != NULL)
+        /* Words from an arena stay with the arena */
+        if (BN_get_flags(b, BN_FLG_ARENA))
+            b->flags &= ~BN_FLG_ARENA;
+        else if (b->d != NULL)
             bn_free_d(b, 1);
         b->d = a;
         b->dmax = words;
@@ -355,9 +358,43 @@ BIGNUM *BN_copy(BIGNUM *a, const BIGNUM *b)
 #define FLAGS_DATA(flags) ((flags) & (BN_FLG_STATIC_DATA \
                                     | BN_FLG_CONSTTIME   \
                                     | BN_FLG_SECURE      \
-                                    | BN_FLG_FIXED_TOP))
+                                    | BN_FLG_FIXED_TOP   \
+                                    | BN_FLG_ARENA))
 #define FLAGS_STRUCT(flags) ((flags) & (BN_FLG_MALLOCED))
 
+/*
+ * Exchanges the values of |a| and |b| through the words each of them already
+ * has, growing them only if the other value doesn't fit.
+ */
+static void bn_swap_values(BIGNUM *a, BIGNUM *b)
+{
+    BN_ULONG tmp_w;
+    int i, n, tmp;
+
+    if (bn_wexpand(a, b->top) == NULL || bn_wexpand(b, a->top) == NULL)
+        return;
+
+    n = a->top > b->top ? a->top : b->top;
+    for (i = 0; i < n; i++) {
+        tmp_w = a->d[i];
+        a->d[i] = b->d[i];
+        b->d[i] = tmp_w;
+    }
+
+    tmp = a->top;
+    a->top = b->top;
+    b->top = tmp;
+    tmp = a->neg;
+    a->neg = b->neg;
+    b->neg = tmp;
+
+    tmp = a->flags;
+    a->flags = (a->flags & ~(BN_FLG_CONSTTIME | BN_FLG_FIXED_TOP))
+               | (b->flags & (BN_FLG_CONSTTIME | BN_FLG_FIXED_TOP));
+    b->flags = (b->flags & ~(BN_FLG_CONSTTIME | BN_FLG_FIXED_TOP))
+               | (tmp & (BN_FLG_CONSTTIME | BN_FLG_FIXED_TOP));
+}
+
 void BN_swap(BIGNUM *a, BIGNUM *b)
 {
     int flags_old_a, flags_old_b;
@@ -367,6 +404,18 @@ void BN_swap(BIGNUM *a, BIGNUM *b)
     bn_check_top(a);
     bn_check_top(b);
 
+    /*
+     * Words from a BN_CTX arena stay with the bignums of its pool, which keep
+     * them until the BN_CTX is done with the operation, so they are only
+     * exchanged between two of those.
+     */
+    if (BN_get_flags(a, BN_FLG_ARENA) != BN_get_flags(b, BN_FLG_ARENA)) {
+        bn_swap_values(a, b);
+        bn_check_top(a);
+        bn_check_top(b);
+        return;
+    }
+
     flags_old_a = a->flags;
     flags_old_b = b->flags;
 
@@ -1045,7 +1094,7 @@ void BN_with_flags(BIGNUM *dest, const BIGNUM *b, int flags)
     dest->dmax = b->dmax;
     dest->neg = b->neg;
     dest->flags = ((dest->flags & BN_FLG_MALLOCED)
-                   | (b->flags & ~BN_FLG_MALLOCED)
+                   | (b->flags & ~(BN_FLG_MALLOCED | BN_FLG_ARENA))
                    | BN_FLG_STATIC_DATA | flags);
 }
 
@@ -167,6 +167,12 @@
  * coverage for openssl's own code.
  */
 
+/*
+ * Marks the words of a bignum from a BN_CTX in arena mode, which belong to
+ * the BN_CTX rather than to the bignum, see bn_ctx.c.
+ */
+# define BN_FLG_ARENA 0x20000
+
 # ifdef BN_DEBUG
 /*
  * The new BN_FLG_FIXED_TOP flag marks vectors that were not treated with
@@ -366,6 +372,33 @@ struct bn_gencb_st {
 # define BN_SQR_RECURSIVE_SIZE_NORMAL            (16)/* 32 */
 # define BN_MUL_LOW_RECURSIVE_SIZE_NORMAL        (32)/* 32 */
 # define BN_MONT_CTX_SET_SIZE_WORD               (64)/* 32 */
+/*
+ * The sizes in words from which BN_mul() and BN_sqr() use Karatsuba for
+ * numbers whose size isn't a power of 2, which have more overhead than the
+ * powers of 2 above, and Toom-3 rather than Karatsuba.  test/bn_mul_calibrate
+ * measures them for a build.
+ */
+# ifndef BN_MUL_KARATSUBA_SIZE_NORMAL
+#  define BN_MUL_KARATSUBA_SIZE_NORMAL           (32)
+# endif
+# ifndef BN_SQR_KARATSUBA_SIZE_NORMAL
+#  define BN_SQR_KARATSUBA_SIZE_NORMAL           (48)
+# endif
+# ifndef BN_MUL_TOOM3_SIZE_NORMAL
+#  define BN_MUL_TOOM3_SIZE_NORMAL               (288)
+# endif
+# ifndef BN_SQR_TOOM3_SIZE_NORMAL
+#  define BN_SQR_TOOM3_SIZE_NORMAL               (192)
+# endif
+
+/*
+ * Which operand size ossl_bn_mul_get_threshold() and
+ * ossl_bn_mul_set_threshold() are about
+ */
+# define BN_MUL_THRESHOLD_KARATSUBA              0
+# define BN_MUL_THRESHOLD_TOOM3                  1
+# define BN_SQR_THRESHOLD_KARATSUBA              2
+# define BN_SQR_THRESHOLD_TOOM3                  3
 
 # if !defined(OPENSSL_NO_ASM) && !defined(OPENSSL_NO_INLINE_ASM) && !defined(PEDANTIC)
 /*
@@ -654,6 +687,15 @@ void bn_mul_recursive(BN_ULONG *r, BN_ULONG *a, BN_ULONG *b, int n2,
 void bn_mul_part_recursive(BN_ULONG *r, BN_ULONG *a, BN_ULONG *b,
                            int n, int tna, int tnb, BN_ULONG *t);
 void bn_sqr_recursive(BN_ULONG *r, const BN_ULONG *a, int n2, BN_ULONG *t);
+void bn_mul_karatsuba(BN_ULONG *r, BN_ULONG *a, BN_ULONG *b, int n,
+                      BN_ULONG *t);
+void bn_sqr_karatsuba(BN_ULONG *r, const BN_ULONG *a, int n, BN_ULONG *t);
+BN_ULONG bn_cond_neg_words(BN_ULONG *r, int n, BN_ULONG neg);
+BN_ULONG bn_abs_sub_words(BN_ULONG *r, const BN_ULONG *a, const BN_ULONG *b,
+                          int n);
+int bn_mul_toom3(BIGNUM *r, const BIGNUM *a, const BIGNUM *b, BN_CTX *ctx);
+int ossl_bn_mul_get_threshold(int which);
+int ossl_bn_mul_set_threshold(int which, int words);
 void bn_mul_low_normal(BN_ULONG *r, BN_ULONG *a, BN_ULONG *b, int n);
 void bn_mul_low_recursive(BN_ULONG *r, BN_ULONG *a, BN_ULONG *b, int n2,
                           BN_ULONG *t);
@@ -665,6 +707,9 @@ void bn_correct_top_consttime(BIGNUM *a);
 BIGNUM *int_bn_mod_inverse(BIGNUM *in,
                            const BIGNUM *a, const BIGNUM *n, BN_CTX *ctx,
                            int *noinv);
+BIGNUM *bn_mod_inverse_safegcd(BIGNUM *in,
+                               const BIGNUM *a, const BIGNUM *n, BN_CTX *ctx,
+                               int *pnoinv);
 
 static ossl_inline BIGNUM *bn_expand(BIGNUM *a, int bits)
 {
@@ -680,4 +725,98 @@ static ossl_inline BIGNUM *bn_expand(BIGNUM *a, int bits)
 int ossl_bn_check_prime(const BIGNUM *w, int checks, BN_CTX *ctx,
                         int do_trial_division, BN_GENCB *cb);
 
+/* Strikes out candidates base + k * step with small factors, see bn_prime.c */
+typedef struct bn_sieve_st BN_SIEVE;
+
+BN_SIEVE *ossl_bn_sieve_new(int bits, int safe);
+void ossl_bn_sieve_free(BN_SIEVE *sieve);
+int ossl_bn_sieve_start(BN_SIEVE *sieve, const BIGNUM *base,
+                        const BIGNUM *step);
+BN_ULONG ossl_bn_sieve_next(BN_SIEVE *sieve);
+int ossl_bn_check_sieved_prime(const BIGNUM *w, int checks, BN_CTX *ctx,
+                               BN_GENCB *cb);
+
+/*
+ * Fixed size Montgomery multiplication in C for common modulus sizes, for
+ * targets without Montgomery multiplication in assembler that can do double
+ * word multiplication in C.
+ */
+# if defined(UINT128_MAX) && !defined(OPENSSL_BN_ASM_MONT) \
+     && (defined(SIXTY_FOUR_BIT) || defined(SIXTY_FOUR_BIT_LONG))
+#  define BN_MONT_FIXED_ENABLED
+
+/*
+ * One outer step of word by word Montgomery multiplication of fully reduced
+ * numbers: t = (t + a * b + m * n) / 2^BN_BITS2, with m chosen to clear the
+ * low word, where k = -1/n mod 2^BN_BITS2.  t has num + 2 words, and starts
+ * out as num + 1 zero words.
+ */
+static ossl_inline void bn_mont_fixed_step(BN_ULONG *t, const BN_ULONG *a,
+                                           BN_ULONG b, const BN_ULONG *n,
+                                           BN_ULONG k, int num)
+{
+    BN_ULONG c, m;
+    uint128_t w;
+    int j;
+
+    for (c = 0, j = 0; j < num; j++) {
+        w = (uint128_t)a[j] * b + t[j] + c;
+        t[j] = (BN_ULONG)w;
+        c = (BN_ULONG)(w >> BN_BITS2);
+    }
+    w = (uint128_t)t[num] + c;
+    t[num] = (BN_ULONG)w;
+    t[num + 1] = (BN_ULONG)(w >> BN_BITS2);
+
+    m = t[0] * k;
+    w = (uint128_t)m * n[0] + t[0];
+    c = (BN_ULONG)(w >> BN_BITS2);
+    for (j = 1; j < num; j++) {
+        w = (uint128_t)m * n[j] + t[j] + c;
+        t[j - 1] = (BN_ULONG)w;
+        c = (BN_ULONG)(w >> BN_BITS2);
+    }
+    w = (uint128_t)t[num] + c;
+    t[num - 1] = (BN_ULONG)w;
+    t[num] = t[num + 1] + (BN_ULONG)(w >> BN_BITS2);
+}
+
+/*
+ * r = t - n if that doesn't borrow beyond |top|, which is the word above the
+ * |num| words of |t|, or else r = t, without branching on which.
+ */
+static ossl_inline void bn_mont_fixed_sub_cond(BN_ULONG *r, const BN_ULONG *t,
+                                               BN_ULONG top,
+                                               const BN_ULONG *n, int num)
+{
+    BN_ULONG d, borrow = 0, mask;
+    int j;
+
+    for (j = 0; j < num; j++) {
+        d = t[j] - n[j] - borrow;
+        borrow = (d > t[j]) | ((d == t[j]) & borrow);
+        r[j] = d;
+    }
+    mask = top - borrow;
+    for (j = 0; j < num; j++)
+        r[j] = (t[j] & mask) | (r[j] & ~mask);
+}
+# endif
+
+/*
+ * Portable interleaved exponentiation for BN_mod_exp_mont_consttime_x2(),
+ * on the same targets, using the kernel above.
+ */
+# ifdef BN_MONT_FIXED_ENABLED
+#  define BN_EXP_X2_ENABLED
+int ossl_bn_mod_exp_mont_x2_eligible(const BIGNUM *a1, const BIGNUM *p1,
+                                     const BIGNUM *m1,
+                                     const BIGNUM *a2, const BIGNUM *p2,
+                                     const BIGNUM *m2);
+int ossl_bn_mod_exp_mont_x2(BIGNUM *rr1, const BIGNUM *a1, const BIGNUM *p1,
+                            const BN_MONT_CTX *mont1,
+                            BIGNUM *rr2, const BIGNUM *a2, const BIGNUM *p2,
+                            const BN_MONT_CTX *mont2);
+# endif
+
 #endif
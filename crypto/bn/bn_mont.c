@@ -23,6 +23,120 @@
 static int bn_from_montgomery_word(BIGNUM *ret, BIGNUM *r, BN_MONT_CTX *mont);
 #endif
 
+#ifdef BN_MONT_FIXED_ENABLED
+/* The largest modulus size in words that has a fixed size kernel */
+# define MONT_FIXED_MAX_WORDS   32
+
+typedef void mont_fixed_fn(BN_ULONG *r, const BN_ULONG *a, const BN_ULONG *b,
+                           const BN_ULONG *n, BN_ULONG k);
+
+/*
+ * r = a * b / R mod n for fully reduced inputs, where k = -1/n mod
+ * 2^BN_BITS2, interleaving multiplication and reduction word by word.
+ */
+static ossl_inline void mont_mul_fixed(BN_ULONG *r, const BN_ULONG *a,
+                                       const BN_ULONG *b, const BN_ULONG *n,
+                                       BN_ULONG k, int num)
+{
+    BN_ULONG t[MONT_FIXED_MAX_WORDS + 2];
+    int i;
+
+    memset(t, 0, sizeof(*t) * (num + 1));
+    for (i = 0; i < num; i++)
+        bn_mont_fixed_step(t, a, b[i], n, k, num);
+    bn_mont_fixed_sub_cond(r, t, t[num], n, num);
+}
+
+/*
+ * r = a^2 / R mod n, computing each cross product a[i] * a[j] only once
+ * before reducing the double width square.
+ */
+static ossl_inline void mont_sqr_fixed(BN_ULONG *r, const BN_ULONG *a,
+                                       const BN_ULONG *n, BN_ULONG k, int num)
+{
+    BN_ULONG t[2 * MONT_FIXED_MAX_WORDS], c, m, carry;
+    uint128_t w;
+    int i, j;
+
+    /* The cross products, once */
+    memset(t, 0, sizeof(*t) * 2 * num);
+    for (i = 0; i < num - 1; i++) {
+        for (c = 0, j = i + 1; j < num; j++) {
+            w = (uint128_t)a[i] * a[j] + t[i + j] + c;
+            t[i + j] = (BN_ULONG)w;
+            c = (BN_ULONG)(w >> BN_BITS2);
+        }
+        t[i + num] = c;
+    }
+
+    /* Double them and add the squares */
+    for (i = 2 * num - 1; i > 0; i--)
+        t[i] = (t[i] << 1) | (t[i - 1] >> (BN_BITS2 - 1));
+    t[0] <<= 1;
+    for (c = 0, i = 0; i < num; i++) {
+        w = (uint128_t)a[i] * a[i] + t[2 * i] + c;
+        t[2 * i] = (BN_ULONG)w;
+        w = (uint128_t)t[2 * i + 1] + (BN_ULONG)(w >> BN_BITS2);
+        t[2 * i + 1] = (BN_ULONG)w;
+        c = (BN_ULONG)(w >> BN_BITS2);
+    }
+
+    /* Add multiples of n until R divides t, as bn_from_montgomery_word() */
+    for (carry = 0, i = 0; i < num; i++) {
+        m = t[i] * k;
+        for (c = 0, j = 0; j < num; j++) {
+            w = (uint128_t)m * n[j] + t[i + j] + c;
+            t[i + j] = (BN_ULONG)w;
+            c = (BN_ULONG)(w >> BN_BITS2);
+        }
+        w = (uint128_t)t[i + num] + c + carry;
+        t[i + num] = (BN_ULONG)w;
+        carry = (BN_ULONG)(w >> BN_BITS2);
+    }
+    bn_mont_fixed_sub_cond(r, t + num, carry, n, num);
+}
+
+/*
+ * Instances for 256 and 384-bit moduli, as used by the NIST curves, and
+ * 1024, 1536 and 2048-bit ones, as used by RSA-CRT and finite field DH,
+ * which let the compiler unroll the loops.
+ */
+# define DEFINE_MONT_FIXED(num)                                             \
+    static void mont_mul_##num(BN_ULONG *r, const BN_ULONG *a,             \
+                               const BN_ULONG *b, const BN_ULONG *n,       \
+                               BN_ULONG k)                                 \
+    {                                                                      \
+        if (a == b)                                                        \
+            mont_sqr_fixed(r, a, n, k, num);                               \
+        else                                                               \
+            mont_mul_fixed(r, a, b, n, k, num);                            \
+    }
+
+DEFINE_MONT_FIXED(4)
+DEFINE_MONT_FIXED(6)
+DEFINE_MONT_FIXED(16)
+DEFINE_MONT_FIXED(24)
+DEFINE_MONT_FIXED(32)
+
+/* Returns the fixed size kernel for a |num| word modulus, if there is one */
+static mont_fixed_fn *mont_fixed_kernel(int num)
+{
+    switch (num) {
+    case 4:
+        return mont_mul_4;
+    case 6:
+        return mont_mul_6;
+    case 16:
+        return mont_mul_16;
+    case 24:
+        return mont_mul_24;
+    case 32:
+        return mont_mul_32;
+    }
+    return NULL;
+}
+#endif
+
 int BN_mod_mul_montgomery(BIGNUM *r, const BIGNUM *a, const BIGNUM *b,
                           BN_MONT_CTX *mont, BN_CTX *ctx)
 {
@@ -40,6 +154,9 @@ int bn_mul_mont_fixed_top(BIGNUM *r, const BIGNUM *a, const BIGNUM *b,
     BIGNUM *tmp;
     int ret = 0;
     int num = mont->N.top;
+#ifdef BN_MONT_FIXED_ENABLED
+    mont_fixed_fn *kernel;
+#endif
 
 #if defined(OPENSSL_BN_ASM_MONT) && defined(MONT_WORD)
     if (num > 1 && num <= BN_SOFT_LIMIT && a->top == num && b->top == num) {
@@ -54,6 +171,19 @@ int bn_mul_mont_fixed_top(BIGNUM *r, const BIGNUM *a, const BIGNUM *b,
     }
 #endif
 
+#ifdef BN_MONT_FIXED_ENABLED
+    if (a->top == num && b->top == num
+            && (kernel = mont_fixed_kernel(num)) != NULL) {
+        if (bn_wexpand(r, num) == NULL)
+            return 0;
+        kernel(r->d, a->d, b->d, mont->N.d, mont->n0[0]);
+        r->neg = a->neg ^ b->neg;
+        r->top = num;
+        r->flags |= BN_FLG_FIXED_TOP;
+        return 1;
+    }
+#endif
+
     if ((a->top + b->top) > 2 * num)
         return 0;
 
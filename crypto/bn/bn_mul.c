@@ -9,6 +9,7 @@
 
 #include <assert.h>
 #include "internal/cryptlib.h"
+#include "internal/tsan_assist.h"
 #include "bn_local.h"
 
 #if defined(OPENSSL_NO_ASM) || !defined(OPENSSL_BN_ASM_PART_WORDS)
@@ -470,6 +471,100 @@ void bn_mul_part_recursive(BN_ULONG *r, BN_ULONG *a, BN_ULONG *b, int n,
     }
 }
 
+/*
+ * Negates the n words of r, as a two's complement number, if neg is 1 and
+ * leaves them alone if it is 0, without branching on it.  Returns the carry
+ * out, which is 1 only to negate zero.
+ */
+BN_ULONG bn_cond_neg_words(BN_ULONG *r, int n, BN_ULONG neg)
+{
+    BN_ULONG mask = (BN_ULONG)0 - neg, c = neg, v;
+    int i;
+
+    for (i = 0; i < n; i++) {
+        v = ((r[i] ^ mask) + c) & BN_MASK2;
+        c = v < c;
+        r[i] = v;
+    }
+    return c;
+}
+
+/*
+ * r = |a - b|, for a and b of n words.  Returns 1 if a < b and 0 otherwise,
+ * without branching on it.
+ */
+BN_ULONG bn_abs_sub_words(BN_ULONG *r, const BN_ULONG *a, const BN_ULONG *b,
+                          int n)
+{
+    BN_ULONG neg = bn_sub_words(r, a, b, n);
+
+    bn_cond_neg_words(r, n, neg);
+    return neg;
+}
+
+/*-
+ * Karatsuba multiplication of numbers of any size n, not just a power of 2.
+ * r needs 2*n words and t needs 8*n.  With h = (n + 1) / 2, a and b are
+ * split in a[0] of h words and a[1] of n - h words, and we calculate
+ * a[0]*b[0]
+ * a[0]*b[0]+a[1]*b[1]+(a[0]-a[1])*(b[1]-b[0])
+ * a[1]*b[1]
+ */
+void bn_mul_karatsuba(BN_ULONG *r, BN_ULONG *a, BN_ULONG *b, int n,
+                      BN_ULONG *t)
+{
+    int h = (n + 1) / 2, l = n - h, i;
+    BN_ULONG neg, c, v, *p;
+
+    if ((n & (n - 1)) == 0) {
+        bn_mul_recursive(r, a, b, n, 0, 0, t);
+        return;
+    }
+    if (n < ossl_bn_mul_get_threshold(BN_MUL_THRESHOLD_KARATSUBA)
+        || n < BN_MUL_RECURSIVE_SIZE_NORMAL) {
+        bn_mul_normal(r, a, n, b, n);
+        return;
+    }
+
+    /*
+     * t[0..h) = |a[0]-a[1]|, t[h..2h) = |b[1]-b[0]|, using r to pad a[1]
+     * and b[1] to h words.  neg is the sign of their product.
+     */
+    memcpy(r, &a[h], sizeof(*r) * l);
+    memcpy(&r[h], &b[h], sizeof(*r) * l);
+    r[h - 1] &= 0 - (BN_ULONG)(h == l);
+    r[2 * h - 1] &= 0 - (BN_ULONG)(h == l);
+    neg = bn_abs_sub_words(t, a, r, h);
+    neg ^= bn_abs_sub_words(&t[h], &r[h], b, h);
+
+    p = &t[4 * h];
+    bn_mul_karatsuba(&t[2 * h], t, &t[h], h, p);
+    bn_mul_karatsuba(r, a, b, h, p);
+    bn_mul_karatsuba(&r[2 * h], &a[h], &b[h], l, p);
+
+    /*-
+     * t[2h] holds |(a[0]-a[1])*(b[1]-b[0])|, negated if neg is 1
+     * r[0] holds a[0]*b[0], r[2h] holds a[1]*b[1]
+     * Make t[0] a[0]*b[0]+a[1]*b[1]+(a[0]-a[1])*(b[1]-b[0]), with the carry
+     * in c, and add it to r[h].
+     */
+    c = bn_add_words(t, r, &r[2 * h], 2 * l);
+    for (i = 2 * l; i < 2 * h; i++) {
+        v = (r[i] + c) & BN_MASK2;
+        c = v < c;
+        t[i] = v;
+    }
+    c += bn_cond_neg_words(&t[2 * h], 2 * h, neg);
+    c += bn_add_words(t, t, &t[2 * h], 2 * h);
+    c -= neg;
+    c += bn_add_words(&r[h], &r[h], t, 2 * h);
+    for (i = 3 * h; c != 0 && i < 2 * n; i++) {
+        v = (r[i] + c) & BN_MASK2;
+        c = v < c;
+        r[i] = v;
+    }
+}
+
 /*-
  * a and b must be the same size, which is n2.
  * r needs to be n2 words and t needs to be n2*2
@@ -494,6 +589,200 @@ void bn_mul_low_recursive(BN_ULONG *r, BN_ULONG *a, BN_ULONG *b, int n2,
 }
 #endif                          /* BN_RECURSION */
 
+/*
+ * The operand sizes in words from which BN_mul() and BN_sqr() switch
+ * algorithms, indexed by BN_MUL_THRESHOLD_KARATSUBA and friends.  Only
+ * test/bn_mul_calibrate changes them, to measure where each algorithm starts
+ * to pay off; a build that wants other values defines the *_SIZE_NORMAL
+ * macros in bn_local.h.  They're read and written atomically, so that
+ * changing them doesn't race with threads that are multiplying.
+ */
+static TSAN_QUALIFIER int bn_mul_thresholds[] = {
+    BN_MUL_KARATSUBA_SIZE_NORMAL,
+    BN_MUL_TOOM3_SIZE_NORMAL,
+    BN_SQR_KARATSUBA_SIZE_NORMAL,
+    BN_SQR_TOOM3_SIZE_NORMAL
+};
+
+int ossl_bn_mul_get_threshold(int which)
+{
+    if (which < 0 || which >= (int)OSSL_NELEM(bn_mul_thresholds))
+        return 0;
+    return tsan_load(&bn_mul_thresholds[which]);
+}
+
+/*
+ * Sets a threshold, INT_MAX to never use the algorithm.  Operations already
+ * under way may pick up the new value part way, which only changes how they
+ * get their result.
+ */
+int ossl_bn_mul_set_threshold(int which, int words)
+{
+    int min = which == BN_MUL_THRESHOLD_TOOM3 || which == BN_SQR_THRESHOLD_TOOM3
+              ? 24 : 8;
+
+    if (which < 0 || which >= (int)OSSL_NELEM(bn_mul_thresholds)
+        || words < min)
+        return 0;
+    tsan_store(&bn_mul_thresholds[which], words);
+    return 1;
+}
+
+#ifdef BN_RECURSION
+/*
+ * Divides |a| in place by 3, which must divide it exactly, from the least
+ * significant word up by multiplying with the inverse of 3.
+ */
+static void bn_div3_exact(BIGNUM *a)
+{
+    const BN_ULONG inv3 = (BN_MASK2 / 3) * 2 + 1;
+    BN_ULONG c = 0, s, q;
+    int i;
+
+    for (i = 0; i < a->top; i++) {
+        s = a->d[i];
+        q = ((s - c) * inv3) & BN_MASK2;
+        c = (s < c) + (q > BN_MASK2 / 3) + (q > (BN_MASK2 / 3) * 2);
+        a->d[i] = q;
+    }
+    bn_correct_top(a);
+    if (a->top == 0)
+        a->neg = 0;
+}
+
+/*
+ * Sets |part| to a read only view of |k| words of |a| from word |from|
+ */
+static void bn_toom3_part(BIGNUM *part, const BIGNUM *a, int from, int k)
+{
+    int n = a->top - from;
+
+    bn_init(part);
+    if (n > 0)
+        bn_set_static_words(part, a->d + from, n < k ? n : k);
+}
+
+/*
+ * Sets |p1|, |pm1| and |pm2| to x0 + x1 * X + x2 * X^2 at X = 1, -1 and -2
+ */
+static int bn_toom3_eval(BIGNUM *p1, BIGNUM *pm1, BIGNUM *pm2,
+                         const BIGNUM *x0, const BIGNUM *x1, const BIGNUM *x2)
+{
+    return BN_add(pm2, x0, x2)
+        && BN_add(p1, pm2, x1)
+        && BN_sub(pm1, pm2, x1)
+        && BN_add(pm2, pm1, x2)
+        && BN_lshift1(pm2, pm2)
+        && BN_sub(pm2, pm2, x0);
+}
+
+static int bn_toom3_mul(BIGNUM *r, const BIGNUM *a, const BIGNUM *b,
+                        BN_CTX *ctx)
+{
+    return a == b ? BN_sqr(r, a, ctx) : BN_mul(r, a, b, ctx);
+}
+
+/*
+ * r = |a| * |b|, or |a|^2 if a == b, by Toom-Cook 3-way multiplication:
+ * a and b are split in three parts of k words, seen as polynomials in
+ * X = 2^(k * BN_BITS2) and multiplied through their values at 0, 1, -1, -2
+ * and infinity, with the interpolation sequence of Bodrato.  The five
+ * products of about k words are done by BN_mul() or BN_sqr(), and may use
+ * Toom-3 again.  Like Karatsuba, this is not constant time.  r must not be
+ * a or b, and gets a->top + b->top words.
+ */
+int bn_mul_toom3(BIGNUM *r, const BIGNUM *a, const BIGNUM *b, BN_CTX *ctx)
+{
+    BIGNUM a0, a1, a2, b0, b1, b2;
+    BIGNUM *w0, *w1, *wm1, *wm2, *winf, *q1, *qm1, *qm2, *t;
+    int top = a->top + b->top, k, i, ret = 0;
+
+    k = ((a->top > b->top ? a->top : b->top) + 2) / 3;
+    bn_toom3_part(&a0, a, 0, k);
+    bn_toom3_part(&a1, a, k, k);
+    bn_toom3_part(&a2, a, 2 * k, k);
+    bn_toom3_part(&b0, b, 0, k);
+    bn_toom3_part(&b1, b, k, k);
+    bn_toom3_part(&b2, b, 2 * k, k);
+
+    BN_CTX_start(ctx);
+    w0 = BN_CTX_get(ctx);
+    w1 = BN_CTX_get(ctx);
+    wm1 = BN_CTX_get(ctx);
+    wm2 = BN_CTX_get(ctx);
+    winf = BN_CTX_get(ctx);
+    q1 = BN_CTX_get(ctx);
+    qm1 = BN_CTX_get(ctx);
+    qm2 = BN_CTX_get(ctx);
+    t = BN_CTX_get(ctx);
+    if (t == NULL)
+        goto err;
+
+    /* Evaluation, and the pointwise products */
+    if (!bn_toom3_eval(w1, wm1, wm2, &a0, &a1, &a2))
+        goto err;
+    if (a == b) {
+        q1 = w1;
+        qm1 = wm1;
+        qm2 = wm2;
+    } else if (!bn_toom3_eval(q1, qm1, qm2, &b0, &b1, &b2)) {
+        goto err;
+    }
+    if (!bn_toom3_mul(w0, &a0, a == b ? &a0 : &b0, ctx)
+        || !bn_toom3_mul(w1, w1, q1, ctx)
+        || !bn_toom3_mul(wm1, wm1, qm1, ctx)
+        || !bn_toom3_mul(wm2, wm2, qm2, ctx)
+        || !bn_toom3_mul(winf, &a2, a == b ? &a2 : &b2, ctx))
+        goto err;
+
+    /*-
+     * Interpolation, leaving the coefficients of the product in
+     * w0, w1, wm1, wm2 and winf:
+     * wm2 = (wm2 - w1) / 3
+     * w1 = (w1 - wm1) / 2
+     * wm1 = wm1 - w0
+     * wm2 = (wm1 - wm2) / 2 + 2 * winf
+     * wm1 = wm1 + w1 - winf
+     * w1 = w1 - wm2
+     */
+    if (!BN_sub(wm2, wm2, w1))
+        goto err;
+    bn_div3_exact(wm2);
+    if (!BN_sub(w1, w1, wm1)
+        || !BN_rshift1(w1, w1)
+        || !BN_sub(wm1, wm1, w0)
+        || !BN_sub(wm2, wm1, wm2)
+        || !BN_rshift1(wm2, wm2)
+        || !BN_lshift1(t, winf)
+        || !BN_add(wm2, wm2, t)
+        || !BN_add(wm1, wm1, w1)
+        || !BN_sub(wm1, wm1, winf)
+        || !BN_sub(w1, w1, wm2))
+        goto err;
+
+    /* r = (((winf * X + wm2) * X + wm1) * X + w1) * X + w0 */
+    if (BN_copy(r, winf) == NULL
+        || !BN_lshift(r, r, k * BN_BITS2)
+        || !BN_add(r, r, wm2)
+        || !BN_lshift(r, r, k * BN_BITS2)
+        || !BN_add(r, r, wm1)
+        || !BN_lshift(r, r, k * BN_BITS2)
+        || !BN_add(r, r, w1)
+        || !BN_lshift(r, r, k * BN_BITS2)
+        || !BN_add(r, r, w0)
+        || bn_wexpand(r, top) == NULL)
+        goto err;
+    for (i = r->top; i < top; i++)
+        r->d[i] = 0;
+    r->top = top;
+    r->neg = 0;
+    ret = 1;
+ err:
+    BN_CTX_end(ctx);
+    return ret;
+}
+#endif                          /* BN_RECURSION */
+
 int BN_mul(BIGNUM *r, const BIGNUM *a, const BIGNUM *b, BN_CTX *ctx)
 {
     int ret = bn_mul_fixed_top(r, a, b, ctx);
@@ -514,7 +803,7 @@ int bn_mul_fixed_top(BIGNUM *r, const BIGNUM *a, const BIGNUM *b, BN_CTX *ctx)
 #endif
 #ifdef BN_RECURSION
     BIGNUM *t = NULL;
-    int j = 0, k;
+    int n, toom3;
 #endif
 
     bn_check_top(a);
@@ -561,39 +850,43 @@ int bn_mul_fixed_top(BIGNUM *r, const BIGNUM *a, const BIGNUM *b, BN_CTX *ctx)
     }
 #endif                          /* BN_MUL_COMBA */
 #ifdef BN_RECURSION
-    if ((al >= BN_MULL_SIZE_NORMAL) && (bl >= BN_MULL_SIZE_NORMAL)) {
+    n = al > bl ? al : bl;
+    /* Karatsuba on a power of 2 is faster than Toom-3 on the same size */
+    toom3 = ossl_bn_mul_get_threshold(BN_MUL_THRESHOLD_TOOM3);
+    if (al >= toom3 && bl >= toom3
+        && 3 * (i < 0 ? -i : i) < n
+        && (i < -1 || i > 1 || (n & (n - 1)) != 0)
+        && BN_get_flags(a, BN_FLG_CONSTTIME) == 0
+        && BN_get_flags(b, BN_FLG_CONSTTIME) == 0) {
+        if (!bn_mul_toom3(rr, a, b, ctx))
+            goto err;
+        goto end;
+    }
+    if ((al >= BN_MULL_SIZE_NORMAL) && (bl >= BN_MULL_SIZE_NORMAL)
+        && ((n & (n - 1)) == 0
+            || n >= ossl_bn_mul_get_threshold(BN_MUL_THRESHOLD_KARATSUBA))) {
         if (i >= -1 && i <= 1) {
+            BN_ULONG *ad = a->d, *bd = b->d;
+
             /*
-             * Find out the power of two lower or equal to the longest of the
-             * two numbers
+             * Karatsuba needs both numbers the same size, so the shorter one
+             * is padded with a zero word in t after the 8 * n words for
+             * bn_mul_karatsuba() itself
              */
-            if (i >= 0) {
-                j = BN_num_bits_word((BN_ULONG)al);
-            }
-            if (i == -1) {
-                j = BN_num_bits_word((BN_ULONG)bl);
-            }
-            j = 1 << (j - 1);
-            assert(j <= al || j <= bl);
-            k = j + j;
             t = BN_CTX_get(ctx);
-            if (t == NULL)
+            if (t == NULL
+                || bn_wexpand(t, 9 * n) == NULL
+                || bn_wexpand(rr, 2 * n) == NULL)
                 goto err;
-            if (al > j || bl > j) {
-                if (bn_wexpand(t, k * 4) == NULL)
-                    goto err;
-                if (bn_wexpand(rr, k * 4) == NULL)
-                    goto err;
-                bn_mul_part_recursive(rr->d, a->d, b->d,
-                                      j, al - j, bl - j, t->d);
-            } else {            /* al <= j || bl <= j */
-
-                if (bn_wexpand(t, k * 2) == NULL)
-                    goto err;
-                if (bn_wexpand(rr, k * 2) == NULL)
-                    goto err;
-                bn_mul_recursive(rr->d, a->d, b->d, j, al - j, bl - j, t->d);
+            if (i != 0) {
+                memcpy(&t->d[8 * n], i < 0 ? ad : bd, sizeof(*ad) * (n - 1));
+                t->d[9 * n - 1] = 0;
+                if (i < 0)
+                    ad = &t->d[8 * n];
+                else
+                    bd = &t->d[8 * n];
             }
+            bn_mul_karatsuba(rr->d, ad, bd, n, t->d);
             rr->top = top;
             goto end;
         }
@@ -19,8 +19,8 @@
  */
 #include "bn_prime.h"
 
-static int probable_prime(BIGNUM *rnd, int bits, int safe, prime_t *mods,
-                          BN_CTX *ctx);
+static int probable_prime(BIGNUM *rnd, int bits, int safe, BN_SIEVE *sieve,
+                          int next, BN_CTX *ctx);
 static int probable_prime_dh(BIGNUM *rnd, int bits, int safe, prime_t *mods,
                              const BIGNUM *add, const BIGNUM *rem,
                              BN_CTX *ctx);
@@ -128,6 +128,7 @@ int BN_generate_prime_ex2(BIGNUM *ret, int bits, int safe,
     int found = 0;
     int i, j, c1 = 0;
     prime_t *mods = NULL;
+    BN_SIEVE *sieve = NULL;
     int checks = bn_mr_min_checks(bits);
 
     if (bits < 2) {
@@ -144,18 +145,25 @@ int BN_generate_prime_ex2(BIGNUM *ret, int bits, int safe,
         return 0;
     }
 
-    mods = OPENSSL_zalloc(sizeof(*mods) * NUMPRIMES);
-    if (mods == NULL)
-        return 0;
+    if (add == NULL) {
+        if ((sieve = ossl_bn_sieve_new(bits, safe)) == NULL)
+            return 0;
+    } else {
+        if ((mods = OPENSSL_zalloc(sizeof(*mods) * NUMPRIMES)) == NULL)
+            return 0;
+    }
 
     BN_CTX_start(ctx);
     t = BN_CTX_get(ctx);
     if (t == NULL)
         goto err;
  loop:
-    /* make a random number and set the top and bottom bits */
+    /*
+     * make a random number and set the top and bottom bits, or carry on
+     * sieving from the candidate that failed
+     */
     if (add == NULL) {
-        if (!probable_prime(ret, bits, safe, mods, ctx))
+        if (!probable_prime(ret, bits, safe, sieve, c1 > 0, ctx))
             goto err;
     } else {
         if (!probable_prime_dh(ret, bits, safe, mods, add, rem, ctx))
@@ -202,6 +210,7 @@ int BN_generate_prime_ex2(BIGNUM *ret, int bits, int safe,
     found = 1;
  err:
     OPENSSL_free(mods);
+    ossl_bn_sieve_free(sieve);
     BN_CTX_end(ctx);
     bn_check_top(ret);
     return found;
@@ -261,11 +270,189 @@ int ossl_bn_check_generated_prime(const BIGNUM *w, int checks, BN_CTX *ctx,
     return bn_is_prime_int(w, checks, ctx, 1, cb);
 }
 
+/*
+ * Use this only for key generation, for candidates from a BN_SIEVE.
+ * The sieve has already done the trial division.
+ */
+int ossl_bn_check_sieved_prime(const BIGNUM *w, int checks, BN_CTX *ctx,
+                               BN_GENCB *cb)
+{
+    return bn_is_prime_int(w, checks, ctx, 0, cb);
+}
+
 int BN_check_prime(const BIGNUM *p, BN_CTX *ctx, BN_GENCB *cb)
 {
     return ossl_bn_check_prime(p, 0, ctx, 1, cb);
 }
 
+/*
+ * A sieve over the candidates base + k * step, for k = 0, 1, 2, ..., that
+ * strikes out the candidates divisible by one of the small primes a window
+ * at a time. The residues modulo the small primes of the candidate at the
+ * start of the window are carried from window to window, so only |base|
+ * and |step| are ever divided by the small primes, and trial division costs
+ * next to nothing per candidate.
+ */
+#define BN_SIEVE_WINDOW 1024
+
+struct bn_sieve_st {
+    /* The small primes used are primes[1] to primes[nprimes] */
+    int nprimes;
+    /* Also strike out candidates c for which (c - 1) / 2 has small factors */
+    int safe;
+    /* The first candidate in the window, modulo each of the small primes */
+    prime_t *residues;
+    /* The inverse of step modulo each of the small primes, or 0 if none */
+    prime_t *step_inv;
+    /* BN_SIEVE_WINDOW * step modulo each of the small primes */
+    prime_t *step_window;
+    /* A set bit for each candidate struck out of the window */
+    unsigned char composite[BN_SIEVE_WINDOW / 8];
+    /* The k of the first candidate in the window, and of the next one */
+    BN_ULONG start, next;
+    /* The k of the candidate returned last */
+    BN_ULONG last;
+};
+
+/*
+ * Sieve with all the small primes, except that candidates of |bits| bits
+ * mustn't be struck out for being a small prime, or twice one plus one.
+ */
+static int calc_sieve_primes(int bits)
+{
+    int n = NUMPRIMES - 1;
+
+    if (bits < 18)
+        while (n > 0 && primes[n] >= 1U << (bits - 2))
+            n--;
+    return n;
+}
+
+BN_SIEVE *ossl_bn_sieve_new(int bits, int safe)
+{
+    BN_SIEVE *sieve = OPENSSL_zalloc(sizeof(*sieve));
+
+    if (sieve == NULL)
+        return NULL;
+    sieve->nprimes = calc_sieve_primes(bits);
+    sieve->safe = safe;
+    sieve->residues = OPENSSL_malloc(3 * sizeof(prime_t) * (NUMPRIMES));
+    if (sieve->residues == NULL) {
+        OPENSSL_free(sieve);
+        return NULL;
+    }
+    sieve->step_inv = sieve->residues + NUMPRIMES;
+    sieve->step_window = sieve->step_inv + NUMPRIMES;
+    return sieve;
+}
+
+void ossl_bn_sieve_free(BN_SIEVE *sieve)
+{
+    if (sieve == NULL)
+        return;
+    OPENSSL_free(sieve->residues);
+    OPENSSL_free(sieve);
+}
+
+/* Returns the inverse of |a| modulo the odd prime |p|, or 0 if there is none */
+static unsigned int inverse_mod_prime(unsigned int a, unsigned int p)
+{
+    int t = 0, newt = 1, q, tmp;
+    unsigned int r = p, newr = a, rtmp;
+
+    while (newr != 0) {
+        q = (int)(r / newr);
+        tmp = t - q * newt;
+        t = newt;
+        newt = tmp;
+        rtmp = r - q * newr;
+        r = newr;
+        newr = rtmp;
+    }
+    if (r != 1)
+        return 0;
+    return t < 0 ? (unsigned int)(t + (int)p) : (unsigned int)t;
+}
+
+static void sieve_fill_window(BN_SIEVE *sieve)
+{
+    unsigned int i, k, p, r, inv;
+
+    memset(sieve->composite, 0, sizeof(sieve->composite));
+    for (i = 1; i <= (unsigned int)sieve->nprimes; i++) {
+        p = primes[i];
+        r = sieve->residues[i];
+        inv = sieve->step_inv[i];
+        sieve->residues[i] = (prime_t)((r + sieve->step_window[i]) % p);
+        if (inv == 0)
+            continue;
+
+        /* The candidates in the window that are 0 modulo p */
+        for (k = (p - r) % p * inv % p; k < BN_SIEVE_WINDOW; k += p)
+            sieve->composite[k >> 3] |= 1 << (k & 7);
+        /* And those that are 1, for which (c - 1) / 2 is 0 modulo p */
+        if (sieve->safe)
+            for (k = (p + 1 - r) % p * inv % p; k < BN_SIEVE_WINDOW; k += p)
+                sieve->composite[k >> 3] |= 1 << (k & 7);
+    }
+}
+
+/*
+ * Starts sieving the candidates |base| + k * |step|.
+ * Returns 1 on success and 0 on error.
+ */
+int ossl_bn_sieve_start(BN_SIEVE *sieve, const BIGNUM *base,
+                        const BIGNUM *step)
+{
+    int i, j;
+    BN_ULONG m, b, s;
+
+    /*
+     * The product of two small primes fits in half a word, so each division
+     * of |base| reduces it modulo two primes at once
+     */
+    for (i = 1; i <= sieve->nprimes; i += 2) {
+        m = primes[i];
+        if (i < sieve->nprimes)
+            m *= primes[i + 1];
+        if ((b = BN_mod_word(base, m)) == (BN_ULONG)-1
+                || (s = BN_mod_word(step, m)) == (BN_ULONG)-1)
+            return 0;
+        for (j = i; j <= i + 1 && j <= sieve->nprimes; j++) {
+            sieve->residues[j] = (prime_t)(b % primes[j]);
+            sieve->step_inv[j] = (prime_t)inverse_mod_prime(s % primes[j],
+                                                           primes[j]);
+            sieve->step_window[j] = (prime_t)(BN_SIEVE_WINDOW % primes[j]
+                                              * (s % primes[j]) % primes[j]);
+        }
+    }
+    sieve->start = sieve->next = sieve->last = 0;
+    sieve_fill_window(sieve);
+    return 1;
+}
+
+/*
+ * Returns the number of steps from the candidate returned last, or from
+ * |base| the first time, to the next candidate without small factors.
+ */
+BN_ULONG ossl_bn_sieve_next(BN_SIEVE *sieve)
+{
+    BN_ULONG k, delta;
+
+    for (;;) {
+        if (sieve->next - sieve->start == BN_SIEVE_WINDOW) {
+            sieve->start = sieve->next;
+            sieve_fill_window(sieve);
+        }
+        k = sieve->next++ - sieve->start;
+        if ((sieve->composite[k >> 3] & (1 << (k & 7))) == 0)
+            break;
+    }
+    delta = sieve->next - 1 - sieve->last;
+    sieve->last = sieve->next - 1;
+    return delta;
+}
+
 /*
  * Tests that |w| is probably prime
  * See FIPS 186-4 C.3.1 Miller Rabin Probabilistic Primality Test.
@@ -478,60 +665,48 @@ err:
 /*
  * Generate a random number of |bits| bits that is probably prime by sieving.
  * If |safe| != 0, it generates a safe prime.
- * |mods| is a preallocated array that gets reused when called again.
+ * If |next| != 0, |rnd| holds the number returned last, and the candidate
+ * that |sieve| finds after it is returned instead of a new random number.
  *
  * The probably prime is saved in |rnd|.
  *
  * Returns 1 on success and 0 on error.
  */
-static int probable_prime(BIGNUM *rnd, int bits, int safe, prime_t *mods,
-                          BN_CTX *ctx)
+static int probable_prime(BIGNUM *rnd, int bits, int safe, BN_SIEVE *sieve,
+                          int next, BN_CTX *ctx)
 {
-    int i;
+    BN_ULONG step = safe ? 4 : 2;
     BN_ULONG delta;
-    int trial_divisions = calc_trial_divisions(bits);
-    BN_ULONG maxdelta = BN_MASK2 - primes[trial_divisions - 1];
+    BIGNUM *bnstep;
+    int ret = 0;
 
+    BN_CTX_start(ctx);
+    if ((bnstep = BN_CTX_get(ctx)) == NULL || !BN_set_word(bnstep, step))
+        goto err;
+    if (next)
+        goto loop;
  again:
     if (!BN_priv_rand_ex(rnd, bits, BN_RAND_TOP_TWO, BN_RAND_BOTTOM_ODD, 0,
                          ctx))
-        return 0;
+        goto err;
     if (safe && !BN_set_bit(rnd, 1))
-        return 0;
+        goto err;
     /* we now have a random number 'rnd' to test. */
-    for (i = 1; i < trial_divisions; i++) {
-        BN_ULONG mod = BN_mod_word(rnd, (BN_ULONG)primes[i]);
-        if (mod == (BN_ULONG)-1)
-            return 0;
-        mods[i] = (prime_t) mod;
-    }
-    delta = 0;
+    if (!ossl_bn_sieve_start(sieve, rnd, bnstep))
+        goto err;
  loop:
-    for (i = 1; i < trial_divisions; i++) {
-        /*
-         * check that rnd is a prime and also that
-         * gcd(rnd-1,primes) == 1 (except for 2)
-         * do the second check only if we are interested in safe primes
-         * in the case that the candidate prime is a single word then
-         * we check only the primes up to sqrt(rnd)
-         */
-        if (bits <= 31 && delta <= 0x7fffffff
-                && square(primes[i]) > BN_get_word(rnd) + delta)
-            break;
-        if (safe ? (mods[i] + delta) % primes[i] <= 1
-                 : (mods[i] + delta) % primes[i] == 0) {
-            delta += safe ? 4 : 2;
-            if (delta > maxdelta)
-                goto again;
-            goto loop;
-        }
-    }
-    if (!BN_add_word(rnd, delta))
-        return 0;
+    delta = ossl_bn_sieve_next(sieve);
+    if (delta > BN_MASK2 / step)
+        goto again;
+    if (!BN_add_word(rnd, delta * step))
+        goto err;
     if (BN_num_bits(rnd) != bits)
         goto again;
+    ret = 1;
+ err:
+    BN_CTX_end(ctx);
     bn_check_top(rnd);
-    return 1;
+    return ret;
 }
 
 /*
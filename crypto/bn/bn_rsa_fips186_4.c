@@ -137,28 +137,40 @@ static int bn_rsa_fips186_4_find_aux_prob_prime(const BIGNUM *Xp1,
     int ret = 0;
     int i = 0;
     int tmp = 0;
+    BIGNUM *two;
+    BN_SIEVE *sieve = NULL;
 
     if (BN_copy(p1, Xp1) == NULL)
         return 0;
     BN_set_flags(p1, BN_FLG_CONSTTIME);
 
+    BN_CTX_start(ctx);
+    two = BN_CTX_get(ctx);
+    if (two == NULL
+            || !BN_set_word(two, 2)
+            || (sieve = ossl_bn_sieve_new(BN_num_bits(p1), 0)) == NULL
+            || !ossl_bn_sieve_start(sieve, p1, two))
+        goto err;
+
     /* Find the first odd number >= Xp1 that is probably prime */
     for (;;) {
+        /* Get the next odd number without small factors */
+        if (!BN_add_word(p1, 2 * ossl_bn_sieve_next(sieve)))
+            goto err;
         i++;
         BN_GENCB_call(cb, 0, i);
-        /* MR test with trial division */
-        tmp = ossl_bn_check_generated_prime(p1, rounds, ctx, cb);
+        /* MR test, the sieve has done the trial division */
+        tmp = ossl_bn_check_sieved_prime(p1, rounds, ctx, cb);
         if (tmp > 0)
             break;
         if (tmp < 0)
             goto err;
-        /* Get next odd number */
-        if (!BN_add_word(p1, 2))
-            goto err;
     }
     BN_GENCB_call(cb, 2, i);
     ret = 1;
 err:
+    ossl_bn_sieve_free(sieve);
+    BN_CTX_end(ctx);
     return ret;
 }
 
@@ -282,6 +294,8 @@ int ossl_bn_rsa_fips186_4_derive_prime(BIGNUM *Y, BIGNUM *X, const BIGNUM *Xin,
     int bits = nlen >> 1;
     BIGNUM *tmp, *R, *r1r2x2, *y1, *r1x2;
     BIGNUM *base, *range;
+    BN_SIEVE *sieve = NULL;
+    BN_ULONG delta;
 
     BN_CTX_start(ctx);
 
@@ -295,6 +309,9 @@ int ossl_bn_rsa_fips186_4_derive_prime(BIGNUM *Y, BIGNUM *X, const BIGNUM *Xin,
     if (r1x2 == NULL)
         goto err;
 
+    if ((sieve = ossl_bn_sieve_new(bits, 0)) == NULL)
+        goto err;
+
     if (Xin != NULL && BN_copy(X, Xin) == NULL)
         goto err;
 
@@ -362,9 +379,28 @@ int ossl_bn_rsa_fips186_4_derive_prime(BIGNUM *Y, BIGNUM *X, const BIGNUM *Xin,
         /* (Step 4) Y = X + ((R - X) mod 2r1r2) */
         if (!BN_mod_sub(Y, R, X, r1r2x2, ctx) || !BN_add(Y, Y, X))
             goto err;
+        /*
+         * Sieve the candidates Y + i * 2r1r2 of Steps 5-10, skipping those
+         * that have small factors
+         */
+        if (!ossl_bn_sieve_start(sieve, Y, r1r2x2))
+            goto err;
         /* (Step 5) */
         i = 0;
         for (;;) {
+            /* (Steps 8-10) Y = Y + 2r1r2, for each candidate skipped */
+            delta = ossl_bn_sieve_next(sieve);
+            if (delta >= (BN_ULONG)(imax - i)) {
+                ERR_raise(ERR_LIB_BN, BN_R_NO_PRIME_CANDIDATE);
+                goto err;
+            }
+            i += (int)delta;
+            if (delta > 0
+                    && (BN_copy(tmp, r1r2x2) == NULL
+                        || !BN_mul_word(tmp, delta)
+                        || !BN_add(Y, Y, tmp)))
+                goto err;
+
             /* (Step 6) */
             if (BN_num_bits(Y) > bits) {
                 if (Xin == NULL)
@@ -380,26 +416,20 @@ int ossl_bn_rsa_fips186_4_derive_prime(BIGNUM *Y, BIGNUM *X, const BIGNUM *Xin,
                 goto err;
 
             if (BN_are_coprime(y1, e, ctx)) {
-                int rv = ossl_bn_check_generated_prime(Y, rounds, ctx, cb);
+                int rv = ossl_bn_check_sieved_prime(Y, rounds, ctx, cb);
 
                 if (rv > 0)
                     goto end;
                 if (rv < 0)
                     goto err;
             }
-            /* (Step 8-10) */
-            if (++i >= imax) {
-                ERR_raise(ERR_LIB_BN, BN_R_NO_PRIME_CANDIDATE);
-                goto err;
-            }
-            if (!BN_add(Y, Y, r1r2x2))
-                goto err;
         }
     }
 end:
     ret = 1;
     BN_GENCB_call(cb, 3, 0);
 err:
+    ossl_bn_sieve_free(sieve);
     BN_clear(y1);
     BN_CTX_end(ctx);
     return ret;
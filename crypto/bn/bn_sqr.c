@@ -68,21 +68,20 @@ int bn_sqr_fixed_top(BIGNUM *r, const BIGNUM *a, BN_CTX *ctx)
         if (al < BN_SQR_RECURSIVE_SIZE_NORMAL) {
             BN_ULONG t[BN_SQR_RECURSIVE_SIZE_NORMAL * 2];
             bn_sqr_normal(rr->d, a->d, al, t);
+        } else if (al >= ossl_bn_mul_get_threshold(BN_SQR_THRESHOLD_TOOM3)
+                   && (al & (al - 1)) != 0
+                   && BN_get_flags(a, BN_FLG_CONSTTIME) == 0) {
+            if (!bn_mul_toom3(rr, a, a, ctx))
+                goto err;
+        } else if ((al & (al - 1)) == 0
+                   || al >= ossl_bn_mul_get_threshold(BN_SQR_THRESHOLD_KARATSUBA)) {
+            if (bn_wexpand(tmp, 4 * max) == NULL)
+                goto err;
+            bn_sqr_karatsuba(rr->d, a->d, al, tmp->d);
         } else {
-            int j, k;
-
-            j = BN_num_bits_word((BN_ULONG)al);
-            j = 1 << (j - 1);
-            k = j + j;
-            if (al == j) {
-                if (bn_wexpand(tmp, k * 2) == NULL)
-                    goto err;
-                bn_sqr_recursive(rr->d, a->d, al, tmp->d);
-            } else {
-                if (bn_wexpand(tmp, max) == NULL)
-                    goto err;
-                bn_sqr_normal(rr->d, a->d, al, tmp->d);
-            }
+            if (bn_wexpand(tmp, max) == NULL)
+                goto err;
+            bn_sqr_normal(rr->d, a->d, al, tmp->d);
         }
 #else
         if (bn_wexpand(tmp, max) == NULL)
@@ -236,4 +235,58 @@ void bn_sqr_recursive(BN_ULONG *r, const BN_ULONG *a, int n2, BN_ULONG *t)
         }
     }
 }
+
+/*-
+ * Karatsuba squaring of a number of any size n, not just a power of 2.
+ * t must be 8*n words in size.  With h = (n + 1) / 2, a is split in a[0]
+ * of h words and a[1] of n - h words, and we calculate
+ * a[0]*a[0]
+ * a[0]*a[0]+a[1]*a[1]-(a[0]-a[1])*(a[0]-a[1])
+ * a[1]*a[1]
+ */
+void bn_sqr_karatsuba(BN_ULONG *r, const BN_ULONG *a, int n, BN_ULONG *t)
+{
+    int h = (n + 1) / 2, l = n - h, i;
+    BN_ULONG c, v, *p;
+
+    if ((n & (n - 1)) == 0) {
+        bn_sqr_recursive(r, a, n, t);
+        return;
+    }
+    if (n < ossl_bn_mul_get_threshold(BN_SQR_THRESHOLD_KARATSUBA)
+        || n < BN_SQR_RECURSIVE_SIZE_NORMAL) {
+        bn_sqr_normal(r, a, n, t);
+        return;
+    }
+
+    /* t[0..h) = |a[0]-a[1]| */
+    memcpy(&t[h], &a[h], sizeof(*t) * l);
+    memset(&t[h + l], 0, sizeof(*t) * (h - l));
+    bn_abs_sub_words(t, a, &t[h], h);
+
+    p = &t[4 * h];
+    bn_sqr_karatsuba(&t[2 * h], t, h, p);
+    bn_sqr_karatsuba(r, a, h, p);
+    bn_sqr_karatsuba(&r[2 * h], &a[h], l, p);
+
+    /*-
+     * t[2h] holds (a[0]-a[1])*(a[0]-a[1])
+     * r[0] holds a[0]*a[0], r[2h] holds a[1]*a[1]
+     * Make t[0] a[0]*a[0]+a[1]*a[1]-(a[0]-a[1])*(a[0]-a[1]), with the
+     * carry in c, and add it to r[h].
+     */
+    c = bn_add_words(t, r, &r[2 * h], 2 * l);
+    for (i = 2 * l; i < 2 * h; i++) {
+        v = (r[i] + c) & BN_MASK2;
+        c = v < c;
+        t[i] = v;
+    }
+    c -= bn_sub_words(t, t, &t[2 * h], 2 * h);
+    c += bn_add_words(&r[h], &r[h], t, 2 * h);
+    for (i = 3 * h; c != 0 && i < 2 * n; i++) {
+        v = (r[i] + c) & BN_MASK2;
+        c = v < c;
+        r[i] = v;
+    }
+}
 #endif
@@ -29,6 +29,11 @@ struct ossl_lib_ctx_st {
     void *global_properties;
     void *drbg;
     void *drbg_nonce;
+    void *rsa_blinding;
+    void *bn_thread_ctx;
+#ifndef OPENSSL_NO_DH
+    void *ffc_comb;
+#endif
 #ifndef FIPS_MODULE
     void *provider_conf;
     void *bio_core;
@@ -41,6 +46,9 @@ struct ossl_lib_ctx_st {
 #endif
 #if defined(OPENSSL_THREADS)
     void *threads;
+#endif
+#if !defined(FIPS_MODULE) && !defined(OPENSSL_NO_DEFAULT_THREAD_POOL)
+    void *rsa_prime_pool;
 #endif
     void *rand_crngt;
 #ifdef FIPS_MODULE
@@ -166,6 +174,20 @@ static int context_init(OSSL_LIB_CTX *ctx)
     if (ctx->drbg_nonce == NULL)
         goto err;
 
+    ctx->rsa_blinding = ossl_rsa_blinding_ctx_new(ctx);
+    if (ctx->rsa_blinding == NULL)
+        goto err;
+
+    ctx->bn_thread_ctx = ossl_bn_thread_ctx_new(ctx);
+    if (ctx->bn_thread_ctx == NULL)
+        goto err;
+
+#ifndef OPENSSL_NO_DH
+    ctx->ffc_comb = ossl_ffc_comb_ctx_new(ctx);
+    if (ctx->ffc_comb == NULL)
+        goto err;
+#endif
+
 #ifndef FIPS_MODULE
     ctx->self_test_cb = ossl_self_test_set_callback_new(ctx);
     if (ctx->self_test_cb == NULL)
@@ -188,6 +210,12 @@ static int context_init(OSSL_LIB_CTX *ctx)
         goto err;
 #endif
 
+#if !defined(FIPS_MODULE) && !defined(OPENSSL_NO_DEFAULT_THREAD_POOL)
+    ctx->rsa_prime_pool = ossl_rsa_prime_pool_ctx_new(ctx);
+    if (ctx->rsa_prime_pool == NULL)
+        goto err;
+#endif
+
     /* Low priority. */
 #ifndef FIPS_MODULE
     ctx->child_provider = ossl_child_prov_ctx_new(ctx);
@@ -215,6 +243,14 @@ static int context_init(OSSL_LIB_CTX *ctx)
 
 static void context_deinit_objs(OSSL_LIB_CTX *ctx)
 {
+#if !defined(FIPS_MODULE) && !defined(OPENSSL_NO_DEFAULT_THREAD_POOL)
+    /* P3. The prime pool workers use the DRBGs and the provider store */
+    if (ctx->rsa_prime_pool != NULL) {
+        ossl_rsa_prime_pool_ctx_free(ctx->rsa_prime_pool);
+        ctx->rsa_prime_pool = NULL;
+    }
+#endif
+
     /* P2. We want evp_method_store to be cleaned up before the provider store */
     if (ctx->evp_method_store != NULL) {
         ossl_method_store_free(ctx->evp_method_store);
@@ -300,6 +336,23 @@ static void context_deinit_objs(OSSL_LIB_CTX *ctx)
         ctx->drbg_nonce = NULL;
     }
 
+    if (ctx->rsa_blinding != NULL) {
+        ossl_rsa_blinding_ctx_free(ctx->rsa_blinding);
+        ctx->rsa_blinding = NULL;
+    }
+
+    if (ctx->bn_thread_ctx != NULL) {
+        ossl_bn_thread_ctx_free(ctx->bn_thread_ctx);
+        ctx->bn_thread_ctx = NULL;
+    }
+
+#ifndef OPENSSL_NO_DH
+    if (ctx->ffc_comb != NULL) {
+        ossl_ffc_comb_ctx_free(ctx->ffc_comb);
+        ctx->ffc_comb = NULL;
+    }
+#endif
+
 #ifndef FIPS_MODULE
     if (ctx->self_test_cb != NULL) {
         ossl_self_test_set_callback_free(ctx->self_test_cb);
@@ -566,6 +619,14 @@ void *ossl_lib_ctx_get_data(OSSL_LIB_CTX *ctx, int index)
         return ctx->drbg;
     case OSSL_LIB_CTX_DRBG_NONCE_INDEX:
         return ctx->drbg_nonce;
+    case OSSL_LIB_CTX_RSA_BLINDING_INDEX:
+        return ctx->rsa_blinding;
+    case OSSL_LIB_CTX_BN_THREAD_CTX_INDEX:
+        return ctx->bn_thread_ctx;
+#ifndef OPENSSL_NO_DH
+    case OSSL_LIB_CTX_FFC_COMB_INDEX:
+        return ctx->ffc_comb;
+#endif
 #ifndef FIPS_MODULE
     case OSSL_LIB_CTX_PROVIDER_CONF_INDEX:
         return ctx->provider_conf;
@@ -588,6 +649,10 @@ void *ossl_lib_ctx_get_data(OSSL_LIB_CTX *ctx, int index)
     case OSSL_LIB_CTX_THREAD_INDEX:
         return ctx->threads;
 #endif
+#if !defined(FIPS_MODULE) && !defined(OPENSSL_NO_DEFAULT_THREAD_POOL)
+    case OSSL_LIB_CTX_RSA_PRIME_POOL_INDEX:
+        return ctx->rsa_prime_pool;
+#endif
 
     case OSSL_LIB_CTX_RAND_CRNGT_INDEX: {
 
@@ -0,0 +1,213 @@
+/*
+ * Copyright 2023 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+#include "internal/cryptlib.h"
+#include "internal/der.h"
+
+/* The low tag number form can't express tag numbers above 30 */
+#define DER_TAG_NUMBER_MASK     0x1F
+
+static int int_der_r_length(PACKET *pkt, size_t *len)
+{
+    unsigned int byte, n;
+    size_t l;
+
+    if (!PACKET_get_1(pkt, &byte))
+        return 0;
+    if (byte < 0x80) {
+        *len = byte;
+        return 1;
+    }
+
+    /* The indefinite length form 0x80 isn't DER, and neither is 0xFF */
+    n = byte & 0x7F;
+    if (n == 0 || n > sizeof(size_t)
+            || !PACKET_get_1(pkt, &byte)
+            || byte == 0)
+        return 0;
+    for (l = byte; --n > 0; l = (l << 8) | byte)
+        if (!PACKET_get_1(pkt, &byte))
+            return 0;
+
+    /* The long form must only be used when the short form can't */
+    if (l < 0x80)
+        return 0;
+    *len = l;
+    return 1;
+}
+
+int ossl_DER_r_peek_id(const PACKET *pkt, unsigned int *id)
+{
+    return PACKET_peek_1(pkt, id)
+        && (*id & DER_TAG_NUMBER_MASK) != DER_TAG_NUMBER_MASK;
+}
+
+int ossl_DER_r_tlv(PACKET *pkt, unsigned int *id, PACKET *content)
+{
+    PACKET tmp = *pkt;
+    size_t len;
+
+    if (!ossl_DER_r_peek_id(&tmp, id)
+            || !PACKET_forward(&tmp, 1)
+            || !int_der_r_length(&tmp, &len)
+            || !PACKET_get_sub_packet(&tmp, content, len))
+        return 0;
+    *pkt = tmp;
+    return 1;
+}
+
+/*
+ * Reads an element with the identifier octet |id| from |pkt|, which must be
+ * wrapped in the explicit context tag |tag| unless that is DER_NO_CONTEXT.
+ */
+static int int_der_r_expect(PACKET *pkt, int tag, unsigned int id,
+                            PACKET *content)
+{
+    PACKET tmp = *pkt, ctx;
+    unsigned int got;
+
+    if (tag >= 0) {
+        if (!ossl_assert(tag <= 30)
+                || !ossl_DER_r_tlv(&tmp, &got, &ctx)
+                || got != (DER_C_CONTEXT | DER_F_CONSTRUCTED | (unsigned)tag)
+                || !ossl_DER_r_tlv(&ctx, &got, content)
+                || PACKET_remaining(&ctx) != 0)
+            return 0;
+    } else if (!ossl_DER_r_tlv(&tmp, &got, content)) {
+        return 0;
+    }
+    if (got != id)
+        return 0;
+    *pkt = tmp;
+    return 1;
+}
+
+int ossl_DER_r_boolean(PACKET *pkt, int tag, int *b)
+{
+    PACKET tmp = *pkt, content;
+    unsigned int v;
+
+    /* DER only allows 0xFF for TRUE */
+    if (!int_der_r_expect(&tmp, tag, DER_P_BOOLEAN, &content)
+            || !PACKET_get_1(&content, &v)
+            || PACKET_remaining(&content) != 0
+            || (v != 0 && v != 0xFF))
+        return 0;
+    *b = v != 0;
+    *pkt = tmp;
+    return 1;
+}
+
+/* For integers, we only support unsigned values for now */
+int ossl_DER_r_uint32(PACKET *pkt, int tag, uint32_t *v)
+{
+    PACKET tmp = *pkt, content;
+    unsigned int byte, next;
+    uint32_t value;
+    size_t len;
+
+    if (!int_der_r_expect(&tmp, tag, DER_P_INTEGER, &content)
+            || (len = PACKET_remaining(&content)) == 0
+            || !PACKET_get_1(&content, &byte)
+            || (byte & 0x80) != 0)
+        return 0;
+
+    /* A leading zero is only allowed to keep the value positive */
+    if (byte == 0 && len > 1) {
+        if (len > 5
+                || !PACKET_peek_1(&content, &next)
+                || (next & 0x80) == 0)
+            return 0;
+    } else if (len > 4) {
+        return 0;
+    }
+    for (value = byte; PACKET_get_1(&content, &byte); )
+        value = (value << 8) | byte;
+
+    *v = value;
+    *pkt = tmp;
+    return 1;
+}
+
+int ossl_DER_r_null(PACKET *pkt, int tag)
+{
+    PACKET tmp = *pkt, content;
+
+    if (!int_der_r_expect(&tmp, tag, DER_P_NULL, &content)
+            || PACKET_remaining(&content) != 0)
+        return 0;
+    *pkt = tmp;
+    return 1;
+}
+
+int ossl_DER_r_octet_string(PACKET *pkt, int tag, PACKET *data)
+{
+    return int_der_r_expect(pkt, tag, DER_P_OCTET_STRING, data);
+}
+
+int ossl_DER_r_bit_string(PACKET *pkt, int tag, unsigned int *unused_bits,
+                          PACKET *data)
+{
+    PACKET tmp = *pkt, content;
+    unsigned int unused;
+    size_t len;
+
+    if (!int_der_r_expect(&tmp, tag, DER_P_BIT_STRING, &content)
+            || !PACKET_get_1(&content, &unused)
+            || unused > 7)
+        return 0;
+
+    /* DER requires the unused bits to be zero, and there to be some */
+    len = PACKET_remaining(&content);
+    if (len == 0 ? unused != 0
+                 : (PACKET_data(&content)[len - 1] & ((1U << unused) - 1)) != 0)
+        return 0;
+
+    *unused_bits = unused;
+    *data = content;
+    *pkt = tmp;
+    return 1;
+}
+
+int ossl_DER_r_oid(PACKET *pkt, int tag, PACKET *oid)
+{
+    PACKET tmp = *pkt, content;
+    const unsigned char *p;
+    size_t i, len;
+
+    if (!int_der_r_expect(&tmp, tag, DER_P_OBJECT, &content)
+            || (len = PACKET_remaining(&content)) == 0)
+        return 0;
+
+    /*
+     * Subidentifiers are base 128 with the high bit set on all but the last
+     * octet, and mustn't be padded with leading 0x80 octets.
+     */
+    p = PACKET_data(&content);
+    if ((p[len - 1] & 0x80) != 0)
+        return 0;
+    for (i = 0; i < len; i++)
+        if (p[i] == 0x80 && (i == 0 || (p[i - 1] & 0x80) == 0))
+            return 0;
+
+    *oid = content;
+    *pkt = tmp;
+    return 1;
+}
+
+int ossl_DER_r_sequence(PACKET *pkt, int tag, PACKET *content)
+{
+    return int_der_r_expect(pkt, tag, DER_F_CONSTRUCTED | DER_P_SEQUENCE,
+                            content);
+}
+
+int ossl_DER_r_set(PACKET *pkt, int tag, PACKET *content)
+{
+    return int_der_r_expect(pkt, tag, DER_F_CONSTRUCTED | DER_P_SET, content);
+}
@@ -60,7 +60,7 @@ int ossl_dh_compute_key(unsigned char *key, const BIGNUM *pub_key, DH *dh)
         return 0;
     }
 
-    ctx = BN_CTX_new_ex(dh->libctx);
+    ctx = ossl_bn_ctx_thread_acquire(dh->libctx, BN_num_bits(dh->params.p));
     if (ctx == NULL)
         goto err;
     BN_CTX_start(ctx);
@@ -103,7 +103,7 @@ int ossl_dh_compute_key(unsigned char *key, const BIGNUM *pub_key, DH *dh)
  err:
     BN_clear(z); /* (Step 2) destroy intermediate values */
     BN_CTX_end(ctx);
-    BN_CTX_free(ctx);
+    ossl_bn_ctx_thread_release(ctx);
     return ret;
 }
 
@@ -232,9 +232,22 @@ int ossl_dh_generate_public_key(BN_CTX *ctx, const DH *dh,
     int ret = 0;
     BIGNUM *prk = BN_new();
     BN_MONT_CTX *mont = NULL;
+    const DH_NAMED_GROUP *group;
+    const BN_COMB *comb = NULL;
 
     if (prk == NULL)
         return 0;
+    BN_with_flags(prk, priv_key, BN_FLG_CONSTTIME);
+
+    /* The named groups have a table of powers of their generator */
+    if (dh->meth->bn_mod_exp == dh_bn_mod_exp) {
+        group = ossl_ffc_uid_to_dh_named_group(DH_get_nid(dh));
+        comb = ossl_ffc_named_group_get_comb(dh->libctx, group, ctx);
+    }
+    if (comb != NULL && BN_num_bits(prk) <= ossl_bn_comb_bits(comb)) {
+        ret = ossl_bn_mod_exp_comb(pub_key, prk, comb, ctx);
+        goto err;
+    }
 
     if (dh->flags & DH_FLAG_CACHE_MONT_P) {
         /*
@@ -250,7 +263,6 @@ int ossl_dh_generate_public_key(BN_CTX *ctx, const DH *dh,
         if (mont == NULL)
             goto err;
     }
-    BN_with_flags(prk, priv_key, BN_FLG_CONSTTIME);
 
     /* pub_key = g^priv_key mod p */
     if (!dh->meth->bn_mod_exp(dh, pub_key, dh->params.g, prk, dh->params.p,
@@ -225,6 +225,10 @@ static int dsa_sign_setup(DSA *dsa, BN_CTX *ctx_in,
     BIGNUM *l;
     int ret = 0;
     int q_bits, q_words;
+#ifndef OPENSSL_NO_DH
+    const DH_NAMED_GROUP *group;
+#endif
+    const BN_COMB *comb = NULL;
 
     if (!dsa->params.p || !dsa->params.q || !dsa->params.g) {
         ERR_raise(ERR_LIB_DSA, DSA_R_MISSING_PARAMETERS);
@@ -320,7 +324,22 @@ static int dsa_sign_setup(DSA *dsa, BN_CTX *ctx_in,
 
     BN_consttime_swap(BN_is_bit_set(l, q_bits), k, l, q_words + 2);
 
-    if ((dsa)->meth->bn_mod_exp != NULL) {
+#ifndef OPENSSL_NO_DH
+    /*
+     * Domain parameters from one of the named groups have a table of powers
+     * of their generator.  k now has q_bits + 1 bits.
+     */
+    if (dsa->meth->bn_mod_exp == NULL) {
+        group = ossl_ffc_numbers_to_dh_named_group(dsa->params.p,
+                                                   dsa->params.q,
+                                                   dsa->params.g);
+        comb = ossl_ffc_named_group_get_comb(dsa->libctx, group, ctx);
+    }
+#endif
+    if (comb != NULL && q_bits < ossl_bn_comb_bits(comb)) {
+        if (!ossl_bn_mod_exp_comb(r, k, comb, ctx))
+            goto err;
+    } else if ((dsa)->meth->bn_mod_exp != NULL) {
             if (!dsa->meth->bn_mod_exp(dsa, r, dsa->params.g, k, dsa->params.p,
                                        ctx, dsa->method_mont_p))
                 goto err;
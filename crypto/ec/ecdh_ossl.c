@@ -18,6 +18,7 @@
 #include <limits.h>
 
 #include "internal/cryptlib.h"
+#include "crypto/bn.h"
 
 #include <openssl/err.h>
 #include <openssl/bn.h>
@@ -58,7 +59,13 @@ int ossl_ecdh_simple_compute_key(unsigned char **pout, size_t *poutlen,
     size_t buflen, len;
     unsigned char *buf = NULL;
 
-    if ((ctx = BN_CTX_new_ex(ecdh->libctx)) == NULL)
+    if ((group = EC_KEY_get0_group(ecdh)) == NULL) {
+        ERR_raise(ERR_LIB_EC, EC_R_MISSING_PARAMETERS);
+        return 0;
+    }
+
+    if ((ctx = ossl_bn_ctx_thread_acquire(ecdh->libctx,
+                                          EC_GROUP_get_degree(group))) == NULL)
         goto err;
     BN_CTX_start(ctx);
     x = BN_CTX_get(ctx);
@@ -73,8 +80,6 @@ int ossl_ecdh_simple_compute_key(unsigned char **pout, size_t *poutlen,
         goto err;
     }
 
-    group = EC_KEY_get0_group(ecdh);
-
     /*
      * Step(1) - Compute the point tmp = cofactor * owners_private_key
      *                                   * peer_public_key.
@@ -141,7 +146,7 @@ int ossl_ecdh_simple_compute_key(unsigned char **pout, size_t *poutlen,
     BN_clear(x);
     EC_POINT_clear_free(tmp);
     BN_CTX_end(ctx);
-    BN_CTX_free(ctx);
+    ossl_bn_ctx_thread_release(ctx);
     OPENSSL_free(buf);
     return ret;
 }
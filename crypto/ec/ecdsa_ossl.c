@@ -292,7 +292,8 @@ ECDSA_SIG *ossl_ecdsa_simple_sign_sig(const unsigned char *dgst, int dgst_len,
     }
     s = ret->s;
 
-    if ((ctx = BN_CTX_new_ex(eckey->libctx)) == NULL
+    if ((ctx = ossl_bn_ctx_thread_acquire(eckey->libctx,
+                                          EC_GROUP_get_degree(group))) == NULL
         || (m = BN_new()) == NULL) {
         ERR_raise(ERR_LIB_EC, ERR_R_BN_LIB);
         goto err;
@@ -382,7 +383,7 @@ ECDSA_SIG *ossl_ecdsa_simple_sign_sig(const unsigned char *dgst, int dgst_len,
         ECDSA_SIG_free(ret);
         ret = NULL;
     }
-    BN_CTX_free(ctx);
+    ossl_bn_ctx_thread_release(ctx);
     BN_clear_free(m);
     BN_clear_free(kinv);
     return ret;
@@ -442,7 +443,7 @@ int ossl_ecdsa_simple_verify_sig(const unsigned char *dgst, int dgst_len,
         return -1;
     }
 
-    ctx = BN_CTX_new_ex(eckey->libctx);
+    ctx = ossl_bn_ctx_thread_acquire(eckey->libctx, EC_GROUP_get_degree(group));
     if (ctx == NULL) {
         ERR_raise(ERR_LIB_EC, ERR_R_BN_LIB);
         return -1;
@@ -524,7 +525,7 @@ int ossl_ecdsa_simple_verify_sig(const unsigned char *dgst, int dgst_len,
     ret = (BN_ucmp(u1, sig->r) == 0);
  err:
     BN_CTX_end(ctx);
-    BN_CTX_free(ctx);
+    ossl_bn_ctx_thread_release(ctx);
     EC_POINT_free(point);
     return ret;
 }
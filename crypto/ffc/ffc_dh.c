@@ -7,9 +7,12 @@
  * https://www.openssl.org/source/license.html
  */
 
+#include <openssl/err.h>
+#include "internal/cryptlib.h"
 #include "internal/ffc.h"
 #include "internal/nelem.h"
 #include "crypto/bn_dh.h"
+#include "crypto/context.h"
 
 #ifndef OPENSSL_NO_DH
 
@@ -170,4 +173,91 @@ int ossl_ffc_named_group_set(FFC_PARAMS *ffc, const DH_NAMED_GROUP *group)
     ffc->nid = NID_undef;
     return 1;
 }
+
+/*
+ * The fixed base exponentiation tables for the generators of the named
+ * groups, built on first use and kept until the library context is freed.
+ */
+typedef struct {
+    CRYPTO_RWLOCK *lock;
+    BN_COMB *combs[OSSL_NELEM(dh_named_groups)];
+} FFC_COMB_CACHE;
+
+void *ossl_ffc_comb_ctx_new(OSSL_LIB_CTX *libctx)
+{
+    FFC_COMB_CACHE *cache = OPENSSL_zalloc(sizeof(*cache));
+
+    if (cache == NULL)
+        return NULL;
+    if ((cache->lock = CRYPTO_THREAD_lock_new()) == NULL) {
+        OPENSSL_free(cache);
+        return NULL;
+    }
+    return cache;
+}
+
+void ossl_ffc_comb_ctx_free(void *vcache)
+{
+    FFC_COMB_CACHE *cache = vcache;
+    size_t i;
+
+    if (cache == NULL)
+        return;
+    for (i = 0; i < OSSL_NELEM(cache->combs); i++)
+        ossl_bn_comb_free(cache->combs[i]);
+    CRYPTO_THREAD_lock_free(cache->lock);
+    OPENSSL_free(cache);
+}
+
+/*
+ * Returns the table for raising the generator of |group| to a private key,
+ * or NULL if there is none.  The table covers exponents of up to the
+ * private key length of the group, or for groups with no such length, one
+ * bit more than q as DSA signing needs.  It stays valid until |libctx| is
+ * freed.
+ */
+const BN_COMB *ossl_ffc_named_group_get_comb(OSSL_LIB_CTX *libctx,
+                                             const DH_NAMED_GROUP *group,
+                                             BN_CTX *ctx)
+{
+    FFC_COMB_CACHE *cache;
+    BN_COMB *comb, *other;
+    size_t idx;
+    int bits;
+
+    if (group == NULL
+        || (cache = ossl_lib_ctx_get_data(libctx,
+                                          OSSL_LIB_CTX_FFC_COMB_INDEX)) == NULL)
+        return NULL;
+    idx = group - dh_named_groups;
+
+    if (!CRYPTO_THREAD_read_lock(cache->lock))
+        return NULL;
+    comb = cache->combs[idx];
+    CRYPTO_THREAD_unlock(cache->lock);
+    if (comb != NULL)
+        return comb;
+
+    /* The callers can do without, so a failure here is not an error */
+    bits = group->keylength != 0 ? group->keylength : BN_num_bits(group->q) + 1;
+    ERR_set_mark();
+    comb = ossl_bn_comb_new(group->g, group->p, bits, ctx);
+    ERR_pop_to_mark();
+    if (comb == NULL)
+        return NULL;
+
+    if (!CRYPTO_THREAD_write_lock(cache->lock)) {
+        ossl_bn_comb_free(comb);
+        return NULL;
+    }
+    /* Another thread may have got there first */
+    if ((other = cache->combs[idx]) == NULL)
+        cache->combs[idx] = comb;
+    CRYPTO_THREAD_unlock(cache->lock);
+    if (other != NULL) {
+        ossl_bn_comb_free(comb);
+        comb = other;
+    }
+    return comb;
+}
 #endif
@@ -100,13 +100,24 @@ ASN1_SEQUENCE(OCSP_SINGLERESP) = {
 
 IMPLEMENT_ASN1_FUNCTIONS(OCSP_SINGLERESP)
 
-ASN1_SEQUENCE(OCSP_RESPDATA) = {
+/* Lets the responder ID mark the received encoding as out of date */
+static int respdata_cb(int operation, ASN1_VALUE **pval, const ASN1_ITEM *it,
+                       void *exarg)
+{
+    OCSP_RESPDATA *rd = (OCSP_RESPDATA *)*pval;
+
+    if (operation == ASN1_OP_NEW_POST)
+        rd->responderId.respdata_modified = &rd->enc.modified;
+    return 1;
+}
+
+ASN1_SEQUENCE_enc(OCSP_RESPDATA, enc, respdata_cb) = {
            ASN1_EXP_OPT(OCSP_RESPDATA, version, ASN1_INTEGER, 0),
            ASN1_EMBED(OCSP_RESPDATA, responderId, OCSP_RESPID),
            ASN1_SIMPLE(OCSP_RESPDATA, producedAt, ASN1_GENERALIZEDTIME),
            ASN1_SEQUENCE_OF(OCSP_RESPDATA, responses, OCSP_SINGLERESP),
            ASN1_EXP_SEQUENCE_OF_OPT(OCSP_RESPDATA, responseExtensions, X509_EXTENSION, 1)
-} ASN1_SEQUENCE_END(OCSP_RESPDATA)
+} ASN1_SEQUENCE_END_enc(OCSP_RESPDATA, OCSP_RESPDATA)
 
 IMPLEMENT_ASN1_FUNCTIONS(OCSP_RESPDATA)
 
@@ -157,7 +157,13 @@ X509_EXTENSION *OCSP_BASICRESP_get_ext(OCSP_BASICRESP *x, int loc)
 
 X509_EXTENSION *OCSP_BASICRESP_delete_ext(OCSP_BASICRESP *x, int loc)
 {
-    return X509v3_delete_ext(x->tbsResponseData.responseExtensions, loc);
+    X509_EXTENSION *ext;
+
+    ext = X509v3_delete_ext(x->tbsResponseData.responseExtensions, loc);
+
+    if (ext != NULL)
+        x->tbsResponseData.enc.modified = 1;
+    return ext;
 }
 
 void *OCSP_BASICRESP_get1_ext_d2i(OCSP_BASICRESP *x, int nid, int *crit,
@@ -170,12 +176,14 @@ void *OCSP_BASICRESP_get1_ext_d2i(OCSP_BASICRESP *x, int nid, int *crit,
 int OCSP_BASICRESP_add1_ext_i2d(OCSP_BASICRESP *x, int nid, void *value,
                                 int crit, unsigned long flags)
 {
+    x->tbsResponseData.enc.modified = 1;
     return X509V3_add1_i2d(&x->tbsResponseData.responseExtensions, nid,
                            value, crit, flags);
 }
 
 int OCSP_BASICRESP_add_ext(OCSP_BASICRESP *x, X509_EXTENSION *ex, int loc)
 {
+    x->tbsResponseData.enc.modified = 1;
     return (X509v3_add_ext(&(x->tbsResponseData.responseExtensions), ex, loc)
             != NULL);
 }
@@ -288,6 +296,7 @@ int OCSP_request_add1_nonce(OCSP_REQUEST *req, unsigned char *val, int len)
 
 int OCSP_basic_add1_nonce(OCSP_BASICRESP *resp, unsigned char *val, int len)
 {
+    resp->tbsResponseData.enc.modified = 1;
     return ocsp_add1_nonce(&resp->tbsResponseData.responseExtensions, val,
                            len);
 }
@@ -103,6 +103,8 @@ struct ocsp_responder_id_st {
         X509_NAME *byName;
         ASN1_OCTET_STRING *byKey;
     } value;
+    /* enc.modified of the OCSP_RESPDATA this is part of, if any */
+    int *respdata_modified;
 };
 
 /*-  KeyHash ::= OCTET STRING --SHA-1 hash of responder's public key
@@ -160,6 +162,7 @@ struct ocsp_response_data_st {
     ASN1_GENERALIZEDTIME *producedAt;
     STACK_OF(OCSP_SINGLERESP) *responses;
     STACK_OF(X509_EXTENSION) *responseExtensions;
+    ASN1_ENCODING enc;          /* received encoding, for verification */
 };
 
 /*-  BasicOCSPResponse       ::= SEQUENCE {
@@ -224,15 +227,17 @@ struct ocsp_service_locator_st {
                          NULL, pkey, md, libctx, propq)
 
 #  define OCSP_BASICRESP_sign(o, pkey, md, d, libctx, propq)\
-        ASN1_item_sign_ex(ASN1_ITEM_rptr(OCSP_RESPDATA),\
-                          &(o)->signatureAlgorithm, NULL,\
-                          (o)->signature, &(o)->tbsResponseData,\
-                          NULL, pkey, md, libctx, propq)
+        ((o)->tbsResponseData.enc.modified = 1,\
+         ASN1_item_sign_ex(ASN1_ITEM_rptr(OCSP_RESPDATA),\
+                           &(o)->signatureAlgorithm, NULL,\
+                           (o)->signature, &(o)->tbsResponseData,\
+                           NULL, pkey, md, libctx, propq))
 
 #  define OCSP_BASICRESP_sign_ctx(o, ctx, d)\
-        ASN1_item_sign_ctx(ASN1_ITEM_rptr(OCSP_RESPDATA),\
-                           &(o)->signatureAlgorithm, NULL,\
-                           (o)->signature, &(o)->tbsResponseData, ctx)
+        ((o)->tbsResponseData.enc.modified = 1,\
+         ASN1_item_sign_ctx(ASN1_ITEM_rptr(OCSP_RESPDATA),\
+                            &(o)->signatureAlgorithm, NULL,\
+                            (o)->signature, &(o)->tbsResponseData, ctx))
 
 #  define OCSP_REQUEST_verify(a, r, libctx, propq)\
         ASN1_item_verify_ex(ASN1_ITEM_rptr(OCSP_REQINFO),\
@@ -147,6 +147,7 @@ OCSP_SINGLERESP *OCSP_basic_add1_status(OCSP_BASICRESP *rsp,
     }
     if (!(sk_OCSP_SINGLERESP_push(rsp->tbsResponseData.responses, single)))
         goto err;
+    rsp->tbsResponseData.enc.modified = 1;
     return single;
  err:
     OCSP_SINGLERESP_free(single);
@@ -239,6 +240,8 @@ int OCSP_RESPID_set_by_name(OCSP_RESPID *respid, X509 *cert)
         return 0;
 
     respid->type = V_OCSP_RESPID_NAME;
+    if (respid->respdata_modified != NULL)
+        *respid->respdata_modified = 1;
 
     return 1;
 }
@@ -269,6 +272,8 @@ int OCSP_RESPID_set_by_key_ex(OCSP_RESPID *respid, X509 *cert,
 
     respid->type = V_OCSP_RESPID_KEY;
     respid->value.byKey = byKey;
+    if (respid->respdata_modified != NULL)
+        *respid->respdata_modified = 1;
 
     ret = 1;
  err:
@@ -188,10 +188,12 @@ static int ocsp_find_signer(X509 **psigner, OCSP_BASICRESP *bs,
 
 static X509 *ocsp_find_signer_sk(STACK_OF(X509) *certs, OCSP_RESPID *id)
 {
-    int i, r;
+    int i;
     unsigned char tmphash[SHA_DIGEST_LENGTH], *keyhash;
-    EVP_MD *md;
-    X509 *x;
+    EVP_MD *md = NULL;
+    OSSL_LIB_CTX *md_libctx = NULL;
+    const char *md_propq = NULL;
+    X509 *x, *ret = NULL;
 
     /* Easy if lookup by name */
     if (id->type == V_OCSP_RESPID_NAME)
@@ -203,20 +205,29 @@ static X509 *ocsp_find_signer_sk(STACK_OF(X509) *certs, OCSP_RESPID *id)
     if (id->value.byKey->length != SHA_DIGEST_LENGTH)
         return NULL;
     keyhash = id->value.byKey->data;
-    /* Calculate hash of each key and compare */
+    /*
+     * Calculate hash of each key and compare, only fetching SHA1 again for
+     * a certificate from a different library context than the one before
+     */
     for (i = 0; i < sk_X509_num(certs); i++) {
         if ((x = sk_X509_value(certs, i)) != NULL) {
-            if ((md = EVP_MD_fetch(x->libctx, SN_sha1, x->propq)) == NULL)
+            if (md == NULL || x->libctx != md_libctx || x->propq != md_propq) {
+                EVP_MD_free(md);
+                md_libctx = x->libctx;
+                md_propq = x->propq;
+                if ((md = EVP_MD_fetch(md_libctx, SN_sha1, md_propq)) == NULL)
+                    break;
+            }
+            if (!X509_pubkey_digest(x, md, tmphash, NULL))
                 break;
-            r = X509_pubkey_digest(x, md, tmphash, NULL);
-            EVP_MD_free(md);
-            if (!r)
+            if (memcmp(keyhash, tmphash, SHA_DIGEST_LENGTH) == 0) {
+                ret = x;
                 break;
-            if (memcmp(keyhash, tmphash, SHA_DIGEST_LENGTH) == 0)
-                return x;
+            }
         }
     }
-    return NULL;
+    EVP_MD_free(md);
+    return ret;
 }
 
 static int ocsp_check_issuer(OCSP_BASICRESP *bs, STACK_OF(X509) *chain)
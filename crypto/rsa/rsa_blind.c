@@ -0,0 +1,170 @@
+/*
+ * Copyright 2023 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * A BN_BLINDING may only be used by one thread at a time, so threads that
+ * share an RSA key would have to take turns at a single blinding for it.
+ * Instead, each thread keeps blindings of its own for the keys it uses.
+ * Keys are told apart by an identifier that's unique within their library
+ * context, which, unlike the address of the RSA, isn't reused once the key
+ * has been freed.
+ */
+
+/*
+ * RSA low level APIs are deprecated for public use, but still ok for
+ * internal use.
+ */
+#include "internal/deprecated.h"
+
+#include <limits.h>
+#include "internal/cryptlib.h"
+#include "crypto/cryptlib.h"
+#include "crypto/context.h"
+#include "rsa_local.h"
+
+/*
+ * The number of blindings a thread keeps.  A key's blinding lives in the slot
+ * picked by its identifier, so a thread can use up to this many keys created
+ * one after the other without any of them displacing another.  Keys whose
+ * identifiers share a slot take turns at it, at the cost of a new blinding
+ * each time they do.
+ */
+#define RSA_THREAD_BLINDING_MAX     64
+
+typedef struct {
+    int id;
+    BN_BLINDING *blinding;
+} RSA_THREAD_BLINDING;
+
+/* The blindings of one thread, indexed by key identifier */
+typedef struct {
+    RSA_THREAD_BLINDING blindings[RSA_THREAD_BLINDING_MAX];
+} RSA_THREAD_BLINDINGS;
+
+typedef struct {
+    /* The RSA_THREAD_BLINDINGS of each thread */
+    CRYPTO_THREAD_LOCAL blindings;
+    /* Only used where there are no atomics */
+    CRYPTO_RWLOCK *lock;
+    int last_id;
+} RSA_BLINDING_GLOBAL;
+
+void *ossl_rsa_blinding_ctx_new(OSSL_LIB_CTX *libctx)
+{
+    RSA_BLINDING_GLOBAL *gbl = OPENSSL_zalloc(sizeof(*gbl));
+
+    if (gbl == NULL)
+        return NULL;
+    if ((gbl->lock = CRYPTO_THREAD_lock_new()) == NULL)
+        goto err;
+    if (!CRYPTO_THREAD_init_local(&gbl->blindings, NULL)) {
+        CRYPTO_THREAD_lock_free(gbl->lock);
+        goto err;
+    }
+    return gbl;
+ err:
+    OPENSSL_free(gbl);
+    return NULL;
+}
+
+void ossl_rsa_blinding_ctx_free(void *vgbl)
+{
+    RSA_BLINDING_GLOBAL *gbl = vgbl;
+
+    if (gbl == NULL)
+        return;
+    CRYPTO_THREAD_cleanup_local(&gbl->blindings);
+    CRYPTO_THREAD_lock_free(gbl->lock);
+    OPENSSL_free(gbl);
+}
+
+static void rsa_blinding_delete_thread_state(void *arg)
+{
+    OSSL_LIB_CTX *ctx = arg;
+    RSA_BLINDING_GLOBAL *gbl
+        = ossl_lib_ctx_get_data(ctx, OSSL_LIB_CTX_RSA_BLINDING_INDEX);
+    RSA_THREAD_BLINDINGS *tb;
+    size_t i;
+
+    if (gbl == NULL)
+        return;
+
+    tb = CRYPTO_THREAD_get_local(&gbl->blindings);
+    CRYPTO_THREAD_set_local(&gbl->blindings, NULL);
+    if (tb == NULL)
+        return;
+    for (i = 0; i < RSA_THREAD_BLINDING_MAX; i++)
+        BN_BLINDING_free(tb->blindings[i].blinding);
+    OPENSSL_free(tb);
+}
+
+/*
+ * Returns a new identifier for a key in |libctx|, or 0 if there's none, in
+ * which case the key has to make do with shared blinding.
+ */
+int ossl_rsa_blinding_new_id(OSSL_LIB_CTX *libctx)
+{
+    RSA_BLINDING_GLOBAL *gbl
+        = ossl_lib_ctx_get_data(libctx, OSSL_LIB_CTX_RSA_BLINDING_INDEX);
+    int id;
+
+    if (gbl == NULL)
+        return 0;
+    /*
+     * Identifiers are never handed out twice, so once they have run out,
+     * new keys get none.
+     */
+    if (!CRYPTO_atomic_load_int(&gbl->last_id, &id, gbl->lock)
+            || id == INT_MAX
+            || !CRYPTO_atomic_add(&gbl->last_id, 1, &id, gbl->lock)
+            || id <= 0)
+        return 0;
+    return id;
+}
+
+/*
+ * Returns the calling thread's blinding for |rsa|, which must have an
+ * identifier, creating it if the thread doesn't have one yet.
+ */
+BN_BLINDING *ossl_rsa_get_thread_blinding(RSA *rsa, BN_CTX *ctx)
+{
+    OSSL_LIB_CTX *libctx = ossl_lib_ctx_get_concrete(rsa->libctx);
+    RSA_BLINDING_GLOBAL *gbl
+        = ossl_lib_ctx_get_data(libctx, OSSL_LIB_CTX_RSA_BLINDING_INDEX);
+    RSA_THREAD_BLINDINGS *tb;
+    RSA_THREAD_BLINDING *b;
+    BN_BLINDING *blinding;
+
+    if (gbl == NULL)
+        return NULL;
+
+    tb = CRYPTO_THREAD_get_local(&gbl->blindings);
+    if (tb == NULL) {
+        /* This is the first time this thread uses an RSA key */
+        if ((tb = OPENSSL_zalloc(sizeof(*tb))) == NULL)
+            return NULL;
+        if (!ossl_init_thread_start(NULL, libctx,
+                                    rsa_blinding_delete_thread_state)
+                || !CRYPTO_THREAD_set_local(&gbl->blindings, tb)) {
+            OPENSSL_free(tb);
+            return NULL;
+        }
+    }
+
+    b = &tb->blindings[rsa->blinding_id % RSA_THREAD_BLINDING_MAX];
+    if (b->id == rsa->blinding_id)
+        return b->blinding;
+
+    if ((blinding = RSA_setup_blinding(rsa, ctx)) == NULL)
+        return NULL;
+    BN_BLINDING_free(b->blinding);
+    b->id = rsa->blinding_id;
+    b->blinding = blinding;
+    return blinding;
+}
@@ -93,6 +93,7 @@ static RSA *rsa_new_intern(ENGINE *engine, OSSL_LIB_CTX *libctx)
     }
 
     ret->libctx = libctx;
+    ret->blinding_id = ossl_rsa_blinding_new_id(libctx);
     ret->meth = RSA_get_default_method();
 #if !defined(OPENSSL_NO_ENGINE) && !defined(FIPS_MODULE)
     ret->flags = ret->meth->flags & ~RSA_FLAG_NON_FIPS_ALLOW;
@@ -178,6 +179,7 @@ void RSA_free(RSA *r)
 #endif
     BN_BLINDING_free(r->blinding);
     BN_BLINDING_free(r->mt_blinding);
+    OPENSSL_free(r->pub_cache);
     OPENSSL_free(r);
 }
 
@@ -201,6 +203,7 @@ OSSL_LIB_CTX *ossl_rsa_get0_libctx(RSA *r)
 void ossl_rsa_set0_libctx(RSA *r, OSSL_LIB_CTX *libctx)
 {
     r->libctx = libctx;
+    r->blinding_id = ossl_rsa_blinding_new_id(libctx);
 }
 
 #ifndef FIPS_MODULE
@@ -416,6 +419,15 @@ int RSA_set0_key(RSA *r, BIGNUM *n, BIGNUM *e, BIGNUM *d)
         r->d = d;
         BN_set_flags(r->d, BN_FLG_CONSTTIME);
     }
+    /* The cached Montgomery context is for the old n */
+    if (n != NULL) {
+        BN_MONT_CTX_free(r->_method_mod_n);
+        r->_method_mod_n = NULL;
+    }
+    if (n != NULL || e != NULL) {
+        OPENSSL_free(r->pub_cache);
+        r->pub_cache = NULL;
+    }
     r->dirty_cnt++;
 
     return 1;
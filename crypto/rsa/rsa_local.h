@@ -15,6 +15,20 @@
 
 #define RSA_MAX_PRIME_NUM       5
 
+/* Blocks of up to this many bytes are kept on the stack */
+#define RSA_STACK_BUF_SIZE      512
+
+/*
+ * What public key operations need of a key, set up by rsa_ossl.c on first
+ * use once the key has passed its checks, and then read without a lock.
+ * mont is the key's _method_mod_n, and e is the public exponent if it is
+ * an odd single word of at least 3, and 0 otherwise.
+ */
+typedef struct rsa_pub_cache_st {
+    BN_MONT_CTX *mont;
+    BN_ULONG e;
+} RSA_PUB_CACHE;
+
 typedef struct rsa_prime_info_st {
     BIGNUM *r;
     BIGNUM *d;
@@ -95,6 +109,10 @@ struct rsa_st {
     BN_MONT_CTX *_method_mod_q;
     BN_BLINDING *blinding;
     BN_BLINDING *mt_blinding;
+    /* Identifies the key to the per thread blindings of its libctx, if not 0 */
+    int blinding_id;
+    /* Set once, published with a release store */
+    RSA_PUB_CACHE *pub_cache;
     CRYPTO_RWLOCK *lock;
 
     int dirty_cnt;
@@ -193,4 +211,10 @@ int ossl_rsa_padding_add_PKCS1_type_2_ex(OSSL_LIB_CTX *libctx, unsigned char *to
                                          int tlen, const unsigned char *from,
                                          int flen);
 
+int ossl_rsa_blinding_new_id(OSSL_LIB_CTX *libctx);
+BN_BLINDING *ossl_rsa_get_thread_blinding(RSA *rsa, BN_CTX *ctx);
+
+int ossl_rsa_prime_pool_get(OSSL_LIB_CTX *libctx, int nbits, const BIGNUM *e,
+                            BIGNUM *p, BIGNUM *Xp);
+
 #endif /* OSSL_CRYPTO_RSA_LOCAL_H */
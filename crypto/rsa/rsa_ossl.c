@@ -17,6 +17,7 @@
 #include "crypto/bn.h"
 #include "rsa_local.h"
 #include "internal/constant_time.h"
+#include "internal/tsan_assist.h"
 #include <openssl/evp.h>
 #include <openssl/sha.h>
 #include <openssl/hmac.h>
@@ -96,39 +97,150 @@ const RSA_METHOD *RSA_null_method(void)
     return NULL;
 }
 
-static int rsa_ossl_public_encrypt(int flen, const unsigned char *from,
-                                  unsigned char *to, RSA *rsa, int padding)
+/* Checks that a key can be used for public key operations */
+static int rsa_ossl_public_check(const RSA *rsa)
 {
-    BIGNUM *f, *ret;
-    int i, num = 0, r = -1;
-    unsigned char *buf = NULL;
-    BN_CTX *ctx = NULL;
-
     if (BN_num_bits(rsa->n) > OPENSSL_RSA_MAX_MODULUS_BITS) {
         ERR_raise(ERR_LIB_RSA, RSA_R_MODULUS_TOO_LARGE);
-        return -1;
+        return 0;
     }
 
     if (BN_ucmp(rsa->n, rsa->e) <= 0) {
         ERR_raise(ERR_LIB_RSA, RSA_R_BAD_E_VALUE);
-        return -1;
+        return 0;
     }
 
     /* for large moduli, enforce exponent limit */
     if (BN_num_bits(rsa->n) > OPENSSL_RSA_SMALL_MODULUS_BITS) {
         if (BN_num_bits(rsa->e) > OPENSSL_RSA_MAX_PUBEXP_BITS) {
             ERR_raise(ERR_LIB_RSA, RSA_R_BAD_E_VALUE);
-            return -1;
+            return 0;
         }
     }
+    return 1;
+}
+
+/*
+ * Without the necessary atomic operations, the RSA_PUB_CACHE of a key is
+ * read under its read lock
+ */
+#if defined(tsan_ld_acq) && defined(tsan_st_rel)
+# define RSA_PUB_CACHE_LOCK_FREE
+# define pub_cache_ld_acq(p)    tsan_ld_acq((void *TSAN_QUALIFIER *)(p))
+# define pub_cache_st_rel(p, v) tsan_st_rel((void *TSAN_QUALIFIER *)(p), (v))
+#endif
+
+/* Returns the RSA_PUB_CACHE of a key, or NULL if it hasn't been set up */
+static const RSA_PUB_CACHE *rsa_ossl_get_pub_cache(RSA *rsa)
+{
+    const RSA_PUB_CACHE *pub;
+
+    if ((rsa->flags & RSA_FLAG_CACHE_PUBLIC) == 0)
+        return NULL;
+#ifdef RSA_PUB_CACHE_LOCK_FREE
+    pub = pub_cache_ld_acq(&rsa->pub_cache);
+#else
+    if (!CRYPTO_THREAD_read_lock(rsa->lock))
+        return NULL;
+    pub = rsa->pub_cache;
+    CRYPTO_THREAD_unlock(rsa->lock);
+#endif
+    return pub;
+}
+
+/* Sets up the RSA_PUB_CACHE of a key that has passed its checks */
+static const RSA_PUB_CACHE *rsa_ossl_set_pub_cache(RSA *rsa, BN_CTX *ctx)
+{
+    RSA_PUB_CACHE *pub;
+
+    if (!BN_MONT_CTX_set_locked(&rsa->_method_mod_n, rsa->lock, rsa->n, ctx)
+        || !CRYPTO_THREAD_write_lock(rsa->lock))
+        return NULL;
+    if ((pub = rsa->pub_cache) == NULL
+        && (pub = OPENSSL_zalloc(sizeof(*pub))) != NULL) {
+        pub->mont = rsa->_method_mod_n;
+        if (!BN_is_negative(rsa->e) && BN_is_odd(rsa->e)
+            && bn_get_top(rsa->e) == 1 && bn_get_words(rsa->e)[0] >= 3)
+            pub->e = bn_get_words(rsa->e)[0];
+#ifdef RSA_PUB_CACHE_LOCK_FREE
+        pub_cache_st_rel(&rsa->pub_cache, pub);
+#else
+        rsa->pub_cache = pub;
+#endif
+    }
+    CRYPTO_THREAD_unlock(rsa->lock);
+    return pub;
+}
+
+/*-
+ * r = f^e mod n for the single word e of |pub|, from left to right.  The
+ * last bit of e is set, and multiplying by f rather than by f in Montgomery
+ * form for it leaves r out of Montgomery form.  For e = 65537 that is 16
+ * squarings and a multiplication, after converting f.
+ */
+static int rsa_ossl_pub_mod_exp(BIGNUM *r, const BIGNUM *f,
+                                const RSA_PUB_CACHE *pub, BN_CTX *ctx)
+{
+    BIGNUM *fm;
+    int i, ret = 0;
+
+    BN_CTX_start(ctx);
+    if ((fm = BN_CTX_get(ctx)) == NULL
+        || !BN_to_montgomery(fm, f, pub->mont, ctx)
+        || BN_copy(r, fm) == NULL)
+        goto err;
+    for (i = BN_num_bits_word(pub->e) - 2; i > 0; i--) {
+        if (!BN_mod_mul_montgomery(r, r, r, pub->mont, ctx))
+            goto err;
+        if (((pub->e >> i) & 1) != 0
+            && !BN_mod_mul_montgomery(r, r, fm, pub->mont, ctx))
+            goto err;
+    }
+    if (!BN_mod_mul_montgomery(r, r, r, pub->mont, ctx)
+        || !BN_mod_mul_montgomery(r, r, f, pub->mont, ctx))
+        goto err;
+    ret = 1;
+ err:
+    BN_CTX_end(ctx);
+    return ret;
+}
+
+/* r = f^e mod n, with the RSA_PUB_CACHE of the key if it has one */
+static int rsa_ossl_public_mod_exp(BIGNUM *r, const BIGNUM *f, RSA *rsa,
+                                   const RSA_PUB_CACHE *pub, BN_CTX *ctx)
+{
+    if (pub == NULL && (rsa->flags & RSA_FLAG_CACHE_PUBLIC) != 0
+        && (pub = rsa_ossl_set_pub_cache(rsa, ctx)) == NULL)
+        return 0;
+    if (pub != NULL && pub->e != 0 && rsa->meth->bn_mod_exp == BN_mod_exp_mont)
+        return rsa_ossl_pub_mod_exp(r, f, pub, ctx);
+    return rsa->meth->bn_mod_exp(r, f, rsa->e, rsa->n, ctx,
+                                 rsa->_method_mod_n);
+}
+
+static int rsa_ossl_public_encrypt(int flen, const unsigned char *from,
+                                  unsigned char *to, RSA *rsa, int padding)
+{
+    BIGNUM *f, *ret;
+    int i, num = 0, r = -1;
+    unsigned char stack_buf[RSA_STACK_BUF_SIZE], *buf = stack_buf;
+    BN_CTX *ctx = NULL;
+    const RSA_PUB_CACHE *pub;
+
+    /* A key with an RSA_PUB_CACHE has passed the checks */
+    if ((pub = rsa_ossl_get_pub_cache(rsa)) == NULL
+        && !rsa_ossl_public_check(rsa))
+        return -1;
 
-    if ((ctx = BN_CTX_new_ex(rsa->libctx)) == NULL)
+    if ((ctx = ossl_bn_ctx_thread_acquire(rsa->libctx,
+                                          BN_num_bits(rsa->n))) == NULL)
         goto err;
     BN_CTX_start(ctx);
     f = BN_CTX_get(ctx);
     ret = BN_CTX_get(ctx);
     num = BN_num_bytes(rsa->n);
-    buf = OPENSSL_malloc(num);
+    if (num > (int)sizeof(stack_buf))
+        buf = OPENSSL_malloc(num);
     if (ret == NULL || buf == NULL)
         goto err;
 
@@ -161,13 +273,7 @@ static int rsa_ossl_public_encrypt(int flen, const unsigned char *from,
         goto err;
     }
 
-    if (rsa->flags & RSA_FLAG_CACHE_PUBLIC)
-        if (!BN_MONT_CTX_set_locked(&rsa->_method_mod_n, rsa->lock,
-                                    rsa->n, ctx))
-            goto err;
-
-    if (!rsa->meth->bn_mod_exp(ret, f, rsa->e, rsa->n, ctx,
-                               rsa->_method_mod_n))
+    if (!rsa_ossl_public_mod_exp(ret, f, rsa, pub, ctx))
         goto err;
 
     /*
@@ -177,8 +283,11 @@ static int rsa_ossl_public_encrypt(int flen, const unsigned char *from,
     r = BN_bn2binpad(ret, to, num);
  err:
     BN_CTX_end(ctx);
-    BN_CTX_free(ctx);
-    OPENSSL_clear_free(buf, num);
+    ossl_bn_ctx_thread_release(ctx);
+    if (buf != stack_buf)
+        OPENSSL_clear_free(buf, num);
+    else
+        OPENSSL_cleanse(stack_buf, num);
     return r;
 }
 
@@ -186,6 +295,17 @@ static BN_BLINDING *rsa_get_blinding(RSA *rsa, int *local, BN_CTX *ctx)
 {
     BN_BLINDING *ret;
 
+    /*
+     * Normally each thread has a blinding of its own, and needs no lock,
+     * but a blinding the application asked for with RSA_blinding_on() is
+     * used as it is.
+     */
+    if (rsa->blinding_id != 0 && rsa->blinding == NULL
+            && (rsa->flags & (RSA_FLAG_BLINDING | RSA_FLAG_NO_BLINDING)) == 0) {
+        *local = 1;
+        return ossl_rsa_get_thread_blinding(rsa, ctx);
+    }
+
     if (!CRYPTO_THREAD_read_lock(rsa->lock))
         return NULL;
 
@@ -292,7 +412,8 @@ static int rsa_ossl_private_encrypt(int flen, const unsigned char *from,
     BIGNUM *unblind = NULL;
     BN_BLINDING *blinding = NULL;
 
-    if ((ctx = BN_CTX_new_ex(rsa->libctx)) == NULL)
+    if ((ctx = ossl_bn_ctx_thread_acquire(rsa->libctx,
+                                          BN_num_bits(rsa->n))) == NULL)
         goto err;
     BN_CTX_start(ctx);
     f = BN_CTX_get(ctx);
@@ -401,7 +522,7 @@ static int rsa_ossl_private_encrypt(int flen, const unsigned char *from,
     r = BN_bn2binpad(res, to, num);
  err:
     BN_CTX_end(ctx);
-    BN_CTX_free(ctx);
+    ossl_bn_ctx_thread_release(ctx);
     OPENSSL_clear_free(buf, num);
     return r;
 }
@@ -514,7 +635,8 @@ static int rsa_ossl_private_decrypt(int flen, const unsigned char *from,
     if ((rsa->flags & RSA_FLAG_EXT_PKEY) && (padding == RSA_PKCS1_PADDING))
         padding = RSA_PKCS1_NO_IMPLICIT_REJECT_PADDING;
 
-    if ((ctx = BN_CTX_new_ex(rsa->libctx)) == NULL)
+    if ((ctx = ossl_bn_ctx_thread_acquire(rsa->libctx,
+                                          BN_num_bits(rsa->n))) == NULL)
         goto err;
     BN_CTX_start(ctx);
     f = BN_CTX_get(ctx);
@@ -648,7 +770,7 @@ static int rsa_ossl_private_decrypt(int flen, const unsigned char *from,
 
  err:
     BN_CTX_end(ctx);
-    BN_CTX_free(ctx);
+    ossl_bn_ctx_thread_release(ctx);
     OPENSSL_clear_free(buf, num);
     return r;
 }
@@ -659,28 +781,17 @@ static int rsa_ossl_public_decrypt(int flen, const unsigned char *from,
 {
     BIGNUM *f, *ret;
     int i, num = 0, r = -1;
-    unsigned char *buf = NULL;
+    unsigned char stack_buf[RSA_STACK_BUF_SIZE], *buf = stack_buf;
     BN_CTX *ctx = NULL;
+    const RSA_PUB_CACHE *pub;
 
-    if (BN_num_bits(rsa->n) > OPENSSL_RSA_MAX_MODULUS_BITS) {
-        ERR_raise(ERR_LIB_RSA, RSA_R_MODULUS_TOO_LARGE);
-        return -1;
-    }
-
-    if (BN_ucmp(rsa->n, rsa->e) <= 0) {
-        ERR_raise(ERR_LIB_RSA, RSA_R_BAD_E_VALUE);
+    /* A key with an RSA_PUB_CACHE has passed the checks */
+    if ((pub = rsa_ossl_get_pub_cache(rsa)) == NULL
+        && !rsa_ossl_public_check(rsa))
         return -1;
-    }
-
-    /* for large moduli, enforce exponent limit */
-    if (BN_num_bits(rsa->n) > OPENSSL_RSA_SMALL_MODULUS_BITS) {
-        if (BN_num_bits(rsa->e) > OPENSSL_RSA_MAX_PUBEXP_BITS) {
-            ERR_raise(ERR_LIB_RSA, RSA_R_BAD_E_VALUE);
-            return -1;
-        }
-    }
 
-    if ((ctx = BN_CTX_new_ex(rsa->libctx)) == NULL)
+    if ((ctx = ossl_bn_ctx_thread_acquire(rsa->libctx,
+                                          BN_num_bits(rsa->n))) == NULL)
         goto err;
     BN_CTX_start(ctx);
     f = BN_CTX_get(ctx);
@@ -690,8 +801,8 @@ static int rsa_ossl_public_decrypt(int flen, const unsigned char *from,
         goto err;
     }
     num = BN_num_bytes(rsa->n);
-    buf = OPENSSL_malloc(num);
-    if (buf == NULL)
+    if (num > (int)sizeof(stack_buf)
+        && (buf = OPENSSL_malloc(num)) == NULL)
         goto err;
 
     /*
@@ -711,13 +822,7 @@ static int rsa_ossl_public_decrypt(int flen, const unsigned char *from,
         goto err;
     }
 
-    if (rsa->flags & RSA_FLAG_CACHE_PUBLIC)
-        if (!BN_MONT_CTX_set_locked(&rsa->_method_mod_n, rsa->lock,
-                                    rsa->n, ctx))
-            goto err;
-
-    if (!rsa->meth->bn_mod_exp(ret, f, rsa->e, rsa->n, ctx,
-                               rsa->_method_mod_n))
+    if (!rsa_ossl_public_mod_exp(ret, f, rsa, pub, ctx))
         goto err;
 
     if ((padding == RSA_X931_PADDING) && ((bn_get_words(ret)[0] & 0xf) != 12))
@@ -747,8 +852,11 @@ static int rsa_ossl_public_decrypt(int flen, const unsigned char *from,
 
  err:
     BN_CTX_end(ctx);
-    BN_CTX_free(ctx);
-    OPENSSL_clear_free(buf, num);
+    ossl_bn_ctx_thread_release(ctx);
+    if (buf != stack_buf)
+        OPENSSL_clear_free(buf, num);
+    else
+        OPENSSL_cleanse(stack_buf, num);
     return r;
 }
 
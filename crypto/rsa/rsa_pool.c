@@ -0,0 +1,341 @@
+/*
+ * Copyright 2023 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * Most of the time taken by RSA key generation goes into finding the primes.
+ * The prime pool has worker threads find primes for one modulus size and
+ * public exponent ahead of time, exactly as FIPS 186-4 B.3.6 key generation
+ * would find them, so that keys of that size can be made from the stock.
+ */
+
+#include <openssl/err.h>
+#include <openssl/rsa.h>
+#include "internal/cryptlib.h"
+#include "internal/thread.h"
+#include "internal/time.h"
+#include "crypto/bn.h"
+#include "crypto/context.h"
+#include "rsa_local.h"
+
+#if !defined(OPENSSL_NO_DEFAULT_THREAD_POOL)
+
+/* How long a worker waits before trying again after failing to find a prime */
+# define RSA_POOL_RETRY_DELAY ossl_ms2time(1000)
+
+/* A probable prime, and the random value it was derived from */
+typedef struct {
+    BIGNUM *p;
+    BIGNUM *Xp;
+} RSA_POOL_PRIME;
+
+typedef struct {
+    OSSL_LIB_CTX *libctx;
+    CRYPTO_MUTEX *lock;
+    /* Signalled when there is room for more primes, or the workers must stop */
+    CRYPTO_CONDVAR *cond_space;
+
+    /* What the primes are for, fixed while the workers run */
+    int nbits;
+    BIGNUM *e;
+
+    RSA_POOL_PRIME *primes;
+    size_t num, size;
+    /* The number of primes being generated */
+    size_t pending;
+
+    void **workers;
+    size_t num_workers;
+    int running, stopping;
+
+    uint64_t hits, misses;
+} RSA_PRIME_POOL;
+
+void *ossl_rsa_prime_pool_ctx_new(OSSL_LIB_CTX *libctx)
+{
+    RSA_PRIME_POOL *pool = OPENSSL_zalloc(sizeof(*pool));
+
+    if (pool == NULL)
+        return NULL;
+    pool->libctx = libctx;
+    pool->lock = ossl_crypto_mutex_new();
+    pool->cond_space = ossl_crypto_condvar_new();
+    if (pool->lock == NULL || pool->cond_space == NULL) {
+        ossl_crypto_mutex_free(&pool->lock);
+        ossl_crypto_condvar_free(&pool->cond_space);
+        OPENSSL_free(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+static void rsa_prime_pool_stop(RSA_PRIME_POOL *pool)
+{
+    size_t i;
+
+    /* Key generation no longer takes primes once |running| is cleared */
+    ossl_crypto_mutex_lock(pool->lock);
+    pool->running = 0;
+    pool->stopping = 1;
+    ossl_crypto_condvar_broadcast(pool->cond_space);
+    ossl_crypto_mutex_unlock(pool->lock);
+
+    /* Workers finish the prime they're on before they notice */
+    for (i = 0; i < pool->num_workers; i++) {
+        ossl_crypto_thread_join(pool->workers[i], NULL);
+        ossl_crypto_thread_clean(pool->workers[i]);
+    }
+    OPENSSL_free(pool->workers);
+    pool->workers = NULL;
+    pool->num_workers = 0;
+
+    ossl_crypto_mutex_lock(pool->lock);
+    for (i = 0; i < pool->num; i++) {
+        BN_clear_free(pool->primes[i].p);
+        BN_clear_free(pool->primes[i].Xp);
+    }
+    OPENSSL_free(pool->primes);
+    pool->primes = NULL;
+    pool->num = pool->size = pool->pending = 0;
+    BN_free(pool->e);
+    pool->e = NULL;
+    pool->stopping = 0;
+    ossl_crypto_mutex_unlock(pool->lock);
+}
+
+void ossl_rsa_prime_pool_ctx_free(void *vpool)
+{
+    RSA_PRIME_POOL *pool = vpool;
+
+    if (pool == NULL)
+        return;
+    rsa_prime_pool_stop(pool);
+    ossl_crypto_mutex_free(&pool->lock);
+    ossl_crypto_condvar_free(&pool->cond_space);
+    OPENSSL_free(pool);
+}
+
+static RSA_PRIME_POOL *rsa_get_prime_pool(OSSL_LIB_CTX *libctx)
+{
+    return ossl_lib_ctx_get_data(libctx, OSSL_LIB_CTX_RSA_PRIME_POOL_INDEX);
+}
+
+static CRYPTO_THREAD_RETVAL rsa_prime_pool_worker(void *arg)
+{
+    RSA_PRIME_POOL *pool = arg;
+    BN_CTX *ctx = BN_CTX_secure_new_ex(pool->libctx);
+    BIGNUM *p, *Xp;
+    OSSL_TIME retry;
+    int ok;
+
+    if (ctx == NULL)
+        return 0;
+
+    ossl_crypto_mutex_lock(pool->lock);
+    while (!pool->stopping) {
+        if (pool->num + pool->pending >= pool->size) {
+            ossl_crypto_condvar_wait(pool->cond_space, pool->lock);
+            continue;
+        }
+        pool->pending++;
+        ossl_crypto_mutex_unlock(pool->lock);
+
+        p = BN_secure_new();
+        Xp = BN_secure_new();
+        ok = p != NULL && Xp != NULL
+            && ossl_bn_rsa_fips186_4_gen_prob_primes(p, Xp, NULL, NULL, NULL,
+                                                     NULL, NULL, pool->nbits,
+                                                     pool->e, ctx, NULL);
+
+        ossl_crypto_mutex_lock(pool->lock);
+        pool->pending--;
+        if (!ok || pool->stopping) {
+            BN_clear_free(p);
+            BN_clear_free(Xp);
+            /*
+             * Failures come from running out of memory or entropy, so give
+             * that a chance to pass before trying again
+             */
+            if (!ok && !pool->stopping) {
+                ERR_clear_error();
+                retry = ossl_time_add(ossl_time_now(), RSA_POOL_RETRY_DELAY);
+                ossl_crypto_condvar_wait_timeout(pool->cond_space, pool->lock,
+                                                 retry);
+            }
+            continue;
+        }
+        pool->primes[pool->num].p = p;
+        pool->primes[pool->num].Xp = Xp;
+        pool->num++;
+    }
+    ossl_crypto_mutex_unlock(pool->lock);
+
+    BN_CTX_free(ctx);
+    return 1;
+}
+
+int OSSL_RSA_prime_pool_start(OSSL_LIB_CTX *libctx, int bits, const BIGNUM *e,
+                              size_t size, size_t threads)
+{
+    RSA_PRIME_POOL *pool = rsa_get_prime_pool(libctx);
+    uint64_t avail;
+
+    if (pool == NULL)
+        return 0;
+
+    if (size == 0 || threads == 0) {
+        ERR_raise(ERR_LIB_RSA, ERR_R_PASSED_INVALID_ARGUMENT);
+        return 0;
+    }
+    /* Only keys that rsa_keygen() makes the SP800-56B way can use the pool */
+    if (bits < 2048) {
+        ERR_raise(ERR_LIB_RSA, RSA_R_KEY_SIZE_TOO_SMALL);
+        return 0;
+    }
+    if (e != NULL
+            && (!ossl_rsa_check_public_exponent(e) || BN_num_bits(e) <= 16)) {
+        ERR_raise(ERR_LIB_RSA, RSA_R_PUB_EXPONENT_OUT_OF_RANGE);
+        return 0;
+    }
+
+    if (pool->running)
+        rsa_prime_pool_stop(pool);
+
+    avail = ossl_get_avail_threads(libctx);
+    if (threads > avail) {
+        ERR_raise_data(ERR_LIB_RSA, ERR_R_PASSED_INVALID_ARGUMENT,
+                       "requested %llu threads, available: %llu",
+                       (unsigned long long)threads, (unsigned long long)avail);
+        return 0;
+    }
+
+    ossl_crypto_mutex_lock(pool->lock);
+    pool->nbits = bits;
+    pool->e = e != NULL ? BN_dup(e) : BN_new();
+    pool->primes = OPENSSL_zalloc(size * sizeof(*pool->primes));
+    pool->workers = OPENSSL_zalloc(threads * sizeof(*pool->workers));
+    if (pool->e == NULL || pool->primes == NULL || pool->workers == NULL
+            || (e == NULL && !BN_set_word(pool->e, 65537))) {
+        ossl_crypto_mutex_unlock(pool->lock);
+        goto err;
+    }
+    pool->size = size;
+    pool->hits = pool->misses = 0;
+    pool->running = 1;
+    ossl_crypto_mutex_unlock(pool->lock);
+
+    for (; pool->num_workers < threads; pool->num_workers++) {
+        pool->workers[pool->num_workers]
+            = ossl_crypto_thread_start(libctx, rsa_prime_pool_worker, pool);
+        if (pool->workers[pool->num_workers] == NULL) {
+            ERR_raise(ERR_LIB_RSA, ERR_R_INIT_FAIL);
+            goto err;
+        }
+    }
+    return 1;
+
+ err:
+    rsa_prime_pool_stop(pool);
+    return 0;
+}
+
+int OSSL_RSA_prime_pool_stop(OSSL_LIB_CTX *libctx)
+{
+    RSA_PRIME_POOL *pool = rsa_get_prime_pool(libctx);
+
+    if (pool == NULL)
+        return 0;
+    rsa_prime_pool_stop(pool);
+    return 1;
+}
+
+int OSSL_RSA_prime_pool_get_stats(OSSL_LIB_CTX *libctx, size_t *num,
+                                  uint64_t *hits, uint64_t *misses)
+{
+    RSA_PRIME_POOL *pool = rsa_get_prime_pool(libctx);
+
+    if (pool == NULL)
+        return 0;
+    ossl_crypto_mutex_lock(pool->lock);
+    if (num != NULL)
+        *num = pool->num;
+    if (hits != NULL)
+        *hits = pool->hits;
+    if (misses != NULL)
+        *misses = pool->misses;
+    ossl_crypto_mutex_unlock(pool->lock);
+    return 1;
+}
+
+/*
+ * Takes a prime for an |nbits| bit modulus with public exponent |e| from the
+ * pool into |p|, and the value it was derived from into |Xp|.
+ * Returns 1 if it did, or 0 if the pool had none to give.
+ */
+int ossl_rsa_prime_pool_get(OSSL_LIB_CTX *libctx, int nbits, const BIGNUM *e,
+                            BIGNUM *p, BIGNUM *Xp)
+{
+    RSA_PRIME_POOL *pool = rsa_get_prime_pool(libctx);
+    RSA_POOL_PRIME *prime;
+    int ret = 0;
+
+    if (pool == NULL)
+        return 0;
+
+    ossl_crypto_mutex_lock(pool->lock);
+    if (!pool->running || pool->stopping
+            || nbits != pool->nbits || BN_cmp(e, pool->e) != 0) {
+        ossl_crypto_mutex_unlock(pool->lock);
+        return 0;
+    }
+    if (pool->num == 0) {
+        pool->misses++;
+        ossl_crypto_mutex_unlock(pool->lock);
+        return 0;
+    }
+
+    prime = &pool->primes[--pool->num];
+    if (BN_copy(p, prime->p) != NULL && BN_copy(Xp, prime->Xp) != NULL) {
+        pool->hits++;
+        ret = 1;
+    }
+    BN_clear_free(prime->p);
+    BN_clear_free(prime->Xp);
+    prime->p = prime->Xp = NULL;
+    ossl_crypto_condvar_signal(pool->cond_space);
+    ossl_crypto_mutex_unlock(pool->lock);
+    return ret;
+}
+
+#else
+
+int OSSL_RSA_prime_pool_start(OSSL_LIB_CTX *libctx, int bits, const BIGNUM *e,
+                              size_t size, size_t threads)
+{
+    ERR_raise(ERR_LIB_RSA, ERR_R_UNSUPPORTED);
+    return 0;
+}
+
+int OSSL_RSA_prime_pool_stop(OSSL_LIB_CTX *libctx)
+{
+    return 0;
+}
+
+int OSSL_RSA_prime_pool_get_stats(OSSL_LIB_CTX *libctx, size_t *num,
+                                  uint64_t *hits, uint64_t *misses)
+{
+    return 0;
+}
+
+int ossl_rsa_prime_pool_get(OSSL_LIB_CTX *libctx, int nbits, const BIGNUM *e,
+                            BIGNUM *p, BIGNUM *Xp)
+{
+    return 0;
+}
+
+#endif
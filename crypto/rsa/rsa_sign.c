@@ -230,6 +230,25 @@ static int digest_sz_from_nid(int nid)
 /* Size of an SSL signature: MD5+SHA1 */
 #define SSL_SIG_LENGTH  36
 
+/*
+ * Returns the DigestInfo prefix for the digest |type|, which is followed by
+ * the digest itself, and sets |*len| to its length.  Returns NULL on error.
+ */
+static const unsigned char *digestinfo_prefix(int type, size_t *len)
+{
+    const unsigned char *di_prefix;
+
+    if (type == NID_undef) {
+        ERR_raise(ERR_LIB_RSA, RSA_R_UNKNOWN_ALGORITHM_TYPE);
+        return NULL;
+    }
+    di_prefix = ossl_rsa_digestinfo_encoding(type, len);
+    if (di_prefix == NULL)
+        ERR_raise(ERR_LIB_RSA,
+                  RSA_R_THE_ASN1_OBJECT_IDENTIFIER_IS_NOT_KNOWN_FOR_THIS_MD);
+    return di_prefix;
+}
+
 /*
  * Encodes a DigestInfo prefix of hash |type| and digest |m|, as
  * described in EMSA-PKCS1-v1_5-ENCODE, RFC 3447 section 9.2 step 2. This
@@ -246,16 +265,8 @@ static int encode_pkcs1(unsigned char **out, size_t *out_len, int type,
     const unsigned char *di_prefix;
     unsigned char *dig_info;
 
-    if (type == NID_undef) {
-        ERR_raise(ERR_LIB_RSA, RSA_R_UNKNOWN_ALGORITHM_TYPE);
+    if ((di_prefix = digestinfo_prefix(type, &di_prefix_len)) == NULL)
         return 0;
-    }
-    di_prefix = ossl_rsa_digestinfo_encoding(type, &di_prefix_len);
-    if (di_prefix == NULL) {
-        ERR_raise(ERR_LIB_RSA,
-                  RSA_R_THE_ASN1_OBJECT_IDENTIFIER_IS_NOT_KNOWN_FOR_THIS_MD);
-        return 0;
-    }
     dig_info_len = di_prefix_len + m_len;
     dig_info = OPENSSL_malloc(dig_info_len);
     if (dig_info == NULL)
@@ -331,8 +342,9 @@ int ossl_rsa_verify(int type, const unsigned char *m, unsigned int m_len,
                     const unsigned char *sigbuf, size_t siglen, RSA *rsa)
 {
     int len, ret = 0;
-    size_t decrypt_len, encoded_len = 0;
-    unsigned char *decrypt_buf = NULL, *encoded = NULL;
+    size_t decrypt_len, di_prefix_len;
+    const unsigned char *di_prefix;
+    unsigned char stack_buf[RSA_STACK_BUF_SIZE], *decrypt_buf = stack_buf;
 
     if (siglen != (size_t)RSA_size(rsa)) {
         ERR_raise(ERR_LIB_RSA, RSA_R_WRONG_SIGNATURE_LENGTH);
@@ -340,9 +352,9 @@ int ossl_rsa_verify(int type, const unsigned char *m, unsigned int m_len,
     }
 
     /* Recover the encoded digest. */
-    decrypt_buf = OPENSSL_malloc(siglen);
-    if (decrypt_buf == NULL)
-        goto err;
+    if (siglen > sizeof(stack_buf)
+        && (decrypt_buf = OPENSSL_malloc(siglen)) == NULL)
+        return 0;
 
     len = RSA_public_decrypt((int)siglen, sigbuf, decrypt_buf, rsa,
                              RSA_PKCS1_PADDING);
@@ -401,8 +413,8 @@ int ossl_rsa_verify(int type, const unsigned char *m, unsigned int m_len,
     {
         /*
          * If recovering the digest, extract a digest-sized output from the end
-         * of |decrypt_buf| for |encode_pkcs1|, then compare the decryption
-         * output as in a standard verification.
+         * of |decrypt_buf|, then compare the decryption output as in a
+         * standard verification.
          */
         if (rm != NULL) {
             len = digest_sz_from_nid(type);
@@ -417,12 +429,13 @@ int ossl_rsa_verify(int type, const unsigned char *m, unsigned int m_len,
             m = decrypt_buf + decrypt_len - m_len;
         }
 
-        /* Construct the encoded digest and ensure it matches. */
-        if (!encode_pkcs1(&encoded, &encoded_len, type, m, m_len))
+        /* Ensure the encoded digest matches, without constructing it. */
+        if ((di_prefix = digestinfo_prefix(type, &di_prefix_len)) == NULL)
             goto err;
 
-        if (encoded_len != decrypt_len
-                || memcmp(encoded, decrypt_buf, encoded_len) != 0) {
+        if (di_prefix_len + m_len != decrypt_len
+                || memcmp(di_prefix, decrypt_buf, di_prefix_len) != 0
+                || memcmp(m, decrypt_buf + di_prefix_len, m_len) != 0) {
             ERR_raise(ERR_LIB_RSA, RSA_R_BAD_SIGNATURE);
             goto err;
         }
@@ -437,8 +450,10 @@ int ossl_rsa_verify(int type, const unsigned char *m, unsigned int m_len,
     ret = 1;
 
 err:
-    OPENSSL_clear_free(encoded, encoded_len);
-    OPENSSL_clear_free(decrypt_buf, siglen);
+    if (decrypt_buf != stack_buf)
+        OPENSSL_clear_free(decrypt_buf, siglen);
+    else
+        OPENSSL_cleanse(stack_buf, siglen);
     return ret;
 }
 
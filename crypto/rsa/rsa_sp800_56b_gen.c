@@ -20,6 +20,26 @@
 #define RSA_FIPS1864_MIN_KEYGEN_KEYSIZE 2048
 #define RSA_FIPS1864_MIN_KEYGEN_STRENGTH 112
 
+/*
+ * Generates the probable prime 'p' from 'Xp', or takes one that the prime
+ * pool of the library context generated earlier in the same way.
+ * Primes that depend on passed in values can't come from the pool.
+ */
+static int rsa_gen_prob_prime(BIGNUM *p, BIGNUM *Xpout, BIGNUM *p1, BIGNUM *p2,
+                              const BIGNUM *Xp, const BIGNUM *Xp1,
+                              const BIGNUM *Xp2, int nbits, const BIGNUM *e,
+                              BN_CTX *ctx, BN_GENCB *cb)
+{
+#ifndef FIPS_MODULE
+    if (p1 == NULL && p2 == NULL && Xp == NULL && Xp1 == NULL && Xp2 == NULL
+            && ossl_rsa_prime_pool_get(ossl_bn_get_libctx(ctx), nbits, e,
+                                       p, Xpout))
+        return 1;
+#endif
+    return ossl_bn_rsa_fips186_4_gen_prob_primes(p, Xpout, p1, p2, Xp, Xp1, Xp2,
+                                                 nbits, e, ctx, cb);
+}
+
 /*
  * Generate probable primes 'p' & 'q'. See FIPS 186-4 Section B.3.6
  * "Generation of Probable Primes with Conditions Based on Auxiliary Probable
@@ -122,13 +142,13 @@ int ossl_rsa_fips186_4_gen_prob_primes(RSA *rsa, RSA_ACVP_TEST *test,
     BN_set_flags(rsa->q, BN_FLG_CONSTTIME);
 
     /* (Step 4) Generate p, Xp */
-    if (!ossl_bn_rsa_fips186_4_gen_prob_primes(rsa->p, Xpo, p1, p2, Xp, Xp1, Xp2,
-                                               nbits, e, ctx, cb))
+    if (!rsa_gen_prob_prime(rsa->p, Xpo, p1, p2, Xp, Xp1, Xp2, nbits, e, ctx,
+                            cb))
         goto err;
     for (;;) {
         /* (Step 5) Generate q, Xq*/
-        if (!ossl_bn_rsa_fips186_4_gen_prob_primes(rsa->q, Xqo, q1, q2, Xq, Xq1,
-                                                   Xq2, nbits, e, ctx, cb))
+        if (!rsa_gen_prob_prime(rsa->q, Xqo, q1, q2, Xq, Xq1, Xq2, nbits, e,
+                                ctx, cb))
             goto err;
 
         /* (Step 6) |Xp - Xq| > 2^(nbitlen/2 - 100) */
@@ -27,7 +27,20 @@
 # include <sys/stat.h>
 #endif
 
+/* Directory indexes are used where modification times are precise enough */
+#if defined(OPENSSL_SYS_UNIX) && !defined(OPENSSL_NO_POSIX_IO)
+# include <fcntl.h>
+# include <unistd.h>
+# define BY_DIR_USE_INDEX
+# ifdef __APPLE__
+#  define BY_DIR_MTIME(st) ((st).st_mtimespec)
+# else
+#  define BY_DIR_MTIME(st) ((st).st_mtim)
+# endif
+#endif
+
 #include <openssl/x509.h>
+#include "internal/hashdir_index.h"
 #include "crypto/x509.h"
 #include "x509_local.h"
 
@@ -36,10 +49,33 @@ struct lookup_dir_hashes_st {
     int suffix;
 };
 
+/* The index of a hashed directory read into memory, see hashdir_index.h */
+typedef struct lookup_dir_index_st {
+    unsigned char *data;
+    size_t len;
+    size_t num;
+    /* Whether each entry has been added to the store, under the BY_DIR lock */
+    unsigned char *loaded;
+    /* When the files were last looked at, under the BY_DIR lock */
+    time_t checked;
+#ifdef BY_DIR_USE_INDEX
+    /* The index file and directory this was read from */
+    struct stat st, dir_st;
+#endif
+    struct lookup_dir_index_st *next;
+} BY_DIR_INDEX;
+
 struct lookup_dir_entry_st {
     char *dir;
     int dir_type;
     STACK_OF(BY_DIR_HASH) *hashes;
+    /*
+     * The current index, NULL if the directory has none that is usable, under
+     * the BY_DIR lock.  Indexes that were replaced are kept on the list of the
+     * current one, as lookups in other threads may still be reading them.
+     */
+    BY_DIR_INDEX *index;
+    BY_DIR_INDEX *retired;
 };
 
 typedef struct lookup_dir_st {
@@ -146,10 +182,308 @@ static int by_dir_hash_cmp(const BY_DIR_HASH *const *a,
     return 0;
 }
 
+static uint32_t by_dir_index_u32(const unsigned char *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16)
+        | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static const unsigned char *by_dir_index_entry(const BY_DIR_INDEX *idx,
+                                               size_t i)
+{
+    return idx->data + OSSL_HASHDIR_INDEX_HEADER_LEN
+        + i * OSSL_HASHDIR_INDEX_ENTRY_LEN;
+}
+
+static void by_dir_index_free(BY_DIR_INDEX *idx)
+{
+    BY_DIR_INDEX *next;
+
+    for (; idx != NULL; idx = next) {
+        next = idx->next;
+        OPENSSL_free(idx->data);
+        OPENSSL_free(idx->loaded);
+        OPENSSL_free(idx);
+    }
+}
+
+#ifdef BY_DIR_USE_INDEX
+static int by_dir_mtime_cmp(const struct stat *a, const struct stat *b)
+{
+    if (BY_DIR_MTIME(*a).tv_sec != BY_DIR_MTIME(*b).tv_sec)
+        return BY_DIR_MTIME(*a).tv_sec < BY_DIR_MTIME(*b).tv_sec ? -1 : 1;
+    if (BY_DIR_MTIME(*a).tv_nsec != BY_DIR_MTIME(*b).tv_nsec)
+        return BY_DIR_MTIME(*a).tv_nsec < BY_DIR_MTIME(*b).tv_nsec ? -1 : 1;
+    return 0;
+}
+
+static char *by_dir_index_path(const char *dir)
+{
+    size_t pathlen = strlen(dir) + sizeof(OSSL_HASHDIR_INDEX_NAME) + 1;
+    char *path;
+
+    if ((path = OPENSSL_malloc(pathlen)) != NULL)
+        BIO_snprintf(path, pathlen, "%s/%s", dir, OSSL_HASHDIR_INDEX_NAME);
+    return path;
+}
+#endif
+
+/*
+ * Reads the index of |dir| if it has one that is well formed and up to date,
+ * else returns NULL so that the directory is searched file by file.  The index
+ * is read rather than mapped, as a mapping would fault if the file were
+ * truncated while in use.
+ */
+static BY_DIR_INDEX *by_dir_index_open(const char *dir)
+{
+#ifdef BY_DIR_USE_INDEX
+    BY_DIR_INDEX *idx = NULL;
+    const unsigned char *ent;
+    uint32_t prev_type = 0, prev_hash = 0, type, hash, off, len;
+    size_t i, done;
+    ssize_t n;
+    char *path;
+    int fd = -1;
+
+    if ((path = by_dir_index_path(dir)) == NULL
+            || (idx = OPENSSL_zalloc(sizeof(*idx))) == NULL)
+        goto err;
+    if (stat(dir, &idx->dir_st) < 0 || (fd = open(path, O_RDONLY)) < 0
+            || fstat(fd, &idx->st) < 0 || !S_ISREG(idx->st.st_mode)
+            || by_dir_mtime_cmp(&idx->st, &idx->dir_st) < 0
+            || idx->st.st_size < OSSL_HASHDIR_INDEX_HEADER_LEN
+            || (uint64_t)idx->st.st_size > UINT32_MAX)
+        goto err;
+    idx->len = (size_t)idx->st.st_size;
+    if ((idx->data = OPENSSL_malloc(idx->len)) == NULL)
+        goto err;
+    for (done = 0; done < idx->len; done += (size_t)n)
+        if ((n = read(fd, idx->data + done, idx->len - done)) <= 0)
+            goto err;
+
+    /* Check the whole index up front, so that lookups can trust it */
+    if (memcmp(idx->data, OSSL_HASHDIR_INDEX_MAGIC,
+               OSSL_HASHDIR_INDEX_MAGIC_LEN) != 0)
+        goto err;
+    idx->num = by_dir_index_u32(idx->data + OSSL_HASHDIR_INDEX_MAGIC_LEN);
+    if (idx->num > (idx->len - OSSL_HASHDIR_INDEX_HEADER_LEN)
+                   / OSSL_HASHDIR_INDEX_ENTRY_LEN)
+        goto err;
+    for (i = 0; i < idx->num; i++) {
+        ent = by_dir_index_entry(idx, i);
+        hash = by_dir_index_u32(ent);
+        type = by_dir_index_u32(ent + 4);
+        off = by_dir_index_u32(ent + 8);
+        len = by_dir_index_u32(ent + 12);
+        if (type > OSSL_HASHDIR_INDEX_TYPE_CRL
+                || type < prev_type || (type == prev_type && hash < prev_hash)
+                || off > idx->len || len > idx->len - off)
+            goto err;
+        prev_type = type;
+        prev_hash = hash;
+    }
+    if (idx->num > 0 && (idx->loaded = OPENSSL_zalloc(idx->num)) == NULL)
+        goto err;
+    idx->checked = time(NULL);
+
+    close(fd);
+    OPENSSL_free(path);
+    return idx;
+
+ err:
+    by_dir_index_free(idx);
+    if (fd >= 0)
+        close(fd);
+    OPENSSL_free(path);
+#endif
+    return NULL;
+}
+
+/*
+ * Checks whether the directory of |ent| or its index changed since |idx| was
+ * read from them.
+ */
+static int by_dir_index_changed(const BY_DIR_ENTRY *ent,
+                                const BY_DIR_INDEX *idx)
+{
+#ifdef BY_DIR_USE_INDEX
+    struct stat dir_st, st;
+    char *path;
+    int ret;
+
+    if (stat(ent->dir, &dir_st) < 0
+            || by_dir_mtime_cmp(&dir_st, &idx->dir_st) != 0)
+        return 1;
+    if ((path = by_dir_index_path(ent->dir)) == NULL)
+        return 0;
+    ret = stat(path, &st) < 0
+        || st.st_dev != idx->st.st_dev || st.st_ino != idx->st.st_ino
+        || st.st_size != idx->st.st_size
+        || by_dir_mtime_cmp(&st, &idx->st) != 0;
+    OPENSSL_free(path);
+    return ret;
+#else
+    return 0;
+#endif
+}
+
+/*
+ * Called when a lookup in |idx| finds nothing, in case that is because it went
+ * out of date.  Reads the index of |ent| again if the directory or the index
+ * changed since, and returns the index to use, or NULL to search the files.
+ * The files are looked at no more than once a second, as misses can be many.
+ */
+static BY_DIR_INDEX *by_dir_index_refresh(BY_DIR *ctx, BY_DIR_ENTRY *ent,
+                                          BY_DIR_INDEX *idx)
+{
+    BY_DIR_INDEX *newidx;
+    time_t now = time(NULL);
+    int due;
+
+    if (!CRYPTO_THREAD_read_lock(ctx->lock))
+        return idx;
+    newidx = ent->index;
+    due = newidx == idx && idx->checked != now;
+    CRYPTO_THREAD_unlock(ctx->lock);
+    if (!due)
+        return newidx;
+
+    if (!CRYPTO_THREAD_write_lock(ctx->lock))
+        return idx;
+    newidx = ent->index;
+    due = newidx == idx && idx->checked != now;
+    idx->checked = now;
+    CRYPTO_THREAD_unlock(ctx->lock);
+    if (!due)
+        return newidx;
+    if (!by_dir_index_changed(ent, idx))
+        return idx;
+
+    /* The new index is read without the lock, and only swapped in under it */
+    newidx = by_dir_index_open(ent->dir);
+
+    if (!CRYPTO_THREAD_write_lock(ctx->lock)) {
+        by_dir_index_free(newidx);
+        return idx;
+    }
+    /* Another lookup may have got there first */
+    if (ent->index != idx) {
+        by_dir_index_free(newidx);
+        newidx = ent->index;
+    } else {
+        idx->next = ent->retired;
+        ent->retired = idx;
+        ent->index = newidx;
+    }
+    CRYPTO_THREAD_unlock(ctx->lock);
+    return newidx;
+}
+
+/*
+ * Finds the entries of |idx| with the given |type| and |hash|, returning how
+ * many there are and the first of them in |*first|.
+ */
+static size_t by_dir_index_find(const BY_DIR_INDEX *idx, uint32_t type,
+                                uint32_t hash, size_t *first)
+{
+    const unsigned char *ent;
+    size_t lo = 0, hi = idx->num, mid, n;
+    uint32_t t, h;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        ent = by_dir_index_entry(idx, mid);
+        t = by_dir_index_u32(ent + 4);
+        h = by_dir_index_u32(ent);
+        if (t < type || (t == type && h < hash))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    for (n = 0; lo + n < idx->num; n++) {
+        ent = by_dir_index_entry(idx, lo + n);
+        if (by_dir_index_u32(ent + 4) != type || by_dir_index_u32(ent) != hash)
+            break;
+    }
+    *first = lo;
+    return n;
+}
+
+/* Decodes entry |i| of |idx| and adds it to the store */
+static int by_dir_index_add(X509_LOOKUP *xl, const BY_DIR_INDEX *idx, size_t i,
+                            OSSL_LIB_CTX *libctx, const char *propq)
+{
+    const unsigned char *ent = by_dir_index_entry(idx, i);
+    const unsigned char *p = idx->data + by_dir_index_u32(ent + 8);
+    long len = (long)by_dir_index_u32(ent + 12);
+    X509 *x;
+    X509_CRL *crl;
+    int ok;
+
+    if (by_dir_index_u32(ent + 4) == OSSL_HASHDIR_INDEX_TYPE_CERT) {
+        x = X509_new_ex(libctx, propq);
+        ok = x != NULL && d2i_X509_AUX(&x, &p, len) != NULL
+            && X509_STORE_add_cert(xl->store_ctx, x);
+        X509_free(x);
+    } else {
+        crl = d2i_X509_CRL(NULL, &p, len);
+        ok = crl != NULL && X509_STORE_add_crl(xl->store_ctx, crl);
+        X509_CRL_free(crl);
+    }
+    return ok;
+}
+
+/*
+ * Adds the objects of |type| with name hash |h| listed in |idx| to the store,
+ * unless that was done by an earlier lookup. Returns the number of such
+ * objects, or -1 on error.  The objects are decoded and added without the
+ * lock, as the store ignores those it already has, like when the same file
+ * is loaded by two lookups.
+ */
+static int by_dir_index_load(X509_LOOKUP *xl, BY_DIR *ctx, BY_DIR_INDEX *idx,
+                             X509_LOOKUP_TYPE type, unsigned long h,
+                             OSSL_LIB_CTX *libctx, const char *propq)
+{
+    size_t first, i, n;
+    int pending = 0;
+
+    n = by_dir_index_find(idx, type == X509_LU_CRL
+                               ? OSSL_HASHDIR_INDEX_TYPE_CRL
+                               : OSSL_HASHDIR_INDEX_TYPE_CERT,
+                          (uint32_t)h, &first);
+    if (n == 0)
+        return 0;
+
+    if (!CRYPTO_THREAD_read_lock(ctx->lock))
+        return -1;
+    for (i = first; i < first + n && !pending; i++)
+        pending = !idx->loaded[i];
+    CRYPTO_THREAD_unlock(ctx->lock);
+    if (!pending)
+        return (int)n;
+
+    for (i = first; i < first + n; i++) {
+        /* Malformed entries are skipped like malformed files */
+        ERR_set_mark();
+        if (by_dir_index_add(xl, idx, i, libctx, propq))
+            ERR_clear_last_mark();
+        else
+            ERR_pop_to_mark();
+    }
+
+    if (!CRYPTO_THREAD_write_lock(ctx->lock))
+        return -1;
+    memset(idx->loaded + first, 1, n);
+    CRYPTO_THREAD_unlock(ctx->lock);
+    return (int)n;
+}
+
 static void by_dir_entry_free(BY_DIR_ENTRY *ent)
 {
     OPENSSL_free(ent->dir);
     sk_BY_DIR_HASH_pop_free(ent->hashes, by_dir_hash_free);
+    by_dir_index_free(ent->index);
+    by_dir_index_free(ent->retired);
     OPENSSL_free(ent);
 }
 
@@ -204,11 +538,13 @@ static int add_cert_dir(BY_DIR *ctx, const char *dir, int type)
                 return 0;
             ent->dir_type = type;
             ent->hashes = sk_BY_DIR_HASH_new(by_dir_hash_cmp);
+            ent->index = ent->retired = NULL;
             ent->dir = OPENSSL_strndup(ss, len);
             if (ent->dir == NULL || ent->hashes == NULL) {
                 by_dir_entry_free(ent);
                 return 0;
             }
+            ent->index = by_dir_index_open(ent->dir);
             if (!sk_BY_DIR_ENTRY_push(ctx->dirs, ent)) {
                 by_dir_entry_free(ent);
                 ERR_raise(ERR_LIB_X509, ERR_R_CRYPTO_LIB);
@@ -224,29 +560,19 @@ static int get_cert_by_subject_ex(X509_LOOKUP *xl, X509_LOOKUP_TYPE type,
                                   OSSL_LIB_CTX *libctx, const char *propq)
 {
     BY_DIR *ctx;
-    union {
-        X509 st_x509;
-        X509_CRL crl;
-    } data;
     int ok = 0;
     int i, j, k;
     unsigned long h;
     BUF_MEM *b = NULL;
-    X509_OBJECT stmp, *tmp;
+    X509_OBJECT *tmp;
     const char *postfix = "";
 
     if (name == NULL)
         return 0;
 
-    stmp.type = type;
-    if (type == X509_LU_X509) {
-        data.st_x509.cert_info.subject = (X509_NAME *)name; /* won't modify it */
-        stmp.data.x509 = &data.st_x509;
-    } else if (type == X509_LU_CRL) {
-        data.crl.crl.issuer = (X509_NAME *)name; /* won't modify it */
-        stmp.data.crl = &data.crl;
+    if (type == X509_LU_CRL) {
         postfix = "r";
-    } else {
+    } else if (type != X509_LU_X509) {
         ERR_raise(ERR_LIB_X509, X509_R_WRONG_LOOKUP_TYPE);
         goto finish;
     }
@@ -262,10 +588,37 @@ static int get_cert_by_subject_ex(X509_LOOKUP *xl, X509_LOOKUP_TYPE type,
         goto finish;
     for (i = 0; i < sk_BY_DIR_ENTRY_num(ctx->dirs); i++) {
         BY_DIR_ENTRY *ent;
-        int idx;
+        BY_DIR_INDEX *index, *newindex = NULL;
+        int idx, refreshed;
         BY_DIR_HASH htmp, *hent;
 
         ent = sk_BY_DIR_ENTRY_value(ctx->dirs, i);
+
+        if (!CRYPTO_THREAD_read_lock(ctx->lock))
+            goto finish;
+        index = ent->index;
+        CRYPTO_THREAD_unlock(ctx->lock);
+
+        /* An index lists everything in its directory, so no files are read */
+        for (refreshed = 0; index != NULL; refreshed = 1, index = newindex) {
+            if ((k = by_dir_index_load(xl, ctx, index, type, h, libctx,
+                                       propq)) < 0)
+                goto finish;
+            if (k > 0
+                && (tmp = ossl_x509_store_get0_by_subject(xl->store_ctx, type,
+                                                          name)) != NULL) {
+                ok = 1;
+                ret->type = tmp->type;
+                memcpy(&ret->data, &tmp->data, sizeof(ret->data));
+                goto finish;
+            }
+            if (refreshed
+                || (newindex = by_dir_index_refresh(ctx, ent, index)) == index)
+                break;
+        }
+        if (index != NULL)
+            continue;
+
         j = strlen(ent->dir) + 1 + 8 + 6 + 1 + 1;
         if (!BUF_MEM_grow(b, j)) {
             ERR_raise(ERR_LIB_X509, ERR_R_BUF_LIB);
@@ -341,18 +694,9 @@ static int get_cert_by_subject_ex(X509_LOOKUP *xl, X509_LOOKUP_TYPE type,
             k++;
         }
 
-        /*
-         * we have added it to the cache so now pull it out again
-         *
-         * Note: quadratic time find here since the objects won't generally be
-         *       sorted and sorting the would result in O(n^2 log n) complexity.
-         */
+        /* we have added it to the cache so now pull it out again */
         if (k > 0) {
-            if (!X509_STORE_lock(xl->store_ctx))
-                goto finish;
-            j = sk_X509_OBJECT_find(xl->store_ctx->objs, &stmp);
-            tmp = sk_X509_OBJECT_value(xl->store_ctx->objs, j);
-            X509_STORE_unlock(xl->store_ctx);
+            tmp = ossl_x509_store_get0_by_subject(xl->store_ctx, type, name);
         } else {
             tmp = NULL;
         }
@@ -419,14 +763,6 @@ static int get_cert_by_subject_ex(X509_LOOKUP *xl, X509_LOOKUP_TYPE type,
         }
     }
  finish:
-    /* If we changed anything, resort the objects for faster lookup */
-    if (!sk_X509_OBJECT_is_sorted(xl->store_ctx->objs)) {
-        if (X509_STORE_lock(xl->store_ctx)) {
-            sk_X509_OBJECT_sort(xl->store_ctx->objs);
-            X509_STORE_unlock(xl->store_ctx);
-        }
-    }
-
     BUF_MEM_free(b);
     return ok;
 }
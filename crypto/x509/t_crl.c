@@ -14,6 +14,7 @@
 #include <openssl/objects.h>
 #include <openssl/x509.h>
 #include <openssl/x509v3.h>
+#include "crypto/x509.h"
 
 #ifndef OPENSSL_NO_STDIO
 int X509_CRL_print_fp(FILE *fp, X509_CRL *x)
@@ -70,7 +71,7 @@ int X509_CRL_print_ex(BIO *out, X509_CRL *x, unsigned long nmflag)
     X509V3_extensions_print(out, "CRL extensions",
                             X509_CRL_get0_extensions(x), 0, 8);
 
-    rev = X509_CRL_get_REVOKED(x);
+    rev = x->crl.revoked;
 
     if (sk_X509_REVOKED_num(rev) > 0)
         BIO_printf(out, "Revoked Certificates:\n");
@@ -555,7 +555,8 @@ int ossl_x509v3_cache_extensions(X509 *x)
         x->ex_flags |= EXFLAG_INVALID;
 
     /* Check if subject name matches issuer */
-    if (X509_NAME_cmp(X509_get_subject_name(x), X509_get_issuer_name(x)) == 0) {
+    if (ossl_x509_name_equal(X509_get_subject_name(x),
+                             X509_get_issuer_name(x))) {
         x->ex_flags |= EXFLAG_SI; /* Cert is self-issued */
         if (X509_check_akid(x, x->akid) == X509_V_OK /* SKID matches AKID */
                 /* .. and the signature alg matches the PUBKEY alg: */
@@ -964,8 +965,8 @@ int ossl_x509_likely_issued(X509 *issuer, X509 *subject)
 {
     int ret;
 
-    if (X509_NAME_cmp(X509_get_subject_name(issuer),
-                      X509_get_issuer_name(subject)) != 0)
+    if (!ossl_x509_name_equal(X509_get_subject_name(issuer),
+                              X509_get_issuer_name(subject)))
         return X509_V_ERR_SUBJECT_ISSUER_MISMATCH;
 
     /* set issuer->skid and subject->akid */
@@ -1031,7 +1032,8 @@ int X509_check_akid(const X509 *issuer, const AUTHORITY_KEYID *akid)
                 break;
             }
         }
-        if (nm != NULL && X509_NAME_cmp(nm, X509_get_issuer_name(issuer)) != 0)
+        if (nm != NULL
+                && !ossl_x509_name_equal(nm, X509_get_issuer_name(issuer)))
             return X509_V_ERR_AKID_ISSUER_SERIAL_MISMATCH;
     }
     return X509_V_OK;
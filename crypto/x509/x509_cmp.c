@@ -251,6 +251,14 @@ int ossl_x509_add_certs_new(STACK_OF(X509) **p_sk, STACK_OF(X509) *certs,
     return 1;
 }
 
+/* Ensure the canonical encoding of |a| is present and up to date */
+static int x509_name_canon_ready(const X509_NAME *a)
+{
+    if (a->canon_enc == NULL || a->modified)
+        return i2d_X509_NAME((X509_NAME *)a, NULL) >= 0;
+    return 1;
+}
+
 int X509_NAME_cmp(const X509_NAME *a, const X509_NAME *b)
 {
     int ret;
@@ -260,18 +268,8 @@ int X509_NAME_cmp(const X509_NAME *a, const X509_NAME *b)
     if (a == NULL)
         return -1;
 
-    /* Ensure canonical encoding is present and up to date */
-    if (a->canon_enc == NULL || a->modified) {
-        ret = i2d_X509_NAME((X509_NAME *)a, NULL);
-        if (ret < 0)
-            return -2;
-    }
-
-    if (b->canon_enc == NULL || b->modified) {
-        ret = i2d_X509_NAME((X509_NAME *)b, NULL);
-        if (ret < 0)
-            return -2;
-    }
+    if (!x509_name_canon_ready(a) || !x509_name_canon_ready(b))
+        return -2;
 
     ret = a->canon_enclen - b->canon_enclen;
     if (ret == 0 && a->canon_enclen == 0)
@@ -286,6 +284,29 @@ int X509_NAME_cmp(const X509_NAME *a, const X509_NAME *b)
     return ret < 0 ? -1 : ret > 0;
 }
 
+/*
+ * Equivalent to X509_NAME_cmp(a, b) == 0, but rejects most unequal names on
+ * their canonical hash without comparing the encodings. X509_NAME_cmp() itself
+ * can't do this as it also has to order the names.
+ */
+int ossl_x509_name_equal(const X509_NAME *a, const X509_NAME *b)
+{
+    if (a == NULL || b == NULL)
+        return a == b;
+    if (a == b)
+        return 1;
+
+    if (!x509_name_canon_ready(a) || !x509_name_canon_ready(b))
+        return 0;
+
+    if (a->canon_enclen != b->canon_enclen || a->canon_hash != b->canon_hash)
+        return 0;
+    if (a->canon_enclen == 0)
+        return 1;
+    return a->canon_enc != NULL && b->canon_enc != NULL
+        && memcmp(a->canon_enc, b->canon_enc, a->canon_enclen) == 0;
+}
+
 unsigned long X509_NAME_hash_ex(const X509_NAME *x, OSSL_LIB_CTX *libctx,
                                 const char *propq, int *ok)
 {
@@ -372,7 +393,7 @@ X509 *X509_find_by_subject(STACK_OF(X509) *sk, const X509_NAME *name)
 
     for (i = 0; i < sk_X509_num(sk); i++) {
         x509 = sk_X509_value(sk, i);
-        if (X509_NAME_cmp(X509_get_subject_name(x509), name) == 0)
+        if (ossl_x509_name_equal(X509_get_subject_name(x509), name))
             return x509;
     }
     return NULL;
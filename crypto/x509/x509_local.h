@@ -106,6 +106,9 @@ struct x509_lookup_st {
     X509_STORE *store_ctx;      /* who owns us */
 };
 
+typedef struct x509_store_index_st X509_STORE_INDEX;
+typedef struct x509_verify_cache_st X509_VERIFY_CACHE;
+
 /*
  * This is used to hold everything.  It is used for all certificate
  * validation.  Once we have a certificate chain, the 'verify' function is
@@ -115,6 +118,15 @@ struct x509_store_st {
     /* The following is a cache of trusted certs */
     int cache;                  /* if true, stash any hits */
     STACK_OF(X509_OBJECT) *objs; /* Cache of all objects */
+    /*
+     * Hash index over |objs| by subject (or CRL issuer) name, under |lock|,
+     * see x509_lu.c. Not used once |index_disabled| is set, which is read and
+     * written atomically.
+     */
+    X509_STORE_INDEX *index;
+    int index_disabled;
+    /* Cache of successful verifications, see x509_vcache.c */
+    X509_VERIFY_CACHE *verify_cache;
     /* These are external lookup methods */
     STACK_OF(X509_LOOKUP) *get_cert_methods;
     X509_VERIFY_PARAM *param;
@@ -156,4 +168,23 @@ typedef STACK_OF(X509_NAME_ENTRY) STACK_OF_X509_NAME_ENTRY;
 DEFINE_STACK_OF(STACK_OF_X509_NAME_ENTRY)
 
 int ossl_x509_likely_issued(X509 *issuer, X509 *subject);
+int ossl_x509_store_index_disabled(const X509_STORE *store);
+X509_OBJECT *ossl_x509_store_get0_by_subject(X509_STORE *store,
+                                             X509_LOOKUP_TYPE type,
+                                             const X509_NAME *name);
 int ossl_x509_signing_allowed(const X509 *issuer, const X509 *subject);
+
+int ossl_x509_crl_index_revoked(X509_CRL *crl);
+int ossl_x509_crl_lookup(X509_CRL *crl, X509_REVOKED **ret,
+                         const ASN1_INTEGER *serial, const X509_NAME *issuer);
+
+void ossl_x509_verify_cache_free(X509_VERIFY_CACHE *vc);
+void ossl_x509_verify_cache_flush(X509_VERIFY_CACHE *vc);
+size_t ossl_x509_verify_cache_hits(const X509_VERIFY_CACHE *vc);
+BUF_MEM *ossl_x509_verify_cache_key(X509_STORE_CTX *ctx);
+int ossl_x509_verify_cache_get1(X509_VERIFY_CACHE *vc, X509_STORE_CTX *ctx,
+                                const BUF_MEM *key, STACK_OF(X509) **chain,
+                                int *num_untrusted);
+void ossl_x509_verify_cache_limit(X509_STORE_CTX *ctx, const ASN1_TIME *t);
+void ossl_x509_verify_cache_add(X509_VERIFY_CACHE *vc, X509_STORE_CTX *ctx,
+                                const BUF_MEM *key);
@@ -10,6 +10,7 @@
 #include <stdio.h>
 #include "internal/cryptlib.h"
 #include "internal/refcount.h"
+#include "internal/tsan_assist.h"
 #include <openssl/x509.h>
 #include "crypto/x509.h"
 #include <openssl/x509v3.h>
@@ -179,6 +180,300 @@ static int x509_object_cmp(const X509_OBJECT *const *a,
     return ret;
 }
 
+/*
+ * X509_STORE object index
+ * =======================
+ *
+ * Chain building looks up the store by subject name at least once for every
+ * certificate of every chain verified, and a store is typically shared by all
+ * threads of a process. Searching |objs| requires it to be sorted, which in
+ * turn requires the store lock, and sorting after each addition requires the
+ * write lock, so lookups in |objs| serialise all threads verifying chains.
+ *
+ * Lookups therefore use a separate index: an open-addressed hash table keyed
+ * by a hash of the canonical encoding of the subject name (or of the issuer
+ * name for CRLs), holding pointers to the X509_OBJECTs in |objs|. The index
+ * never needs sorting, so lookups only take the read lock and run
+ * concurrently. When the index would become more than half full, it is
+ * replaced by one twice the size built from |objs|.
+ *
+ * Objects with the same name are found in the order they were added, which
+ * is the order the sorted |objs| has them in.
+ *
+ * Readers hold the lock for as long as they use the objects they find, as an
+ * application that has called X509_STORE_get0_objects() may remove objects
+ * from |objs| and free them with the store locked.  X509_STORE_get0_objects()
+ * also disables the index, since the application might modify |objs| behind
+ * its back, and lookups then fall back to searching |objs|. It may be called
+ * with the store locked or not, so it only sets |index_disabled|, which is
+ * never cleared, and the index itself is left alone until the store is freed.
+ */
+#if defined(tsan_ld_acq) && defined(tsan_st_rel)
+# define flag_ld_acq(p)         tsan_ld_acq((int TSAN_QUALIFIER *)(p))
+# define flag_st_rel(p, v)      tsan_st_rel((int TSAN_QUALIFIER *)(p), (v))
+#else
+# define flag_ld_acq(p)         (*(p))
+# define flag_st_rel(p, v)      (*(p) = (v))
+#endif
+
+int ossl_x509_store_index_disabled(const X509_STORE *store)
+{
+    return flag_ld_acq(&store->index_disabled);
+}
+
+#define X509_STORE_INDEX_MIN_SLOTS  16
+
+typedef struct x509_store_index_slot_st {
+    uint32_t hash;
+    X509_OBJECT *obj;           /* NULL if the slot is free */
+} X509_STORE_INDEX_SLOT;
+
+struct x509_store_index_st {
+    X509_STORE_INDEX_SLOT *slots;
+    size_t mask;                /* Number of slots - 1, a power of two */
+    size_t num_objs;
+};
+
+static const X509_NAME *x509_object_name(const X509_OBJECT *obj)
+{
+    switch (obj->type) {
+    case X509_LU_X509:
+        return X509_get_subject_name(obj->data.x509);
+    case X509_LU_CRL:
+        return X509_CRL_get_issuer(obj->data.crl);
+    default:
+        return NULL;
+    }
+}
+
+/*
+ * The canonical hash of |name|, which X509_NAME caches alongside its canonical
+ * encoding, folded to 32 bits and combined with |type|.
+ */
+static uint32_t x509_store_index_hash(X509_LOOKUP_TYPE type,
+                                      const X509_NAME *name)
+{
+    uint64_t h;
+
+    if (name == NULL)
+        return (uint32_t)type;
+
+    /* Ensure canonical encoding is present and up to date */
+    if (name->modified && i2d_X509_NAME((X509_NAME *)name, NULL) < 0)
+        return (uint32_t)type;
+
+    h = name->canon_hash;
+    return (uint32_t)(h ^ (h >> 32)) ^ ((uint32_t)type * 0x9e3779b9U);
+}
+
+static X509_STORE_INDEX *x509_store_index_new(size_t num_slots)
+{
+    X509_STORE_INDEX *idx = OPENSSL_zalloc(sizeof(*idx));
+
+    if (idx == NULL)
+        return NULL;
+
+    idx->slots = OPENSSL_zalloc(num_slots * sizeof(*idx->slots));
+    if (idx->slots == NULL) {
+        OPENSSL_free(idx);
+        return NULL;
+    }
+    idx->mask = num_slots - 1;
+    return idx;
+}
+
+static void x509_store_index_free(X509_STORE_INDEX *idx)
+{
+    if (idx == NULL)
+        return;
+    OPENSSL_free(idx->slots);
+    OPENSSL_free(idx);
+}
+
+/* Adds |obj| to |idx|, which must have a free slot. */
+static void x509_store_index_insert(X509_STORE_INDEX *idx, X509_OBJECT *obj)
+{
+    uint32_t hash = x509_store_index_hash(obj->type, x509_object_name(obj));
+    size_t pos = hash & idx->mask;
+
+    while (idx->slots[pos].obj != NULL)
+        pos = (pos + 1) & idx->mask;
+
+    idx->slots[pos].hash = hash;
+    idx->slots[pos].obj = obj;
+    idx->num_objs++;
+}
+
+/*
+ * Returns the next object of the given type and name in |idx| starting from
+ * slot |*pos|, and advances |*pos| past it, or returns NULL if there are no
+ * more.
+ */
+static X509_OBJECT *x509_store_index_next(const X509_STORE_INDEX *idx,
+                                          uint32_t hash, X509_LOOKUP_TYPE type,
+                                          const X509_NAME *name, size_t *pos)
+{
+    X509_OBJECT *obj;
+    const X509_STORE_INDEX_SLOT *slot;
+
+    while ((obj = idx->slots[*pos].obj) != NULL) {
+        slot = &idx->slots[*pos];
+        *pos = (*pos + 1) & idx->mask;
+        if (slot->hash == hash && obj->type == type
+            && ossl_x509_name_equal(x509_object_name(obj), name))
+            return obj;
+    }
+    return NULL;
+}
+
+/*
+ * Adds |obj|, which has just been pushed onto |store->objs|, to the index.
+ * Must be called with the store write locked.
+ */
+static int x509_store_index_add(X509_STORE *store, X509_OBJECT *obj)
+{
+    X509_STORE_INDEX *idx = store->index, *nidx;
+    size_t num_slots;
+    int i, num = sk_X509_OBJECT_num(store->objs);
+
+    if (ossl_x509_store_index_disabled(store))
+        return 1;
+
+    if (2 * (idx->num_objs + 1) <= idx->mask + 1) {
+        x509_store_index_insert(idx, obj);
+        return 1;
+    }
+
+    for (num_slots = 2 * (idx->mask + 1); num_slots < 2 * (size_t)num;
+         num_slots *= 2)
+        continue;
+
+    if ((nidx = x509_store_index_new(num_slots)) == NULL)
+        return 0;
+
+    for (i = 0; i < num; i++)
+        x509_store_index_insert(nidx, sk_X509_OBJECT_value(store->objs, i));
+
+    store->index = nidx;
+    x509_store_index_free(idx);
+    return 1;
+}
+
+/* Returns 1 if |store| already holds a match for |obj|, locked by caller. */
+static int x509_store_contains(X509_STORE *store, X509_OBJECT *obj)
+{
+    const X509_NAME *name;
+    X509_OBJECT *pobj;
+    uint32_t hash;
+    size_t pos;
+
+    if (ossl_x509_store_index_disabled(store))
+        return X509_OBJECT_retrieve_match(store->objs, obj) != NULL;
+
+    name = x509_object_name(obj);
+    hash = x509_store_index_hash(obj->type, name);
+    pos = hash & store->index->mask;
+    while ((pobj = x509_store_index_next(store->index, hash, obj->type, name,
+                                         &pos)) != NULL) {
+        if (obj->type == X509_LU_X509
+                ? X509_cmp(pobj->data.x509, obj->data.x509) == 0
+                : X509_CRL_match(pobj->data.crl, obj->data.crl) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+/*
+ * Iteration over the objects of a given type and name in a store, with the
+ * store locked, using the index if available or else |objs|.
+ */
+typedef struct x509_store_iter_st {
+    X509_STORE *store;
+    X509_STORE_INDEX *index;
+    X509_LOOKUP_TYPE type;
+    const X509_NAME *name;
+    uint32_t hash;
+    size_t pos;
+    int idx, cnt;               /* Used when there is no index */
+} X509_STORE_ITER;
+
+static int x509_object_idx_cnt(STACK_OF(X509_OBJECT) *h, X509_LOOKUP_TYPE type,
+                               const X509_NAME *name, int *pnmatch);
+static void x509_object_free_internal(X509_OBJECT *a);
+
+/*
+ * Returns 0 on failure. Otherwise, x509_store_iter_end() must be called when
+ * done.
+ */
+static int x509_store_iter_begin(X509_STORE_ITER *it, X509_STORE *store,
+                                 X509_LOOKUP_TYPE type, const X509_NAME *name)
+{
+    it->store = store;
+    it->type = type;
+    it->name = name;
+
+    if (!x509_store_read_lock(store))
+        return 0;
+    it->index = ossl_x509_store_index_disabled(store) ? NULL : store->index;
+    if (it->index != NULL) {
+        it->hash = x509_store_index_hash(type, name);
+        it->pos = it->hash & it->index->mask;
+        return 1;
+    }
+
+    /* Should already be sorted...but just in case */
+    if (!sk_X509_OBJECT_is_sorted(store->objs)) {
+        X509_STORE_unlock(store);
+        /* Take a write lock instead of a read lock */
+        if (!X509_STORE_lock(store))
+            return 0;
+        /*
+         * Another thread might have sorted it in the meantime. But if so,
+         * sk_X509_OBJECT_sort() exits early.
+         */
+        sk_X509_OBJECT_sort(store->objs);
+    }
+    it->idx = x509_object_idx_cnt(store->objs, type, name, &it->cnt);
+    if (it->idx < 0)
+        it->cnt = 0;
+    return 1;
+}
+
+static X509_OBJECT *x509_store_iter_next(X509_STORE_ITER *it)
+{
+    if (it->index != NULL)
+        return x509_store_index_next(it->index, it->hash, it->type, it->name,
+                                     &it->pos);
+
+    if (it->cnt <= 0)
+        return NULL;
+    it->cnt--;
+    return sk_X509_OBJECT_value(it->store->objs, it->idx++);
+}
+
+static void x509_store_iter_end(X509_STORE_ITER *it)
+{
+    X509_STORE_unlock(it->store);
+}
+
+/*
+ * Returns the first object of the given type and name in |store|, without
+ * taking a reference, or NULL if there is none.
+ */
+X509_OBJECT *ossl_x509_store_get0_by_subject(X509_STORE *store,
+                                             X509_LOOKUP_TYPE type,
+                                             const X509_NAME *name)
+{
+    X509_STORE_ITER it;
+    X509_OBJECT *obj;
+
+    if (!x509_store_iter_begin(&it, store, type, name))
+        return NULL;
+    obj = x509_store_iter_next(&it);
+    x509_store_iter_end(&it);
+    return obj;
+}
+
 X509_STORE *X509_STORE_new(void)
 {
     X509_STORE *ret = OPENSSL_zalloc(sizeof(*ret));
@@ -189,6 +484,11 @@ X509_STORE *X509_STORE_new(void)
         ERR_raise(ERR_LIB_X509, ERR_R_CRYPTO_LIB);
         goto err;
     }
+    if ((ret->index = x509_store_index_new(X509_STORE_INDEX_MIN_SLOTS))
+            == NULL) {
+        ERR_raise(ERR_LIB_X509, ERR_R_CRYPTO_LIB);
+        goto err;
+    }
     ret->cache = 1;
     if ((ret->get_cert_methods = sk_X509_LOOKUP_new_null()) == NULL) {
         ERR_raise(ERR_LIB_X509, ERR_R_CRYPTO_LIB);
@@ -216,6 +516,7 @@ X509_STORE *X509_STORE_new(void)
 
 err:
     X509_VERIFY_PARAM_free(ret->param);
+    x509_store_index_free(ret->index);
     sk_X509_OBJECT_free(ret->objs);
     sk_X509_LOOKUP_free(ret->get_cert_methods);
     CRYPTO_THREAD_lock_free(ret->lock);
@@ -245,6 +546,8 @@ void X509_STORE_free(X509_STORE *xs)
     }
     sk_X509_LOOKUP_free(sk);
     sk_X509_OBJECT_pop_free(xs->objs, X509_OBJECT_free);
+    x509_store_index_free(xs->index);
+    ossl_x509_verify_cache_free(xs->verify_cache);
 
     CRYPTO_free_ex_data(CRYPTO_EX_INDEX_X509_STORE, xs, &xs->ex_data);
     X509_VERIFY_PARAM_free(xs->param);
@@ -323,8 +626,9 @@ static int ossl_x509_store_ctx_get_by_subject(const X509_STORE_CTX *ctx,
                                               X509_OBJECT *ret)
 {
     X509_STORE *store = ctx->store;
+    X509_STORE_ITER it;
     X509_LOOKUP *lu;
-    X509_OBJECT stmp, *tmp;
+    X509_OBJECT stmp, cached, *tmp;
     int i, j;
 
     if (store == NULL)
@@ -332,46 +636,49 @@ static int ossl_x509_store_ctx_get_by_subject(const X509_STORE_CTX *ctx,
 
     stmp.type = X509_LU_NONE;
     stmp.data.ptr = NULL;
+    cached.type = X509_LU_NONE;
+    cached.data.ptr = NULL;
 
-    if (!x509_store_read_lock(store))
+    /* The reference is taken before the lock is released */
+    if (!x509_store_iter_begin(&it, store, type, name))
         return 0;
-    /* Should already be sorted...but just in case */
-    if (!sk_X509_OBJECT_is_sorted(store->objs)) {
-        X509_STORE_unlock(store);
-        /* Take a write lock instead of a read lock */
-        if (!X509_STORE_lock(store))
-            return 0;
-        /*
-         * Another thread might have sorted it in the meantime. But if so,
-         * sk_X509_OBJECT_sort() exits early.
-         */
-        sk_X509_OBJECT_sort(store->objs);
+    if ((tmp = x509_store_iter_next(&it)) != NULL) {
+        if (!X509_OBJECT_up_ref_count(tmp)) {
+            x509_store_iter_end(&it);
+            return -1;
+        }
+        cached.type = tmp->type;
+        cached.data.ptr = tmp->data.ptr;
     }
-    tmp = X509_OBJECT_retrieve_by_subject(store->objs, type, name);
-    X509_STORE_unlock(store);
+    x509_store_iter_end(&it);
 
     if (tmp == NULL || type == X509_LU_CRL) {
         for (i = 0; i < sk_X509_LOOKUP_num(store->get_cert_methods); i++) {
             lu = sk_X509_LOOKUP_value(store->get_cert_methods, i);
             if (lu->skip)
                 continue;
-            if (lu->method == NULL)
+            if (lu->method == NULL) {
+                x509_object_free_internal(&cached);
                 return -1;
+            }
             j = X509_LOOKUP_by_subject_ex(lu, type, name, &stmp,
                                           ctx->libctx, ctx->propq);
             if (j != 0) { /* non-zero value is considered success here */
-                tmp = &stmp;
+                if (!X509_OBJECT_up_ref_count(&stmp)) {
+                    x509_object_free_internal(&cached);
+                    return -1;
+                }
+                x509_object_free_internal(&cached);
+                cached = stmp;
                 break;
             }
         }
-        if (tmp == NULL)
+        if (cached.type == X509_LU_NONE)
             return 0;
     }
-    if (!X509_OBJECT_up_ref_count(tmp))
-        return -1;
 
-    ret->type = tmp->type;
-    ret->data.ptr = tmp->data.ptr;
+    ret->type = cached.type;
+    ret->data.ptr = cached.data.ptr;
     return 1;
 }
 
@@ -413,11 +720,17 @@ static int x509_store_add(X509_STORE *store, void *x, int crl)
         return 0;
     }
 
-    if (X509_OBJECT_retrieve_match(store->objs, obj)) {
+    if (x509_store_contains(store, obj)) {
         ret = 1;
     } else {
         added = sk_X509_OBJECT_push(store->objs, obj);
+        if (added != 0 && !x509_store_index_add(store, obj)) {
+            (void)sk_X509_OBJECT_pop(store->objs);
+            added = 0;
+        }
         ret = added != 0;
+        if (added != 0)
+            ossl_x509_verify_cache_flush(store->verify_cache);
     }
     X509_STORE_unlock(store);
 
@@ -580,6 +893,14 @@ X509_OBJECT *X509_OBJECT_retrieve_by_subject(STACK_OF(X509_OBJECT) *h,
 
 STACK_OF(X509_OBJECT) *X509_STORE_get0_objects(const X509_STORE *xs)
 {
+    X509_STORE *store = (X509_STORE *)xs;
+
+    /*
+     * The caller may now modify |objs|, so stop using the index.  The store
+     * may be locked by the caller, so don't take the lock here.
+     */
+    if (!ossl_x509_store_index_disabled(store))
+        flag_st_rel(&store->index_disabled, 1);
     return xs->objs;
 }
 
@@ -599,7 +920,7 @@ STACK_OF(X509) *X509_STORE_get1_all_certs(X509_STORE *store)
         goto out_free;
 
     sk_X509_OBJECT_sort(store->objs);
-    objs = X509_STORE_get0_objects(store);
+    objs = store->objs;
     for (i = 0; i < sk_X509_OBJECT_num(objs); i++) {
         X509 *cert = X509_OBJECT_get0_X509(sk_X509_OBJECT_value(objs, i));
 
@@ -621,28 +942,27 @@ STACK_OF(X509) *X509_STORE_get1_all_certs(X509_STORE *store)
 STACK_OF(X509) *X509_STORE_CTX_get1_certs(X509_STORE_CTX *ctx,
                                           const X509_NAME *nm)
 {
-    int i, idx, cnt;
+    int i;
     STACK_OF(X509) *sk = NULL;
-    X509 *x;
     X509_OBJECT *obj;
     X509_STORE *store = ctx->store;
+    X509_STORE_ITER it;
 
     if (store == NULL)
         return sk_X509_new_null();
 
-    if (!X509_STORE_lock(store))
+    if (!x509_store_iter_begin(&it, store, X509_LU_X509, nm))
         return NULL;
 
-    sk_X509_OBJECT_sort(store->objs);
-    idx = x509_object_idx_cnt(store->objs, X509_LU_X509, nm, &cnt);
-    if (idx < 0) {
+    obj = x509_store_iter_next(&it);
+    if (obj == NULL) {
         /*
          * Nothing found in cache: do lookup to possibly add new objects to
          * cache
          */
         X509_OBJECT *xobj = X509_OBJECT_new();
 
-        X509_STORE_unlock(store);
+        x509_store_iter_end(&it);
         if (xobj == NULL)
             return NULL;
         i = ossl_x509_store_ctx_get_by_subject(ctx, X509_LU_X509, nm, xobj);
@@ -651,30 +971,23 @@ STACK_OF(X509) *X509_STORE_CTX_get1_certs(X509_STORE_CTX *ctx,
             return i < 0 ? NULL : sk_X509_new_null();
         }
         X509_OBJECT_free(xobj);
-        if (!X509_STORE_lock(store))
+        if (!x509_store_iter_begin(&it, store, X509_LU_X509, nm))
             return NULL;
-        sk_X509_OBJECT_sort(store->objs);
-        idx = x509_object_idx_cnt(store->objs, X509_LU_X509, nm, &cnt);
-        if (idx < 0) {
-            sk = sk_X509_new_null();
-            goto end;
-        }
+        obj = x509_store_iter_next(&it);
     }
 
     sk = sk_X509_new_null();
     if (sk == NULL)
         goto end;
-    for (i = 0; i < cnt; i++, idx++) {
-        obj = sk_X509_OBJECT_value(store->objs, idx);
-        x = obj->data.x509;
-        if (!X509_add_cert(sk, x, X509_ADD_FLAG_UP_REF)) {
-            X509_STORE_unlock(store);
+    for (; obj != NULL; obj = x509_store_iter_next(&it)) {
+        if (!X509_add_cert(sk, obj->data.x509, X509_ADD_FLAG_UP_REF)) {
+            x509_store_iter_end(&it);
             OSSL_STACK_OF_X509_free(sk);
             return NULL;
         }
     }
  end:
-    X509_STORE_unlock(store);
+    x509_store_iter_end(&it);
     return sk;
 }
 
@@ -682,11 +995,12 @@ STACK_OF(X509) *X509_STORE_CTX_get1_certs(X509_STORE_CTX *ctx,
 STACK_OF(X509_CRL) *X509_STORE_CTX_get1_crls(const X509_STORE_CTX *ctx,
                                              const X509_NAME *nm)
 {
-    int i = 1, idx, cnt;
+    int i = 1;
     STACK_OF(X509_CRL) *sk = sk_X509_CRL_new_null();
     X509_CRL *x;
     X509_OBJECT *obj, *xobj = X509_OBJECT_new();
     X509_STORE *store = ctx->store;
+    X509_STORE_ITER it;
 
     /* Always do lookup to possibly add new CRLs to cache */
     if (sk == NULL
@@ -700,33 +1014,26 @@ STACK_OF(X509_CRL) *X509_STORE_CTX_get1_crls(const X509_STORE_CTX *ctx,
     X509_OBJECT_free(xobj);
     if (i == 0)
         return sk;
-    if (!X509_STORE_lock(store)) {
+    if (!x509_store_iter_begin(&it, store, X509_LU_CRL, nm)) {
         sk_X509_CRL_free(sk);
         return NULL;
     }
-    sk_X509_OBJECT_sort(store->objs);
-    idx = x509_object_idx_cnt(store->objs, X509_LU_CRL, nm, &cnt);
-    if (idx < 0) {
-        X509_STORE_unlock(store);
-        return sk;
-    }
 
-    for (i = 0; i < cnt; i++, idx++) {
-        obj = sk_X509_OBJECT_value(store->objs, idx);
+    while ((obj = x509_store_iter_next(&it)) != NULL) {
         x = obj->data.crl;
         if (!X509_CRL_up_ref(x)) {
-            X509_STORE_unlock(store);
+            x509_store_iter_end(&it);
             sk_X509_CRL_pop_free(sk, X509_CRL_free);
             return NULL;
         }
         if (!sk_X509_CRL_push(sk, x)) {
-            X509_STORE_unlock(store);
+            x509_store_iter_end(&it);
             X509_CRL_free(x);
             sk_X509_CRL_pop_free(sk, X509_CRL_free);
             return NULL;
         }
     }
-    X509_STORE_unlock(store);
+    x509_store_iter_end(&it);
     return sk;
 }
 
@@ -773,7 +1080,8 @@ int X509_STORE_CTX_get1_issuer(X509 **issuer, X509_STORE_CTX *ctx, X509 *x)
     const X509_NAME *xn;
     X509_OBJECT *obj = X509_OBJECT_new(), *pobj = NULL;
     X509_STORE *store = ctx->store;
-    int i, ok, idx, ret, nmatch = 0;
+    X509_STORE_ITER it;
+    int ok, ret;
 
     if (obj == NULL)
         return -1;
@@ -804,43 +1112,35 @@ int X509_STORE_CTX_get1_issuer(X509 **issuer, X509_STORE_CTX *ctx, X509 *x)
     if (store == NULL)
         return 0;
 
-    /* Find index of first currently valid cert accepted by 'check_issued' */
+    /* Find first currently valid cert accepted by 'check_issued' */
     ret = 0;
-    if (!X509_STORE_lock(store))
+    if (!x509_store_iter_begin(&it, store, X509_LU_X509, xn))
         return 0;
 
-    sk_X509_OBJECT_sort(store->objs);
-    idx = x509_object_idx_cnt(store->objs, X509_LU_X509, xn, &nmatch);
-    if (idx != -1) { /* should be true as we've had at least one match */
-        /* Look through all matching certs for suitable issuer */
-        for (i = idx; i < idx + nmatch; i++) {
-            pobj = sk_X509_OBJECT_value(store->objs, i);
-            /* See if we've run past the matches */
-            if (pobj->type != X509_LU_X509)
+    /* Look through all matching certs for suitable issuer */
+    while ((pobj = x509_store_iter_next(&it)) != NULL) {
+        if (ctx->check_issued(ctx, x, pobj->data.x509)) {
+            ret = 1;
+            /* If times check fine, exit with match, else keep looking. */
+            if (ossl_x509_check_cert_time(ctx, pobj->data.x509, -1)) {
+                *issuer = pobj->data.x509;
                 break;
-            if (ctx->check_issued(ctx, x, pobj->data.x509)) {
-                ret = 1;
-                /* If times check fine, exit with match, else keep looking. */
-                if (ossl_x509_check_cert_time(ctx, pobj->data.x509, -1)) {
-                    *issuer = pobj->data.x509;
-                    break;
-                }
-                /*
-                 * Leave the so far most recently expired match in *issuer
-                 * so we return nearest match if no certificate time is OK.
-                 */
-                if (*issuer == NULL
-                    || ASN1_TIME_compare(X509_get0_notAfter(pobj->data.x509),
-                                         X509_get0_notAfter(*issuer)) > 0)
-                    *issuer = pobj->data.x509;
             }
+            /*
+             * Leave the so far most recently expired match in *issuer
+             * so we return nearest match if no certificate time is OK.
+             */
+            if (*issuer == NULL
+                || ASN1_TIME_compare(X509_get0_notAfter(pobj->data.x509),
+                                     X509_get0_notAfter(*issuer)) > 0)
+                *issuer = pobj->data.x509;
         }
     }
     if (*issuer != NULL && !X509_up_ref(*issuer)) {
         *issuer = NULL;
         ret = -1;
     }
-    X509_STORE_unlock(store);
+    x509_store_iter_end(&it);
     return ret;
 }
 
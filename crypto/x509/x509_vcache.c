@@ -0,0 +1,349 @@
+/*
+ * Copyright 2023 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+#include <time.h>
+#include <openssl/buffer.h>
+#include <openssl/evp.h>
+#include <openssl/lhash.h>
+#include <openssl/x509.h>
+#include "internal/packet.h"
+#include "internal/tsan_assist.h"
+#include "crypto/x509.h"
+#include "x509_local.h"
+
+/*
+ * Cache of successful chain verifications attached to an X509_STORE.
+ *
+ * An entry is keyed by the exact verification inputs: the SHA256 hashes of the
+ * encodings of the target and the untrusted certificates, the verification
+ * parameters and the library context. It records the verified chain, and is usable until the
+ * earliest of the configured time to live, the expiry of any certificate in
+ * the chain and the next update of any CRL consulted. Adding objects to the
+ * store bumps the cache generation, which retires all existing entries.
+ *
+ * Entries are kept in insertion order in a ring of |max_entries| slots, and
+ * the oldest entry is evicted when a new one is added to a full cache.
+ */
+
+typedef struct x509_vcache_entry_st {
+    unsigned long hash;
+    unsigned char *key;
+    size_t keylen;
+    uint64_t generation;
+    time_t expires;             /* 0 if not limited by time */
+    STACK_OF(X509) *chain;
+    int num_untrusted;
+} X509_VCACHE_ENTRY;
+
+DEFINE_LHASH_OF_EX(X509_VCACHE_ENTRY);
+
+struct x509_verify_cache_st {
+    CRYPTO_RWLOCK *lock;
+    LHASH_OF(X509_VCACHE_ENTRY) *entries;
+    X509_VCACHE_ENTRY **ring;
+    size_t max_entries, next;
+    time_t ttl;
+    uint64_t generation;
+    TSAN_QUALIFIER size_t hits;
+};
+
+static unsigned long vcache_entry_hash(const X509_VCACHE_ENTRY *e)
+{
+    return e->hash;
+}
+
+static int vcache_entry_cmp(const X509_VCACHE_ENTRY *a,
+                            const X509_VCACHE_ENTRY *b)
+{
+    if (a->keylen != b->keylen)
+        return a->keylen < b->keylen ? -1 : 1;
+    return memcmp(a->key, b->key, a->keylen);
+}
+
+static unsigned long vcache_key_hash(const unsigned char *key, size_t keylen)
+{
+    uint32_t h = 0x811c9dc5;
+    size_t i;
+
+    for (i = 0; i < keylen; i++)
+        h = (h ^ key[i]) * 0x01000193;
+    return h;
+}
+
+static void vcache_entry_free(X509_VCACHE_ENTRY *e)
+{
+    if (e == NULL)
+        return;
+    OSSL_STACK_OF_X509_free(e->chain);
+    OPENSSL_free(e->key);
+    OPENSSL_free(e);
+}
+
+static X509_VERIFY_CACHE *vcache_new(size_t max_entries, time_t ttl)
+{
+    X509_VERIFY_CACHE *vc = OPENSSL_zalloc(sizeof(*vc));
+
+    if (vc == NULL)
+        return NULL;
+    if ((vc->lock = CRYPTO_THREAD_lock_new()) == NULL
+            || (vc->entries = lh_X509_VCACHE_ENTRY_new(vcache_entry_hash,
+                                                       vcache_entry_cmp))
+               == NULL
+            || (vc->ring = OPENSSL_zalloc(max_entries * sizeof(*vc->ring)))
+               == NULL) {
+        ossl_x509_verify_cache_free(vc);
+        return NULL;
+    }
+    vc->max_entries = max_entries;
+    vc->ttl = ttl;
+    return vc;
+}
+
+void ossl_x509_verify_cache_free(X509_VERIFY_CACHE *vc)
+{
+    size_t i;
+
+    if (vc == NULL)
+        return;
+    if (vc->ring != NULL)
+        for (i = 0; i < vc->max_entries; i++)
+            vcache_entry_free(vc->ring[i]);
+    OPENSSL_free(vc->ring);
+    lh_X509_VCACHE_ENTRY_free(vc->entries);
+    CRYPTO_THREAD_lock_free(vc->lock);
+    OPENSSL_free(vc);
+}
+
+int X509_STORE_set_verify_cache(X509_STORE *xs, size_t max_entries, time_t ttl)
+{
+    X509_VERIFY_CACHE *vc = NULL;
+
+    if (xs == NULL || ttl < 0) {
+        ERR_raise(ERR_LIB_X509, ERR_R_PASSED_INVALID_ARGUMENT);
+        return 0;
+    }
+    if (max_entries > 0 && (vc = vcache_new(max_entries, ttl)) == NULL) {
+        ERR_raise(ERR_LIB_X509, ERR_R_CRYPTO_LIB);
+        return 0;
+    }
+    ossl_x509_verify_cache_free(xs->verify_cache);
+    xs->verify_cache = vc;
+    return 1;
+}
+
+/* Retires all entries, called with the owning store locked */
+void ossl_x509_verify_cache_flush(X509_VERIFY_CACHE *vc)
+{
+    if (vc == NULL || !CRYPTO_THREAD_write_lock(vc->lock))
+        return;
+    vc->generation++;
+    CRYPTO_THREAD_unlock(vc->lock);
+}
+
+size_t ossl_x509_verify_cache_hits(const X509_VERIFY_CACHE *vc)
+{
+    return vc == NULL ? 0 : tsan_load(&vc->hits);
+}
+
+static int vcache_put_cert(WPACKET *pkt, X509 *x, const EVP_MD *md)
+{
+    unsigned char hash[EVP_MAX_MD_SIZE];
+    unsigned int len;
+
+    return X509_digest(x, md, hash, &len)
+        && WPACKET_memcpy(pkt, hash, len);
+}
+
+static int vcache_put_param(WPACKET *pkt, const X509_VERIFY_PARAM *vpm)
+{
+    const char *host;
+    int i;
+
+    if (!WPACKET_put_bytes_u64(pkt, vpm->flags)
+            || !WPACKET_put_bytes_u32(pkt, (uint32_t)vpm->purpose)
+            || !WPACKET_put_bytes_u32(pkt, (uint32_t)vpm->trust)
+            || !WPACKET_put_bytes_u32(pkt, (uint32_t)vpm->depth)
+            || !WPACKET_put_bytes_u32(pkt, (uint32_t)vpm->auth_level)
+            || !WPACKET_put_bytes_u32(pkt, vpm->hostflags))
+        return 0;
+    if ((vpm->flags & X509_V_FLAG_USE_CHECK_TIME) != 0
+            && !WPACKET_put_bytes_u64(pkt, (uint64_t)vpm->check_time))
+        return 0;
+
+    if (!WPACKET_start_sub_packet_u16(pkt))
+        return 0;
+    for (i = 0; i < sk_OPENSSL_STRING_num(vpm->hosts); i++) {
+        host = sk_OPENSSL_STRING_value(vpm->hosts, i);
+        if (!WPACKET_sub_memcpy_u16(pkt, host, strlen(host)))
+            return 0;
+    }
+    return WPACKET_close(pkt)
+        && WPACKET_sub_memcpy_u16(pkt, vpm->email, vpm->emaillen)
+        && WPACKET_sub_memcpy_u8(pkt, vpm->ip, vpm->iplen);
+}
+
+/*
+ * Returns the cache key for the verification to be performed by |ctx|, or
+ * NULL if it cannot be cached.
+ */
+BUF_MEM *ossl_x509_verify_cache_key(X509_STORE_CTX *ctx)
+{
+    BUF_MEM *key = BUF_MEM_new();
+    EVP_MD *md = EVP_MD_fetch(ctx->libctx, "SHA256", ctx->propq);
+    WPACKET pkt;
+    size_t written;
+    int i, ok;
+
+    if (key == NULL || md == NULL || !WPACKET_init(&pkt, key)) {
+        EVP_MD_free(md);
+        BUF_MEM_free(key);
+        return NULL;
+    }
+
+    ok = vcache_put_cert(&pkt, ctx->cert, md)
+        && WPACKET_start_sub_packet_u16(&pkt);
+    for (i = 0; ok && i < sk_X509_num(ctx->untrusted); i++)
+        ok = vcache_put_cert(&pkt, sk_X509_value(ctx->untrusted, i), md);
+    ok = ok
+        && WPACKET_close(&pkt)
+        && vcache_put_param(&pkt, ctx->param)
+        && WPACKET_put_bytes_u64(&pkt, (uint64_t)(uintptr_t)ctx->libctx)
+        && WPACKET_sub_memcpy_u8(&pkt, ctx->propq,
+                                 ctx->propq == NULL ? 0 : strlen(ctx->propq))
+        && WPACKET_get_total_written(&pkt, &written)
+        && WPACKET_finish(&pkt);
+    EVP_MD_free(md);
+    if (!ok) {
+        WPACKET_cleanup(&pkt);
+        BUF_MEM_free(key);
+        return NULL;
+    }
+    key->length = written;
+    return key;
+}
+
+/*
+ * Looks up the verification to be performed by |ctx|. On a hit, returns 1 with
+ * a copy of the cached chain in |*chain|. On a miss, returns 0 and prepares
+ * |ctx| for the verification result to be added by
+ * ossl_x509_verify_cache_add().
+ */
+int ossl_x509_verify_cache_get1(X509_VERIFY_CACHE *vc, X509_STORE_CTX *ctx,
+                                const BUF_MEM *key, STACK_OF(X509) **chain,
+                                int *num_untrusted)
+{
+    X509_VCACHE_ENTRY tmpl, *e;
+    time_t now = time(NULL);
+    int ret = 0;
+
+    tmpl.key = (unsigned char *)key->data;
+    tmpl.keylen = key->length;
+    tmpl.hash = vcache_key_hash(tmpl.key, tmpl.keylen);
+
+    if (!CRYPTO_THREAD_read_lock(vc->lock))
+        return 0;
+    e = lh_X509_VCACHE_ENTRY_retrieve(vc->entries, &tmpl);
+    if (e != NULL && e->generation == vc->generation
+            && (e->expires == 0 || now < e->expires)
+            && (*chain = X509_chain_up_ref(e->chain)) != NULL) {
+        *num_untrusted = e->num_untrusted;
+        ret = 1;
+    }
+    ctx->vcache.generation = vc->generation;
+    CRYPTO_THREAD_unlock(vc->lock);
+
+    if (ret)
+        tsan_counter(&vc->hits);
+    else
+        ctx->vcache.expires = vc->ttl > 0 ? now + vc->ttl : 0;
+    return ret;
+}
+
+/*
+ * Shortens the lifetime of the entry to be added for |ctx| to end no later
+ * than |t|.
+ */
+void ossl_x509_verify_cache_limit(X509_STORE_CTX *ctx, const ASN1_TIME *t)
+{
+    time_t until;
+    int days, secs;
+
+    if (!ASN1_TIME_diff(&days, &secs, NULL, t) || days < 0 || secs < 0)
+        until = 1;
+    else
+        until = time(NULL) + (time_t)days * 24 * 60 * 60 + secs;
+    if (ctx->vcache.expires == 0 || until < ctx->vcache.expires)
+        ctx->vcache.expires = until;
+}
+
+/* Adds the successfully verified chain of |ctx| to the cache */
+void ossl_x509_verify_cache_add(X509_VERIFY_CACHE *vc, X509_STORE_CTX *ctx,
+                                const BUF_MEM *key)
+{
+    X509_VCACHE_ENTRY *e, *old;
+    X509 *x;
+    int i;
+
+    if ((ctx->param->flags
+         & (X509_V_FLAG_USE_CHECK_TIME | X509_V_FLAG_NO_CHECK_TIME)) == 0)
+        for (i = 0; i < sk_X509_num(ctx->chain); i++) {
+            x = sk_X509_value(ctx->chain, i);
+            ossl_x509_verify_cache_limit(ctx, X509_get0_notAfter(x));
+        }
+    if (ctx->vcache.expires != 0 && ctx->vcache.expires <= time(NULL))
+        return;
+
+    if ((e = OPENSSL_zalloc(sizeof(*e))) == NULL)
+        return;
+    if ((e->key = OPENSSL_memdup(key->data, key->length)) == NULL
+            || (e->chain = X509_chain_up_ref(ctx->chain)) == NULL) {
+        vcache_entry_free(e);
+        return;
+    }
+    e->keylen = key->length;
+    e->hash = vcache_key_hash(e->key, e->keylen);
+    e->generation = ctx->vcache.generation;
+    e->expires = ctx->vcache.expires;
+    e->num_untrusted = ctx->num_untrusted;
+
+    if (!CRYPTO_THREAD_write_lock(vc->lock)) {
+        vcache_entry_free(e);
+        return;
+    }
+    /* The store changed while we were verifying */
+    if (e->generation != vc->generation)
+        goto end;
+
+    /* Another thread may have raced us to it, if so refresh its entry */
+    if ((old = lh_X509_VCACHE_ENTRY_retrieve(vc->entries, e)) != NULL) {
+        OSSL_STACK_OF_X509_free(old->chain);
+        old->chain = e->chain;
+        old->generation = e->generation;
+        old->expires = e->expires;
+        old->num_untrusted = e->num_untrusted;
+        e->chain = NULL;
+        goto end;
+    }
+
+    if ((old = vc->ring[vc->next]) != NULL) {
+        (void)lh_X509_VCACHE_ENTRY_delete(vc->entries, old);
+        vcache_entry_free(old);
+        vc->ring[vc->next] = NULL;
+    }
+    (void)lh_X509_VCACHE_ENTRY_insert(vc->entries, e);
+    if (lh_X509_VCACHE_ENTRY_error(vc->entries) > 0)
+        goto end;
+    vc->ring[vc->next] = e;
+    vc->next = (vc->next + 1) % vc->max_entries;
+    e = NULL;
+
+ end:
+    CRYPTO_THREAD_unlock(vc->lock);
+    vcache_entry_free(e);
+}
@@ -76,6 +76,8 @@ static void crl_akid_check(X509_STORE_CTX *ctx, X509_CRL *crl, X509 **pissuer,
                            int *pcrl_score);
 static int crl_crldp_check(X509 *x, X509_CRL *crl, int crl_score,
                            unsigned int *preasons);
+static int check_crl(X509_STORE_CTX *ctx, X509_CRL *crl);
+static int cert_crl(X509_STORE_CTX *ctx, X509_CRL *crl, X509 *x);
 static int check_crl_path(X509_STORE_CTX *ctx, X509 *x);
 static int check_crl_chain(X509_STORE_CTX *ctx,
                            STACK_OF(X509) *cert_path,
@@ -321,6 +323,117 @@ static int x509_verify_rpk(X509_STORE_CTX *ctx)
     return ret;
 }
 
+/*
+ * Returns 1 if the outcome of verifying with |ctx| depends only on what the
+ * verified chain cache keys on, i.e. no callbacks other than verify_cb are
+ * customised and no checks that consult state beyond the chain are enabled.
+ */
+static int verify_cache_usable(X509_STORE_CTX *ctx)
+{
+    const unsigned long uncached_flags = X509_V_FLAG_POLICY_CHECK
+        | X509_V_FLAG_NOTIFY_POLICY | X509_V_FLAG_EXTENDED_CRL_SUPPORT;
+
+    return ctx->store != NULL && ctx->store->verify_cache != NULL
+        && !ossl_x509_store_index_disabled(ctx->store)
+        && ctx->parent == NULL
+        && sk_X509_CRL_num(ctx->crls) <= 0
+        && (ctx->param->flags & uncached_flags) == 0
+        && (ctx->verify == NULL || ctx->verify == internal_verify)
+        && ctx->get_issuer == X509_STORE_CTX_get1_issuer
+        && ctx->check_issued == check_issued
+        && ctx->check_revocation == check_revocation
+        && ctx->get_crl == NULL
+        && ctx->check_crl == check_crl
+        && ctx->cert_crl == cert_crl
+        && ctx->lookup_certs == X509_STORE_CTX_get1_certs
+        && ctx->lookup_crls == X509_STORE_CTX_get1_crls;
+}
+
+/*
+ * Stands in for the verify callback while verifying a chain that may be
+ * cached, noting whether any error was reported, even if overridden.
+ */
+static int verify_cache_cb(int ok, X509_STORE_CTX *ctx)
+{
+    if (!ok)
+        ctx->vcache.cb_failed = 1;
+    return ctx->vcache.verify_cb(ok, ctx);
+}
+
+/*
+ * Completes a verification from a cached |chain|, reporting success at each
+ * depth to the verify callback as internal_verify() would.
+ * Sadly, returns 0 also on internal error in ctx->verify_cb().
+ */
+static int verify_cached_chain(X509_STORE_CTX *ctx, STACK_OF(X509) *chain,
+                               int num_untrusted)
+{
+    int top = sk_X509_num(chain) - 1, n, ok;
+
+    OSSL_STACK_OF_X509_free(ctx->chain);
+    ctx->chain = chain;
+    ctx->num_untrusted = num_untrusted;
+
+    /* Sets the matched peer name, if any */
+    if ((ok = check_id(ctx)) <= 0)
+        return ok;
+
+    for (n = top; n >= 0; n--) {
+        /* As in internal_verify(), the top cert is reported as self-issued */
+        ctx->current_issuer = sk_X509_value(chain, n == top ? n : n + 1);
+        ctx->current_cert = sk_X509_value(chain, n);
+        ctx->error_depth = n;
+        if (!ctx->verify_cb(1, ctx))
+            return 0;
+    }
+    return 1;
+}
+
+/*
+ * Verifies the chain using the store's verified chain cache, adding successful
+ * verifications without errors reported to the verify callback.
+ * Returns -1 on internal error.
+ * Sadly, returns 0 also on internal error in ctx->verify_cb().
+ */
+static int verify_chain_cached(X509_STORE_CTX *ctx)
+{
+    X509_VERIFY_CACHE *vc = ctx->store->verify_cache;
+    STACK_OF(X509) *chain;
+    BUF_MEM *key;
+    int num_untrusted, ret;
+
+    if ((key = ossl_x509_verify_cache_key(ctx)) == NULL)
+        return verify_chain(ctx);
+
+    if (ossl_x509_verify_cache_get1(vc, ctx, key, &chain, &num_untrusted)) {
+        /*
+         * The cached target has the same encoding, but the chain must still
+         * start with the caller's own object as after a full verification
+         */
+        if (!X509_up_ref(ctx->cert)) {
+            OSSL_STACK_OF_X509_free(chain);
+            BUF_MEM_free(key);
+            ctx->error = X509_V_ERR_UNSPECIFIED;
+            return -1;
+        }
+        X509_free(sk_X509_value(chain, 0));
+        (void)sk_X509_set(chain, 0, ctx->cert);
+        ret = verify_cached_chain(ctx, chain, num_untrusted);
+    } else {
+        ctx->vcache.active = 1;
+        ctx->vcache.cb_failed = 0;
+        ctx->vcache.verify_cb = ctx->verify_cb;
+        ctx->verify_cb = verify_cache_cb;
+        ret = verify_chain(ctx);
+        ctx->verify_cb = ctx->vcache.verify_cb;
+        ctx->vcache.active = 0;
+        if (ret > 0 && ctx->error == X509_V_OK && !ctx->vcache.cb_failed)
+            ossl_x509_verify_cache_add(vc, ctx, key);
+    }
+    BUF_MEM_free(key);
+    return ret;
+}
+
 /*-
  * Returns -1 on internal error.
  * Sadly, returns 0 also on internal error in ctx->verify_cb().
@@ -355,7 +468,12 @@ static int x509_verify_x509(X509_STORE_CTX *ctx)
     CB_FAIL_IF(!check_cert_key_level(ctx, ctx->cert),
                ctx, ctx->cert, 0, X509_V_ERR_EE_KEY_TOO_SMALL);
 
-    ret = DANETLS_ENABLED(ctx->dane) ? dane_verify(ctx) : verify_chain(ctx);
+    if (DANETLS_ENABLED(ctx->dane))
+        ret = dane_verify(ctx);
+    else if (verify_cache_usable(ctx))
+        ret = verify_chain_cached(ctx);
+    else
+        ret = verify_chain(ctx);
 
     /*
      * Safety-net.  If we are returning an error, we must also set ctx->error,
@@ -443,7 +561,7 @@ static STACK_OF(X509) *lookup_certs_sk(X509_STORE_CTX *ctx, const X509_NAME *nm)
         return NULL;
     for (i = 0; i < sk_X509_num(ctx->other_ctx); i++) {
         x = sk_X509_value(ctx->other_ctx, i);
-        if (X509_NAME_cmp(nm, X509_get_subject_name(x)) == 0) {
+        if (ossl_x509_name_equal(nm, X509_get_subject_name(x))) {
             if (!X509_add_cert(sk, x, X509_ADD_FLAG_UP_REF)) {
                 OSSL_STACK_OF_X509_free(sk);
                 ctx->error = X509_V_ERR_OUT_OF_MEM;
@@ -1112,8 +1230,13 @@ static int check_crl_time(X509_STORE_CTX *ctx, X509_CRL *crl, int notify)
         }
     }
 
-    if (notify)
+    if (notify) {
         ctx->current_crl = NULL;
+        /* A cached verification must not outlive the CRLs it relied on */
+        if (ctx->vcache.active && ptime == NULL
+                && X509_CRL_get0_nextUpdate(crl) != NULL)
+            ossl_x509_verify_cache_limit(ctx, X509_CRL_get0_nextUpdate(crl));
+    }
 
     return 1;
 }
@@ -1287,7 +1410,8 @@ static int get_crl_score(X509_STORE_CTX *ctx, X509 **pissuer,
     else if (crl->base_crl_number != NULL)
         return 0;
     /* If issuer name doesn't match certificate need indirect CRL */
-    if (X509_NAME_cmp(X509_get_issuer_name(x), X509_CRL_get_issuer(crl)) != 0) {
+    if (!ossl_x509_name_equal(X509_get_issuer_name(x),
+                              X509_CRL_get_issuer(crl))) {
         if ((crl->idp_flags & IDP_INDIRECT) == 0)
             return 0;
     } else {
@@ -1346,7 +1470,7 @@ static void crl_akid_check(X509_STORE_CTX *ctx, X509_CRL *crl,
 
     for (cidx++; cidx < sk_X509_num(ctx->chain); cidx++) {
         crl_issuer = sk_X509_value(ctx->chain, cidx);
-        if (X509_NAME_cmp(X509_get_subject_name(crl_issuer), cnm))
+        if (!ossl_x509_name_equal(X509_get_subject_name(crl_issuer), cnm))
             continue;
         if (X509_check_akid(crl_issuer, crl->akid) == X509_V_OK) {
             *pcrl_score |= CRL_SCORE_AKID | CRL_SCORE_SAME_PATH;
@@ -1365,7 +1489,7 @@ static void crl_akid_check(X509_STORE_CTX *ctx, X509_CRL *crl,
      */
     for (i = 0; i < sk_X509_num(ctx->untrusted); i++) {
         crl_issuer = sk_X509_value(ctx->untrusted, i);
-        if (X509_NAME_cmp(X509_get_subject_name(crl_issuer), cnm) != 0)
+        if (!ossl_x509_name_equal(X509_get_subject_name(crl_issuer), cnm))
             continue;
         if (X509_check_akid(crl_issuer, crl->akid) == X509_V_OK) {
             *pissuer = crl_issuer;
@@ -2182,7 +2306,7 @@ X509_CRL *X509_CRL_diff(X509_CRL *base, X509_CRL *newer,
     }
 
     /* Go through revoked entries, copying as needed */
-    revs = X509_CRL_get_REVOKED(newer);
+    revs = newer->crl.revoked;
 
     for (i = 0; i < sk_X509_REVOKED_num(revs); i++) {
         X509_REVOKED *rvn, *rvtmp;
@@ -2219,6 +2343,162 @@ X509_CRL *X509_CRL_diff(X509_CRL *base, X509_CRL *newer,
     return NULL;
 }
 
+static int revoked_ptr_cmp(const X509_REVOKED *const *a,
+                           const X509_REVOKED *const *b)
+{
+    return *a < *b ? -1 : *a > *b;
+}
+
+/* Remove the entries listed in |removed| from the revoked entries of |crl| */
+static int crl_remove_revoked(X509_CRL *crl, STACK_OF(X509_REVOKED) *removed)
+{
+    STACK_OF(X509_REVOKED) *kept;
+    X509_REVOKED *rev;
+    int i;
+
+    /* A copy keeps the comparison function, and has room for all entries */
+    if ((kept = sk_X509_REVOKED_dup(crl->crl.revoked)) == NULL)
+        return 0;
+    sk_X509_REVOKED_zero(kept);
+    sk_X509_REVOKED_sort(removed);
+    for (i = 0; i < sk_X509_REVOKED_num(crl->crl.revoked); i++) {
+        rev = sk_X509_REVOKED_value(crl->crl.revoked, i);
+        if (sk_X509_REVOKED_find(removed, rev) >= 0)
+            X509_REVOKED_free(rev);
+        else
+            (void)sk_X509_REVOKED_push(kept, rev);
+    }
+    sk_X509_REVOKED_free(crl->crl.revoked);
+    crl->crl.revoked = kept;
+    crl->crl.enc.modified = 1;
+    return 1;
+}
+
+/*
+ * Merge the delta CRL |delta| into the complete CRL |base| it applies to, so
+ * that |base| becomes the complete CRL the issuer would have issued along with
+ * |delta|. Only the entries in |delta| are processed, the rest of |base| is
+ * left as it is.
+ */
+int X509_CRL_merge_delta(X509_CRL *base, X509_CRL *delta)
+{
+    STACK_OF(X509_REVOKED) *revs, *removed = NULL;
+    X509_REVOKED *rvn, *rvb, *rvtmp, tmp;
+    ASN1_INTEGER *crl_number = NULL;
+    int i, ret = 0;
+
+    if (base->base_crl_number != NULL) {
+        ERR_raise(ERR_LIB_X509, X509_R_CRL_ALREADY_DELTA);
+        return 0;
+    }
+    if (delta->base_crl_number == NULL) {
+        ERR_raise(ERR_LIB_X509, X509_R_CRL_NOT_DELTA);
+        return 0;
+    }
+    if (base->crl_number == NULL) {
+        ERR_raise(ERR_LIB_X509, X509_R_NO_CRL_NUMBER);
+        return 0;
+    }
+    /* Entries of indirect CRLs can't simply be appended */
+    if (base->issuers != NULL || delta->issuers != NULL
+            || ((base->idp_flags | delta->idp_flags) & IDP_INDIRECT) != 0) {
+        ERR_raise(ERR_LIB_X509, X509_R_INDIRECT_CRL_NOT_SUPPORTED);
+        return 0;
+    }
+    if (X509_NAME_cmp(X509_CRL_get_issuer(base),
+                      X509_CRL_get_issuer(delta)) != 0) {
+        ERR_raise(ERR_LIB_X509, X509_R_ISSUER_MISMATCH);
+        return 0;
+    }
+    if (!crl_extension_match(base, delta, NID_authority_key_identifier)) {
+        ERR_raise(ERR_LIB_X509, X509_R_AKID_MISMATCH);
+        return 0;
+    }
+    if (!crl_extension_match(base, delta, NID_issuing_distribution_point)) {
+        ERR_raise(ERR_LIB_X509, X509_R_IDP_MISMATCH);
+        return 0;
+    }
+    /* Delta CRL base number must not exceed Full CRL number. */
+    if (ASN1_INTEGER_cmp(delta->base_crl_number, base->crl_number) > 0) {
+        ERR_raise(ERR_LIB_X509, X509_R_BASE_CRL_TOO_OLD);
+        return 0;
+    }
+    /* Delta CRL number must exceed full CRL number */
+    if (ASN1_INTEGER_cmp(delta->crl_number, base->crl_number) <= 0) {
+        ERR_raise(ERR_LIB_X509, X509_R_NEWER_CRL_NOT_NEWER);
+        return 0;
+    }
+
+    revs = delta->crl.revoked;
+    for (i = 0; i < sk_X509_REVOKED_num(revs); i++) {
+        rvn = sk_X509_REVOKED_value(revs, i);
+        if (!ossl_x509_crl_lookup(base, &rvb, &rvn->serialNumber, NULL))
+            rvb = NULL;
+
+        if (rvn->reason == CRL_REASON_REMOVE_FROM_CRL) {
+            if (rvb == NULL)
+                continue;
+            if (removed == NULL)
+                removed = sk_X509_REVOKED_new(revoked_ptr_cmp);
+            if (removed == NULL || !sk_X509_REVOKED_push(removed, rvb)) {
+                ERR_raise(ERR_LIB_X509, ERR_R_CRYPTO_LIB);
+                goto err;
+            }
+            continue;
+        }
+
+        if ((rvtmp = X509_REVOKED_dup(rvn)) == NULL) {
+            ERR_raise(ERR_LIB_X509, ERR_R_ASN1_LIB);
+            goto err;
+        }
+        rvtmp->reason = rvn->reason;
+        if (rvb != NULL) {
+            /* The entry in the delta supersedes the one in the base */
+            tmp = *rvb;
+            *rvb = *rvtmp;
+            rvb->sequence = tmp.sequence;
+            *rvtmp = tmp;
+            X509_REVOKED_free(rvtmp);
+            base->crl.enc.modified = 1;
+        } else if (!X509_CRL_add0_revoked(base, rvtmp)) {
+            X509_REVOKED_free(rvtmp);
+            ERR_raise(ERR_LIB_X509, ERR_R_X509_LIB);
+            goto err;
+        }
+    }
+
+    if (removed != NULL) {
+        if (!crl_remove_revoked(base, removed)) {
+            ERR_raise(ERR_LIB_X509, ERR_R_CRYPTO_LIB);
+            goto err;
+        }
+        /* If this fails lookups sort the entries instead */
+        (void)ossl_x509_crl_index_revoked(base);
+    }
+
+    if (!X509_CRL_set1_lastUpdate(base, X509_CRL_get0_lastUpdate(delta))
+            || !X509_CRL_set1_nextUpdate(base, X509_CRL_get0_nextUpdate(delta))
+            || !X509_CRL_add1_ext_i2d(base, NID_crl_number, delta->crl_number,
+                                      0, X509V3_ADD_REPLACE)
+            || (crl_number = ASN1_INTEGER_dup(delta->crl_number)) == NULL) {
+        ERR_raise(ERR_LIB_X509, ERR_R_X509_LIB);
+        goto err;
+    }
+    ASN1_INTEGER_free(base->crl_number);
+    base->crl_number = crl_number;
+    base->flags |= delta->flags & (EXFLAG_INVALID | EXFLAG_CRITICAL);
+
+    /* X509_CRL_digest() recomputes the fingerprint only when it is unset */
+    base->flags |= EXFLAG_NO_FINGERPRINT;
+    if (X509_CRL_digest(base, EVP_sha1(), base->sha1_hash, NULL))
+        base->flags &= ~EXFLAG_NO_FINGERPRINT;
+
+    ret = 1;
+ err:
+    sk_X509_REVOKED_free(removed);
+    return ret;
+}
+
 int X509_STORE_CTX_set_ex_data(X509_STORE_CTX *ctx, int idx, void *data)
 {
     return CRYPTO_set_ex_data(&ctx->ex_data, idx, data);
@@ -2456,6 +2736,7 @@ int X509_STORE_CTX_init(X509_STORE_CTX *ctx, X509_STORE *store, X509 *x509,
     ctx->dane = NULL;
     ctx->bare_ta_signed = 0;
     ctx->rpk = NULL;
+    ctx->vcache.active = 0;
     /* Zero ex_data to make sure we're cleanup-safe */
     memset(&ctx->ex_data, 0, sizeof(ctx->ex_data));
 
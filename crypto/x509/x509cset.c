@@ -122,6 +122,7 @@ const STACK_OF(X509_EXTENSION) *X509_CRL_get0_extensions(const X509_CRL *crl)
 
 STACK_OF(X509_REVOKED) *X509_CRL_get_REVOKED(X509_CRL *crl)
 {
+    crl->revoked_shared = 1;
     return crl->crl.revoked;
 }
 
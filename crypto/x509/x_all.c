@@ -27,15 +27,109 @@
 #include "crypto/pkcs7.h"
 #include "crypto/x509.h"
 #include "crypto/rsa.h"
+#include "crypto/evp.h"
+#include "crypto/asn1.h"
+
+/*
+ * The to be signed part of a certificate is only re-encoded once it has been
+ * modified after decoding, so until then its signature needs checking just
+ * once per issuer key. The key last found to verify it is held on to, so that
+ * it can be recognised by its address, together with the state of the key
+ * and the signature it verified, which must not have changed since.
+ */
+static const void *x509_pkey_data(const EVP_PKEY *pkey)
+{
+    return evp_pkey_is_provided(pkey) ? pkey->keydata : pkey->pkey.ptr;
+}
+
+static size_t x509_pkey_dirty_cnt(const EVP_PKEY *pkey)
+{
+    if (evp_pkey_is_legacy(pkey) && pkey->ameth->dirty_cnt != NULL)
+        return pkey->ameth->dirty_cnt(pkey);
+    return pkey->dirty_cnt;
+}
+
+void ossl_x509_verified_by_free(X509 *x)
+{
+    EVP_PKEY_free(x->verified_by.key);
+    X509_ALGOR_free(x->verified_by.sig_alg);
+    ASN1_BIT_STRING_free(x->verified_by.signature);
+    memset(&x->verified_by, 0, sizeof(x->verified_by));
+}
+
+static int x509_is_verified_by(X509 *a, EVP_PKEY *r)
+{
+    int ret;
+
+    if (r == NULL || a->cert_info.enc.modified
+            || !CRYPTO_THREAD_read_lock(a->lock))
+        return 0;
+    ret = a->verified_by.key == r
+        && a->verified_by.keydata == x509_pkey_data(r)
+        && a->verified_by.key_dirty_cnt == x509_pkey_dirty_cnt(r)
+        && X509_ALGOR_cmp(a->verified_by.sig_alg, &a->sig_alg) == 0
+        && ASN1_STRING_cmp(a->verified_by.signature, &a->signature) == 0;
+    CRYPTO_THREAD_unlock(a->lock);
+    return ret;
+}
+
+/*
+ * Remembers that |r| verified the signature of |a|, |keydata| and |dirty_cnt|
+ * being what x509_pkey_data() and x509_pkey_dirty_cnt() returned for |r| before
+ * it did.
+ */
+static void x509_set_verified_by(X509 *a, EVP_PKEY *r, const void *keydata,
+                                 size_t dirty_cnt)
+{
+    X509_ALGOR *sig_alg = NULL;
+    ASN1_BIT_STRING *signature = NULL;
+
+    if (a->cert_info.enc.modified)
+        return;
+    if ((sig_alg = X509_ALGOR_dup(&a->sig_alg)) == NULL
+            || (signature = ASN1_STRING_dup(&a->signature)) == NULL
+            || !EVP_PKEY_up_ref(r))
+        goto err;
+    if (!CRYPTO_THREAD_write_lock(a->lock)) {
+        EVP_PKEY_free(r);
+        goto err;
+    }
+    ossl_x509_verified_by_free(a);
+    a->verified_by.key = r;
+    a->verified_by.keydata = keydata;
+    a->verified_by.key_dirty_cnt = dirty_cnt;
+    a->verified_by.sig_alg = sig_alg;
+    a->verified_by.signature = signature;
+    CRYPTO_THREAD_unlock(a->lock);
+    return;
+
+ err:
+    X509_ALGOR_free(sig_alg);
+    ASN1_BIT_STRING_free(signature);
+}
 
 int X509_verify(X509 *a, EVP_PKEY *r)
 {
+    const void *keydata = NULL;
+    size_t dirty_cnt = 0;
+    int ret;
+
     if (X509_ALGOR_cmp(&a->sig_alg, &a->cert_info.signature) != 0)
         return 0;
 
-    return ASN1_item_verify_ex(ASN1_ITEM_rptr(X509_CINF), &a->sig_alg,
-                               &a->signature, &a->cert_info,
-                               a->distinguishing_id, r, a->libctx, a->propq);
+    if (x509_is_verified_by(a, r))
+        return 1;
+    if (r != NULL) {
+        keydata = x509_pkey_data(r);
+        dirty_cnt = x509_pkey_dirty_cnt(r);
+    }
+
+    ret = ASN1_item_verify_ex(ASN1_ITEM_rptr(X509_CINF), &a->sig_alg,
+                              &a->signature, &a->cert_info,
+                              a->distinguishing_id, r, a->libctx, a->propq);
+    if (ret > 0)
+        x509_set_verified_by(a, r, keydata, dirty_cnt);
+    return ret;
 }
 
 int X509_REQ_verify_ex(X509_REQ *a, EVP_PKEY *r, OSSL_LIB_CTX *libctx,
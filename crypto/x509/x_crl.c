@@ -86,7 +86,7 @@ static int crl_set_issuers(X509_CRL *crl)
     GENERAL_NAMES *gens, *gtmp;
     STACK_OF(X509_REVOKED) *revoked;
 
-    revoked = X509_CRL_get_REVOKED(crl);
+    revoked = crl->crl.revoked;
 
     gens = NULL;
     for (i = 0; i < sk_X509_REVOKED_num(revoked); i++) {
@@ -174,6 +174,7 @@ static int crl_cb(int operation, ASN1_VALUE **pval, const ASN1_ITEM *it,
         ASN1_INTEGER_free(crl->crl_number);
         ASN1_INTEGER_free(crl->base_crl_number);
         sk_GENERAL_NAMES_pop_free(crl->issuers, GENERAL_NAMES_free);
+        OPENSSL_free(crl->revoked_index);
         /* fall through */
 
     case ASN1_OP_NEW_POST:
@@ -187,6 +188,10 @@ static int crl_cb(int operation, ASN1_VALUE **pval, const ASN1_ITEM *it,
         crl->issuers = NULL;
         crl->crl_number = NULL;
         crl->base_crl_number = NULL;
+        crl->revoked_index = NULL;
+        crl->revoked_index_mask = 0;
+        crl->revoked_index_num = 0;
+        crl->revoked_shared = 0;
         break;
 
     case ASN1_OP_D2I_POST:
@@ -252,6 +257,12 @@ static int crl_cb(int operation, ASN1_VALUE **pval, const ASN1_ITEM *it,
         if (!crl_set_issuers(crl))
             return 0;
 
+        /*
+         * Index the revoked entries now rather than sorting them on first
+         * lookup. Failing to do so is not fatal, lookups then sort instead.
+         */
+        (void)ossl_x509_crl_index_revoked(crl);
+
         if (crl->meth->crl_init) {
             if (crl->meth->crl_init(crl) == 0)
                 return 0;
@@ -270,6 +281,7 @@ static int crl_cb(int operation, ASN1_VALUE **pval, const ASN1_ITEM *it,
         ASN1_INTEGER_free(crl->crl_number);
         ASN1_INTEGER_free(crl->base_crl_number);
         sk_GENERAL_NAMES_pop_free(crl->issuers, GENERAL_NAMES_free);
+        OPENSSL_free(crl->revoked_index);
         OPENSSL_free(crl->propq);
         break;
     case ASN1_OP_DUP_POST:
@@ -346,6 +358,79 @@ static int X509_REVOKED_cmp(const X509_REVOKED *const *a,
                             (ASN1_STRING *)&(*b)->serialNumber));
 }
 
+/*
+ * Revoked entries are indexed by an FNV-1a hash of their serial number in an
+ * open addressed table, with linear probing, that is kept at most half full.
+ * The index only changes along with the CRL itself, so lookups need no lock.
+ */
+#define CRL_INDEX_MIN_SLOTS     16
+
+static size_t crl_serial_hash(const ASN1_INTEGER *serial)
+{
+    uint32_t h = 0x811c9dc5;
+    int i;
+
+    for (i = 0; i < serial->length; i++)
+        h = (h ^ serial->data[i]) * 0x01000193;
+    if (serial->type == V_ASN1_NEG_INTEGER)
+        h = ~h;
+    return h;
+}
+
+static void crl_index_insert(X509_CRL *crl, X509_REVOKED *rev)
+{
+    size_t pos = crl_serial_hash(&rev->serialNumber) & crl->revoked_index_mask;
+
+    while (crl->revoked_index[pos] != NULL)
+        pos = (pos + 1) & crl->revoked_index_mask;
+    crl->revoked_index[pos] = rev;
+    crl->revoked_index_num++;
+}
+
+/* (Re)build the index of all revoked entries of |crl| */
+int ossl_x509_crl_index_revoked(X509_CRL *crl)
+{
+    int i, num = sk_X509_REVOKED_num(crl->crl.revoked);
+    size_t slots = CRL_INDEX_MIN_SLOTS;
+
+    OPENSSL_free(crl->revoked_index);
+    crl->revoked_index = NULL;
+    crl->revoked_index_num = 0;
+    if (num <= 0)
+        return 1;
+
+    while (slots / 2 < (size_t)num) {
+        if (slots > SIZE_MAX / (2 * sizeof(*crl->revoked_index)))
+            return 0;
+        slots *= 2;
+    }
+    if ((crl->revoked_index = OPENSSL_zalloc(slots
+                                             * sizeof(*crl->revoked_index)))
+            == NULL)
+        return 0;
+    crl->revoked_index_mask = slots - 1;
+    for (i = 0; i < num; i++)
+        crl_index_insert(crl, sk_X509_REVOKED_value(crl->crl.revoked, i));
+    return 1;
+}
+
+/*
+ * Add |rev|, just appended to the revoked entries of |crl|, to its index if
+ * there is one, growing the index as needed.
+ */
+static int crl_index_add(X509_CRL *crl, X509_REVOKED *rev)
+{
+    int num = sk_X509_REVOKED_num(crl->crl.revoked);
+
+    if (crl->revoked_index == NULL || crl->revoked_shared
+            || crl->revoked_index_num + 1 != num)
+        return 1;
+    if ((size_t)crl->revoked_index_num + 1 > (crl->revoked_index_mask + 1) / 2)
+        return ossl_x509_crl_index_revoked(crl);
+    crl_index_insert(crl, rev);
+    return 1;
+}
+
 X509_CRL *X509_CRL_new_ex(OSSL_LIB_CTX *libctx, const char *propq)
 {
     X509_CRL *crl = NULL;
@@ -370,6 +455,11 @@ int X509_CRL_add0_revoked(X509_CRL *crl, X509_REVOKED *rev)
         return 0;
     }
     inf->enc.modified = 1;
+    if (!crl_index_add(crl, rev)) {
+        /* Lookups sort the entries instead */
+        OPENSSL_free(crl->revoked_index);
+        crl->revoked_index = NULL;
+    }
     return 1;
 }
 
@@ -431,16 +521,49 @@ static int crl_revoked_issuer_match(X509_CRL *crl, const X509_NAME *nm,
 
 }
 
+static int crl_revoked_found(X509_REVOKED **ret, X509_REVOKED *rev)
+{
+    if (ret)
+        *ret = rev;
+    if (rev->reason == CRL_REASON_REMOVE_FROM_CRL)
+        return 2;
+    return 1;
+}
+
 static int def_crl_lookup(X509_CRL *crl,
                           X509_REVOKED **ret, const ASN1_INTEGER *serial,
                           const X509_NAME *issuer)
+{
+    return ossl_x509_crl_lookup(crl, ret, serial, issuer);
+}
+
+int ossl_x509_crl_lookup(X509_CRL *crl, X509_REVOKED **ret,
+                         const ASN1_INTEGER *serial, const X509_NAME *issuer)
 {
     X509_REVOKED rtmp, *rev;
     int idx, num;
+    size_t pos;
 
     if (crl->crl.revoked == NULL)
         return 0;
 
+    /*
+     * Use the index, unless the revoked entries may have been changed
+     * directly, in which case it could point at freed entries or put them
+     * under their old serial numbers.
+     */
+    num = sk_X509_REVOKED_num(crl->crl.revoked);
+    if (crl->revoked_index != NULL && !crl->revoked_shared
+            && crl->revoked_index_num == num) {
+        pos = crl_serial_hash(serial) & crl->revoked_index_mask;
+        for (; (rev = crl->revoked_index[pos]) != NULL;
+             pos = (pos + 1) & crl->revoked_index_mask)
+            if (ASN1_INTEGER_cmp(&rev->serialNumber, serial) == 0
+                    && crl_revoked_issuer_match(crl, issuer, rev))
+                return crl_revoked_found(ret, rev);
+        return 0;
+    }
+
     /*
      * Sort revoked into serial number order if not already sorted. Do this
      * under a lock to avoid race condition.
@@ -460,13 +583,8 @@ static int def_crl_lookup(X509_CRL *crl,
         rev = sk_X509_REVOKED_value(crl->crl.revoked, idx);
         if (ASN1_INTEGER_cmp(&rev->serialNumber, serial))
             return 0;
-        if (crl_revoked_issuer_match(crl, issuer, rev)) {
-            if (ret)
-                *ret = rev;
-            if (rev->reason == CRL_REASON_REMOVE_FROM_CRL)
-                return 2;
-            return 1;
-        }
+        if (crl_revoked_issuer_match(crl, issuer, rev))
+            return crl_revoked_found(ret, rev);
     }
     return 0;
 }
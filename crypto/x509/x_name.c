@@ -1,5 +1,5 @@
 /*
- * Copyright 1995-2021 The OpenSSL Project Authors. All Rights Reserved.
+ * Copyright 1995-2023 The OpenSSL Project Authors. All Rights Reserved.
  *
  * Licensed under the Apache License 2.0 (the "License").  You may not use
  * this file except in compliance with the License.  You can obtain a copy
@@ -10,6 +10,7 @@
 #include <stdio.h>
 #include "crypto/ctype.h"
 #include "internal/cryptlib.h"
+#include "internal/der.h"
 #include <openssl/asn1t.h>
 #include <openssl/x509.h>
 #include "crypto/x509.h"
@@ -138,6 +139,63 @@ static void local_sk_X509_NAME_ENTRY_pop_free(STACK_OF(X509_NAME_ENTRY) *ne)
     sk_X509_NAME_ENTRY_pop_free(ne, X509_NAME_ENTRY_free);
 }
 
+/*
+ * Decodes a DER encoded Name directly into a new X509_NAME, only using the
+ * template decoder for the individual AttributeTypeAndValue entries.  This
+ * avoids building the internal STACK_OF(STACK_OF(X509_NAME_ENTRY)) form with
+ * its stack per RDN, which is most of the allocations when decoding a Name.
+ *
+ * Returns NULL without leaving any errors if the input isn't plain DER, in
+ * which case the caller falls back to the template decoder.
+ */
+static X509_NAME *x509_name_der_d2i(const unsigned char **in, long len)
+{
+    union {
+        X509_NAME *x;
+        ASN1_VALUE *a;
+    } nm = {
+        NULL
+    };
+    PACKET pkt, name, rdn, atv;
+    const unsigned char *p;
+    X509_NAME_ENTRY *entry;
+    int set;
+
+    if (len <= 0 || !PACKET_buf_init(&pkt, *in, (size_t)len))
+        return NULL;
+
+    ERR_set_mark();
+    if (!ossl_DER_r_sequence(&pkt, DER_NO_CONTEXT, &name)
+            || !x509_name_ex_new(&nm.a, NULL))
+        goto err;
+    for (set = 0; PACKET_remaining(&name) > 0; set++) {
+        if (!ossl_DER_r_set(&name, DER_NO_CONTEXT, &rdn))
+            goto err;
+        while (PACKET_remaining(&rdn) > 0) {
+            p = PACKET_data(&rdn);
+            if (!ossl_DER_r_sequence(&rdn, DER_NO_CONTEXT, &atv)
+                    || (entry = d2i_X509_NAME_ENTRY(NULL, &p,
+                                                    PACKET_data(&rdn) - p))
+                       == NULL)
+                goto err;
+            entry->set = set;
+            if (p != PACKET_data(&rdn)
+                    || !sk_X509_NAME_ENTRY_push(nm.x->entries, entry)) {
+                X509_NAME_ENTRY_free(entry);
+                goto err;
+            }
+        }
+    }
+    ERR_clear_last_mark();
+    *in = PACKET_data(&pkt);
+    return nm.x;
+
+ err:
+    X509_NAME_free(nm.x);
+    ERR_pop_to_mark();
+    return NULL;
+}
+
 static int x509_name_ex_d2i(ASN1_VALUE **val,
                             const unsigned char **in, long len,
                             const ASN1_ITEM *it, int tag, int aclass,
@@ -164,34 +222,43 @@ static int x509_name_ex_d2i(ASN1_VALUE **val,
         len = X509_NAME_MAX;
     q = p;
 
-    /* Get internal representation of Name */
-    ret = ASN1_item_ex_d2i(&intname.a,
-                           &p, len, ASN1_ITEM_rptr(X509_NAME_INTERNAL),
-                           tag, aclass, opt, ctx);
+    if (tag == -1 && (nm.x = x509_name_der_d2i(&p, len)) != NULL) {
+        /* The header may have been cached by a failed OPTIONAL match */
+        if (ctx != NULL)
+            ctx->valid = 0;
+        if (*val)
+            x509_name_ex_free(val, NULL);
+    } else {
+        /* Get internal representation of Name */
+        ret = ASN1_item_ex_d2i(&intname.a,
+                               &p, len, ASN1_ITEM_rptr(X509_NAME_INTERNAL),
+                               tag, aclass, opt, ctx);
+
+        if (ret <= 0)
+            return ret;
 
-    if (ret <= 0)
-        return ret;
+        if (*val)
+            x509_name_ex_free(val, NULL);
+        if (!x509_name_ex_new(&nm.a, NULL))
+            goto err;
 
-    if (*val)
-        x509_name_ex_free(val, NULL);
-    if (!x509_name_ex_new(&nm.a, NULL))
-        goto err;
+        /* Convert internal representation to X509_NAME structure */
+        for (i = 0; i < sk_STACK_OF_X509_NAME_ENTRY_num(intname.s); i++) {
+            entries = sk_STACK_OF_X509_NAME_ENTRY_value(intname.s, i);
+            for (j = 0; j < sk_X509_NAME_ENTRY_num(entries); j++) {
+                entry = sk_X509_NAME_ENTRY_value(entries, j);
+                entry->set = i;
+                if (!sk_X509_NAME_ENTRY_push(nm.x->entries, entry))
+                    goto err;
+                (void)sk_X509_NAME_ENTRY_set(entries, j, NULL);
+            }
+        }
+    }
     /* We've decoded it: now cache encoding */
     if (!BUF_MEM_grow(nm.x->bytes, p - q))
         goto err;
     memcpy(nm.x->bytes->data, q, p - q);
 
-    /* Convert internal representation to X509_NAME structure */
-    for (i = 0; i < sk_STACK_OF_X509_NAME_ENTRY_num(intname.s); i++) {
-        entries = sk_STACK_OF_X509_NAME_ENTRY_value(intname.s, i);
-        for (j = 0; j < sk_X509_NAME_ENTRY_num(entries); j++) {
-            entry = sk_X509_NAME_ENTRY_value(entries, j);
-            entry->set = i;
-            if (!sk_X509_NAME_ENTRY_push(nm.x->entries, entry))
-                goto err;
-            (void)sk_X509_NAME_ENTRY_set(entries, j, NULL);
-        }
-    }
     ret = x509_name_canon(nm.x);
     if (!ret)
         goto err;
@@ -307,6 +374,18 @@ static int x509_name_ex_print(BIO *out, const ASN1_VALUE **pval,
  * NOTE: For empty X509_NAME (NULL-DN), canon_enclen == 0 && canon_enc == NULL
  */
 
+/* 64-bit FNV-1a */
+static uint64_t x509_name_canon_hash(const unsigned char *p, int len)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    while (len-- > 0) {
+        h ^= *p++;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
 static int x509_name_canon(X509_NAME *a)
 {
     unsigned char *p;
@@ -320,6 +399,7 @@ static int x509_name_canon(X509_NAME *a)
     /* Special case: empty X509_NAME => null encoding */
     if (sk_X509_NAME_ENTRY_num(a->entries) == 0) {
         a->canon_enclen = 0;
+        a->canon_hash = x509_name_canon_hash(NULL, 0);
         return 1;
     }
     intname = sk_STACK_OF_X509_NAME_ENTRY_new_null();
@@ -372,6 +452,7 @@ static int x509_name_canon(X509_NAME *a)
     a->canon_enc = p;
 
     i2d_name_canon(intname, &p);
+    a->canon_hash = x509_name_canon_hash(a->canon_enc, a->canon_enclen);
 
     ret = 1;
 
@@ -27,6 +27,7 @@
 #include <openssl/encoder.h>
 #include "internal/provider.h"
 #include "internal/sizes.h"
+#include "internal/tsan_assist.h"
 
 struct X509_pubkey_st {
     X509_ALGOR *algor;
@@ -38,10 +39,31 @@ struct X509_pubkey_st {
     OSSL_LIB_CTX *libctx;
     char *propq;
 
+    /*
+     * Keys decoded from DER are only turned into |pkey| on first use, which
+     * most certificates parsed for their names or extensions never see.
+     * |decode_pending| is set until that has been attempted, and both it and
+     * |pkey| are then updated under |lock|, which only exists for such keys.
+     */
+    int decode_pending;
+    CRYPTO_RWLOCK *lock;
+
     /* Flag to force legacy keys */
     unsigned int flag_force_legacy : 1;
 };
 
+/*
+ * With atomic loads and stores, an already decoded key is returned without
+ * taking the lock.
+ */
+#if defined(tsan_ld_acq) && defined(tsan_st_rel)
+# define X509_PUBKEY_LOCK_FREE
+# define pkey_ld_acq(p)     tsan_ld_acq((void *TSAN_QUALIFIER *)(p))
+# define pkey_st_rel(p, v)  tsan_st_rel((void *TSAN_QUALIFIER *)(p), (v))
+#else
+# define pkey_st_rel(p, v)  (*(p) = (v))
+#endif
+
 static int x509_pubkey_decode(EVP_PKEY **pk, const X509_PUBKEY *key);
 
 static int x509_pubkey_set0_libctx(X509_PUBKEY *x, OSSL_LIB_CTX *libctx,
@@ -92,6 +114,7 @@ static void x509_pubkey_ex_free(ASN1_VALUE **pval, const ASN1_ITEM *it)
         ASN1_BIT_STRING_free(pubkey->public_key);
         EVP_PKEY_free(pubkey->pkey);
         OPENSSL_free(pubkey->propq);
+        CRYPTO_THREAD_lock_free(pubkey->lock);
         OPENSSL_free(pubkey);
         *pval = NULL;
     }
@@ -127,41 +150,37 @@ static int x509_pubkey_ex_new_ex(ASN1_VALUE **pval, const ASN1_ITEM *it,
     return ret != NULL;
 }
 
-static int x509_pubkey_ex_d2i_ex(ASN1_VALUE **pval,
-                                 const unsigned char **in, long len,
-                                 const ASN1_ITEM *it, int tag, int aclass,
-                                 char opt, ASN1_TLC *ctx, OSSL_LIB_CTX *libctx,
-                                 const char *propq)
+/*
+ * Checks whether the |publen| bytes at |in| are the DER encoding of |pubkey|,
+ * apart from an implicit tag.  Deferred decoding works on that encoding, so
+ * it only sees the same input as decoding straight away if they are.
+ */
+static int x509_pubkey_is_der(const X509_PUBKEY *pubkey,
+                              const unsigned char *in, size_t publen)
+{
+    unsigned char *der = NULL;
+    int derlen, ret;
+
+    derlen = ASN1_item_i2d((const ASN1_VALUE *)pubkey, &der,
+                           ASN1_ITEM_rptr(X509_PUBKEY_INTERNAL));
+    ret = derlen > 0 && (size_t)derlen == publen
+        && memcmp(der + 1, in + 1, publen - 1) == 0;
+    OPENSSL_free(der);
+    return ret;
+}
+
+/*
+ * Decodes the key of |pubkey| from the |publen| bytes at |in| it was parsed
+ * from.  Returns 0 on fatal errors and if the key does not take up all of
+ * them, other failures are left to be reported when the key is used.
+ */
+static int x509_pubkey_decode_now(X509_PUBKEY *pubkey,
+                                  const unsigned char *in, size_t publen,
+                                  int aclass)
 {
-    const unsigned char *in_saved = *in;
-    size_t publen;
-    X509_PUBKEY *pubkey;
-    int ret;
     OSSL_DECODER_CTX *dctx = NULL;
     unsigned char *tmpbuf = NULL;
-
-    if (*pval == NULL && !x509_pubkey_ex_new_ex(pval, it, libctx, propq))
-        return 0;
-    if (!x509_pubkey_ex_populate(pval, NULL)) {
-        ERR_raise(ERR_LIB_ASN1, ERR_R_X509_LIB);
-        return 0;
-    }
-
-    /* This ensures that |*in| advances properly no matter what */
-    if ((ret = ASN1_item_ex_d2i(pval, in, len,
-                                ASN1_ITEM_rptr(X509_PUBKEY_INTERNAL),
-                                tag, aclass, opt, ctx)) <= 0)
-        return ret;
-
-    publen = *in - in_saved;
-    if (!ossl_assert(publen > 0)) {
-        ERR_raise(ERR_LIB_ASN1, ERR_R_INTERNAL_ERROR);
-        return 0;
-    }
-
-    pubkey = (X509_PUBKEY *)*pval;
-    EVP_PKEY_free(pubkey->pkey);
-    pubkey->pkey = NULL;
+    int ret;
 
     /*
      * Opportunistically decode the key but remove any non fatal errors
@@ -177,6 +196,7 @@ static int x509_pubkey_ex_d2i_ex(ASN1_VALUE **pval,
     if ((ret = x509_pubkey_decode(&pubkey->pkey, pubkey)) == -1) {
         /* -1 indicates a fatal error, like malloc failure */
         ERR_clear_last_mark();
+        ret = 0;
         goto end;
     }
 
@@ -191,17 +211,21 @@ static int x509_pubkey_ex_d2i_ex(ASN1_VALUE **pval,
         * class so we modify the data accordingly.
         */
         if (aclass != V_ASN1_UNIVERSAL) {
-            tmpbuf = OPENSSL_memdup(in_saved, publen);
-            if (tmpbuf == NULL)
-                return 0;
-            in_saved = tmpbuf;
+            tmpbuf = OPENSSL_memdup(in, publen);
+            if (tmpbuf == NULL) {
+                ERR_clear_last_mark();
+                ret = 0;
+                goto end;
+            }
+            in = tmpbuf;
             *tmpbuf = V_ASN1_CONSTRUCTED | V_ASN1_SEQUENCE;
         }
-        p = in_saved;
+        p = in;
 
         if (OBJ_obj2txt(txtoidname, sizeof(txtoidname),
                         pubkey->algor->algorithm, 0) <= 0) {
             ERR_clear_last_mark();
+            ret = 0;
             goto end;
         }
         if ((dctx =
@@ -222,6 +246,7 @@ static int x509_pubkey_ex_d2i_ex(ASN1_VALUE **pval,
                      */
                     ERR_clear_last_mark();
                     ERR_raise(ERR_LIB_ASN1, EVP_R_DECODE_ERROR);
+                    ret = 0;
                     goto end;
                 }
             }
@@ -235,6 +260,139 @@ static int x509_pubkey_ex_d2i_ex(ASN1_VALUE **pval,
     return ret;
 }
 
+static int x509_pubkey_ex_d2i_ex(ASN1_VALUE **pval,
+                                 const unsigned char **in, long len,
+                                 const ASN1_ITEM *it, int tag, int aclass,
+                                 char opt, ASN1_TLC *ctx, OSSL_LIB_CTX *libctx,
+                                 const char *propq)
+{
+    const unsigned char *in_saved = *in;
+    size_t publen;
+    X509_PUBKEY *pubkey;
+    int ret;
+
+    if (*pval == NULL && !x509_pubkey_ex_new_ex(pval, it, libctx, propq))
+        return 0;
+    if (!x509_pubkey_ex_populate(pval, NULL)) {
+        ERR_raise(ERR_LIB_ASN1, ERR_R_X509_LIB);
+        return 0;
+    }
+
+    /* This ensures that |*in| advances properly no matter what */
+    if ((ret = ASN1_item_ex_d2i(pval, in, len,
+                                ASN1_ITEM_rptr(X509_PUBKEY_INTERNAL),
+                                tag, aclass, opt, ctx)) <= 0)
+        return ret;
+
+    publen = *in - in_saved;
+    if (!ossl_assert(publen > 0)) {
+        ERR_raise(ERR_LIB_ASN1, ERR_R_INTERNAL_ERROR);
+        return 0;
+    }
+
+    pubkey = (X509_PUBKEY *)*pval;
+    EVP_PKEY_free(pubkey->pkey);
+    pubkey->pkey = NULL;
+    pubkey->decode_pending = 0;
+
+    /*
+     * Only DER input can be checked as well later, anything else is decoded
+     * and checked now.
+     */
+    if (!x509_pubkey_is_der(pubkey, in_saved, publen))
+        return x509_pubkey_decode_now(pubkey, in_saved, publen, aclass);
+
+    /* The key itself is decoded by x509_pubkey_get0_pkey() when needed */
+    if (pubkey->lock == NULL
+        && (pubkey->lock = CRYPTO_THREAD_lock_new()) == NULL) {
+        ERR_raise(ERR_LIB_ASN1, ERR_R_CRYPTO_LIB);
+        return 0;
+    }
+    pubkey->decode_pending = 1;
+    return 1;
+}
+
+/*
+ * Decode the key held in |pubkey| into an EVP_PKEY, which is left NULL if that
+ * fails.  This is opportunistic, failures are reported by the caller.
+ */
+static EVP_PKEY *x509_pubkey_decode_pending(const X509_PUBKEY *pubkey)
+{
+    EVP_PKEY *pkey = NULL;
+    OSSL_DECODER_CTX *dctx = NULL;
+    unsigned char *der = NULL;
+    const unsigned char *p;
+    char txtoidname[OSSL_MAX_NAME_SIZE];
+    size_t slen;
+    int derlen;
+
+    ERR_set_mark();
+
+    /*
+     * Try to decode with legacy method first.  This ensures that engines
+     * aren't overridden by providers.
+     */
+    if (x509_pubkey_decode(&pkey, pubkey) != 0 || pubkey->flag_force_legacy)
+        goto end;
+
+    /*
+     * Try to decode it into an EVP_PKEY with OSSL_DECODER.  The decoders only
+     * handle Universal class, so re-encode the key rather than keeping the
+     * possibly implicitly tagged original around.
+     */
+    if ((derlen = ASN1_item_i2d((const ASN1_VALUE *)pubkey, &der,
+                                ASN1_ITEM_rptr(X509_PUBKEY_INTERNAL))) <= 0
+        || OBJ_obj2txt(txtoidname, sizeof(txtoidname),
+                       pubkey->algor->algorithm, 0) <= 0)
+        goto end;
+
+    p = der;
+    slen = derlen;
+    if ((dctx =
+         OSSL_DECODER_CTX_new_for_pkey(&pkey, "DER", "SubjectPublicKeyInfo",
+                                       txtoidname, EVP_PKEY_PUBLIC_KEY,
+                                       pubkey->libctx,
+                                       pubkey->propq)) != NULL
+        && OSSL_DECODER_from_data(dctx, &p, &slen)
+        && slen != 0) {
+        /* If we successfully decoded then we *must* consume all the bytes */
+        EVP_PKEY_free(pkey);
+        pkey = NULL;
+    }
+
+ end:
+    ERR_pop_to_mark();
+    OSSL_DECODER_CTX_free(dctx);
+    OPENSSL_free(der);
+    return pkey;
+}
+
+/*
+ * Returns the EVP_PKEY for |key|, decoding it first if that is still pending.
+ * Decoding only fills in a cache, which is why |key| is const.
+ */
+static EVP_PKEY *x509_pubkey_get0_pkey(const X509_PUBKEY *key)
+{
+    X509_PUBKEY *pubkey = (X509_PUBKEY *)key;
+    EVP_PKEY *pkey;
+
+    if (key->lock == NULL)
+        return key->pkey;
+#ifdef X509_PUBKEY_LOCK_FREE
+    if ((pkey = pkey_ld_acq(&key->pkey)) != NULL)
+        return pkey;
+#endif
+    if (!CRYPTO_THREAD_write_lock(key->lock))
+        return NULL;
+    /* A key set since it was parsed takes precedence over decoding it */
+    if (pubkey->decode_pending && pubkey->pkey == NULL)
+        pkey_st_rel(&pubkey->pkey, x509_pubkey_decode_pending(pubkey));
+    pubkey->decode_pending = 0;
+    pkey = key->pkey;
+    CRYPTO_THREAD_unlock(key->lock);
+    return pkey;
+}
+
 static int x509_pubkey_ex_i2d(const ASN1_VALUE **pval, unsigned char **out,
                               const ASN1_ITEM *it, int tag, int aclass)
 {
@@ -283,6 +441,7 @@ X509_PUBKEY *X509_PUBKEY_new_ex(OSSL_LIB_CTX *libctx, const char *propq)
 X509_PUBKEY *X509_PUBKEY_dup(const X509_PUBKEY *a)
 {
     X509_PUBKEY *pubkey = OPENSSL_zalloc(sizeof(*pubkey));
+    EVP_PKEY *pkey;
 
     if (pubkey == NULL)
         return NULL;
@@ -303,9 +462,9 @@ X509_PUBKEY *X509_PUBKEY_dup(const X509_PUBKEY *a)
         return NULL;
     }
 
-    if (a->pkey != NULL) {
+    if ((pkey = x509_pubkey_get0_pkey(a)) != NULL) {
         ERR_set_mark();
-        pubkey->pkey = EVP_PKEY_dup(a->pkey);
+        pubkey->pkey = EVP_PKEY_dup(pkey);
         if (pubkey->pkey == NULL) {
             pubkey->flag_force_legacy = 1;
             if (x509_pubkey_decode(&pubkey->pkey, pubkey) <= 0) {
@@ -387,6 +546,7 @@ int X509_PUBKEY_set(X509_PUBKEY **x, EVP_PKEY *pkey)
         EVP_PKEY_free(pk->pkey);
 
     pk->pkey = pkey;
+    pk->decode_pending = 0;
     return 1;
 
  error:
@@ -454,18 +614,20 @@ static int x509_pubkey_decode(EVP_PKEY **ppkey, const X509_PUBKEY *key)
 
 EVP_PKEY *X509_PUBKEY_get0(const X509_PUBKEY *key)
 {
+    EVP_PKEY *pkey;
+
     if (key == NULL) {
         ERR_raise(ERR_LIB_X509, ERR_R_PASSED_NULL_PARAMETER);
         return NULL;
     }
 
-    if (key->pkey == NULL) {
+    if ((pkey = x509_pubkey_get0_pkey(key)) == NULL) {
         /* We failed to decode the key when we loaded it, or it was never set */
         ERR_raise(ERR_LIB_EVP, EVP_R_DECODE_ERROR);
         return NULL;
     }
 
-    return key->pkey;
+    return pkey;
 }
 
 EVP_PKEY *X509_PUBKEY_get(const X509_PUBKEY *key)
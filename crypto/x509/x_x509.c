@@ -54,6 +54,7 @@ static int x509_cb(int operation, ASN1_VALUE **pval, const ASN1_ITEM *it,
         ASIdentifiers_free(ret->rfc3779_asid);
 #endif
         ASN1_OCTET_STRING_free(ret->distinguishing_id);
+        ossl_x509_verified_by_free(ret);
 
         /* fall through */
 
@@ -75,6 +76,7 @@ static int x509_cb(int operation, ASN1_VALUE **pval, const ASN1_ITEM *it,
         ret->rfc3779_asid = NULL;
 #endif
         ret->distinguishing_id = NULL;
+        memset(&ret->verified_by, 0, sizeof(ret->verified_by));
         ret->aux = NULL;
         ret->crldp = NULL;
         if (!CRYPTO_new_ex_data(CRYPTO_EX_INDEX_X509, ret, &ret->ex_data))
@@ -95,6 +97,7 @@ static int x509_cb(int operation, ASN1_VALUE **pval, const ASN1_ITEM *it,
         ASIdentifiers_free(ret->rfc3779_asid);
 #endif
         ASN1_OCTET_STRING_free(ret->distinguishing_id);
+        ossl_x509_verified_by_free(ret);
         OPENSSL_free(ret->propq);
         break;
 
@@ -308,6 +311,8 @@ void X509_set0_distinguishing_id(X509 *x, ASN1_OCTET_STRING *d_id)
 {
     ASN1_OCTET_STRING_free(x->distinguishing_id);
     x->distinguishing_id = d_id;
+    /* The distinguishing ID is an input to SM2 signature verification */
+    ossl_x509_verified_by_free(x);
 }
 
 ASN1_OCTET_STRING *X509_get0_distinguishing_id(X509 *x)
@@ -0,0 +1,432 @@
+/*
+ *  Copyright 2023 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ *  Licensed under the Apache License 2.0 (the "License").  You may not use
+ *  this file except in compliance with the License.  You can obtain a copy
+ *  in the file LICENSE in the source distribution or at
+ *  https://www.openssl.org/source/license.html
+ */
+
+/*
+ * This demo shows how an application can drive many nonblocking QUIC
+ * connections from a single thread using its own event loop. Each connection's
+ * poll descriptor is registered with an application owned epoll set, each
+ * connection's next event deadline is tracked by the application, and all
+ * connections which become ready in a given iteration of the loop are
+ * processed together using SSL_handle_events_many().
+ *
+ * epoll is Linux specific; the same structure applies equally to kqueue or
+ * any other readiness notification mechanism.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <openssl/bio.h>
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+
+#define MAX_CONNS   64
+
+enum conn_state {
+    CONN_STATE_CONNECT,
+    CONN_STATE_WRITE,
+    CONN_STATE_READ,
+    CONN_STATE_DONE,
+    CONN_STATE_FAILED
+};
+
+struct conn {
+    SSL *ssl;
+    int fd;
+    enum conn_state state;
+    int registered;             /* fd has been added to the epoll set */
+    uint32_t epoll_events;      /* events currently registered with epoll */
+    int has_deadline;
+    int is_ready;               /* queued for processing this iteration */
+    struct timeval deadline;    /* absolute time of next required event */
+    size_t written;             /* bytes of the request written so far */
+    size_t received;            /* bytes of the response read so far */
+};
+
+static char request[256];
+static size_t request_len;
+
+/* Helper function to create a BIO connected to the server */
+static BIO *create_socket_bio(const char *hostname, const char *port,
+                              BIO_ADDR **peer_addr)
+{
+    int sock = -1;
+    BIO_ADDRINFO *res;
+    const BIO_ADDRINFO *ai = NULL;
+    BIO *bio;
+
+    if (!BIO_lookup_ex(hostname, port, BIO_LOOKUP_CLIENT, AF_INET, SOCK_DGRAM,
+                       0, &res))
+        return NULL;
+
+    for (ai = res; ai != NULL; ai = BIO_ADDRINFO_next(ai)) {
+        sock = BIO_socket(BIO_ADDRINFO_family(ai), SOCK_DGRAM, 0, 0);
+        if (sock == -1)
+            continue;
+
+        if (!BIO_connect(sock, BIO_ADDRINFO_address(ai), 0)
+                || !BIO_socket_nbio(sock, 1)) {
+            BIO_closesocket(sock);
+            sock = -1;
+            continue;
+        }
+
+        break;
+    }
+
+    if (sock != -1) {
+        *peer_addr = BIO_ADDR_dup(BIO_ADDRINFO_address(ai));
+        if (*peer_addr == NULL) {
+            BIO_closesocket(sock);
+            sock = -1;
+        }
+    }
+
+    BIO_ADDRINFO_free(res);
+
+    if (sock == -1)
+        return NULL;
+
+    bio = BIO_new(BIO_s_datagram());
+    if (bio == NULL) {
+        BIO_closesocket(sock);
+        return NULL;
+    }
+
+    BIO_set_fd(bio, sock, BIO_CLOSE);
+    return bio;
+}
+
+static int conn_init(struct conn *c, SSL_CTX *ctx, const char *hostname,
+                     const char *port)
+{
+    static const unsigned char alpn[] = {
+        8, 'h', 't', 't', 'p', '/', '1', '.', '0'
+    };
+    BIO *bio;
+    BIO_ADDR *peer_addr = NULL;
+    BIO_POLL_DESCRIPTOR desc;
+    int ok = 0;
+
+    memset(c, 0, sizeof(*c));
+    c->fd = -1;
+
+    if ((c->ssl = SSL_new(ctx)) == NULL)
+        return 0;
+
+    if ((bio = create_socket_bio(hostname, port, &peer_addr)) == NULL)
+        return 0;
+
+    SSL_set_bio(c->ssl, bio, bio);
+
+    if (!SSL_set_tlsext_host_name(c->ssl, hostname)
+            || !SSL_set1_host(c->ssl, hostname)
+            || SSL_set_alpn_protos(c->ssl, alpn, sizeof(alpn)) != 0
+            || !SSL_set1_initial_peer_addr(c->ssl, peer_addr)
+            || !SSL_set_blocking_mode(c->ssl, 0))
+        goto err;
+
+    /*
+     * Export the descriptor the connection wants to be polled on, so that it
+     * can be added to our own epoll set.
+     */
+    if (!SSL_get_rpoll_descriptor(c->ssl, &desc)
+            || desc.type != BIO_POLL_DESCRIPTOR_TYPE_SOCK_FD)
+        goto err;
+
+    c->fd = desc.value.fd;
+    c->state = CONN_STATE_CONNECT;
+    ok = 1;
+ err:
+    BIO_ADDR_free(peer_addr);
+    return ok;
+}
+
+/* Returns 1 if the connection can make further progress later. */
+static int conn_handle_result(struct conn *c, int ret)
+{
+    switch (SSL_get_error(c->ssl, ret)) {
+    case SSL_ERROR_WANT_READ:
+    case SSL_ERROR_WANT_WRITE:
+        return 1;
+    case SSL_ERROR_ZERO_RETURN:
+        c->state = CONN_STATE_DONE;
+        return 0;
+    default:
+        c->state = CONN_STATE_FAILED;
+        return 0;
+    }
+}
+
+/*
+ * Try to advance the application protocol of a connection as far as possible
+ * without blocking.
+ */
+static void conn_advance(struct conn *c)
+{
+    char buf[512];
+    size_t n;
+    int ret;
+
+    for (;;) {
+        switch (c->state) {
+        case CONN_STATE_CONNECT:
+            if ((ret = SSL_connect(c->ssl)) != 1) {
+                conn_handle_result(c, ret);
+                return;
+            }
+            c->state = CONN_STATE_WRITE;
+            break;
+
+        case CONN_STATE_WRITE:
+            if (!SSL_write_ex(c->ssl, request + c->written,
+                              request_len - c->written, &n)) {
+                conn_handle_result(c, 0);
+                return;
+            }
+            c->written += n;
+            if (c->written < request_len)
+                break;
+
+            /* Signal the end of the request to the server. */
+            if (!SSL_stream_conclude(c->ssl, 0)) {
+                c->state = CONN_STATE_FAILED;
+                return;
+            }
+            c->state = CONN_STATE_READ;
+            break;
+
+        case CONN_STATE_READ:
+            if (!SSL_read_ex(c->ssl, buf, sizeof(buf), &n)) {
+                conn_handle_result(c, 0);
+                return;
+            }
+            c->received += n;
+            break;
+
+        default:
+            return;
+        }
+    }
+}
+
+static int conn_is_active(const struct conn *c)
+{
+    return c->state != CONN_STATE_DONE && c->state != CONN_STATE_FAILED;
+}
+
+/*
+ * Bring the epoll registration and the deadline we track for a connection up
+ * to date after it has been processed.
+ */
+static int conn_update_interest(struct conn *c, int epfd,
+                                const struct timeval *now)
+{
+    struct epoll_event ev = {0};
+    struct timeval tv;
+    int is_infinite;
+
+    if (!conn_is_active(c)) {
+        if (c->registered)
+            epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+        c->registered = 0;
+        c->has_deadline = 0;
+        return 1;
+    }
+
+    ev.events = (SSL_net_read_desired(c->ssl) ? EPOLLIN : 0)
+                | (SSL_net_write_desired(c->ssl) ? EPOLLOUT : 0);
+    ev.data.ptr = c;
+
+    if (!c->registered) {
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, c->fd, &ev) < 0)
+            return 0;
+        c->registered = 1;
+    } else if (ev.events != c->epoll_events) {
+        if (epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev) < 0)
+            return 0;
+    }
+    c->epoll_events = ev.events;
+
+    if (!SSL_get_event_timeout(c->ssl, &tv, &is_infinite))
+        return 0;
+
+    c->has_deadline = !is_infinite;
+    if (c->has_deadline)
+        timeradd(now, &tv, &c->deadline);
+
+    return 1;
+}
+
+int main(int argc, char *argv[])
+{
+    SSL_CTX *ctx = NULL;
+    struct conn conns[MAX_CONNS];
+    SSL *ready[MAX_CONNS];
+    struct conn *ready_conns[MAX_CONNS];
+    struct epoll_event events[MAX_CONNS];
+    size_t num_requested, num_conns = 0, num_ready, i;
+    int epfd = -1, nev, timeout_ms, active, res = EXIT_FAILURE;
+    struct timeval now, wait;
+
+    if (argc < 4) {
+        printf("Usage: quic-client-epoll hostname port num-connections\n");
+        goto end;
+    }
+
+    num_requested = strtoul(argv[3], NULL, 10);
+    if (num_requested == 0 || num_requested > MAX_CONNS) {
+        printf("num-connections must be between 1 and %d\n", MAX_CONNS);
+        goto end;
+    }
+
+    request_len = (size_t)snprintf(request, sizeof(request),
+                                   "GET / HTTP/1.0\r\nConnection: close\r\n"
+                                   "Host: %s\r\n\r\n", argv[1]);
+    if (request_len >= sizeof(request)) {
+        printf("Hostname too long\n");
+        goto end;
+    }
+
+    ctx = SSL_CTX_new(OSSL_QUIC_client_method());
+    if (ctx == NULL) {
+        printf("Failed to create the SSL_CTX\n");
+        goto end;
+    }
+
+    SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER, NULL);
+    if (!SSL_CTX_set_default_verify_paths(ctx)) {
+        printf("Failed to set the default trusted certificate store\n");
+        goto end;
+    }
+
+    if ((epfd = epoll_create1(0)) < 0) {
+        printf("Failed to create epoll instance\n");
+        goto end;
+    }
+
+    gettimeofday(&now, NULL);
+    for (i = 0; i < num_requested; ++i) {
+        /* Count the connection first so that it is always freed. */
+        ++num_conns;
+        if (!conn_init(&conns[i], ctx, argv[1], argv[2])) {
+            printf("Failed to create connection %zu\n", i);
+            goto end;
+        }
+
+        /* Kick off the handshake and register interest in the socket. */
+        conn_advance(&conns[i]);
+        if (!conn_update_interest(&conns[i], epfd, &now)) {
+            printf("Failed to register connection %zu\n", i);
+            goto end;
+        }
+    }
+
+    for (;;) {
+        /*
+         * Work out how long to sleep for from the earliest deadline of any
+         * connection. A server with very many connections would keep these in
+         * a heap or timer wheel rather than scanning them.
+         */
+        active = 0;
+        timeout_ms = -1;
+        gettimeofday(&now, NULL);
+        for (i = 0; i < num_conns; ++i) {
+            if (!conn_is_active(&conns[i]))
+                continue;
+
+            active = 1;
+            if (!conns[i].has_deadline)
+                continue;
+
+            if (timercmp(&conns[i].deadline, &now, <)) {
+                timeout_ms = 0;
+                break;
+            }
+
+            timersub(&conns[i].deadline, &now, &wait);
+            if (timeout_ms < 0
+                    || wait.tv_sec * 1000 + wait.tv_usec / 1000 < timeout_ms)
+                timeout_ms = (int)(wait.tv_sec * 1000 + wait.tv_usec / 1000);
+        }
+
+        if (!active)
+            break;
+
+        nev = epoll_wait(epfd, events, MAX_CONNS, timeout_ms);
+        if (nev < 0)
+            goto end;
+
+        /*
+         * Collect every connection which either has network activity or whose
+         * deadline has expired, and process them all in a single pass.
+         */
+        num_ready = 0;
+        gettimeofday(&now, NULL);
+        for (i = 0; i < (size_t)nev; ++i) {
+            struct conn *c = events[i].data.ptr;
+
+            c->is_ready = 1;
+            ready_conns[num_ready] = c;
+            ready[num_ready++] = c->ssl;
+        }
+
+        for (i = 0; i < num_conns; ++i) {
+            struct conn *c = &conns[i];
+
+            if (!c->is_ready && conn_is_active(c) && c->has_deadline
+                    && !timercmp(&now, &c->deadline, <)) {
+                c->is_ready = 1;
+                ready_conns[num_ready] = c;
+                ready[num_ready++] = c->ssl;
+            }
+        }
+
+        /* Failures are picked up per connection by conn_advance() below. */
+        SSL_handle_events_many(ready, num_ready, NULL, NULL);
+
+        /*
+         * Only the connections which were processed can have changed state,
+         * so there is no need to touch any of the others.
+         */
+        for (i = 0; i < num_ready; ++i) {
+            struct conn *c = ready_conns[i];
+
+            c->is_ready = 0;
+            conn_advance(c);
+            if (!conn_update_interest(c, epfd, &now))
+                goto end;
+        }
+    }
+
+    res = EXIT_SUCCESS;
+    for (i = 0; i < num_conns; ++i) {
+        printf("Connection %zu: %s, %zu bytes received\n", i,
+               conns[i].state == CONN_STATE_DONE ? "done" : "failed",
+               conns[i].received);
+        if (conns[i].state != CONN_STATE_DONE)
+            res = EXIT_FAILURE;
+    }
+
+ end:
+    if (res != EXIT_SUCCESS)
+        ERR_print_errors_fp(stderr);
+
+    for (i = 0; i < num_conns; ++i)
+        SSL_free(conns[i].ssl);
+    SSL_CTX_free(ctx);
+    if (epfd >= 0)
+        close(epfd);
+    return res;
+}
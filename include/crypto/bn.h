@@ -113,6 +113,18 @@ int ossl_bn_rsa_fips186_4_derive_prime(BIGNUM *Y, BIGNUM *X, const BIGNUM *Xin,
                                        BN_GENCB *cb);
 
 OSSL_LIB_CTX *ossl_bn_get_libctx(BN_CTX *ctx);
+int ossl_bn_ctx_set_arena(BN_CTX *ctx, int bits);
+BN_CTX *ossl_bn_ctx_thread_acquire(OSSL_LIB_CTX *libctx, int bits);
+void ossl_bn_ctx_thread_release(BN_CTX *ctx);
+
+/* Precomputed powers of a fixed base for ossl_bn_mod_exp_comb() */
+typedef struct bn_comb_st BN_COMB;
+BN_COMB *ossl_bn_comb_new(const BIGNUM *g, const BIGNUM *m, int bits,
+                          BN_CTX *ctx);
+void ossl_bn_comb_free(BN_COMB *comb);
+int ossl_bn_comb_bits(const BN_COMB *comb);
+int ossl_bn_mod_exp_comb(BIGNUM *r, const BIGNUM *p, const BN_COMB *comb,
+                         BN_CTX *ctx);
 
 extern const BIGNUM ossl_bn_inv_sqrt_2;
 
@@ -24,6 +24,10 @@ void *ossl_rand_crng_ctx_new(OSSL_LIB_CTX *);
 int ossl_thread_register_fips(OSSL_LIB_CTX *);
 void *ossl_thread_event_ctx_new(OSSL_LIB_CTX *);
 void *ossl_fips_prov_ossl_ctx_new(OSSL_LIB_CTX *);
+void *ossl_rsa_blinding_ctx_new(OSSL_LIB_CTX *);
+void *ossl_rsa_prime_pool_ctx_new(OSSL_LIB_CTX *);
+void *ossl_ffc_comb_ctx_new(OSSL_LIB_CTX *);
+void *ossl_bn_thread_ctx_new(OSSL_LIB_CTX *);
 #if defined(OPENSSL_THREADS)
 void *ossl_threads_ctx_new(OSSL_LIB_CTX *);
 #endif
@@ -42,6 +46,10 @@ void ossl_self_test_set_callback_free(void *);
 void ossl_rand_crng_ctx_free(void *);
 void ossl_thread_event_ctx_free(void *);
 void ossl_fips_prov_ossl_ctx_free(void *);
+void ossl_rsa_blinding_ctx_free(void *);
+void ossl_rsa_prime_pool_ctx_free(void *);
+void ossl_ffc_comb_ctx_free(void *);
+void ossl_bn_thread_ctx_free(void *);
 void ossl_release_default_drbg_ctx(void);
 #if defined(OPENSSL_THREADS)
 void ossl_threads_ctx_free(void *);
@@ -43,6 +43,8 @@ struct X509_name_st {
     /* canonical encoding used for rapid Name comparison */
     unsigned char *canon_enc;
     int canon_enclen;
+    /* FNV-1a hash of canon_enc, to reject unequal names without a memcmp */
+    uint64_t canon_hash;
 } /* X509_NAME */ ;
 
 /* Signature info structure */
@@ -116,6 +118,18 @@ struct X509_crl_st {
     ASN1_INTEGER *crl_number;
     ASN1_INTEGER *base_crl_number;
     STACK_OF(GENERAL_NAMES) *issuers;
+    /*
+     * Open addressed hash index of |crl.revoked| by serial number, with
+     * |revoked_index_mask| + 1 slots holding |revoked_index_num| entries.
+     */
+    X509_REVOKED **revoked_index;
+    size_t revoked_index_mask;
+    int revoked_index_num;
+    /*
+     * Set once X509_CRL_get_REVOKED() has handed out |crl.revoked|, which
+     * can then be changed behind the index's back, so it is no longer used.
+     */
+    int revoked_shared;
     /* hash of CRL */
     unsigned char sha1_hash[SHA_DIGEST_LENGTH];
     /* alternative method to handle this CRL */
@@ -199,6 +213,17 @@ struct x509_st {
     X509_CERT_AUX *aux;
     CRYPTO_RWLOCK *lock;
     volatile int ex_cached;
+    /*
+     * Issuer key the signature is known to verify with, see X509_verify(),
+     * and what the key and the signature were at the time
+     */
+    struct {
+        EVP_PKEY *key;
+        const void *keydata;
+        size_t key_dirty_cnt;
+        X509_ALGOR *sig_alg;
+        ASN1_BIT_STRING *signature;
+    } verified_by;
 
     /* Set on live certificates for authentication purposes */
     ASN1_OCTET_STRING *distinguishing_id;
@@ -280,6 +305,14 @@ struct x509_store_ctx_st {      /* X509_STORE_CTX */
     int bare_ta_signed;
     /* Raw Public Key */
     EVP_PKEY *rpk;
+    /* Verified chain cache state, see x509_vcache.c */
+    struct {
+        int active;
+        int cb_failed;          /* verify_cb was called to report an error */
+        int (*verify_cb) (int ok, X509_STORE_CTX *ctx);
+        uint64_t generation;
+        time_t expires;         /* 0 if not limited by time */
+    } vcache;
 
     OSSL_LIB_CTX *libctx;
     char *propq;
@@ -313,8 +346,10 @@ struct x509_object_st {
 int ossl_a2i_ipadd(unsigned char *ipout, const char *ipasc);
 int ossl_x509_set1_time(int *modified, ASN1_TIME **ptm, const ASN1_TIME *tm);
 int ossl_x509_print_ex_brief(BIO *bio, X509 *cert, unsigned long neg_cflags);
+int ossl_x509_name_equal(const X509_NAME *a, const X509_NAME *b);
 int ossl_x509v3_cache_extensions(X509 *x);
 int ossl_x509_init_sig_info(X509 *x);
+void ossl_x509_verified_by_free(X509 *x);
 
 int ossl_x509_set0_libctx(X509 *x, OSSL_LIB_CTX *libctx, const char *propq);
 int ossl_x509_crl_set0_libctx(X509_CRL *x, OSSL_LIB_CTX *libctx,
@@ -117,7 +117,11 @@ typedef struct ossl_ex_data_global_st {
 # define OSSL_LIB_CTX_CHILD_PROVIDER_INDEX          18
 # define OSSL_LIB_CTX_THREAD_INDEX                  19
 # define OSSL_LIB_CTX_DECODER_CACHE_INDEX           20
-# define OSSL_LIB_CTX_MAX_INDEXES                   20
+# define OSSL_LIB_CTX_RSA_BLINDING_INDEX            21
+# define OSSL_LIB_CTX_RSA_PRIME_POOL_INDEX          22
+# define OSSL_LIB_CTX_FFC_COMB_INDEX                23
+# define OSSL_LIB_CTX_BN_THREAD_CTX_INDEX           24
+# define OSSL_LIB_CTX_MAX_INDEXES                   24
 
 OSSL_LIB_CTX *ossl_lib_ctx_get_concrete(OSSL_LIB_CTX *ctx);
 int ossl_lib_ctx_is_default(OSSL_LIB_CTX *ctx);
@@ -1,5 +1,5 @@
 /*
- * Copyright 2020-2022 The OpenSSL Project Authors. All Rights Reserved.
+ * Copyright 2020-2023 The OpenSSL Project Authors. All Rights Reserved.
  *
  * Licensed under the Apache License 2.0 (the "License").  You may not use
  * this file except in compliance with the License.  You can obtain a copy
@@ -91,4 +91,25 @@ int ossl_DER_w_octet_string_uint32(WPACKET *pkt, int tag, uint32_t value);
 int ossl_DER_w_begin_sequence(WPACKET *pkt, int tag);
 int ossl_DER_w_end_sequence(WPACKET *pkt, int tag);
 
+/*
+ * The reader functions are the counterparts of the writers above.  Each one
+ * consumes a single element from |pkt|, including any explicit context tag
+ * |tag|, and only accepts DER: the low tag number form and definite lengths
+ * in their shortest encoding.  Contents are returned as PACKETs pointing into
+ * the input, so nothing is ever copied or allocated.  On failure |pkt| is left
+ * unchanged.
+ */
+int ossl_DER_r_peek_id(const PACKET *pkt, unsigned int *id);
+int ossl_DER_r_tlv(PACKET *pkt, unsigned int *id, PACKET *content);
+
+int ossl_DER_r_boolean(PACKET *pkt, int tag, int *b);
+int ossl_DER_r_uint32(PACKET *pkt, int tag, uint32_t *v);
+int ossl_DER_r_null(PACKET *pkt, int tag);
+int ossl_DER_r_octet_string(PACKET *pkt, int tag, PACKET *data);
+int ossl_DER_r_bit_string(PACKET *pkt, int tag, unsigned int *unused_bits,
+                          PACKET *data);
+int ossl_DER_r_oid(PACKET *pkt, int tag, PACKET *oid);
+int ossl_DER_r_sequence(PACKET *pkt, int tag, PACKET *content);
+int ossl_DER_r_set(PACKET *pkt, int tag, PACKET *content);
+
 #endif
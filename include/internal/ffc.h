@@ -18,6 +18,7 @@
 # include <openssl/params.h>
 # include <openssl/param_build.h>
 # include "internal/sizes.h"
+# include "crypto/bn.h"
 
 /* Default value for gindex when canonical generation of g is not used */
 # define FFC_UNVERIFIABLE_GINDEX -1
@@ -216,6 +217,9 @@ const char *ossl_ffc_named_group_get_name(const DH_NAMED_GROUP *);
 int ossl_ffc_named_group_get_keylength(const DH_NAMED_GROUP *group);
 const BIGNUM *ossl_ffc_named_group_get_q(const DH_NAMED_GROUP *group);
 int ossl_ffc_named_group_set(FFC_PARAMS *ffc, const DH_NAMED_GROUP *group);
+const BN_COMB *ossl_ffc_named_group_get_comb(OSSL_LIB_CTX *libctx,
+                                             const DH_NAMED_GROUP *group,
+                                             BN_CTX *ctx);
 #endif
 
 #endif /* OSSL_INTERNAL_FFC_H */
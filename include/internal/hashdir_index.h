@@ -0,0 +1,41 @@
+/*
+ * Copyright 2023 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+#ifndef OSSL_INTERNAL_HASHDIR_INDEX_H
+# define OSSL_INTERNAL_HASHDIR_INDEX_H
+# pragma once
+
+/*
+ * Index of a hashed certificate directory, written by "openssl rehash -index"
+ * and read by the X509_LOOKUP_hash_dir() lookup method in place of probing
+ * and parsing the individual "<hash>.N" and "<hash>.rN" files.
+ *
+ * All integers are unsigned 32-bit big endian. The file consists of:
+ *
+ *   header   magic (8 bytes), number of entries
+ *   entries  hash, type, offset, length; sorted by type and then hash
+ *   data     the DER encodings referred to by offset and length, of
+ *            certificates including any trust settings, or of CRLs
+ *
+ * The hash is the one X509_NAME_hash_ex() returns for the certificate subject
+ * or CRL issuer. An index is only used if it was modified no earlier than its
+ * directory, so any change to the directory's links makes it stale until the
+ * directory is rehashed again.
+ */
+
+# define OSSL_HASHDIR_INDEX_NAME        "openssl-rehash.idx"
+# define OSSL_HASHDIR_INDEX_MAGIC       "OSSLHDX1"
+# define OSSL_HASHDIR_INDEX_MAGIC_LEN   8
+# define OSSL_HASHDIR_INDEX_HEADER_LEN  (OSSL_HASHDIR_INDEX_MAGIC_LEN + 4)
+# define OSSL_HASHDIR_INDEX_ENTRY_LEN   16
+
+# define OSSL_HASHDIR_INDEX_TYPE_CERT   0
+# define OSSL_HASHDIR_INDEX_TYPE_CRL    1
+
+#endif
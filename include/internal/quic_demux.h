@@ -187,7 +187,8 @@ typedef int (ossl_quic_stateless_reset_cb_fn)(const unsigned char *data,
                                               size_t data_len, void *arg);
 
 /*
- * Creates a new demuxer. The given BIO is used to receive datagrams from the
+ * Creates a new demuxer. libctx is used to obtain the random key used to hash
+ * connection IDs. The given BIO is used to receive datagrams from the
  * network using BIO_recvmmsg. short_conn_id_len is the length of destination
  * connection IDs used in RX'd packets; it must have the same value for all
  * connections used on a socket. default_urxe_alloc_len is the buffer size to
@@ -198,7 +199,8 @@ typedef int (ossl_quic_stateless_reset_cb_fn)(const unsigned char *data,
  * received. now_arg is an opaque argument passed to the function. If now is
  * NULL, ossl_time_zero() is used as the datagram reception time.
  */
-QUIC_DEMUX *ossl_quic_demux_new(BIO *net_bio,
+QUIC_DEMUX *ossl_quic_demux_new(OSSL_LIB_CTX *libctx,
+                                BIO *net_bio,
                                 size_t short_conn_id_len,
                                 OSSL_TIME (*now)(void *arg),
                                 void *now_arg);
@@ -38,6 +38,43 @@
 # ifndef OPENSSL_NO_QUIC
 
 typedef struct stream_frame_st STREAM_FRAME;
+typedef struct sframe_slab_st SFRAME_SLAB;
+
+/*
+ * Stream frame pool
+ * =================
+ *
+ * A stream frame pool allocates stream frames from slabs shared by any number
+ * of stream frame lists, so that queueing a received STREAM frame does not
+ * generally require a heap allocation. Slabs are allocated as the number of
+ * frames held grows and are released again as it shrinks.
+ *
+ * A pool is not thread safe; all lists using a pool must be protected by the
+ * same lock. In the QUIC stack one pool is owned by each QUIC_CHANNEL and is
+ * used by all streams of that channel. A pool must outlive all lists using it.
+ */
+typedef struct sframe_pool_st SFRAME_POOL;
+
+typedef struct sframe_pool_stats_st {
+    /* Number of slabs currently allocated. */
+    size_t      num_slabs;
+    /* Number of frames currently handed out. */
+    size_t      num_frames_used;
+    /* Total number of slab allocations ever performed. */
+    uint64_t    num_slab_allocs;
+    /* Total number of frames ever handed out. */
+    uint64_t    num_frame_allocs;
+} SFRAME_POOL_STATS;
+
+SFRAME_POOL *ossl_sframe_pool_new(void);
+
+/*
+ * Frees the pool. All frames allocated from it must have been released first.
+ */
+void ossl_sframe_pool_free(SFRAME_POOL *pool);
+
+void ossl_sframe_pool_get_stats(const SFRAME_POOL *pool,
+                                SFRAME_POOL_STATS *stats);
 
 typedef struct sframe_list_st {
     STREAM_FRAME  *head, *tail;
@@ -51,6 +88,8 @@ typedef struct sframe_list_st {
     int head_locked;
     /* Cleanse data on release? */
     int cleanse;
+    /* Pool to allocate frames from, or NULL to use the heap directly */
+    SFRAME_POOL *pool;
 } SFRAME_LIST;
 
 /*
@@ -64,6 +103,12 @@ void ossl_sframe_list_init(SFRAME_LIST *fl);
  */
 void ossl_sframe_list_destroy(SFRAME_LIST *fl);
 
+/*
+ * Sets the pool frames are allocated from. Can only be called while the list
+ * is empty. Returns 1 on success.
+ */
+int ossl_sframe_list_set_pool(SFRAME_LIST *fl, SFRAME_POOL *pool);
+
 /*
  * Insert a stream frame data into the list.
  * The data covers an offset range (range.start is inclusive,
@@ -123,6 +168,13 @@ int ossl_sframe_list_lock_head(SFRAME_LIST *fl, UINT_RANGE *range,
  */
 int ossl_sframe_list_is_head_locked(SFRAME_LIST *fl);
 
+/*
+ * Returns the decrypted packet holding the data of the head frame locked by
+ * a previous ossl_sframe_list_lock_head() call, or NULL if the head is not
+ * locked or its data has been moved to side storage. No reference is taken.
+ */
+OSSL_QRX_PKT *ossl_sframe_list_get_head_pkt(const SFRAME_LIST *fl);
+
 /*
  * Callback function type to write stream frame data to some
  * side storage before the packet containing the frame data
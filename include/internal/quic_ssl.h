@@ -28,6 +28,9 @@ __owur int ossl_quic_accept(SSL *s);
 __owur int ossl_quic_connect(SSL *s);
 __owur int ossl_quic_read(SSL *s, void *buf, size_t len, size_t *readbytes);
 __owur int ossl_quic_peek(SSL *s, void *buf, size_t len, size_t *readbytes);
+__owur int ossl_quic_get0_read_buffer(SSL *s, const unsigned char **buf,
+                                      size_t *len);
+__owur int ossl_quic_release_read_buffer(SSL *s, size_t bytes_read);
 __owur int ossl_quic_write(SSL *s, const void *buf, size_t len, size_t *written);
 __owur long ossl_quic_ctrl(SSL *s, int cmd, long larg, void *parg);
 __owur long ossl_quic_ctx_ctrl(SSL_CTX *ctx, int cmd, long larg, void *parg);
@@ -52,7 +55,8 @@ __owur int ossl_quic_has_pending(const SSL *s);
 __owur int ossl_quic_handle_events(SSL *s);
 __owur int ossl_quic_get_event_timeout(SSL *s, struct timeval *tv,
                                        int *is_infinite);
-OSSL_TIME ossl_quic_get_event_deadline(SSL *s);
+__owur int ossl_quic_handle_events_timeout(SSL *s, struct timeval *tv,
+                                           int *is_infinite);
 __owur int ossl_quic_get_rpoll_descriptor(SSL *s, BIO_POLL_DESCRIPTOR *d);
 __owur int ossl_quic_get_wpoll_descriptor(SSL *s, BIO_POLL_DESCRIPTOR *d);
 __owur int ossl_quic_get_net_read_desired(SSL *s);
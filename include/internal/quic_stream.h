@@ -19,6 +19,7 @@
 #include "internal/quic_record_rx.h"
 #include "internal/quic_fc.h"
 #include "internal/quic_statm.h"
+#include "internal/quic_sf_list.h"
 
 # ifndef OPENSSL_NO_QUIC
 
@@ -386,6 +387,15 @@ int ossl_quic_rstream_get_record(QUIC_RSTREAM *qrs,
                                  const unsigned char **record, size_t *rec_len,
                                  int *fin);
 
+/*
+ * Returns the decrypted packet holding the data of the record returned by the
+ * previous ossl_quic_rstream_get_record() call, or NULL if there is no such
+ * record or its data is held in the internal ring buffer. No reference is
+ * taken; the caller may take one with ossl_qrx_pkt_up_ref() to keep the data
+ * valid beyond the lifetime of the rstream.
+ */
+OSSL_QRX_PKT *ossl_quic_rstream_get_record_pkt(const QUIC_RSTREAM *qrs);
+
 /*
  * Releases (possibly partially) the record returned by
  * previous ossl_quic_rstream_get_record() call.
@@ -424,6 +434,13 @@ int ossl_quic_rstream_resize_rbuf(QUIC_RSTREAM *qrs, size_t rbuf_size);
  * Sets flag to cleanse the buffered data when user reads it.
  */
 void ossl_quic_rstream_set_cleanse(QUIC_RSTREAM *qrs, int cleanse);
+
+/*
+ * Sets the pool received stream frames are allocated from. The pool must
+ * outlive the rstream. This can only be done before any data is queued.
+ * Returns 1 on success and 0 on failure.
+ */
+int ossl_quic_rstream_set_sframe_pool(QUIC_RSTREAM *qrs, SFRAME_POOL *pool);
 # endif
 
 #endif
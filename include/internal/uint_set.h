@@ -10,17 +10,16 @@
 # define OSSL_UINT_SET_H
 
 #include "openssl/params.h"
-#include "internal/list.h"
 
 /*
  * uint64_t Integer Sets
  * =====================
  *
  * Utilities for managing a logical set of unsigned 64-bit integers. The
- * structure tracks each contiguous range of integers using one allocation and
- * is thus optimised for cases where integers tend to appear consecutively.
- * Queries are optimised under the assumption that they will generally be made
- * on integers near the end of the set.
+ * structure tracks each contiguous range of integers as one element of a sorted
+ * array and is thus optimised for cases where integers tend to appear
+ * consecutively. Queries and updates locate ranges by binary search, with a
+ * fast path for operations on integers near the end of the set.
  *
  * Discussion of implementation details can be found in uint_set.c.
  */
@@ -28,24 +27,20 @@ typedef struct uint_range_st {
     uint64_t    start, end;
 } UINT_RANGE;
 
-typedef struct uint_set_item_st UINT_SET_ITEM;
-struct uint_set_item_st {
-    OSSL_LIST_MEMBER(uint_set, UINT_SET_ITEM);
-    UINT_RANGE                  range;
-};
-
-DEFINE_LIST_OF(uint_set, UINT_SET_ITEM);
-
-typedef OSSL_LIST(uint_set) UINT_SET;
+typedef struct uint_set_st {
+    /* Disjoint, non-adjacent ranges in ascending order. */
+    UINT_RANGE  *ranges;
+    size_t      num_ranges, alloc_ranges;
+} UINT_SET;
 
 void ossl_uint_set_init(UINT_SET *s);
 void ossl_uint_set_destroy(UINT_SET *s);
 
 /*
  * Insert a range into a integer set. Returns 0 on allocation failure, in which
- * case the integer set is in a valid but undefined state. Otherwise, returns 1.
- * Ranges can overlap existing ranges without limitation. If a range is a subset
- * of an existing range in the set, this is a no-op and returns 1.
+ * case the integer set is unchanged. Otherwise, returns 1. Ranges can overlap
+ * existing ranges without limitation. If a range is a subset of an existing
+ * range in the set, this is a no-op and returns 1.
  */
 int ossl_uint_set_insert(UINT_SET *s, const UINT_RANGE *range);
 
@@ -60,4 +55,24 @@ int ossl_uint_set_remove(UINT_SET *s, const UINT_RANGE *range);
 /* Returns 1 iff the given integer is in the integer set. */
 int ossl_uint_set_query(const UINT_SET *s, uint64_t v);
 
+/*
+ * Returns the number of ranges in the set. Ranges in the set never overlap or
+ * border one another, so a set covering a single contiguous run of integers
+ * always has exactly one range.
+ */
+static ossl_unused ossl_inline size_t ossl_uint_set_num_ranges(const UINT_SET *s)
+{
+    return s->num_ranges;
+}
+
+/*
+ * Returns the range at index i, where ranges are indexed in ascending order, or
+ * NULL if i is out of bounds.
+ */
+static ossl_unused ossl_inline const UINT_RANGE *
+ossl_uint_set_get_range(const UINT_SET *s, size_t i)
+{
+    return i < s->num_ranges ? &s->ranges[i] : NULL;
+}
+
 #endif
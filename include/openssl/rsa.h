@@ -170,6 +170,12 @@ int EVP_PKEY_CTX_get_rsa_oaep_md_name(EVP_PKEY_CTX *ctx, char *name,
 int EVP_PKEY_CTX_set0_rsa_oaep_label(EVP_PKEY_CTX *ctx, void *label, int llen);
 int EVP_PKEY_CTX_get0_rsa_oaep_label(EVP_PKEY_CTX *ctx, unsigned char **label);
 
+int OSSL_RSA_prime_pool_start(OSSL_LIB_CTX *libctx, int bits, const BIGNUM *e,
+                              size_t size, size_t threads);
+int OSSL_RSA_prime_pool_stop(OSSL_LIB_CTX *libctx);
+int OSSL_RSA_prime_pool_get_stats(OSSL_LIB_CTX *libctx, size_t *num,
+                                  uint64_t *hits, uint64_t *misses);
+
 # define EVP_PKEY_CTRL_RSA_PADDING       (EVP_PKEY_ALG_CTRL + 1)
 # define EVP_PKEY_CTRL_RSA_PSS_SALTLEN   (EVP_PKEY_ALG_CTRL + 2)
 
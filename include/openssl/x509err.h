@@ -25,15 +25,18 @@
 # define X509_R_BAD_SELECTOR                              133
 # define X509_R_BAD_X509_FILETYPE                         100
 # define X509_R_BASE64_DECODE_ERROR                       118
+# define X509_R_BASE_CRL_TOO_OLD                          146
 # define X509_R_CANT_CHECK_DH_KEY                         114
 # define X509_R_CERTIFICATE_VERIFICATION_FAILED           139
 # define X509_R_CERT_ALREADY_IN_HASH_TABLE                101
 # define X509_R_CRL_ALREADY_DELTA                         127
+# define X509_R_CRL_NOT_DELTA                             145
 # define X509_R_CRL_VERIFY_FAILURE                        131
 # define X509_R_DUPLICATE_ATTRIBUTE                       140
 # define X509_R_ERROR_GETTING_MD_BY_NID                   141
 # define X509_R_ERROR_USING_SIGINF_SET                    142
 # define X509_R_IDP_MISMATCH                              128
+# define X509_R_INDIRECT_CRL_NOT_SUPPORTED                147
 # define X509_R_INVALID_ATTRIBUTES                        138
 # define X509_R_INVALID_DIRECTORY                         113
 # define X509_R_INVALID_DISTPOINT                         143
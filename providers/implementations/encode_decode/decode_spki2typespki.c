@@ -13,7 +13,9 @@
 #include <openssl/core_object.h>
 #include <openssl/params.h>
 #include <openssl/x509.h>
+#include "internal/der.h"
 #include "internal/sizes.h"
+#include "crypto/asn1.h"
 #include "crypto/x509.h"
 #include "crypto/ec.h"
 #include "prov/bio.h"
@@ -73,6 +75,59 @@ static int spki2typespki_set_ctx_params(void *vctx, const OSSL_PARAM params[])
     return 1;
 }
 
+/*
+ * Finds the algorithm name of a DER encoded SubjectPublicKeyInfo by reading
+ * it in place, without decoding it into an X509_PUBKEY.  Returns 1 on success
+ * and 0 if |der| needs the full decoder to tell, for example because it isn't
+ * strictly DER or has explicit EC parameters.
+ */
+static int spki_peek_type(const unsigned char *der, long len,
+                          char *dataname, size_t dataname_sz)
+{
+    PACKET pkt, spki, algor, oid, params, value, key;
+    ASN1_OBJECT obj = { 0 };
+    unsigned int unused_bits, id;
+
+    if (len <= 0
+            || !PACKET_buf_init(&pkt, der, (size_t)len)
+            || !ossl_DER_r_sequence(&pkt, DER_NO_CONTEXT, &spki)
+            || !ossl_DER_r_sequence(&spki, DER_NO_CONTEXT, &algor)
+            || !ossl_DER_r_oid(&algor, DER_NO_CONTEXT, &oid)
+            || PACKET_remaining(&oid) > INT_MAX
+            || !ossl_DER_r_bit_string(&spki, DER_NO_CONTEXT, &unused_bits,
+                                      &key)
+            || PACKET_remaining(&spki) != 0)
+        return 0;
+
+    /* The parameters are a single optional element of any type */
+    params = algor;
+    if (PACKET_remaining(&algor) != 0
+            && (!ossl_DER_r_tlv(&algor, &id, &value)
+                || PACKET_remaining(&algor) != 0))
+        return 0;
+
+    obj.data = PACKET_data(&oid);
+    obj.length = (int)PACKET_remaining(&oid);
+
+#ifndef OPENSSL_NO_EC
+    /* SM2 abuses the EC oid, so this could actually be SM2 */
+    if (OBJ_obj2nid(&obj) == NID_X9_62_id_ecPublicKey
+            && PACKET_remaining(&params) != 0) {
+        ASN1_OBJECT curve = { 0 };
+
+        if (!ossl_DER_r_oid(&params, DER_NO_CONTEXT, &oid))
+            return 0;
+        curve.data = PACKET_data(&oid);
+        curve.length = (int)PACKET_remaining(&oid);
+        if (OBJ_obj2nid(&curve) == NID_sm2) {
+            strcpy(dataname, "SM2");
+            return 1;
+        }
+    }
+#endif
+    return OBJ_obj2txt(dataname, dataname_sz, &obj, 0) > 0;
+}
+
 static int spki2typespki_decode(void *vctx, OSSL_CORE_BIO *cin, int selection,
                                 OSSL_CALLBACK *data_cb, void *data_cbarg,
                                 OSSL_PASSPHRASE_CALLBACK *pw_cb, void *pw_cbarg)
@@ -90,33 +145,37 @@ static int spki2typespki_decode(void *vctx, OSSL_CORE_BIO *cin, int selection,
 
     if (!ossl_read_der(ctx->provctx, cin, &der, &len))
         return 1;
-    derp = der;
-    xpub = ossl_d2i_X509_PUBKEY_INTERNAL((const unsigned char **)&derp, len,
-                                         PROV_LIBCTX_OF(ctx->provctx),
-                                         ctx->propq);
-
-    if (xpub == NULL) {
-        /* We return "empty handed".  This is not an error. */
-        ok = 1;
-        goto end;
-    }
 
-    if (!X509_PUBKEY_get0_param(NULL, NULL, NULL, &algor, xpub))
-        goto end;
-    X509_ALGOR_get0(&oid, NULL, NULL, algor);
+    if (!spki_peek_type(der, len, dataname, sizeof(dataname))) {
+        derp = der;
+        xpub = ossl_d2i_X509_PUBKEY_INTERNAL((const unsigned char **)&derp,
+                                             len,
+                                             PROV_LIBCTX_OF(ctx->provctx),
+                                             ctx->propq);
+
+        if (xpub == NULL) {
+            /* We return "empty handed".  This is not an error. */
+            ok = 1;
+            goto end;
+        }
+
+        if (!X509_PUBKEY_get0_param(NULL, NULL, NULL, &algor, xpub))
+            goto end;
+        X509_ALGOR_get0(&oid, NULL, NULL, algor);
 
 #ifndef OPENSSL_NO_EC
-    /* SM2 abuses the EC oid, so this could actually be SM2 */
-    if (OBJ_obj2nid(oid) == NID_X9_62_id_ecPublicKey
-            && ossl_x509_algor_is_sm2(algor))
-        strcpy(dataname, "SM2");
-    else
+        /* SM2 abuses the EC oid, so this could actually be SM2 */
+        if (OBJ_obj2nid(oid) == NID_X9_62_id_ecPublicKey
+                && ossl_x509_algor_is_sm2(algor))
+            strcpy(dataname, "SM2");
+        else
 #endif
-    if (OBJ_obj2txt(dataname, sizeof(dataname), oid, 0) <= 0)
-        goto end;
+        if (OBJ_obj2txt(dataname, sizeof(dataname), oid, 0) <= 0)
+            goto end;
 
-    ossl_X509_PUBKEY_INTERNAL_free(xpub);
-    xpub = NULL;
+        ossl_X509_PUBKEY_INTERNAL_free(xpub);
+        xpub = NULL;
+    }
 
     *p++ =
         OSSL_PARAM_construct_utf8_string(OSSL_OBJECT_PARAM_DATA_TYPE,
@@ -27,18 +27,37 @@ DEFINE_LIST_OF(tx_history, OSSL_ACKM_TX_PKT);
  * numbers of the packets appended to the list must monotonically increase), as
  * we should not currently need more general functionality such as a sorted list
  * insert.
+ *
+ * Since packet numbers are allocated sequentially and packets leave the history
+ * soon after they are sent (once ACKed or declared lost), the packets in the
+ * history always occupy a fairly narrow window of the packet number space.
+ * Lookup by packet number is therefore done using a ring buffer of pointers
+ * indexed by the low bits of the packet number, which avoids the per-packet
+ * allocation and hashing cost of a hash table. The ring is grown (and
+ * repopulated from the list) if the window of outstanding packet numbers
+ * becomes wider than the ring.
  */
+#define TX_HISTORY_MIN_RING_CAP     64
+
 struct tx_pkt_history_st {
     /* A linked list of all our packets. */
     OSSL_LIST(tx_history) packets;
 
     /*
-     * Mapping from packet numbers (uint64_t) to (OSSL_ACKM_TX_PKT *)
+     * Mapping from packet numbers to (OSSL_ACKM_TX_PKT *). The packet with
+     * packet number pn is found in ring[pn & (ring_cap - 1)]. ring_cap is zero
+     * or a power of two.
      *
-     * Invariant: A packet is in this map if and only if it is in the linked
+     * Invariant: A packet is in this ring if and only if it is in the linked
      *            list.
+     *
+     * Invariant: Every packet in the list has a packet number in the range
+     *            [ring_base, ring_base + ring_cap). ring_base is the packet
+     *            number of the packet at the head of the list, if any.
      */
-    LHASH_OF(OSSL_ACKM_TX_PKT) *map;
+    OSSL_ACKM_TX_PKT **ring;
+    size_t ring_cap;
+    uint64_t ring_base;
 
     /*
      * The lowest packet number which may currently be added to the history list
@@ -56,58 +75,81 @@ struct tx_pkt_history_st {
     uint64_t highest_sent;
 };
 
-DEFINE_LHASH_OF_EX(OSSL_ACKM_TX_PKT);
-
-static unsigned long tx_pkt_info_hash(const OSSL_ACKM_TX_PKT *pkt)
+static int
+tx_pkt_history_init(struct tx_pkt_history_st *h)
 {
-    /* Using low bits of the packet number as the hash should be enough */
-    return (unsigned long)pkt->pkt_num;
+    ossl_list_tx_history_init(&h->packets);
+    h->watermark    = 0;
+    h->highest_sent = 0;
+    h->ring         = NULL;
+    h->ring_cap     = 0;
+    h->ring_base    = 0;
+    return 1;
 }
 
-static int tx_pkt_info_compare(const OSSL_ACKM_TX_PKT *a,
-                               const OSSL_ACKM_TX_PKT *b)
+static void
+tx_pkt_history_destroy(struct tx_pkt_history_st *h)
 {
-    if (a->pkt_num < b->pkt_num)
-        return -1;
-    if (a->pkt_num > b->pkt_num)
-        return 1;
-    return 0;
+    OPENSSL_free(h->ring);
+    h->ring     = NULL;
+    h->ring_cap = 0;
+    ossl_list_tx_history_init(&h->packets);
 }
 
+/*
+ * Grow the ring until it can hold packet number pkt_num, repopulating it from
+ * the list.
+ */
 static int
-tx_pkt_history_init(struct tx_pkt_history_st *h)
+tx_pkt_history_grow_ring(struct tx_pkt_history_st *h, uint64_t pkt_num)
 {
-    ossl_list_tx_history_init(&h->packets);
-    h->watermark    = 0;
-    h->highest_sent = 0;
+    OSSL_ACKM_TX_PKT **ring, *pkt;
+    size_t cap = h->ring_cap == 0 ? TX_HISTORY_MIN_RING_CAP : h->ring_cap;
+
+    while (pkt_num - h->ring_base >= cap) {
+        if (cap > SIZE_MAX / (2 * sizeof(*ring)))
+            return 0;
 
-    h->map = lh_OSSL_ACKM_TX_PKT_new(tx_pkt_info_hash, tx_pkt_info_compare);
-    if (h->map == NULL)
+        cap *= 2;
+    }
+
+    ring = OPENSSL_zalloc(cap * sizeof(*ring));
+    if (ring == NULL)
         return 0;
 
+    for (pkt = ossl_list_tx_history_head(&h->packets);
+         pkt != NULL;
+         pkt = ossl_list_tx_history_next(pkt))
+        ring[pkt->pkt_num & (cap - 1)] = pkt;
+
+    OPENSSL_free(h->ring);
+    h->ring     = ring;
+    h->ring_cap = cap;
     return 1;
 }
 
-static void
-tx_pkt_history_destroy(struct tx_pkt_history_st *h)
+/* Retrieve a packet information structure by packet number. */
+static OSSL_ACKM_TX_PKT *
+tx_pkt_history_by_pkt_num(struct tx_pkt_history_st *h, uint64_t pkt_num)
 {
-    lh_OSSL_ACKM_TX_PKT_free(h->map);
-    h->map = NULL;
-    ossl_list_tx_history_init(&h->packets);
+    OSSL_ACKM_TX_PKT *pkt;
+
+    if (pkt_num < h->ring_base || pkt_num - h->ring_base >= h->ring_cap)
+        return NULL;
+
+    pkt = h->ring[pkt_num & (h->ring_cap - 1)];
+    return pkt != NULL && pkt->pkt_num == pkt_num ? pkt : NULL;
 }
 
 static int
 tx_pkt_history_add_actual(struct tx_pkt_history_st *h,
                           OSSL_ACKM_TX_PKT *pkt)
 {
-    OSSL_ACKM_TX_PKT *existing;
-
     /*
      * There should not be any existing packet with this number
      * in our mapping.
      */
-    existing = lh_OSSL_ACKM_TX_PKT_retrieve(h->map, pkt);
-    if (!ossl_assert(existing == NULL))
+    if (!ossl_assert(tx_pkt_history_by_pkt_num(h, pkt->pkt_num) == NULL))
         return 0;
 
     /* Should not already be in a list. */
@@ -115,7 +157,14 @@ tx_pkt_history_add_actual(struct tx_pkt_history_st *h,
             && ossl_list_tx_history_prev(pkt) == NULL))
         return 0;
 
-    lh_OSSL_ACKM_TX_PKT_insert(h->map, pkt);
+    if (ossl_list_tx_history_is_empty(&h->packets))
+        h->ring_base = pkt->pkt_num;
+
+    if (pkt->pkt_num - h->ring_base >= h->ring_cap
+        && !tx_pkt_history_grow_ring(h, pkt->pkt_num))
+        return 0;
+
+    h->ring[pkt->pkt_num & (h->ring_cap - 1)] = pkt;
 
     ossl_list_tx_history_insert_tail(&h->packets, pkt);
     return 1;
@@ -137,30 +186,25 @@ tx_pkt_history_add(struct tx_pkt_history_st *h,
     return 1;
 }
 
-/* Retrieve a packet information structure by packet number. */
-static OSSL_ACKM_TX_PKT *
-tx_pkt_history_by_pkt_num(struct tx_pkt_history_st *h, uint64_t pkt_num)
-{
-    OSSL_ACKM_TX_PKT key;
-
-    key.pkt_num = pkt_num;
-
-    return lh_OSSL_ACKM_TX_PKT_retrieve(h->map, &key);
-}
-
 /* Remove a packet information structure from the history log. */
 static int
 tx_pkt_history_remove(struct tx_pkt_history_st *h, uint64_t pkt_num)
 {
-    OSSL_ACKM_TX_PKT key, *pkt;
-    key.pkt_num = pkt_num;
+    OSSL_ACKM_TX_PKT *pkt, *head;
 
     pkt = tx_pkt_history_by_pkt_num(h, pkt_num);
     if (pkt == NULL)
         return 0;
 
     ossl_list_tx_history_remove(&h->packets, pkt);
-    lh_OSSL_ACKM_TX_PKT_delete(h->map, &key);
+    h->ring[pkt_num & (h->ring_cap - 1)] = NULL;
+
+    /* Slide the window forward if we removed the lowest packet. */
+    if (pkt_num == h->ring_base) {
+        head = ossl_list_tx_history_head(&h->packets);
+        h->ring_base = head != NULL ? head->pkt_num : h->watermark;
+    }
+
     return 1;
 }
 
@@ -418,23 +462,27 @@ static void rx_pkt_history_destroy(struct rx_pkt_history_st *h)
 
 static void rx_pkt_history_trim_range_count(struct rx_pkt_history_st *h)
 {
-    QUIC_PN highest = QUIC_PN_INVALID;
+    size_t num_ranges = ossl_uint_set_num_ranges(&h->set);
+    UINT_RANGE r;
 
-    while (ossl_list_uint_set_num(&h->set) > MAX_RX_ACK_RANGES) {
-        UINT_RANGE r = ossl_list_uint_set_head(&h->set)->range;
+    if (num_ranges <= MAX_RX_ACK_RANGES)
+        return;
 
-        highest = (highest == QUIC_PN_INVALID)
-            ? r.end : ossl_quic_pn_max(highest, r.end);
+    /*
+     * The excess ranges are the lowest ones, so remove them all at once by
+     * removing the span from the start of the first to the end of the last.
+     */
+    r.start = ossl_uint_set_get_range(&h->set, 0)->start;
+    r.end   = ossl_uint_set_get_range(&h->set,
+                                      num_ranges - MAX_RX_ACK_RANGES - 1)->end;
 
-        ossl_uint_set_remove(&h->set, &r);
-    }
+    ossl_uint_set_remove(&h->set, &r);
 
     /*
      * Bump watermark to cover all PNs we removed to avoid accidental
      * reprocessing of packets.
      */
-    if (highest != QUIC_PN_INVALID)
-        rx_pkt_history_bump_watermark(h, highest + 1);
+    rx_pkt_history_bump_watermark(h, r.end + 1);
 }
 
 static int rx_pkt_history_add_pn(struct rx_pkt_history_st *h,
@@ -671,8 +719,9 @@ static OSSL_ACKM_TX_PKT *ackm_detect_and_remove_newly_acked_pkts(OSSL_ACKM *ackm
                                                                  int pkt_space)
 {
     OSSL_ACKM_TX_PKT *acked_pkts = NULL, **fixup = &acked_pkts, *pkt, *pprev;
+    const OSSL_QUIC_ACK_RANGE *range;
     struct tx_pkt_history_st *h;
-    size_t ridx = 0;
+    size_t ridx;
 
     assert(ack->num_ack_ranges > 0);
 
@@ -682,58 +731,47 @@ static OSSL_ACKM_TX_PKT *ackm_detect_and_remove_newly_acked_pkts(OSSL_ACKM *ackm
      *
      * ack->ack_ranges is a list of packet number ranges in descending order.
      *
-     * Walk through our history list from the end in order to efficiently detect
-     * membership in the specified ack ranges. As an optimization, we use our
-     * hashtable to try and skip to the first matching packet. This may fail if
-     * the ACK ranges given include nonexistent packets.
+     * Walk through our history list from the end, keeping a cursor which only
+     * ever moves backwards, and process each range in turn. Where the cursor is
+     * above a range, we use our ring to skip directly to the highest packet in
+     * the range; this may fail if the end of the range is a packet which does
+     * not exist (e.g. because it has already been acknowledged), in which case
+     * we step the cursor back over the unacknowledged packets in between. Each
+     * packet is thus visited at most once and the cost of processing an ACK
+     * frame is bounded by the number of ranges and packets acknowledged rather
+     * than by the span of packet numbers it covers.
      */
     h = get_tx_history(ackm, pkt_space);
+    pkt = ossl_list_tx_history_tail(&h->packets);
 
-    pkt = tx_pkt_history_by_pkt_num(h, ack->ack_ranges[0].end);
-    if (pkt == NULL)
-        pkt = ossl_list_tx_history_tail(&h->packets);
+    for (ridx = 0; ridx < ack->num_ack_ranges && pkt != NULL; ++ridx) {
+        range = &ack->ack_ranges[ridx];
 
-    for (; pkt != NULL; pkt = pprev) {
-        /*
-         * Save prev value as it will be zeroed if we remove the packet from the
-         * history list below.
-         */
-        pprev = ossl_list_tx_history_prev(pkt);
+        if (pkt->pkt_num > range->end) {
+            pprev = tx_pkt_history_by_pkt_num(h, range->end);
+            if (pprev != NULL)
+                pkt = pprev;
+            else
+                while (pkt != NULL && pkt->pkt_num > range->end)
+                    pkt = ossl_list_tx_history_prev(pkt);
+        }
 
-        for (;; ++ridx) {
-            if (ridx >= ack->num_ack_ranges) {
-                /*
-                 * We have exhausted all ranges so stop here, even if there are
-                 * more packets to look at.
-                 */
-                goto stop;
-            }
+        while (pkt != NULL && pkt->pkt_num >= range->start) {
+            /*
+             * Save prev value as it will be zeroed when we remove the packet
+             * from the history list below.
+             */
+            pprev = ossl_list_tx_history_prev(pkt);
 
-            if (range_contains(&ack->ack_ranges[ridx], pkt->pkt_num)) {
-                /* We have matched this range. */
-                tx_pkt_history_remove(h, pkt->pkt_num);
+            tx_pkt_history_remove(h, pkt->pkt_num);
 
-                *fixup = pkt;
-                fixup = &pkt->anext;
-                *fixup = NULL;
-                break;
-            } else if (pkt->pkt_num > ack->ack_ranges[ridx].end) {
-                /*
-                 * We have not reached this range yet in our list, so do not
-                 * advance ridx.
-                 */
-                break;
-            } else {
-                /*
-                 * We have moved beyond this range, so advance to the next range
-                 * and try matching again.
-                 */
-                assert(pkt->pkt_num < ack->ack_ranges[ridx].start);
-                continue;
-            }
+            *fixup = pkt;
+            fixup = &pkt->anext;
+            *fixup = NULL;
+
+            pkt = pprev;
         }
     }
-stop:
 
     return acked_pkts;
 }
@@ -1420,12 +1458,17 @@ static int ackm_is_missing(OSSL_ACKM *ackm, int pkt_space, QUIC_PN pkt_num)
 static int ackm_has_newly_missing(OSSL_ACKM *ackm, int pkt_space)
 {
     struct rx_pkt_history_st *h;
+    const UINT_RANGE *tail;
+    size_t num_ranges;
 
     h = get_rx_history(ackm, pkt_space);
+    num_ranges = ossl_uint_set_num_ranges(&h->set);
 
-    if (ossl_list_uint_set_is_empty(&h->set))
+    if (num_ranges == 0)
         return 0;
 
+    tail = ossl_uint_set_get_range(&h->set, num_ranges - 1);
+
     /*
      * The second condition here establishes that the highest PN range in our RX
      * history comprises only a single PN. If there is more than one, then this
@@ -1439,10 +1482,8 @@ static int ackm_has_newly_missing(OSSL_ACKM *ackm, int pkt_space)
      * the PNs we have ACK'd previously and the PN we have just received.
      */
     return ackm->ack[pkt_space].num_ack_ranges > 0
-        && ossl_list_uint_set_tail(&h->set)->range.start
-           == ossl_list_uint_set_tail(&h->set)->range.end
-        && ossl_list_uint_set_tail(&h->set)->range.start
-            > ackm->ack[pkt_space].ack_ranges[0].end + 1;
+        && tail->start == tail->end
+        && tail->start > ackm->ack[pkt_space].ack_ranges[0].end + 1;
 }
 
 static void ackm_set_flush_deadline(OSSL_ACKM *ackm, int pkt_space,
@@ -1594,18 +1635,18 @@ static void ackm_fill_rx_ack_ranges(OSSL_ACKM *ackm, int pkt_space,
                                     OSSL_QUIC_FRAME_ACK *ack)
 {
     struct rx_pkt_history_st *h = get_rx_history(ackm, pkt_space);
-    UINT_SET_ITEM *x;
-    size_t i = 0;
+    const UINT_RANGE *x;
+    size_t i, num_ranges = ossl_uint_set_num_ranges(&h->set);
 
     /*
      * Copy out ranges from the PN set, starting at the end, until we reach our
      * maximum number of ranges.
      */
-    for (x = ossl_list_uint_set_tail(&h->set);
-         x != NULL && i < OSSL_NELEM(ackm->ack_ranges);
-         x = ossl_list_uint_set_prev(x), ++i) {
-        ackm->ack_ranges[pkt_space][i].start = x->range.start;
-        ackm->ack_ranges[pkt_space][i].end   = x->range.end;
+    for (i = 0; i < num_ranges && i < OSSL_NELEM(ackm->ack_ranges[pkt_space]);
+         ++i) {
+        x = ossl_uint_set_get_range(&h->set, num_ranges - 1 - i);
+        ackm->ack_ranges[pkt_space][i].start = x->start;
+        ackm->ack_ranges[pkt_space][i].end   = x->end;
     }
 
     ack->ack_ranges     = ackm->ack_ranges[pkt_space];
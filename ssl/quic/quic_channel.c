@@ -389,7 +389,7 @@ static int ch_init(QUIC_CHANNEL *ch)
 
     ossl_quic_tx_packetiser_set_ack_tx_cb(ch->txp, ch_on_txp_ack_tx, ch);
 
-    if ((ch->demux = ossl_quic_demux_new(/*BIO=*/NULL,
+    if ((ch->demux = ossl_quic_demux_new(ch->libctx, /*BIO=*/NULL,
                                          /*Short CID Len=*/rx_short_cid_len,
                                          get_time, ch)) == NULL)
         goto err;
@@ -432,9 +432,14 @@ static int ch_init(QUIC_CHANNEL *ch)
     if (!ch->is_server && !ossl_qrx_add_dst_conn_id(ch->qrx, &txp_args.cur_scid))
         goto err;
 
+    if ((ch->sframe_pool = ossl_sframe_pool_new()) == NULL)
+        goto err;
+
     for (pn_space = QUIC_PN_SPACE_INITIAL; pn_space < QUIC_PN_SPACE_NUM; ++pn_space) {
         ch->crypto_recv[pn_space] = ossl_quic_rstream_new(NULL, NULL, 0);
-        if (ch->crypto_recv[pn_space] == NULL)
+        if (ch->crypto_recv[pn_space] == NULL
+            || !ossl_quic_rstream_set_sframe_pool(ch->crypto_recv[pn_space],
+                                                  ch->sframe_pool))
             goto err;
     }
 
@@ -518,6 +523,9 @@ static void ch_cleanup(QUIC_CHANNEL *ch)
         ossl_quic_rstream_free(ch->crypto_recv[pn_space]);
     }
 
+    /* Must come after all rstreams using it have been freed. */
+    ossl_sframe_pool_free(ch->sframe_pool);
+
     ossl_qrx_pkt_release(ch->qrx_pkt);
     ch->qrx_pkt = NULL;
 
@@ -3550,10 +3558,14 @@ static int ch_init_new_stream(QUIC_CHANNEL *ch, QUIC_STREAM *qs,
         if ((qs->sstream = ossl_quic_sstream_new(INIT_APP_BUF_LEN)) == NULL)
             goto err;
 
-    if (can_recv)
+    if (can_recv) {
         if ((qs->rstream = ossl_quic_rstream_new(NULL, NULL, 0)) == NULL)
             goto err;
 
+        if (!ossl_quic_rstream_set_sframe_pool(qs->rstream, ch->sframe_pool))
+            goto err;
+    }
+
     /* TXFC */
     if (!ossl_quic_txfc_init(&qs->txfc, &ch->conn_txfc))
         goto err;
@@ -120,6 +120,13 @@ struct quic_channel_st {
     QUIC_SSTREAM                    *crypto_send[QUIC_PN_SPACE_NUM];
     QUIC_RSTREAM                    *crypto_recv[QUIC_PN_SPACE_NUM];
 
+    /*
+     * Pool from which the receive parts of all streams of this channel,
+     * including the crypto streams, allocate their stream frames. Must be
+     * freed after all of those streams.
+     */
+    SFRAME_POOL                     *sframe_pool;
+
     /* Internal state. */
     /*
      * Client: The DCID used in the first Initial packet we transmit as a client.
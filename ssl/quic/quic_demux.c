@@ -10,7 +10,8 @@
 #include "internal/quic_demux.h"
 #include "internal/quic_wire_pkt.h"
 #include "internal/common.h"
-#include <openssl/lhash.h>
+#include "crypto/siphash.h"
+#include <openssl/rand.h>
 #include <openssl/err.h>
 
 #define URXE_DEMUX_STATE_FREE       0 /* on urx_free list */
@@ -21,36 +22,39 @@
 
 #define DEMUX_DEFAULT_MTU        1500
 
-/* Structure used to track a given connection ID. */
-typedef struct quic_demux_conn_st QUIC_DEMUX_CONN;
+/*
+ * Connection ID Table
+ * ===================
+ *
+ * Registered connection IDs are kept in an open-addressed hash table using
+ * linear probing. Each slot holds the connection ID inline together with its
+ * handler, so a lookup scans a short contiguous run of slots and registration
+ * does not require a per-entry allocation. Entries are removed by shifting
+ * later entries of the same probe run back rather than by leaving tombstones,
+ * so probe runs do not grow as connection IDs are retired and replaced.
+ *
+ * The initial connection IDs registered by a server are chosen by the peer, so
+ * slots are selected using SipHash under a random per-demuxer key to prevent
+ * an attacker from deliberately creating long probe runs. Lookups never modify
+ * the table.
+ */
+#define DEMUX_CID_MIN_SLOTS     16
 
-struct quic_demux_conn_st {
-    QUIC_DEMUX_CONN                 *next; /* used when unregistering only */
-    QUIC_CONN_ID                    dst_conn_id;
+/*
+ * SipHash-1-3 provides adequate protection against hash flooding for table
+ * indexing and is markedly cheaper than SipHash-2-4 on short inputs.
+ */
+#define DEMUX_CID_HASH_C_ROUNDS 1
+#define DEMUX_CID_HASH_D_ROUNDS 3
+
+typedef struct demux_cid_slot_st {
+    /* Hash of dst_conn_id, kept so that resizing does not need to rehash. */
+    uint64_t                        hash;
+    /* The handler for this connection ID, or NULL if the slot is empty. */
     ossl_quic_demux_cb_fn           *cb;
     void                            *cb_arg;
-};
-
-DEFINE_LHASH_OF_EX(QUIC_DEMUX_CONN);
-
-static unsigned long demux_conn_hash(const QUIC_DEMUX_CONN *conn)
-{
-    size_t i;
-    unsigned long v = 0;
-
-    assert(conn->dst_conn_id.id_len <= QUIC_MAX_CONN_ID_LEN);
-
-    for (i = 0; i < conn->dst_conn_id.id_len; ++i)
-        v ^= ((unsigned long)conn->dst_conn_id.id[i])
-             << ((i * 8) % (sizeof(unsigned long) * 8));
-
-    return v;
-}
-
-static int demux_conn_cmp(const QUIC_DEMUX_CONN *a, const QUIC_DEMUX_CONN *b)
-{
-    return !ossl_quic_conn_id_eq(&a->dst_conn_id, &b->dst_conn_id);
-}
+    QUIC_CONN_ID                    dst_conn_id;
+} DEMUX_CID_SLOT;
 
 struct quic_demux_st {
     /* The underlying transport BIO with datagram semantics. */
@@ -73,8 +77,16 @@ struct quic_demux_st {
     OSSL_TIME                 (*now)(void *arg);
     void                       *now_arg;
 
-    /* Hashtable mapping connection IDs to QUIC_DEMUX_CONN structures. */
-    LHASH_OF(QUIC_DEMUX_CONN)  *conns_by_id;
+    /*
+     * Table mapping connection IDs to handlers. The number of slots is always
+     * a power of two and cid_mask is one less than it.
+     */
+    DEMUX_CID_SLOT             *cid_slots;
+    size_t                      cid_mask;
+    size_t                      num_cids;
+
+    /* Keyed hash state used to hash connection IDs, cloned for each use. */
+    SIPHASH                     cid_hash;
 
     /* The default packet handler, if any. */
     ossl_quic_demux_cb_fn      *default_cb;
@@ -103,12 +115,14 @@ struct quic_demux_st {
     char                        use_local_addr;
 };
 
-QUIC_DEMUX *ossl_quic_demux_new(BIO *net_bio,
+QUIC_DEMUX *ossl_quic_demux_new(OSSL_LIB_CTX *libctx,
+                                BIO *net_bio,
                                 size_t short_conn_id_len,
                                 OSSL_TIME (*now)(void *arg),
                                 void *now_arg)
 {
     QUIC_DEMUX *demux;
+    unsigned char key[SIPHASH_KEY_SIZE];
 
     demux = OPENSSL_zalloc(sizeof(QUIC_DEMUX));
     if (demux == NULL)
@@ -121,13 +135,27 @@ QUIC_DEMUX *ossl_quic_demux_new(BIO *net_bio,
     demux->now                      = now;
     demux->now_arg                  = now_arg;
 
-    demux->conns_by_id
-        = lh_QUIC_DEMUX_CONN_new(demux_conn_hash, demux_conn_cmp);
-    if (demux->conns_by_id == NULL) {
+    demux->cid_slots = OPENSSL_zalloc(DEMUX_CID_MIN_SLOTS
+                                      * sizeof(DEMUX_CID_SLOT));
+    if (demux->cid_slots == NULL) {
         OPENSSL_free(demux);
         return NULL;
     }
 
+    demux->cid_mask = DEMUX_CID_MIN_SLOTS - 1;
+
+    if (RAND_bytes_ex(libctx, key, sizeof(key), sizeof(key) * 8) != 1
+        || !SipHash_set_hash_size(&demux->cid_hash, SIPHASH_MIN_DIGEST_SIZE)
+        || !SipHash_Init(&demux->cid_hash, key, DEMUX_CID_HASH_C_ROUNDS,
+                         DEMUX_CID_HASH_D_ROUNDS)) {
+        OPENSSL_cleanse(key, sizeof(key));
+        OPENSSL_free(demux->cid_slots);
+        OPENSSL_free(demux);
+        return NULL;
+    }
+
+    OPENSSL_cleanse(key, sizeof(key));
+
     if (net_bio != NULL
         && BIO_dgram_get_local_addr_cap(net_bio)
         && BIO_dgram_set_local_addr_enable(net_bio, 1))
@@ -136,11 +164,6 @@ QUIC_DEMUX *ossl_quic_demux_new(BIO *net_bio,
     return demux;
 }
 
-static void demux_free_conn_it(QUIC_DEMUX_CONN *conn, void *arg)
-{
-    OPENSSL_free(conn);
-}
-
 static void demux_free_urxl(QUIC_URXE_LIST *l)
 {
     QUIC_URXE *e, *enext;
@@ -157,9 +180,9 @@ void ossl_quic_demux_free(QUIC_DEMUX *demux)
     if (demux == NULL)
         return;
 
-    /* Free all connection structures. */
-    lh_QUIC_DEMUX_CONN_doall_arg(demux->conns_by_id, demux_free_conn_it, NULL);
-    lh_QUIC_DEMUX_CONN_free(demux->conns_by_id);
+    /* Free the connection ID table. */
+    OPENSSL_free(demux->cid_slots);
+    OPENSSL_cleanse(&demux->cid_hash, sizeof(demux->cid_hash));
 
     /* Free all URXEs we are holding. */
     demux_free_urxl(&demux->urx_free);
@@ -195,23 +218,130 @@ int ossl_quic_demux_set_mtu(QUIC_DEMUX *demux, unsigned int mtu)
     return 1;
 }
 
-static QUIC_DEMUX_CONN *demux_get_by_conn_id(QUIC_DEMUX *demux,
-                                             const QUIC_CONN_ID *dst_conn_id)
+static uint64_t demux_cid_hash(const QUIC_DEMUX *demux,
+                               const QUIC_CONN_ID *dst_conn_id)
+{
+    SIPHASH h = demux->cid_hash;
+    unsigned char out[SIPHASH_MIN_DIGEST_SIZE];
+    uint64_t v = 0;
+    size_t i;
+
+    SipHash_Update(&h, &dst_conn_id->id_len, 1);
+    SipHash_Update(&h, dst_conn_id->id, dst_conn_id->id_len);
+    SipHash_Final(&h, out, sizeof(out));
+
+    for (i = 0; i < sizeof(out); ++i)
+        v |= (uint64_t)out[i] << (i * 8);
+
+    return v;
+}
+
+/*
+ * Returns the slot holding the given connection ID, or NULL if it is not
+ * registered.
+ */
+static DEMUX_CID_SLOT *demux_get_by_conn_id(const QUIC_DEMUX *demux,
+                                            const QUIC_CONN_ID *dst_conn_id)
 {
-    QUIC_DEMUX_CONN key;
+    uint64_t hash;
+    size_t i;
+    DEMUX_CID_SLOT *slot;
 
     if (dst_conn_id->id_len > QUIC_MAX_CONN_ID_LEN)
         return NULL;
 
-    key.dst_conn_id = *dst_conn_id;
-    return lh_QUIC_DEMUX_CONN_retrieve(demux->conns_by_id, &key);
+    hash = demux_cid_hash(demux, dst_conn_id);
+
+    for (i = (size_t)hash & demux->cid_mask;; i = (i + 1) & demux->cid_mask) {
+        slot = &demux->cid_slots[i];
+
+        if (slot->cb == NULL)
+            return NULL;
+
+        if (slot->hash == hash
+            && ossl_quic_conn_id_eq(&slot->dst_conn_id, dst_conn_id))
+            return slot;
+    }
+}
+
+/* Places an entry into a table known to have a free slot. */
+static void demux_cid_place(DEMUX_CID_SLOT *slots, size_t mask,
+                            const DEMUX_CID_SLOT *entry)
+{
+    size_t i;
+
+    for (i = (size_t)entry->hash & mask; slots[i].cb != NULL;
+         i = (i + 1) & mask);
+
+    slots[i] = *entry;
+}
+
+static int demux_cid_resize(QUIC_DEMUX *demux, size_t num_slots)
+{
+    DEMUX_CID_SLOT *slots;
+    size_t i;
+
+    if (num_slots > SIZE_MAX / sizeof(DEMUX_CID_SLOT))
+        return 0;
+
+    slots = OPENSSL_zalloc(num_slots * sizeof(DEMUX_CID_SLOT));
+    if (slots == NULL)
+        return 0;
+
+    for (i = 0; i <= demux->cid_mask; ++i)
+        if (demux->cid_slots[i].cb != NULL)
+            demux_cid_place(slots, num_slots - 1, &demux->cid_slots[i]);
+
+    OPENSSL_free(demux->cid_slots);
+    demux->cid_slots    = slots;
+    demux->cid_mask     = num_slots - 1;
+    return 1;
+}
+
+/*
+ * Shrinks the table if it has become sparse. This is never done while
+ * removing entries, so callers may remove entries while iterating over the
+ * slots. Shrinking is best effort.
+ */
+static void demux_cid_maybe_shrink(QUIC_DEMUX *demux)
+{
+    size_t num_slots = demux->cid_mask + 1;
+
+    if (num_slots > DEMUX_CID_MIN_SLOTS && demux->num_cids < num_slots / 8)
+        demux_cid_resize(demux, num_slots / 2);
+}
+
+/*
+ * Removes the entry in the given slot. Later entries in the same probe run are
+ * shifted back into the gap where their home slot permits, so that every entry
+ * remains reachable from its home slot without passing an empty slot.
+ */
+static void demux_cid_remove(QUIC_DEMUX *demux, DEMUX_CID_SLOT *slot)
+{
+    size_t mask = demux->cid_mask;
+    size_t gap = (size_t)(slot - demux->cid_slots), i, home;
+
+    for (i = (gap + 1) & mask; demux->cid_slots[i].cb != NULL;
+         i = (i + 1) & mask) {
+        home = (size_t)demux->cid_slots[i].hash & mask;
+
+        /* Entry may move into the gap only if the gap is not before home. */
+        if (((i - home) & mask) >= ((i - gap) & mask)) {
+            demux->cid_slots[gap] = demux->cid_slots[i];
+            gap = i;
+        }
+    }
+
+    memset(&demux->cid_slots[gap], 0, sizeof(DEMUX_CID_SLOT));
+    --demux->num_cids;
 }
 
 int ossl_quic_demux_register(QUIC_DEMUX *demux,
                              const QUIC_CONN_ID *dst_conn_id,
                              ossl_quic_demux_cb_fn *cb, void *cb_arg)
 {
-    QUIC_DEMUX_CONN *conn;
+    DEMUX_CID_SLOT entry;
+    size_t num_slots;
 
     if (dst_conn_id == NULL
         || dst_conn_id->id_len > QUIC_MAX_CONN_ID_LEN
@@ -223,74 +353,65 @@ int ossl_quic_demux_register(QUIC_DEMUX *demux,
         /* Handler already registered with this connection ID. */
         return 0;
 
-    conn = OPENSSL_zalloc(sizeof(QUIC_DEMUX_CONN));
-    if (conn == NULL)
+    /* Keep the load factor at or below 3/4. */
+    num_slots = demux->cid_mask + 1;
+    if ((demux->num_cids + 1) * 4 > num_slots * 3
+        && (num_slots > SIZE_MAX / 2
+            || !demux_cid_resize(demux, num_slots * 2)))
         return 0;
 
-    conn->dst_conn_id   = *dst_conn_id;
-    conn->cb            = cb;
-    conn->cb_arg        = cb_arg;
+    memset(&entry, 0, sizeof(entry));
+    entry.hash          = demux_cid_hash(demux, dst_conn_id);
+    entry.cb            = cb;
+    entry.cb_arg        = cb_arg;
+    entry.dst_conn_id   = *dst_conn_id;
 
-    lh_QUIC_DEMUX_CONN_insert(demux->conns_by_id, conn);
+    demux_cid_place(demux->cid_slots, demux->cid_mask, &entry);
+    ++demux->num_cids;
     return 1;
 }
 
-static void demux_unregister(QUIC_DEMUX *demux,
-                             QUIC_DEMUX_CONN *conn)
-{
-    lh_QUIC_DEMUX_CONN_delete(demux->conns_by_id, conn);
-    OPENSSL_free(conn);
-}
-
 int ossl_quic_demux_unregister(QUIC_DEMUX *demux,
                                const QUIC_CONN_ID *dst_conn_id)
 {
-    QUIC_DEMUX_CONN *conn;
+    DEMUX_CID_SLOT *slot;
 
     if (dst_conn_id == NULL
         || dst_conn_id->id_len > QUIC_MAX_CONN_ID_LEN)
         return 0;
 
-    conn = demux_get_by_conn_id(demux, dst_conn_id);
-    if (conn == NULL)
+    slot = demux_get_by_conn_id(demux, dst_conn_id);
+    if (slot == NULL)
         return 0;
 
-    demux_unregister(demux, conn);
+    demux_cid_remove(demux, slot);
+    demux_cid_maybe_shrink(demux);
     return 1;
 }
 
-struct unreg_arg {
-    ossl_quic_demux_cb_fn *cb;
-    void *cb_arg;
-    QUIC_DEMUX_CONN *head;
-};
-
-static void demux_unregister_by_cb(QUIC_DEMUX_CONN *conn, void *arg_)
-{
-    struct unreg_arg *arg = arg_;
-
-    if (conn->cb == arg->cb && conn->cb_arg == arg->cb_arg) {
-        conn->next = arg->head;
-        arg->head = conn;
-    }
-}
-
 void ossl_quic_demux_unregister_by_cb(QUIC_DEMUX *demux,
                                       ossl_quic_demux_cb_fn *cb,
                                       void *cb_arg)
 {
-    QUIC_DEMUX_CONN *conn, *cnext;
-    struct unreg_arg arg = {0};
-    arg.cb      = cb;
-    arg.cb_arg  = cb_arg;
+    size_t i;
+    DEMUX_CID_SLOT *slot;
 
-    lh_QUIC_DEMUX_CONN_doall_arg(demux->conns_by_id,
-                                 demux_unregister_by_cb, &arg);
+    /*
+     * Removing an entry only moves later entries of its probe run back into the
+     * freed slot or slots after it, other than entries which wrapped around to
+     * the start of the table and have therefore already been examined. So
+     * examining the current slot again after a removal visits every entry.
+     */
+    for (i = 0; i <= demux->cid_mask;) {
+        slot = &demux->cid_slots[i];
 
-    for (conn = arg.head; conn != NULL; conn = cnext) {
-        cnext = conn->next;
-        demux_unregister(demux, conn);
+        if (slot->cb != NULL && slot->cb == cb && slot->cb_arg == cb_arg)
+            demux_cid_remove(demux, slot);
+        else
+            ++i;
     }
+
+    demux_cid_maybe_shrink(demux);
 }
 
 void ossl_quic_demux_set_default_handler(QUIC_DEMUX *demux,
@@ -480,8 +601,8 @@ static int demux_identify_conn_id(QUIC_DEMUX *demux,
                                                   dst_conn_id);
 }
 
-/* Identify the connection structure corresponding to a given URXE. */
-static QUIC_DEMUX_CONN *demux_identify_conn(QUIC_DEMUX *demux, QUIC_URXE *e)
+/* Identify the connection ID table entry corresponding to a given URXE. */
+static DEMUX_CID_SLOT *demux_identify_conn(QUIC_DEMUX *demux, QUIC_URXE *e)
 {
     QUIC_CONN_ID dst_conn_id;
 
@@ -501,7 +622,7 @@ static QUIC_DEMUX_CONN *demux_identify_conn(QUIC_DEMUX *demux, QUIC_URXE *e)
  */
 static int demux_process_pending_urxe(QUIC_DEMUX *demux, QUIC_URXE *e)
 {
-    QUIC_DEMUX_CONN *conn;
+    DEMUX_CID_SLOT *conn;
     int r;
 
     /* The next URXE we process should be at the head of the pending list. */
@@ -555,7 +676,7 @@ static int demux_process_pending_urxe(QUIC_DEMUX *demux, QUIC_URXE *e)
 
     /*
      * Remove from list and invoke callback. The URXE now belongs to the
-     * callback. (QUIC_DEMUX_CONN never has non-NULL cb.)
+     * callback. (An occupied DEMUX_CID_SLOT never has NULL cb.)
      */
     ossl_list_urxe_remove(&demux->urx_pending, e);
     e->demux_state = URXE_DEMUX_STATE_ISSUED;
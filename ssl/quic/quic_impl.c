@@ -38,6 +38,7 @@ static int quic_validate_for_write(QUIC_XSO *xso, int *err);
 static int quic_mutation_allowed(QUIC_CONNECTION *qc, int req_active);
 static int qc_blocking_mode(const QUIC_CONNECTION *qc);
 static int xso_blocking_mode(const QUIC_XSO *xso);
+static void xso_drop_read_buffer(QUIC_XSO *xso);
 
 /*
  * QUIC Front-End I/O API: Common Utilities
@@ -484,6 +485,14 @@ void ossl_quic_free(SSL *s)
         assert(ctx.qc->num_xso > 0);
         --ctx.qc->num_xso;
 
+        /* Give back any receive buffer the application did not release. */
+        if (ctx.xso->rbuf_held) {
+            if (ctx.xso->stream->rstream != NULL)
+                ossl_quic_rstream_release_record(ctx.xso->stream->rstream, 0);
+
+            xso_drop_read_buffer(ctx.xso);
+        }
+
         /* If a stream's send part has not been finished, auto-reset it. */
         if ((   ctx.xso->stream->send_state == QUIC_SSTREAM_STATE_READY
              || ctx.xso->stream->send_state == QUIC_SSTREAM_STATE_SEND)
@@ -1060,6 +1069,33 @@ int ossl_quic_handle_events(SSL *s)
     return 1;
 }
 
+/*
+ * Computes the event timeout for a connection relative to the connection's
+ * notion of the current time.
+ */
+QUIC_NEEDS_LOCK
+static void qc_get_event_timeout(QUIC_CONNECTION *qc, struct timeval *tv,
+                                 int *is_infinite)
+{
+    OSSL_TIME deadline
+        = ossl_quic_reactor_get_tick_deadline(ossl_quic_channel_get_reactor(qc->ch));
+
+    if (ossl_time_is_infinite(deadline)) {
+        *is_infinite = 1;
+
+        /*
+         * Robustness against faulty applications that don't check *is_infinite;
+         * harmless long timeout.
+         */
+        tv->tv_sec  = 1000000;
+        tv->tv_usec = 0;
+        return;
+    }
+
+    *tv = ossl_time_to_timeval(ossl_time_subtract(deadline, get_time(qc)));
+    *is_infinite = 0;
+}
+
 /*
  * SSL_get_event_timeout. Get the time in milliseconds until the SSL object
  * should next have events handled by the application by calling
@@ -1071,32 +1107,34 @@ QUIC_TAKES_LOCK
 int ossl_quic_get_event_timeout(SSL *s, struct timeval *tv, int *is_infinite)
 {
     QCTX ctx;
-    OSSL_TIME deadline = ossl_time_infinite();
 
     if (!expect_quic(s, &ctx))
         return 0;
 
     quic_lock(ctx.qc);
+    qc_get_event_timeout(ctx.qc, tv, is_infinite);
+    quic_unlock(ctx.qc);
+    return 1;
+}
 
-    deadline
-        = ossl_quic_reactor_get_tick_deadline(ossl_quic_channel_get_reactor(ctx.qc->ch));
-
-    if (ossl_time_is_infinite(deadline)) {
-        *is_infinite = 1;
-
-        /*
-         * Robustness against faulty applications that don't check *is_infinite;
-         * harmless long timeout.
-         */
-        tv->tv_sec  = 1000000;
-        tv->tv_usec = 0;
+/*
+ * SSL_handle_events_many helper. Ticks the reactor and then determines the
+ * resulting event timeout while holding the connection lock only once. This
+ * is what allows an event loop servicing many connections to process each
+ * ready connection and update its timer in a single pass.
+ */
+QUIC_TAKES_LOCK
+int ossl_quic_handle_events_timeout(SSL *s, struct timeval *tv,
+                                    int *is_infinite)
+{
+    QCTX ctx;
 
-        quic_unlock(ctx.qc);
-        return 1;
-    }
+    if (!expect_quic(s, &ctx))
+        return 0;
 
-    *tv = ossl_time_to_timeval(ossl_time_subtract(deadline, get_time(ctx.qc)));
-    *is_infinite = 0;
+    quic_lock(ctx.qc);
+    ossl_quic_reactor_tick(ossl_quic_channel_get_reactor(ctx.qc->ch), 0);
+    qc_get_event_timeout(ctx.qc, tv, is_infinite);
     quic_unlock(ctx.qc);
     return 1;
 }
@@ -2535,12 +2573,13 @@ out:
  * --------
  */
 struct quic_read_again_args {
-    QCTX            *ctx;
-    QUIC_STREAM     *stream;
-    void            *buf;
-    size_t          len;
-    size_t          *bytes_read;
-    int             peek;
+    QCTX                *ctx;
+    QUIC_STREAM         *stream;
+    void                *buf;
+    size_t              len;
+    const unsigned char **zc_buf;
+    size_t              *bytes_read;
+    int                 peek;
 };
 
 QUIC_NEEDS_LOCK
@@ -2643,6 +2682,75 @@ static int quic_read_actual(QCTX *ctx,
     return 1;
 }
 
+/*
+ * Zero-copy counterpart of quic_read_actual(). Rather than copying out the
+ * received data, locks the first contiguous run of it in the stream and
+ * returns a pointer to it, which remains valid until released by
+ * ossl_quic_release_read_buffer().
+ */
+QUIC_NEEDS_LOCK
+static int quic_get0_read_buffer_actual(QCTX *ctx, QUIC_STREAM *stream,
+                                        const unsigned char **buf,
+                                        size_t *len)
+{
+    int is_fin = 0, err, eos;
+    QUIC_XSO *xso = ctx->xso;
+    OSSL_QRX_PKT *pkt;
+
+    if (!quic_validate_for_read(xso, &err, &eos)) {
+        if (eos)
+            return QUIC_RAISE_NORMAL_ERROR(ctx, SSL_ERROR_ZERO_RETURN);
+        else
+            return QUIC_RAISE_NON_NORMAL_ERROR(ctx, err, NULL);
+    }
+
+    if (!ossl_quic_rstream_get_record(stream->rstream, buf, len, &is_fin))
+        return QUIC_RAISE_NON_NORMAL_ERROR(ctx, ERR_R_INTERNAL_ERROR, NULL);
+
+    if (*len == 0) {
+        /* The head is not locked if there is no data. */
+        if (is_fin) {
+            QUIC_STREAM_MAP *qsm = ossl_quic_channel_get_qsm(ctx->qc->ch);
+
+            ossl_quic_stream_map_notify_totally_read(qsm, stream);
+            return QUIC_RAISE_NORMAL_ERROR(ctx, SSL_ERROR_ZERO_RETURN);
+        }
+
+        return 1;
+    }
+
+    /*
+     * Application stream data is always kept in the packet it arrived in and
+     * never moved to the ring buffer, so there is always a packet to pin.
+     */
+    pkt = ossl_quic_rstream_get_record_pkt(stream->rstream);
+    if (!ossl_assert(pkt != NULL)) {
+        ossl_quic_rstream_release_record(stream->rstream, 0);
+        *buf = NULL;
+        *len = 0;
+        return QUIC_RAISE_NON_NORMAL_ERROR(ctx, ERR_R_INTERNAL_ERROR, NULL);
+    }
+
+    ossl_qrx_pkt_up_ref(pkt);
+    xso->rbuf_pkt   = pkt;
+    xso->rbuf_len   = *len;
+    xso->rbuf_fin   = is_fin;
+    xso->rbuf_held  = 1;
+    return 1;
+}
+
+QUIC_NEEDS_LOCK
+static int quic_read_step(struct quic_read_again_args *args)
+{
+    if (args->zc_buf != NULL)
+        return quic_get0_read_buffer_actual(args->ctx, args->stream,
+                                            args->zc_buf, args->bytes_read);
+
+    return quic_read_actual(args->ctx, args->stream,
+                            args->buf, args->len, args->bytes_read,
+                            args->peek);
+}
+
 QUIC_NEEDS_LOCK
 static int quic_read_again(void *arg)
 {
@@ -2654,9 +2762,7 @@ static int quic_read_again(void *arg)
         return -1;
     }
 
-    if (!quic_read_actual(args->ctx, args->stream,
-                          args->buf, args->len, args->bytes_read,
-                          args->peek))
+    if (!quic_read_step(args))
         return -1;
 
     if (*args->bytes_read > 0)
@@ -2667,13 +2773,17 @@ static int quic_read_again(void *arg)
 }
 
 QUIC_TAKES_LOCK
-static int quic_read(SSL *s, void *buf, size_t len, size_t *bytes_read, int peek)
+static int quic_read(SSL *s, void *buf, size_t len,
+                     const unsigned char **zc_buf, size_t *bytes_read,
+                     int peek)
 {
     int ret, res;
     QCTX ctx;
     struct quic_read_again_args args;
 
     *bytes_read = 0;
+    if (zc_buf != NULL)
+        *zc_buf = NULL;
 
     if (!expect_quic(s, &ctx))
         return 0;
@@ -2706,8 +2816,23 @@ static int quic_read(SSL *s, void *buf, size_t len, size_t *bytes_read, int peek
         ctx.xso = ctx.qc->default_xso;
     }
 
-    if (!quic_read_actual(&ctx, ctx.xso->stream, buf, len, bytes_read, peek)) {
-        ret = 0; /* quic_read_actual raised error here */
+    /* No reading while the application holds a zero-copy receive buffer. */
+    if (ctx.xso->rbuf_held) {
+        ret = QUIC_RAISE_NON_NORMAL_ERROR(&ctx, ERR_R_SHOULD_NOT_HAVE_BEEN_CALLED,
+                                          NULL);
+        goto out;
+    }
+
+    args.ctx        = &ctx;
+    args.stream     = ctx.xso->stream;
+    args.buf        = buf;
+    args.len        = len;
+    args.zc_buf     = zc_buf;
+    args.bytes_read = bytes_read;
+    args.peek       = peek;
+
+    if (!quic_read_step(&args)) {
+        ret = 0; /* quic_read_step raised error here */
         goto out;
     }
 
@@ -2724,13 +2849,6 @@ static int quic_read(SSL *s, void *buf, size_t len, size_t *bytes_read, int peek
          * buffer is empty. This means we need to block until we get
          * at least one byte.
          */
-        args.ctx        = &ctx;
-        args.stream     = ctx.xso->stream;
-        args.buf        = buf;
-        args.len        = len;
-        args.bytes_read = bytes_read;
-        args.peek       = peek;
-
         res = block_until_pred(ctx.qc, quic_read_again, &args, 0);
         if (res == 0) {
             ret = QUIC_RAISE_NON_NORMAL_ERROR(&ctx, ERR_R_INTERNAL_ERROR, NULL);
@@ -2749,8 +2867,8 @@ static int quic_read(SSL *s, void *buf, size_t len, size_t *bytes_read, int peek
         ossl_quic_reactor_tick(ossl_quic_channel_get_reactor(ctx.qc->ch), 0);
 
         /* Try the read again. */
-        if (!quic_read_actual(&ctx, ctx.xso->stream, buf, len, bytes_read, peek)) {
-            ret = 0; /* quic_read_actual raised error here */
+        if (!quic_read_step(&args)) {
+            ret = 0; /* quic_read_step raised error here */
             goto out;
         }
 
@@ -2767,12 +2885,98 @@ out:
 
 int ossl_quic_read(SSL *s, void *buf, size_t len, size_t *bytes_read)
 {
-    return quic_read(s, buf, len, bytes_read, 0);
+    return quic_read(s, buf, len, NULL, bytes_read, 0);
 }
 
 int ossl_quic_peek(SSL *s, void *buf, size_t len, size_t *bytes_read)
 {
-    return quic_read(s, buf, len, bytes_read, 1);
+    return quic_read(s, buf, len, NULL, bytes_read, 1);
+}
+
+/*
+ * SSL_get0_read_buffer
+ * --------------------
+ */
+int ossl_quic_get0_read_buffer(SSL *s, const unsigned char **buf, size_t *len)
+{
+    return quic_read(s, NULL, 0, buf, len, 0);
+}
+
+/*
+ * SSL_release_read_buffer
+ * -----------------------
+ */
+QUIC_NEEDS_LOCK
+static void xso_drop_read_buffer(QUIC_XSO *xso)
+{
+    ossl_qrx_pkt_release(xso->rbuf_pkt);
+    xso->rbuf_pkt   = NULL;
+    xso->rbuf_len   = 0;
+    xso->rbuf_fin   = 0;
+    xso->rbuf_held  = 0;
+}
+
+QUIC_TAKES_LOCK
+int ossl_quic_release_read_buffer(SSL *s, size_t bytes_read)
+{
+    int ret = 0;
+    QCTX ctx;
+    QUIC_STREAM *stream;
+    QUIC_STREAM_MAP *qsm;
+    OSSL_RTT_INFO rtt_info;
+
+    if (!expect_quic_with_stream_lock(s, /*remote_init=*/-1, /*io=*/1, &ctx))
+        return 0;
+
+    if (!ctx.xso->rbuf_held) {
+        QUIC_RAISE_NON_NORMAL_ERROR(&ctx, ERR_R_SHOULD_NOT_HAVE_BEEN_CALLED,
+                                    NULL);
+        goto out;
+    }
+
+    if (bytes_read > ctx.xso->rbuf_len) {
+        QUIC_RAISE_NON_NORMAL_ERROR(&ctx, ERR_R_PASSED_INVALID_ARGUMENT, NULL);
+        goto out;
+    }
+
+    stream  = ctx.xso->stream;
+    qsm     = ossl_quic_channel_get_qsm(ctx.qc->ch);
+
+    /*
+     * If the stream was reset while the buffer was held, its QUIC_RSTREAM is
+     * already gone and there is nothing left to account for; we only need to
+     * give up our reference to the packet.
+     */
+    if (stream->rstream != NULL) {
+        if (!ossl_quic_rstream_release_record(stream->rstream, bytes_read)) {
+            QUIC_RAISE_NON_NORMAL_ERROR(&ctx, ERR_R_INTERNAL_ERROR, NULL);
+            goto drop;
+        }
+
+        if (bytes_read > 0) {
+            ossl_statm_get_rtt_info(ossl_quic_channel_get_statm(ctx.qc->ch),
+                                    &rtt_info);
+
+            if (!ossl_quic_rxfc_on_retire(&stream->rxfc, bytes_read,
+                                          rtt_info.smoothed_rtt)) {
+                QUIC_RAISE_NON_NORMAL_ERROR(&ctx, ERR_R_INTERNAL_ERROR, NULL);
+                goto drop;
+            }
+        }
+
+        if (ctx.xso->rbuf_fin && bytes_read == ctx.xso->rbuf_len)
+            ossl_quic_stream_map_notify_totally_read(qsm, stream);
+
+        if (bytes_read > 0)
+            ossl_quic_stream_map_update_state(qsm, stream);
+    }
+
+    ret = 1;
+drop:
+    xso_drop_read_buffer(ctx.xso);
+out:
+    quic_unlock(ctx.qc);
+    return ret;
 }
 
 /*
@@ -92,6 +92,24 @@ struct quic_xso_st {
      */
     size_t                          aon_buf_pos;
 
+    /*
+     * Is a receive buffer obtained by SSL_get0_read_buffer() currently held by
+     * the application? While it is, the head of the stream's receive frame
+     * list stays locked and SSL_read() and SSL_peek() are not permitted.
+     */
+    unsigned int                    rbuf_held               : 1;
+    /* Was the held receive buffer the last data on the stream? */
+    unsigned int                    rbuf_fin                : 1;
+    /*
+     * The packet containing the data of the held receive buffer. We hold a
+     * reference to it so that the buffer remains valid even if the stream is
+     * reset by the peer and its QUIC_RSTREAM freed before the buffer is
+     * released.
+     */
+    OSSL_QRX_PKT                    *rbuf_pkt;
+    /* The length of the held receive buffer, in bytes. */
+    size_t                          rbuf_len;
+
     /* SSL_set_mode */
     uint32_t                        ssl_mode;
 
@@ -228,6 +228,10 @@ int ossl_quic_rstream_get_record(QUIC_RSTREAM *qrs,
     return 1;
 }
 
+OSSL_QRX_PKT *ossl_quic_rstream_get_record_pkt(const QUIC_RSTREAM *qrs)
+{
+    return ossl_sframe_list_get_head_pkt(&qrs->fl);
+}
 
 int ossl_quic_rstream_release_record(QUIC_RSTREAM *qrs, size_t read_len)
 {
@@ -293,3 +297,8 @@ void ossl_quic_rstream_set_cleanse(QUIC_RSTREAM *qrs, int cleanse)
 {
     qrs->fl.cleanse = cleanse;
 }
+
+int ossl_quic_rstream_set_sframe_pool(QUIC_RSTREAM *qrs, SFRAME_POOL *pool)
+{
+    return ossl_sframe_list_set_pool(&qrs->fl, pool);
+}
@@ -16,21 +16,195 @@ struct stream_frame_st {
     UINT_RANGE range;
     OSSL_QRX_PKT *pkt;
     const unsigned char *data;
+    /* Slab this frame was carved from, or NULL if individually allocated */
+    SFRAME_SLAB *slab;
 };
 
+/*
+ * Stream frame pool
+ * =================
+ *
+ * Frames are carved out of fixed size slabs. Each slab keeps its own free
+ * list so that a slab which becomes entirely unused can be returned to the
+ * heap. Slabs with at least one free frame are kept on the avail list; full
+ * slabs are not on any list. A small number of entirely unused slabs is
+ * retained to avoid thrashing when the number of frames held repeatedly drops
+ * to zero and grows again, which is the common pattern when an application
+ * drains its streams between bursts of received packets.
+ */
+#define SFRAME_SLAB_FRAMES      32
+#define SFRAME_MAX_EMPTY_SLABS  4
+
+struct sframe_slab_st {
+    SFRAME_SLAB     *prev, *next;
+    STREAM_FRAME    *free_list;
+    size_t          num_used;
+    STREAM_FRAME    frames[SFRAME_SLAB_FRAMES];
+};
+
+struct sframe_pool_st {
+    SFRAME_SLAB     *avail;
+    size_t          num_slabs;
+    size_t          num_empty_slabs;
+    size_t          num_frames_used;
+    uint64_t        num_slab_allocs;
+    uint64_t        num_frame_allocs;
+};
+
+SFRAME_POOL *ossl_sframe_pool_new(void)
+{
+    return OPENSSL_zalloc(sizeof(SFRAME_POOL));
+}
+
+static void slab_unlink(SFRAME_POOL *pool, SFRAME_SLAB *slab)
+{
+    if (slab->prev != NULL)
+        slab->prev->next = slab->next;
+    else
+        pool->avail = slab->next;
+
+    if (slab->next != NULL)
+        slab->next->prev = slab->prev;
+
+    slab->prev = slab->next = NULL;
+}
+
+static void slab_link(SFRAME_POOL *pool, SFRAME_SLAB *slab)
+{
+    slab->prev = NULL;
+    slab->next = pool->avail;
+    if (pool->avail != NULL)
+        pool->avail->prev = slab;
+    pool->avail = slab;
+}
+
+void ossl_sframe_pool_free(SFRAME_POOL *pool)
+{
+    SFRAME_SLAB *slab, *next;
+
+    if (pool == NULL)
+        return;
+
+    /*
+     * All frames must have been returned before the pool is freed. If not,
+     * leak the pool rather than leaving lists pointing at freed memory.
+     */
+    if (!ossl_assert(pool->num_frames_used == 0))
+        return;
+
+    for (slab = pool->avail; slab != NULL; slab = next) {
+        next = slab->next;
+        OPENSSL_free(slab);
+    }
+
+    OPENSSL_free(pool);
+}
+
+static SFRAME_SLAB *sframe_slab_new(SFRAME_POOL *pool)
+{
+    SFRAME_SLAB *slab = OPENSSL_malloc(sizeof(*slab));
+    size_t i;
+
+    if (slab == NULL)
+        return NULL;
+
+    slab->free_list = NULL;
+    for (i = SFRAME_SLAB_FRAMES; i > 0; --i) {
+        slab->frames[i - 1].next = slab->free_list;
+        slab->free_list = &slab->frames[i - 1];
+    }
+
+    slab->num_used = 0;
+    slab_link(pool, slab);
+    ++pool->num_slabs;
+    ++pool->num_empty_slabs;
+    ++pool->num_slab_allocs;
+    return slab;
+}
+
+static STREAM_FRAME *sframe_pool_alloc(SFRAME_POOL *pool)
+{
+    SFRAME_SLAB *slab = pool->avail;
+    STREAM_FRAME *sf;
+
+    if (slab == NULL && (slab = sframe_slab_new(pool)) == NULL)
+        return NULL;
+
+    sf = slab->free_list;
+    slab->free_list = sf->next;
+
+    if (slab->num_used++ == 0)
+        --pool->num_empty_slabs;
+
+    if (slab->free_list == NULL)
+        slab_unlink(pool, slab);
+
+    ++pool->num_frames_used;
+    ++pool->num_frame_allocs;
+
+    memset(sf, 0, sizeof(*sf));
+    sf->slab = slab;
+    return sf;
+}
+
+static void sframe_pool_release(SFRAME_POOL *pool, STREAM_FRAME *sf)
+{
+    SFRAME_SLAB *slab = sf->slab;
+
+    if (slab->free_list == NULL)
+        /* Slab was full, so it becomes available again. */
+        slab_link(pool, slab);
+
+    sf->next = slab->free_list;
+    slab->free_list = sf;
+    --pool->num_frames_used;
+
+    if (--slab->num_used > 0)
+        return;
+
+    if (pool->num_empty_slabs >= SFRAME_MAX_EMPTY_SLABS) {
+        /* Already holding enough spare slabs, so give this one back. */
+        slab_unlink(pool, slab);
+        --pool->num_slabs;
+        OPENSSL_free(slab);
+        return;
+    }
+
+    ++pool->num_empty_slabs;
+}
+
+void ossl_sframe_pool_get_stats(const SFRAME_POOL *pool,
+                                SFRAME_POOL_STATS *stats)
+{
+    stats->num_slabs        = pool->num_slabs;
+    stats->num_frames_used  = pool->num_frames_used;
+    stats->num_slab_allocs  = pool->num_slab_allocs;
+    stats->num_frame_allocs = pool->num_frame_allocs;
+}
+
 static void stream_frame_free(SFRAME_LIST *fl, STREAM_FRAME *sf)
 {
     if (fl->cleanse && sf->data != NULL)
         OPENSSL_cleanse((unsigned char *)sf->data,
                         (size_t)(sf->range.end - sf->range.start));
     ossl_qrx_pkt_release(sf->pkt);
-    OPENSSL_free(sf);
+
+    if (sf->slab != NULL)
+        sframe_pool_release(fl->pool, sf);
+    else
+        OPENSSL_free(sf);
 }
 
-static STREAM_FRAME *stream_frame_new(UINT_RANGE *range, OSSL_QRX_PKT *pkt,
+static STREAM_FRAME *stream_frame_new(SFRAME_LIST *fl, UINT_RANGE *range,
+                                      OSSL_QRX_PKT *pkt,
                                       const unsigned char *data)
 {
-    STREAM_FRAME *sf = OPENSSL_zalloc(sizeof(*sf));
+    STREAM_FRAME *sf;
+
+    if (fl->pool != NULL)
+        sf = sframe_pool_alloc(fl->pool);
+    else
+        sf = OPENSSL_zalloc(sizeof(*sf));
 
     if (sf == NULL)
         return NULL;
@@ -60,13 +234,23 @@ void ossl_sframe_list_destroy(SFRAME_LIST *fl)
     }
 }
 
+int ossl_sframe_list_set_pool(SFRAME_LIST *fl, SFRAME_POOL *pool)
+{
+    /* The pool can only be changed while no frames are held. */
+    if (!ossl_assert(fl->head == NULL))
+        return 0;
+
+    fl->pool = pool;
+    return 1;
+}
+
 static int append_frame(SFRAME_LIST *fl, UINT_RANGE *range,
                         OSSL_QRX_PKT *pkt,
                         const unsigned char *data)
 {
     STREAM_FRAME *new_frame;
 
-    if ((new_frame = stream_frame_new(range, pkt, data)) == NULL)
+    if ((new_frame = stream_frame_new(fl, range, pkt, data)) == NULL)
         return 0;
     new_frame->prev = fl->tail;
     if (fl->tail != NULL)
@@ -81,6 +265,7 @@ int ossl_sframe_list_insert(SFRAME_LIST *fl, UINT_RANGE *range,
                             const unsigned char *data, int fin)
 {
     STREAM_FRAME *sf, *new_frame, *prev_frame, *next_frame;
+    UINT_RANGE trimmed;
 #ifndef NDEBUG
     uint64_t curr_end = fl->tail != NULL ? fl->tail->range.end
                                          : fl->offset;
@@ -93,9 +278,25 @@ int ossl_sframe_list_insert(SFRAME_LIST *fl, UINT_RANGE *range,
     if (fl->offset >= range->end)
         goto end;
 
+    /*
+     * The data of a locked head frame may be referenced by the caller until
+     * it is dropped, so the frame must not be replaced by an overlapping one.
+     * Any new data it already covers is redundant anyway.
+     */
+    if (fl->head_locked && range->start < fl->head->range.end) {
+        if (range->end <= fl->head->range.end)
+            goto end;
+
+        if (data != NULL)
+            data += (size_t)(fl->head->range.end - range->start);
+        trimmed.start = fl->head->range.end;
+        trimmed.end = range->end;
+        range = &trimmed;
+    }
+
     /* nothing there yet */
     if (fl->tail == NULL) {
-        fl->tail = fl->head = stream_frame_new(range, pkt, data);
+        fl->tail = fl->head = stream_frame_new(fl, range, pkt, data);
         if (fl->tail == NULL)
             return 0;
 
@@ -129,7 +330,7 @@ int ossl_sframe_list_insert(SFRAME_LIST *fl, UINT_RANGE *range,
      * Now we must create a new frame although in the end we might drop it,
      * because we will be potentially dropping existing overlapping frames.
      */
-    new_frame = stream_frame_new(range, pkt, data);
+    new_frame = stream_frame_new(fl, range, pkt, data);
     if (new_frame == NULL)
         return 0;
 
@@ -269,6 +470,14 @@ int ossl_sframe_list_is_head_locked(SFRAME_LIST *fl)
     return fl->head_locked;
 }
 
+OSSL_QRX_PKT *ossl_sframe_list_get_head_pkt(const SFRAME_LIST *fl)
+{
+    if (!fl->head_locked || fl->head->data == NULL)
+        return NULL;
+
+    return fl->head->pkt;
+}
+
 int ossl_sframe_list_move_data(SFRAME_LIST *fl,
                                sframe_list_write_at_cb *write_at_cb,
                                void *cb_arg)
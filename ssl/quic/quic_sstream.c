@@ -97,16 +97,13 @@ int ossl_quic_sstream_get_stream_frame(QUIC_SSTREAM *qss,
     size_t num_iov_ = 0, src_len = 0, total_len = 0, i;
     uint64_t max_len;
     const unsigned char *src = NULL;
-    UINT_SET_ITEM *range = ossl_list_uint_set_head(&qss->new_set);
+    const UINT_RANGE *range = ossl_uint_set_get_range(&qss->new_set, skip);
 
     if (*num_iov < 2)
         return 0;
 
-    for (i = 0; i < skip && range != NULL; ++i)
-        range = ossl_list_uint_set_next(range);
-
     if (range == NULL) {
-        if (i < skip)
+        if (skip > ossl_uint_set_num_ranges(&qss->new_set))
             /* Don't return FIN for infinitely increasing skip */
             return 0;
 
@@ -128,14 +125,14 @@ int ossl_quic_sstream_get_stream_frame(QUIC_SSTREAM *qss,
      * Set entries never have 'adjacent' entries so we don't have to worry
      * about them here.
      */
-    max_len = range->range.end - range->range.start + 1;
+    max_len = range->end - range->start + 1;
 
     for (i = 0;; ++i) {
         if (total_len >= max_len)
             break;
 
         if (!ring_buf_get_buf_at(&qss->ring_buf,
-                                 range->range.start + total_len,
+                                 range->start + total_len,
                                  &src, &src_len))
             return 0;
 
@@ -154,7 +151,7 @@ int ossl_quic_sstream_get_stream_frame(QUIC_SSTREAM *qss,
         ++num_iov_;
     }
 
-    hdr->offset = range->range.start;
+    hdr->offset = range->start;
     hdr->len    = total_len;
     hdr->is_fin = qss->have_final_size
         && hdr->offset + hdr->len == qss->ring_buf.head_offset;
@@ -331,7 +328,7 @@ int ossl_quic_sstream_append(QUIC_SSTREAM *qss,
 
 static void qss_cull(QUIC_SSTREAM *qss)
 {
-    UINT_SET_ITEM *h = ossl_list_uint_set_head(&qss->acked_set);
+    const UINT_RANGE *h = ossl_uint_set_get_range(&qss->acked_set, 0);
 
     /*
      * Potentially cull data from our ring buffer. This can happen once data has
@@ -350,7 +347,7 @@ static void qss_cull(QUIC_SSTREAM *qss)
      * can only cull contiguous areas at the start of the ring buffer anyway.
      */
     if (h != NULL)
-        ring_buf_cpop_range(&qss->ring_buf, h->range.start, h->range.end,
+        ring_buf_cpop_range(&qss->ring_buf, h->start, h->end,
                             qss->cleanse);
 }
 
@@ -385,14 +382,14 @@ int ossl_quic_sstream_is_totally_acked(QUIC_SSTREAM *qss)
     if (ossl_quic_sstream_get_cur_size(qss) == 0)
         return 1;
 
-    if (ossl_list_uint_set_num(&qss->acked_set) != 1)
+    if (ossl_uint_set_num_ranges(&qss->acked_set) != 1)
         return 0;
 
-    r = ossl_list_uint_set_head(&qss->acked_set)->range;
+    r = *ossl_uint_set_get_range(&qss->acked_set, 0);
     cur_size = qss->ring_buf.head_offset;
 
     /*
-     * The invariants of UINT_SET guarantee a single list element if we have a
+     * The invariants of UINT_SET guarantee a single range if we have a
      * single contiguous range, which is what we should have if everything has
      * been acked.
      */
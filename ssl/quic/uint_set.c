@@ -9,7 +9,7 @@
 
 #include "internal/uint_set.h"
 #include "internal/common.h"
-#include <assert.h>
+#include <string.h>
 
 /*
  * uint64_t Integer Sets
@@ -31,17 +31,17 @@
  *
  * For greater efficiency in tracking large numbers of contiguous integers, we
  * track integer ranges rather than individual integers. The data structure
- * manages a list of integer ranges [[start, end]...]. Internally this is
- * implemented as a doubly linked sorted list of range structures, which are
+ * manages an array of integer ranges [[start, end]...], which are
  * automatically split and merged as necessary.
  *
- * This data structure requires O(n) traversal of the list for insertion,
- * removal and query when we are not adding/removing ranges which are near the
- * beginning or end of the set of ranges. For the applications for which this
- * data structure is used (e.g. QUIC PN tracking for ACK generation), it is
- * expected that the number of integer ranges needed at any given time will
- * generally be small and that most operations will be close to the beginning or
- * end of the range.
+ * The array is kept sorted, so insertion, removal and query locate the ranges
+ * they affect by binary search. Insertion or removal in the middle of the
+ * array requires moving the ranges after it, but this is a single memmove() of
+ * a contiguous block rather than a walk of scattered list nodes, and no
+ * allocation takes place unless the array needs to grow. For the applications
+ * for which this data structure is used (e.g. QUIC PN tracking for ACK
+ * generation), it is expected that most operations will be at or close to the
+ * end of the set, so this case is tested before searching.
  *
  * Invariant: The data structure is always sorted in ascending order by value.
  *
@@ -57,276 +57,193 @@
  *            item inside the data structure can represent a span of zero
  *            integers.
  */
+#define MIN_ALLOC_RANGES    4
+
 void ossl_uint_set_init(UINT_SET *s)
 {
-    ossl_list_uint_set_init(s);
+    s->ranges       = NULL;
+    s->num_ranges   = 0;
+    s->alloc_ranges = 0;
 }
 
 void ossl_uint_set_destroy(UINT_SET *s)
 {
-    UINT_SET_ITEM *x, *xnext;
-
-    for (x = ossl_list_uint_set_head(s); x != NULL; x = xnext) {
-        xnext = ossl_list_uint_set_next(x);
-        OPENSSL_free(x);
-    }
+    OPENSSL_free(s->ranges);
+    ossl_uint_set_init(s);
 }
 
-/* Possible merge of x, prev(x) */
-static void uint_set_merge_adjacent(UINT_SET *s, UINT_SET_ITEM *x)
+/* Ensures there is room for at least one more range in the array. */
+static int uint_set_reserve_one(UINT_SET *s)
 {
-    UINT_SET_ITEM *xprev = ossl_list_uint_set_prev(x);
+    UINT_RANGE *ranges;
+    size_t alloc_ranges;
 
-    if (xprev == NULL)
-        return;
+    if (s->num_ranges < s->alloc_ranges)
+        return 1;
 
-    if (x->range.start - 1 != xprev->range.end)
-        return;
+    alloc_ranges = s->alloc_ranges == 0 ? MIN_ALLOC_RANGES
+                                        : s->alloc_ranges * 2;
+    if (alloc_ranges < s->alloc_ranges)
+        return 0;
 
-    x->range.start = xprev->range.start;
-    ossl_list_uint_set_remove(s, xprev);
-    OPENSSL_free(xprev);
-}
+    ranges = OPENSSL_realloc(s->ranges, alloc_ranges * sizeof(*ranges));
+    if (ranges == NULL)
+        return 0;
 
-static uint64_t u64_min(uint64_t x, uint64_t y)
-{
-    return x < y ? x : y;
+    s->ranges       = ranges;
+    s->alloc_ranges = alloc_ranges;
+    return 1;
 }
 
-static uint64_t u64_max(uint64_t x, uint64_t y)
+/* Returns the index of the first range with end >= v, or num_ranges. */
+static size_t uint_set_first_ending_at_or_after(const UINT_SET *s, uint64_t v)
 {
-    return x > y ? x : y;
+    size_t lo = 0, hi = s->num_ranges, mid;
+
+    /* Fast path: operations are most often at the end of the set. */
+    if (hi == 0 || s->ranges[hi - 1].end < v)
+        return hi;
+
+    if (hi >= 2 && s->ranges[hi - 2].end < v)
+        return hi - 1;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (s->ranges[mid].end < v)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
 }
 
-/*
- * Returns 1 if there exists an integer x which falls within both ranges a and
- * b.
- */
-static int uint_range_overlaps(const UINT_RANGE *a,
-                               const UINT_RANGE *b)
+/* Returns the index of the first range with start > v, or num_ranges. */
+static size_t uint_set_first_starting_after(const UINT_SET *s, uint64_t v)
 {
-    return u64_min(a->end, b->end)
-        >= u64_max(a->start, b->start);
+    size_t lo = 0, hi = s->num_ranges, mid;
+
+    if (hi == 0 || s->ranges[hi - 1].start <= v)
+        return hi;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (s->ranges[mid].start <= v)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
 }
 
-static UINT_SET_ITEM *create_set_item(uint64_t start, uint64_t end)
+/* Removes ranges [first, last) from the array. */
+static void uint_set_erase(UINT_SET *s, size_t first, size_t last)
 {
-    UINT_SET_ITEM *x = OPENSSL_malloc(sizeof(UINT_SET_ITEM));
-
-    if (x == NULL)
-        return NULL;
+    if (first >= last)
+        return;
 
-    ossl_list_uint_set_init_elem(x);
-    x->range.start = start;
-    x->range.end   = end;
-    return x;
+    memmove(&s->ranges[first], &s->ranges[last],
+            (s->num_ranges - last) * sizeof(UINT_RANGE));
+    s->num_ranges -= last - first;
 }
 
 int ossl_uint_set_insert(UINT_SET *s, const UINT_RANGE *range)
 {
-    UINT_SET_ITEM *x, *xnext, *z, *zprev, *f;
     uint64_t start = range->start, end = range->end;
+    size_t i, j;
 
     if (!ossl_assert(start <= end))
         return 0;
 
-    if (ossl_list_uint_set_is_empty(s)) {
-        /* Nothing in the set yet, so just add this range. */
-        x = create_set_item(start, end);
-        if (x == NULL)
-            return 0;
-        ossl_list_uint_set_insert_head(s, x);
-        return 1;
-    }
+    /*
+     * Find the ranges [i, j) which overlap or border the new range. These are
+     * all merged into a single range.
+     */
+    i = uint_set_first_ending_at_or_after(s, start > 0 ? start - 1 : 0);
+    j = end < UINT64_MAX ? uint_set_first_starting_after(s, end + 1)
+                         : s->num_ranges;
 
-    z = ossl_list_uint_set_tail(s);
-    if (start > z->range.end) {
+    if (i == j) {
         /*
-         * Range is after the latest range in the set, so append.
-         *
-         * Note: The case where the range is before the earliest range in the
-         * set is handled as a degenerate case of the final case below. See
-         * optimization note (*) below.
+         * The new range does not touch any existing range, so insert it in
+         * between, preserving sort.
          */
-        if (z->range.end + 1 == start) {
-            z->range.end = end;
-            return 1;
-        }
-
-        x = create_set_item(start, end);
-        if (x == NULL)
+        if (!uint_set_reserve_one(s))
             return 0;
-        ossl_list_uint_set_insert_tail(s, x);
-        return 1;
-    }
 
-    f = ossl_list_uint_set_head(s);
-    if (start <= f->range.start && end >= z->range.end) {
-        /*
-         * New range dwarfs all ranges in our set.
-         *
-         * Free everything except the first range in the set, which we scavenge
-         * and reuse.
-         */
-        x = ossl_list_uint_set_head(s);
-        x->range.start = start;
-        x->range.end = end;
-        for (x = ossl_list_uint_set_next(x); x != NULL; x = xnext) {
-            xnext = ossl_list_uint_set_next(x);
-            ossl_list_uint_set_remove(s, x);
-        }
+        memmove(&s->ranges[i + 1], &s->ranges[i],
+                (s->num_ranges - i) * sizeof(UINT_RANGE));
+        s->ranges[i].start = start;
+        s->ranges[i].end   = end;
+        ++s->num_ranges;
         return 1;
     }
 
-    /*
-     * Walk backwards since we will most often be inserting at the end. As an
-     * optimization, test the head node first and skip iterating over the
-     * entire list if we are inserting at the start. The assumption is that
-     * insertion at the start and end of the space will be the most common
-     * operations. (*)
-     */
-    z = end < f->range.start ? f : z;
-
-    for (; z != NULL; z = zprev) {
-        zprev = ossl_list_uint_set_prev(z);
-
-        /* An existing range dwarfs our new range (optimisation). */
-        if (z->range.start <= start && z->range.end >= end)
-            return 1;
-
-        if (uint_range_overlaps(&z->range, range)) {
-            /*
-             * Our new range overlaps an existing range, or possibly several
-             * existing ranges.
-             */
-            UINT_SET_ITEM *ovend = z;
-
-            ovend->range.end = u64_max(end, z->range.end);
-
-            /* Get earliest overlapping range. */
-            while (zprev != NULL && uint_range_overlaps(&zprev->range, range)) {
-                z = zprev;
-                zprev = ossl_list_uint_set_prev(z);
-            }
-
-            ovend->range.start = u64_min(start, z->range.start);
-
-            /* Replace sequence of nodes z..ovend with updated ovend only. */
-            while (z != ovend) {
-                z = ossl_list_uint_set_next(x = z);
-                ossl_list_uint_set_remove(s, x);
-                OPENSSL_free(x);
-            }
-            break;
-        } else if (end < z->range.start
-                    && (zprev == NULL || start > zprev->range.end)) {
-            if (z->range.start == end + 1) {
-                /* We can extend the following range backwards. */
-                z->range.start = start;
-
-                /*
-                 * If this closes a gap we now need to merge
-                 * consecutive nodes.
-                 */
-                uint_set_merge_adjacent(s, z);
-            } else if (zprev != NULL && zprev->range.end + 1 == start) {
-                /* We can extend the preceding range forwards. */
-                zprev->range.end = end;
-
-                /*
-                 * If this closes a gap we now need to merge
-                 * consecutive nodes.
-                 */
-                uint_set_merge_adjacent(s, z);
-            } else {
-                /*
-                 * The new interval is between intervals without overlapping or
-                 * touching them, so insert between, preserving sort.
-                 */
-                x = create_set_item(start, end);
-                if (x == NULL)
-                    return 0;
-                ossl_list_uint_set_insert_before(s, z, x);
-            }
-            break;
-        }
-    }
+    /* Widen the first range to cover everything and drop the rest. */
+    if (start < s->ranges[i].start)
+        s->ranges[i].start = start;
 
+    s->ranges[i].end = end > s->ranges[j - 1].end ? end : s->ranges[j - 1].end;
+    uint_set_erase(s, i + 1, j);
     return 1;
 }
 
 int ossl_uint_set_remove(UINT_SET *s, const UINT_RANGE *range)
 {
-    UINT_SET_ITEM *z, *zprev, *y;
     uint64_t start = range->start, end = range->end;
+    size_t i, j, first, last;
 
     if (!ossl_assert(start <= end))
         return 0;
 
-    /* Walk backwards since we will most often be removing at the end. */
-    for (z = ossl_list_uint_set_tail(s); z != NULL; z = zprev) {
-        zprev = ossl_list_uint_set_prev(z);
-
-        if (start > z->range.end)
-            /* No overlapping ranges can exist beyond this point, so stop. */
-            break;
-
-        if (start <= z->range.start && end >= z->range.end) {
-            /*
-             * The range being removed dwarfs this range, so it should be
-             * removed.
-             */
-            ossl_list_uint_set_remove(s, z);
-            OPENSSL_free(z);
-        } else if (start <= z->range.start && end >= z->range.start) {
-            /*
-             * The range being removed includes start of this range, but does
-             * not cover the entire range (as this would be caught by the case
-             * above). Shorten the range.
-             */
-            assert(end < z->range.end);
-            z->range.start = end + 1;
-        } else if (end >= z->range.end) {
-            /*
-             * The range being removed includes the end of this range, but does
-             * not cover the entire range (as this would be caught by the case
-             * above). Shorten the range. We can also stop iterating.
-             */
-            assert(start > z->range.start);
-            assert(start > 0);
-            z->range.end = start - 1;
-            break;
-        } else if (start > z->range.start && end < z->range.end) {
-            /*
-             * The range being removed falls entirely in this range, so cut it
-             * into two. Cases where a zero-length range would be created are
-             * handled by the above cases.
-             */
-            y = create_set_item(end + 1, z->range.end);
-            ossl_list_uint_set_insert_after(s, z, y);
-            z->range.end = start - 1;
-            break;
-        } else {
-            /* Assert no partial overlap; all cases should be covered above. */
-            assert(!uint_range_overlaps(&z->range, range));
-        }
+    /* Find the ranges [i, j) which overlap the range being removed. */
+    i = uint_set_first_ending_at_or_after(s, start);
+    j = uint_set_first_starting_after(s, end);
+
+    if (i >= j)
+        return 1;
+
+    if (j - i == 1 && s->ranges[i].start < start && s->ranges[i].end > end) {
+        /*
+         * The range being removed falls entirely in this range, so cut it
+         * into two. Cases where a zero-length range would be created are
+         * handled below.
+         */
+        if (!uint_set_reserve_one(s))
+            return 0;
+
+        memmove(&s->ranges[i + 1], &s->ranges[i],
+                (s->num_ranges - i) * sizeof(UINT_RANGE));
+        ++s->num_ranges;
+        s->ranges[i].end       = start - 1;
+        s->ranges[i + 1].start = end + 1;
+        return 1;
+    }
+
+    /*
+     * Shorten the first and last overlapping ranges if they extend beyond the
+     * range being removed, and remove all of the others outright.
+     */
+    first = i;
+    if (s->ranges[i].start < start) {
+        s->ranges[i].end = start - 1;
+        ++first;
     }
 
+    last = j;
+    if (s->ranges[j - 1].end > end) {
+        s->ranges[j - 1].start = end + 1;
+        --last;
+    }
+
+    uint_set_erase(s, first, last);
     return 1;
 }
 
 int ossl_uint_set_query(const UINT_SET *s, uint64_t v)
 {
-    UINT_SET_ITEM *x;
-
-    if (ossl_list_uint_set_is_empty(s))
-        return 0;
-
-    for (x = ossl_list_uint_set_tail(s); x != NULL; x = ossl_list_uint_set_prev(x))
-        if (x->range.start <= v && x->range.end >= v)
-            return 1;
-        else if (x->range.end < v)
-            return 0;
+    size_t i = uint_set_first_ending_at_or_after(s, v);
 
-    return 0;
+    return i < s->num_ranges && s->ranges[i].start <= v;
 }
@@ -4213,6 +4213,10 @@ void SSL_CTX_free(SSL_CTX *a)
     OPENSSL_free(a->client_cert_type);
     OPENSSL_free(a->server_cert_type);
 
+#ifndef OPENSSL_NO_OCSP
+    ssl_ctx_free_ocsp_staples(a);
+#endif
+
     CRYPTO_THREAD_lock_free(a->lock);
     CRYPTO_FREE_REF(&a->references);
 #ifdef TSAN_REQUIRES_LOCKING
@@ -7328,6 +7332,65 @@ int SSL_get_event_timeout(SSL *s, struct timeval *tv, int *is_infinite)
     return 1;
 }
 
+int SSL_handle_events_many(SSL **ssls, size_t num_ssls,
+                           struct timeval *tv, int *is_infinite)
+{
+    size_t i;
+    int ok = 1, have_timeout = 0, cur_infinite, r;
+    struct timeval cur, min_tv = {0, 0};
+
+    if ((ssls == NULL && num_ssls > 0)
+        || (tv == NULL) != (is_infinite == NULL)) {
+        ERR_raise(ERR_LIB_SSL, ERR_R_PASSED_NULL_PARAMETER);
+        return 0;
+    }
+
+    for (i = 0; i < num_ssls; ++i) {
+        if (ssls[i] == NULL)
+            continue;
+
+#ifndef OPENSSL_NO_QUIC
+        if (IS_QUIC(ssls[i]))
+            r = ossl_quic_handle_events_timeout(ssls[i], &cur, &cur_infinite);
+        else
+#endif
+            r = SSL_handle_events(ssls[i])
+                && SSL_get_event_timeout(ssls[i], &cur, &cur_infinite);
+
+        /*
+         * A failure on one object must not prevent the remaining objects from
+         * being serviced; we report it in the return value only.
+         */
+        if (!r) {
+            ok = 0;
+            continue;
+        }
+
+        if (cur_infinite)
+            continue;
+
+        if (!have_timeout
+            || cur.tv_sec < min_tv.tv_sec
+            || (cur.tv_sec == min_tv.tv_sec && cur.tv_usec < min_tv.tv_usec)) {
+            min_tv = cur;
+            have_timeout = 1;
+        }
+    }
+
+    if (tv != NULL && is_infinite != NULL) {
+        if (have_timeout) {
+            *tv = min_tv;
+            *is_infinite = 0;
+        } else {
+            tv->tv_sec  = 1000000;
+            tv->tv_usec = 0;
+            *is_infinite = 1;
+        }
+    }
+
+    return ok;
+}
+
 int SSL_get_rpoll_descriptor(SSL *s, BIO_POLL_DESCRIPTOR *desc)
 {
     SSL_CONNECTION *sc = SSL_CONNECTION_FROM_SSL(s);
@@ -7444,6 +7507,36 @@ int SSL_stream_conclude(SSL *ssl, uint64_t flags)
 #endif
 }
 
+int SSL_get0_read_buffer(SSL *ssl, const unsigned char **buf, size_t *len)
+{
+#ifndef OPENSSL_NO_QUIC
+    if (!IS_QUIC(ssl)) {
+        ERR_raise(ERR_LIB_SSL, SSL_R_WRONG_SSL_VERSION);
+        return 0;
+    }
+
+    return ossl_quic_get0_read_buffer(ssl, buf, len);
+#else
+    ERR_raise(ERR_LIB_SSL, SSL_R_WRONG_SSL_VERSION);
+    return 0;
+#endif
+}
+
+int SSL_release_read_buffer(SSL *ssl, size_t bytes_read)
+{
+#ifndef OPENSSL_NO_QUIC
+    if (!IS_QUIC(ssl)) {
+        ERR_raise(ERR_LIB_SSL, SSL_R_WRONG_SSL_VERSION);
+        return 0;
+    }
+
+    return ossl_quic_release_read_buffer(ssl, bytes_read);
+#else
+    ERR_raise(ERR_LIB_SSL, SSL_R_WRONG_SSL_VERSION);
+    return 0;
+#endif
+}
+
 SSL *SSL_new_stream(SSL *s, uint64_t flags)
 {
 #ifndef OPENSSL_NO_QUIC
@@ -725,6 +725,8 @@ typedef struct ssl_ctx_ext_secure_st {
     unsigned char tick_aes_key[TLSEXT_TICK_KEY_LENGTH];
 } SSL_CTX_EXT_SECURE;
 
+typedef struct ssl_ocsp_staple_st SSL_OCSP_STAPLE;
+
 /*
  * Helper function for HMAC
  * The structure should be considered opaque, it will change once the low
@@ -1023,6 +1025,13 @@ struct ssl_ctx_st {
         void *status_arg;
         /* ext status type used for CSR extension (OCSP Stapling) */
         int status_type;
+# ifndef OPENSSL_NO_OCSP
+        /* OCSP responses to staple for our certificates, protected by lock */
+        SSL_OCSP_STAPLE *staples;
+        size_t num_staples;
+        SSL_CTX_ocsp_staple_refresh_cb_fn staple_refresh_cb;
+        void *staple_refresh_arg;
+# endif
         /* RFC 4366 Maximum Fragment Length Negotiation */
         uint8_t max_fragment_len_mode;
 
@@ -2470,6 +2479,11 @@ __owur CERT *ssl_cert_new(size_t ssl_pkey_num);
 __owur CERT *ssl_cert_dup(CERT *cert);
 void ssl_cert_clear_certs(CERT *c);
 void ssl_cert_free(CERT *c);
+# ifndef OPENSSL_NO_OCSP
+__owur int ssl_ctx_get_ocsp_staple(SSL_CTX *ctx, X509 *x, unsigned char **resp,
+                                   size_t *resp_len);
+void ssl_ctx_free_ocsp_staples(SSL_CTX *ctx);
+# endif
 __owur int ssl_generate_session_id(SSL_CONNECTION *s, SSL_SESSION *ss);
 __owur int ssl_get_new_session(SSL_CONNECTION *s, int session);
 __owur SSL_SESSION *lookup_sess_in_cache(SSL_CONNECTION *s,
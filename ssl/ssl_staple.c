@@ -0,0 +1,247 @@
+/*
+ * Copyright 2023 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+#include <openssl/ocsp.h>
+#include "ssl_local.h"
+#include "internal/time.h"
+
+#ifndef OPENSSL_NO_OCSP
+
+/*
+ * A DER encoded OCSP response stapled for a certificate of the SSL_CTX,
+ * handed out to handshakes until |expire| and due to be replaced from
+ * |refresh| onwards.
+ */
+struct ssl_ocsp_staple_st {
+    X509 *x;
+    unsigned char *resp;
+    size_t resp_len;
+    OSSL_TIME refresh;
+    OSSL_TIME expire;
+    int refresh_requested;
+};
+
+/* Returns the number of seconds from now until |t|, which may be negative */
+static int seconds_from_now(const ASN1_TIME *t, int64_t *secs)
+{
+    int days, s;
+
+    if (!ASN1_TIME_diff(&days, &s, NULL, t))
+        return 0;
+    *secs = (int64_t)days * 24 * 60 * 60 + s;
+    return 1;
+}
+
+static OSSL_TIME time_from_now(OSSL_TIME now, int64_t secs)
+{
+    if (secs <= 0)
+        return now;
+    return ossl_time_add(now, ossl_seconds2time(secs));
+}
+
+/*
+ * Works out when the staple |resp| should be refreshed and when it expires.
+ * It expires at the earliest nextUpdate of its single responses, and is
+ * refreshed halfway between the thisUpdate and nextUpdate of that response.
+ * A response without a nextUpdate never needs refreshing.
+ */
+static int staple_deadlines(const unsigned char *resp, size_t resp_len,
+                            OSSL_TIME *refresh, OSSL_TIME *expire)
+{
+    OCSP_RESPONSE *rsp = NULL;
+    OCSP_BASICRESP *bs = NULL;
+    ASN1_GENERALIZEDTIME *thisupd, *nextupd;
+    OSSL_TIME now = ossl_time_now();
+    int64_t this_secs, next_secs, min_next = 0;
+    int i, num, have_next = 0, ret = 0;
+
+    *refresh = *expire = ossl_time_infinite();
+    if (resp_len > LONG_MAX
+            || (rsp = d2i_OCSP_RESPONSE(NULL, &resp, (long)resp_len)) == NULL
+            || OCSP_response_status(rsp) != OCSP_RESPONSE_STATUS_SUCCESSFUL
+            || (bs = OCSP_response_get1_basic(rsp)) == NULL
+            || (num = OCSP_resp_count(bs)) <= 0)
+        goto err;
+
+    for (i = 0; i < num; i++) {
+        if (OCSP_single_get0_status(OCSP_resp_get0(bs, i), NULL, NULL,
+                                    &thisupd, &nextupd) < 0
+                || !seconds_from_now(thisupd, &this_secs))
+            goto err;
+        if (nextupd == NULL)
+            continue;
+        if (!seconds_from_now(nextupd, &next_secs))
+            goto err;
+        if (!have_next || next_secs < min_next) {
+            have_next = 1;
+            min_next = next_secs;
+            *refresh = time_from_now(now,
+                                     this_secs + (next_secs - this_secs) / 2);
+        }
+    }
+    if (have_next) {
+        /* There's no point in stapling a response that has already expired */
+        if (min_next <= 0)
+            goto err;
+        *expire = time_from_now(now, min_next);
+    }
+    ret = 1;
+ err:
+    OCSP_BASICRESP_free(bs);
+    OCSP_RESPONSE_free(rsp);
+    return ret;
+}
+
+/* Must be called with ctx->lock held */
+static SSL_OCSP_STAPLE *staple_find(SSL_CTX *ctx, X509 *x)
+{
+    size_t i;
+
+    /* Normally |x| is the very certificate that the staple was set for */
+    for (i = 0; i < ctx->ext.num_staples; i++)
+        if (ctx->ext.staples[i].x == x)
+            return &ctx->ext.staples[i];
+    for (i = 0; i < ctx->ext.num_staples; i++)
+        if (X509_cmp(ctx->ext.staples[i].x, x) == 0)
+            return &ctx->ext.staples[i];
+    return NULL;
+}
+
+int SSL_CTX_set1_ocsp_staple(SSL_CTX *ctx, X509 *x,
+                             const unsigned char *resp, size_t resp_len)
+{
+    SSL_OCSP_STAPLE *staple, *tmp;
+    unsigned char *copy = NULL;
+    OSSL_TIME refresh, expire;
+
+    if (ctx == NULL || x == NULL) {
+        ERR_raise(ERR_LIB_SSL, ERR_R_PASSED_NULL_PARAMETER);
+        return 0;
+    }
+
+    if (resp != NULL) {
+        if (!staple_deadlines(resp, resp_len, &refresh, &expire)) {
+            ERR_raise(ERR_LIB_SSL, SSL_R_INVALID_OCSP_RESPONSE);
+            return 0;
+        }
+        if ((copy = OPENSSL_memdup(resp, resp_len)) == NULL)
+            return 0;
+    }
+
+    if (!CRYPTO_THREAD_write_lock(ctx->lock)) {
+        OPENSSL_free(copy);
+        return 0;
+    }
+    staple = staple_find(ctx, x);
+    if (copy == NULL) {
+        /* Remove any staple for |x| by moving the last one into its place */
+        if (staple != NULL) {
+            X509_free(staple->x);
+            OPENSSL_free(staple->resp);
+            *staple = ctx->ext.staples[--ctx->ext.num_staples];
+        }
+        CRYPTO_THREAD_unlock(ctx->lock);
+        return 1;
+    }
+
+    if (staple == NULL) {
+        tmp = OPENSSL_realloc(ctx->ext.staples,
+                              (ctx->ext.num_staples + 1) * sizeof(*tmp));
+        if (tmp == NULL) {
+            CRYPTO_THREAD_unlock(ctx->lock);
+            OPENSSL_free(copy);
+            return 0;
+        }
+        ctx->ext.staples = tmp;
+        staple = &tmp[ctx->ext.num_staples++];
+        X509_up_ref(x);
+        staple->x = x;
+    } else {
+        OPENSSL_free(staple->resp);
+    }
+    staple->resp = copy;
+    staple->resp_len = resp_len;
+    staple->refresh = refresh;
+    staple->expire = expire;
+    staple->refresh_requested = 0;
+    CRYPTO_THREAD_unlock(ctx->lock);
+    return 1;
+}
+
+void SSL_CTX_set_ocsp_staple_refresh_cb(SSL_CTX *ctx,
+                                        SSL_CTX_ocsp_staple_refresh_cb_fn cb,
+                                        void *arg)
+{
+    ctx->ext.staple_refresh_cb = cb;
+    ctx->ext.staple_refresh_arg = arg;
+}
+
+/*
+ * Copies the staple cached for |x| into |*resp|, unless it has expired.
+ * Asks the application to refresh it, once, when its refresh time has come.
+ * Returns 1 on success, 0 if there is no staple to send, or -1 on error.
+ */
+int ssl_ctx_get_ocsp_staple(SSL_CTX *ctx, X509 *x, unsigned char **resp,
+                            size_t *resp_len)
+{
+    SSL_OCSP_STAPLE *staple;
+    OSSL_TIME now;
+    int ret = 0, refresh = 0;
+
+    now = ossl_time_now();
+    if (!CRYPTO_THREAD_read_lock(ctx->lock))
+        return -1;
+    if ((staple = staple_find(ctx, x)) != NULL) {
+        refresh = !staple->refresh_requested
+            && ossl_time_compare(now, staple->refresh) >= 0;
+        if (ossl_time_compare(now, staple->expire) < 0) {
+            if ((*resp = OPENSSL_memdup(staple->resp,
+                                        staple->resp_len)) == NULL)
+                ret = -1;
+            else
+                ret = 1;
+            *resp_len = staple->resp_len;
+        }
+    }
+    CRYPTO_THREAD_unlock(ctx->lock);
+
+    if (!refresh || ctx->ext.staple_refresh_cb == NULL)
+        return ret;
+
+    /*
+     * Only one of the handshakes that notice a staple is due asks for it, and
+     * not if it has been replaced in the meantime
+     */
+    if (!CRYPTO_THREAD_write_lock(ctx->lock))
+        return ret;
+    staple = staple_find(ctx, x);
+    refresh = staple != NULL && !staple->refresh_requested
+        && ossl_time_compare(now, staple->refresh) >= 0;
+    if (refresh)
+        staple->refresh_requested = 1;
+    CRYPTO_THREAD_unlock(ctx->lock);
+    if (refresh)
+        ctx->ext.staple_refresh_cb(ctx, x, ctx->ext.staple_refresh_arg);
+    return ret;
+}
+
+void ssl_ctx_free_ocsp_staples(SSL_CTX *ctx)
+{
+    size_t i;
+
+    for (i = 0; i < ctx->ext.num_staples; i++) {
+        X509_free(ctx->ext.staples[i].x);
+        OPENSSL_free(ctx->ext.staples[i].resp);
+    }
+    OPENSSL_free(ctx->ext.staples);
+    ctx->ext.staples = NULL;
+    ctx->ext.num_staples = 0;
+}
+
+#endif
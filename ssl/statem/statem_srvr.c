@@ -2162,6 +2162,29 @@ static int tls_handle_status_request(SSL_CONNECTION *s)
 
     s->ext.status_expected = 0;
 
+#ifndef OPENSSL_NO_OCSP
+    /* A staple cached for the certificate we will use needs no callback */
+    if (s->ext.status_type == TLSEXT_STATUSTYPE_ocsp && sctx != NULL
+            && s->s3.tmp.cert != NULL && s->s3.tmp.cert->x509 != NULL) {
+        unsigned char *resp = NULL;
+        size_t resp_len = 0;
+        int ret = ssl_ctx_get_ocsp_staple(sctx, s->s3.tmp.cert->x509, &resp,
+                                          &resp_len);
+
+        if (ret < 0) {
+            SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_INTERNAL_ERROR);
+            return 0;
+        }
+        if (ret > 0) {
+            OPENSSL_free(s->ext.ocsp.resp);
+            s->ext.ocsp.resp = resp;
+            s->ext.ocsp.resp_len = resp_len;
+            s->ext.status_expected = 1;
+            return 1;
+        }
+    }
+#endif
+
     /*
      * If status request then ask callback what to do. Note: this must be
      * called after servername callbacks in case the certificate has changed,
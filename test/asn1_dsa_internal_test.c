@@ -1,5 +1,5 @@
 /*
- * Copyright 2019-2020 The OpenSSL Project Authors. All Rights Reserved.
+ * Copyright 2019-2023 The OpenSSL Project Authors. All Rights Reserved.
  *
  * Licensed under the Apache License 2.0 (the "License").  You may not use
  * this file except in compliance with the License.  You can obtain a copy
@@ -12,6 +12,8 @@
 
 #include <openssl/bn.h>
 #include "crypto/asn1_dsa.h"
+#include "internal/der.h"
+#include "internal/nelem.h"
 #include "testutil.h"
 
 static unsigned char t_dsa_sig[] = {
@@ -177,8 +179,141 @@ fail:
     return rv;
 }
 
+static const unsigned char t_der_all[] = {
+    0x30, 0x24,                  /* SEQUENCE tag + length */
+    0x01, 0x01, 0xff,            /* BOOLEAN tag + length + TRUE */
+    0xa1, 0x04,                  /* [1] tag + length */
+    0x02, 0x02, 0x00, 0x80,      /* INTEGER tag + length + content */
+    0x05, 0x00,                  /* NULL tag + length */
+    0x04, 0x02, 0x61, 0x62,      /* OCTET STRING tag + length + content */
+    0x03, 0x02, 0x04, 0xf0,      /* BIT STRING tag + length + content */
+    0x06, 0x06, 0x2a, 0x86, 0x48, 0x86, 0xf7, 0x0d, /* 1.2.840.113549 */
+    0x31, 0x07,                  /* SET tag + length */
+    0x02, 0x05, 0x00, 0xff, 0xff, 0xff, 0xff /* INTEGER 2^32 - 1 */
+};
+
+static int test_der_reader(void)
+{
+    PACKET pkt, seq, set, data;
+    unsigned int id, unused_bits;
+    uint32_t v1 = 0, v2 = 0;
+    int b = 0, before = test_alloc_count(), after;
+
+    if (!TEST_true(PACKET_buf_init(&pkt, t_der_all, sizeof(t_der_all)))
+        || !TEST_true(ossl_DER_r_peek_id(&pkt, &id))
+        || !TEST_uint_eq(id, DER_F_CONSTRUCTED | DER_P_SEQUENCE)
+        || !TEST_true(ossl_DER_r_sequence(&pkt, DER_NO_CONTEXT, &seq))
+        || !TEST_size_t_eq(PACKET_remaining(&pkt), 0)
+        || !TEST_true(ossl_DER_r_boolean(&seq, DER_NO_CONTEXT, &b))
+        || !TEST_false(ossl_DER_r_uint32(&seq, DER_NO_CONTEXT, &v1))
+        || !TEST_false(ossl_DER_r_uint32(&seq, 0, &v1))
+        || !TEST_true(ossl_DER_r_uint32(&seq, 1, &v1))
+        || !TEST_true(ossl_DER_r_null(&seq, DER_NO_CONTEXT))
+        || !TEST_true(ossl_DER_r_octet_string(&seq, DER_NO_CONTEXT, &data))
+        || !TEST_mem_eq(PACKET_data(&data), PACKET_remaining(&data), "ab", 2)
+        || !TEST_true(ossl_DER_r_bit_string(&seq, DER_NO_CONTEXT,
+                                            &unused_bits, &data))
+        || !TEST_ptr_eq(PACKET_data(&data), t_der_all + 20)
+        || !TEST_true(ossl_DER_r_oid(&seq, DER_NO_CONTEXT, &data))
+        || !TEST_ptr_eq(PACKET_data(&data), t_der_all + 23)
+        || !TEST_size_t_eq(PACKET_remaining(&data), 6)
+        || !TEST_true(ossl_DER_r_set(&seq, DER_NO_CONTEXT, &set))
+        || !TEST_true(ossl_DER_r_uint32(&set, DER_NO_CONTEXT, &v2))
+        || !TEST_size_t_eq(PACKET_remaining(&seq), 0))
+        return 0;
+    after = test_alloc_count();
+
+    /* Reading is done in place, so must never allocate */
+    return TEST_true(b)
+        && TEST_uint_eq(v1, 0x80)
+        && TEST_uint_eq(unused_bits, 4)
+        && TEST_uint_eq(v2, 0xffffffff)
+        && TEST_int_eq(after, before);
+}
+
+static int read_tlv(PACKET *pkt)
+{
+    unsigned int id;
+    PACKET content;
+
+    return ossl_DER_r_tlv(pkt, &id, &content);
+}
+
+static int read_boolean(PACKET *pkt)
+{
+    int b;
+
+    return ossl_DER_r_boolean(pkt, DER_NO_CONTEXT, &b);
+}
+
+static int read_uint32(PACKET *pkt)
+{
+    uint32_t v;
+
+    return ossl_DER_r_uint32(pkt, DER_NO_CONTEXT, &v);
+}
+
+static int read_bit_string(PACKET *pkt)
+{
+    unsigned int unused_bits;
+    PACKET data;
+
+    return ossl_DER_r_bit_string(pkt, DER_NO_CONTEXT, &unused_bits, &data);
+}
+
+static int read_oid(PACKET *pkt)
+{
+    PACKET oid;
+
+    return ossl_DER_r_oid(pkt, DER_NO_CONTEXT, &oid);
+}
+
+/* Things that are valid BER, or not even that, but not DER */
+static const struct {
+    const char *name;
+    unsigned char der[8];
+    size_t der_n;
+    int (*read)(PACKET *pkt);
+} t_not_der[] = {
+    { "indefinite length", { 0x30, 0x80, 0x00, 0x00 }, 4, read_tlv },
+    { "long form length", { 0x04, 0x81, 0x01, 0x61 }, 4, read_tlv },
+    { "padded length", { 0x04, 0x82, 0x00, 0x81 }, 4, read_tlv },
+    { "high tag number", { 0x1f, 0x81, 0x00, 0x00 }, 4, read_tlv },
+    { "truncated", { 0x04, 0x03, 0x61, 0x62 }, 4, read_tlv },
+    { "BOOLEAN 1", { 0x01, 0x01, 0x01 }, 3, read_boolean },
+    { "padded INTEGER", { 0x02, 0x02, 0x00, 0x01 }, 4, read_uint32 },
+    { "negative INTEGER", { 0x02, 0x01, 0x80 }, 3, read_uint32 },
+    { "large INTEGER", { 0x02, 0x05, 0x01, 0, 0, 0, 0 }, 7, read_uint32 },
+    { "unused bits set", { 0x03, 0x02, 0x04, 0xf8 }, 4, read_bit_string },
+    { "8 unused bits", { 0x03, 0x02, 0x08, 0x00 }, 4, read_bit_string },
+    { "padded OID", { 0x06, 0x02, 0x80, 0x01 }, 4, read_oid },
+    { "incomplete OID", { 0x06, 0x01, 0x86 }, 3, read_oid }
+};
+
+static int test_der_reader_not_der(int idx)
+{
+    PACKET pkt;
+
+    /* Failures leave the input where it was */
+    if (!TEST_true(PACKET_buf_init(&pkt, t_not_der[idx].der,
+                                   t_not_der[idx].der_n))
+            || !TEST_false(t_not_der[idx].read(&pkt))
+            || !TEST_size_t_eq(PACKET_remaining(&pkt), t_not_der[idx].der_n)) {
+        TEST_info("asn1_dsa test_der_reader_not_der: %s", t_not_der[idx].name);
+        return 0;
+    }
+    return 1;
+}
+
+int global_init(void)
+{
+    return test_alloc_count_init();
+}
+
 int setup_tests(void)
 {
     ADD_TEST(test_decode);
+    ADD_TEST(test_der_reader);
+    ADD_ALL_TESTS(test_der_reader_not_der, OSSL_NELEM(t_not_der));
     return 1;
 }
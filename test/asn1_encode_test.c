@@ -1,5 +1,5 @@
 /*
- * Copyright 2017-2021 The OpenSSL Project Authors. All Rights Reserved.
+ * Copyright 2017-2023 The OpenSSL Project Authors. All Rights Reserved.
  *
  * Licensed under the Apache License 2.0 (the "License").  You may not use
  * this file except in compliance with the License.  You can obtain a copy
@@ -12,6 +12,7 @@
 
 #include <openssl/rand.h>
 #include <openssl/asn1t.h>
+#include <openssl/err.h>
 #include "internal/numbers.h"
 #include "testutil.h"
 
@@ -892,6 +893,262 @@ static int test_invalid_template(void)
     return ret < 0;
 }
 
+/***** Nested constructed encodings ******************************************/
+
+typedef struct enc_node_st ENC_NODE;
+struct enc_node_st {
+    int32_t value;
+    STACK_OF(ASN1_INTEGER) *set;
+    ENC_NODE *child;
+};
+
+static const ASN1_ITEM *ENC_NODE_it(void);
+
+ASN1_SEQUENCE(ENC_NODE) = {
+    ASN1_EMBED(ENC_NODE, value, INT32),
+    ASN1_SET_OF(ENC_NODE, set, ASN1_INTEGER),
+    ASN1_EXP_OPT(ENC_NODE, child, ENC_NODE, 0)
+} static_ASN1_SEQUENCE_END(ENC_NODE)
+
+IMPLEMENT_STATIC_ASN1_ENCODE_FUNCTIONS(ENC_NODE)
+IMPLEMENT_STATIC_ASN1_ALLOC_FUNCTIONS(ENC_NODE)
+
+static const unsigned char t_enc_nodes[] = {
+    0x30, 0x14,                         /* SEQUENCE */
+    0x02, 0x01, 0x01,                   /* INTEGER 1 */
+    0x31, 0x06,                         /* SET, sorted */
+    0x02, 0x01, 0x02,                   /* INTEGER 2 */
+    0x02, 0x01, 0x03,                   /* INTEGER 3 */
+    0xa0, 0x07,                         /* [0] */
+    0x30, 0x05,                         /* SEQUENCE */
+    0x02, 0x01, 0x02,                   /* INTEGER 2 */
+    0x31, 0x00                          /* SET */
+};
+
+/*
+ * Makes a chain of |depth| nodes, each with a SET of |num| INTEGERs which are
+ * in order for every other node.
+ */
+static ENC_NODE *make_enc_nodes(int depth, int num)
+{
+    ENC_NODE *root = NULL, **next = &root;
+    ASN1_INTEGER *n = NULL;
+    int i, j;
+
+    for (i = 1; i <= depth; i++, next = &(*next)->child) {
+        if (!TEST_ptr(*next = ENC_NODE_new())
+            || !TEST_ptr((*next)->set = sk_ASN1_INTEGER_new_null()))
+            goto err;
+        (*next)->value = i;
+        for (j = 0; j < num; j++) {
+            if (!TEST_ptr(n = ASN1_INTEGER_new())
+                || !TEST_true(ASN1_INTEGER_set(n, i % 2 == 0 ? j : num - j))
+                || !TEST_true(sk_ASN1_INTEGER_push((*next)->set, n)))
+                goto err;
+            n = NULL;
+        }
+    }
+    return root;
+ err:
+    ASN1_INTEGER_free(n);
+    ENC_NODE_free(root);
+    return NULL;
+}
+
+static void enc_node_free(ENC_NODE *node)
+{
+    ENC_NODE *child;
+
+    for (; node != NULL; node = child) {
+        child = node->child;
+        node->child = NULL;
+        ENC_NODE_free(node);
+    }
+}
+
+static int test_nested_encoding(void)
+{
+    static const int depths[] = { 2, 10, 200 };
+    ENC_NODE *root = NULL, *decoded = NULL, *node;
+    ASN1_INTEGER *n = NULL;
+    unsigned char *der = NULL, *buf = NULL, *p;
+    const unsigned char *q;
+    long prev;
+    size_t i;
+    int j, len, testresult = 0;
+
+    /* The SETs come out sorted and the EXPLICIT tag around each child */
+    if (!TEST_ptr(root = make_enc_nodes(2, 0)))
+        goto err;
+    for (j = 3; j > 1; j--)
+        if (!TEST_ptr(n = ASN1_INTEGER_new())
+            || !TEST_true(ASN1_INTEGER_set(n, j))
+            || !TEST_true(sk_ASN1_INTEGER_push(root->set, n)))
+            goto err;
+    n = NULL;
+    if (!TEST_int_eq(len = i2d_ENC_NODE(root, &der), sizeof(t_enc_nodes))
+        || !TEST_mem_eq(der, len, t_enc_nodes, sizeof(t_enc_nodes)))
+        goto err;
+    enc_node_free(root);
+    root = NULL;
+    OPENSSL_free(der);
+    der = NULL;
+
+    for (i = 0; i < OSSL_NELEM(depths); i++) {
+        /* Allocated and caller supplied output buffers must agree */
+        if (!TEST_ptr(root = make_enc_nodes(depths[i], 20))
+            || !TEST_int_gt(len = i2d_ENC_NODE(root, NULL), 0)
+            || !TEST_int_eq(i2d_ENC_NODE(root, &der), len)
+            || !TEST_ptr(buf = OPENSSL_malloc(len)))
+            goto err;
+        p = buf;
+        if (!TEST_int_eq(i2d_ENC_NODE(root, &p), len)
+            || !TEST_ptr_eq(p, buf + len)
+            || !TEST_mem_eq(buf, len, der, len))
+            goto err;
+
+        /* Decoding limits how deeply things are nested */
+        if (depths[i] <= 10) {
+            q = der;
+            if (!TEST_ptr(decoded = d2i_ENC_NODE(NULL, &q, len))
+                || !TEST_ptr_eq(q, der + len))
+                goto err;
+            for (node = decoded; node != NULL; node = node->child) {
+                prev = -1;
+                for (j = 0; j < sk_ASN1_INTEGER_num(node->set); j++) {
+                    if (!TEST_long_gt(ASN1_INTEGER_get(
+                                          sk_ASN1_INTEGER_value(node->set, j)),
+                                      prev))
+                        goto err;
+                    prev = ASN1_INTEGER_get(sk_ASN1_INTEGER_value(node->set,
+                                                                  j));
+                }
+            }
+            OPENSSL_free(buf);
+            buf = NULL;
+            if (!TEST_int_eq(i2d_ENC_NODE(decoded, &buf), len)
+                || !TEST_mem_eq(buf, len, der, len))
+                goto err;
+            enc_node_free(decoded);
+            decoded = NULL;
+        }
+        enc_node_free(root);
+        root = NULL;
+        OPENSSL_free(der);
+        der = NULL;
+        OPENSSL_free(buf);
+        buf = NULL;
+    }
+
+    testresult = 1;
+ err:
+    ASN1_INTEGER_free(n);
+    enc_node_free(root);
+    enc_node_free(decoded);
+    OPENSSL_free(der);
+    OPENSSL_free(buf);
+    return testresult;
+}
+
+
+/*
+ * A member that cannot be encoded, as it is defined by a type it has no
+ * template for, is left out if it is OPTIONAL.  Lengths recorded for what
+ * comes before and after must still line up.
+ */
+typedef struct enc_adb_st {
+    ENC_NODE *node;
+    ASN1_INTEGER *type;
+    ASN1_INTEGER *value;
+} ENC_ADB;
+
+ASN1_ADB(ENC_ADB) = {
+    ADB_ENTRY(1, ASN1_SIMPLE(ENC_ADB, value, ASN1_INTEGER))
+} ASN1_ADB_END(ENC_ADB, 0, type, 0, NULL, NULL);
+
+ASN1_SEQUENCE(ENC_ADB) = {
+    ASN1_SIMPLE(ENC_ADB, node, ENC_NODE),
+    ASN1_SIMPLE(ENC_ADB, type, ASN1_INTEGER),
+    ASN1_ADB_INTEGER(ENC_ADB)
+} static_ASN1_SEQUENCE_END(ENC_ADB)
+
+IMPLEMENT_STATIC_ASN1_ALLOC_FUNCTIONS(ENC_ADB)
+
+typedef struct enc_opt_st {
+    ENC_NODE *first;
+    ENC_ADB *adb;
+    ENC_NODE *last;
+} ENC_OPT;
+
+ASN1_SEQUENCE(ENC_OPT) = {
+    ASN1_SIMPLE(ENC_OPT, first, ENC_NODE),
+    ASN1_EXP_OPT(ENC_OPT, adb, ENC_ADB, 0),
+    ASN1_SIMPLE(ENC_OPT, last, ENC_NODE)
+} static_ASN1_SEQUENCE_END(ENC_OPT)
+
+IMPLEMENT_STATIC_ASN1_ENCODE_FUNCTIONS(ENC_OPT)
+IMPLEMENT_STATIC_ASN1_ALLOC_FUNCTIONS(ENC_OPT)
+
+static int test_unencodable_optional(void)
+{
+    ENC_OPT *opt = NULL, *decoded = NULL;
+    ENC_ADB *adb = NULL;
+    unsigned char *der = NULL, *der_adb = NULL, *buf = NULL, *p;
+    const unsigned char *q;
+    int len, adb_len, testresult = 0;
+
+    if (!TEST_ptr(opt = ENC_OPT_new())
+        || !TEST_ptr(opt->first = make_enc_nodes(2, 3))
+        || !TEST_ptr(opt->last = make_enc_nodes(3, 3))
+        || !TEST_int_gt(len = i2d_ENC_OPT(opt, &der), 0)
+        || !TEST_ptr(adb = ENC_ADB_new())
+        || !TEST_ptr(adb->node = make_enc_nodes(2, 3))
+        || !TEST_ptr(adb->type = ASN1_INTEGER_new())
+        || !TEST_true(ASN1_INTEGER_set(adb->type, 99)))
+        goto err;
+    opt->adb = adb;
+
+    /* The member is left out, whichever way the output is given */
+    if (!TEST_int_eq(i2d_ENC_OPT(opt, NULL), len)
+        || !TEST_int_eq(i2d_ENC_OPT(opt, &der_adb), len)
+        || !TEST_mem_eq(der_adb, len, der, len)
+        || !TEST_ptr(buf = OPENSSL_malloc(len)))
+        goto err;
+    p = buf;
+    if (!TEST_int_eq(i2d_ENC_OPT(opt, &p), len)
+        || !TEST_ptr_eq(p, buf + len)
+        || !TEST_mem_eq(buf, len, der, len))
+        goto err;
+    ERR_clear_error();
+    OPENSSL_free(der_adb);
+    der_adb = NULL;
+
+    /* And is there once it has a type that can be encoded */
+    if (!TEST_true(ASN1_INTEGER_set(adb->type, 1))
+        || !TEST_ptr(adb->value = ASN1_INTEGER_new())
+        || !TEST_true(ASN1_INTEGER_set(adb->value, 5))
+        || !TEST_int_gt(adb_len = i2d_ENC_OPT(opt, &der_adb), len))
+        goto err;
+    len = adb_len;
+    q = der_adb;
+    OPENSSL_free(buf);
+    buf = NULL;
+    if (!TEST_ptr(decoded = d2i_ENC_OPT(NULL, &q, len))
+        || !TEST_ptr(decoded->adb)
+        || !TEST_long_eq(ASN1_INTEGER_get(decoded->adb->value), 5)
+        || !TEST_int_eq(i2d_ENC_OPT(decoded, &buf), len)
+        || !TEST_mem_eq(buf, len, der_adb, len))
+        goto err;
+
+    testresult = 1;
+ err:
+    ENC_OPT_free(opt);
+    ENC_OPT_free(decoded);
+    OPENSSL_free(der);
+    OPENSSL_free(der_adb);
+    OPENSSL_free(buf);
+    return testresult;
+}
 
 int setup_tests(void)
 {
@@ -904,5 +1161,7 @@ int setup_tests(void)
     ADD_TEST(test_int64);
     ADD_TEST(test_uint64);
     ADD_TEST(test_invalid_template);
+    ADD_TEST(test_nested_encoding);
+    ADD_TEST(test_unencodable_optional);
     return 1;
 }
@@ -20,6 +20,7 @@
 #include "internal/numbers.h"
 #include "testutil.h"
 #include "bn_prime.h"
+#include "bn_local.h"
 #include "crypto/bn.h"
 
 static BN_CTX *ctx;
@@ -86,6 +87,426 @@ err:
     return ret;
 }
 
+/*
+ * Test that a BN_SIEVE skips exactly the candidates that trial division by
+ * the small primes finds factors of, over several windows, for small and
+ * large steps and for bases that are just big enough to use all the primes.
+ */
+static int test_bn_sieve(int idx)
+{
+    int ret = 0, i, composite, found, safe = idx & 1;
+    int want = safe ? 50 : 200;
+    BIGNUM *base = NULL, *step = NULL, *cand = NULL;
+    BN_SIEVE *sieve = NULL;
+    BN_ULONG k, last, mod;
+
+    if (!TEST_ptr(base = BN_new())
+            || !TEST_ptr(step = BN_new())
+            || !TEST_ptr(cand = BN_new())
+            || !TEST_true(BN_rand(base, (idx & 4) != 0 ? 318 : 18,
+                                  BN_RAND_TOP_ONE, BN_RAND_BOTTOM_ODD))
+            || (safe && !TEST_true(BN_set_bit(base, 1))))
+        goto err;
+    if ((idx & 2) == 0) {
+        if (!TEST_true(BN_set_word(step, safe ? 4 : 2)))
+            goto err;
+    } else {
+        /* As in the callers, the small primes don't divide the step */
+        if (!TEST_true(BN_generate_prime_ex(step, 256, 0, NULL, NULL, NULL))
+                || !TEST_true(BN_lshift(step, step, safe ? 2 : 1)))
+            goto err;
+    }
+    if (!TEST_ptr(sieve = ossl_bn_sieve_new(BN_num_bits(base), safe))
+            || !TEST_true(ossl_bn_sieve_start(sieve, base, step))
+            || !TEST_ptr(BN_copy(cand, base)))
+        goto err;
+
+    for (k = last = 0, found = 0; found < want; k++) {
+        for (i = 1, composite = 0; i < NUMPRIMES && !composite; i++) {
+            mod = BN_mod_word(cand, primes[i]);
+            composite = mod == 0 || (safe && mod == 1);
+        }
+        if (!composite) {
+            if (!TEST_ulong_eq((unsigned long)ossl_bn_sieve_next(sieve),
+                               (unsigned long)(k - last)))
+                goto err;
+            last = k;
+            found++;
+        }
+        if (!TEST_true(BN_add(cand, cand, step)))
+            goto err;
+    }
+    ret = 1;
+ err:
+    ossl_bn_sieve_free(sieve);
+    BN_free(base);
+    BN_free(step);
+    BN_free(cand);
+    return ret;
+}
+
+static const int comb_bits[] = { 1, 4, 5, 161, 225, 257, 400 };
+
+static int test_bn_comb(int idx)
+{
+    int ret = 0, i, bits = comb_bits[idx];
+    BIGNUM *m = NULL, *g = NULL, *e = NULL, *ce = NULL, *r = NULL;
+    BIGNUM *want = NULL;
+    BN_COMB *comb = NULL;
+
+    if (!TEST_ptr(m = BN_new())
+            || !TEST_ptr(g = BN_new())
+            || !TEST_ptr(e = BN_new())
+            || !TEST_ptr(ce = BN_new())
+            || !TEST_ptr(r = BN_new())
+            || !TEST_ptr(want = BN_new())
+            || !TEST_true(BN_rand(m, 1024 + 64 * idx, BN_RAND_TOP_ONE,
+                                  BN_RAND_BOTTOM_ODD))
+            || !TEST_true(BN_rand_range(g, m))
+            || !TEST_ptr(comb = ossl_bn_comb_new(g, m, bits, ctx))
+            || !TEST_int_eq(ossl_bn_comb_bits(comb), bits))
+        goto err;
+
+    /* Zero, all ones, then random exponents of every length up to |bits| */
+    for (i = -2; i < 50; i++) {
+        if (i == -2) {
+            BN_zero(e);
+        } else if (i == -1) {
+            if (!TEST_true(BN_set_word(e, 1))
+                    || !TEST_true(BN_lshift(e, e, bits))
+                    || !TEST_true(BN_sub_word(e, 1)))
+                goto err;
+        } else if (!TEST_true(BN_rand(e, 1 + i * bits / 50, BN_RAND_TOP_ANY,
+                                      BN_RAND_BOTTOM_ANY))) {
+            goto err;
+        }
+        BN_with_flags(ce, e, BN_FLG_CONSTTIME);
+        if (!TEST_true(ossl_bn_mod_exp_comb(r, ce, comb, ctx))
+                || !TEST_true(BN_mod_exp_simple(want, g, e, m, ctx))
+                || !TEST_BN_eq(r, want))
+            goto err;
+    }
+
+    /* Longer exponents than the table is for are refused */
+    if (!TEST_true(BN_set_bit(e, bits))
+            || !TEST_false(ossl_bn_mod_exp_comb(r, e, comb, ctx)))
+        goto err;
+    ERR_clear_error();
+    ret = 1;
+ err:
+    ossl_bn_comb_free(comb);
+    BN_free(m);
+    BN_free(g);
+    BN_free(e);
+    BN_free(ce);
+    BN_free(r);
+    BN_free(want);
+    return ret;
+}
+
+static int test_bn_ctx_arena(void)
+{
+    int ret = 0, i, before = 0, after = 0;
+    BN_CTX *arena = NULL, *plain = NULL, *t1 = NULL, *t2 = NULL, *t3 = NULL;
+    BIGNUM *a, *b, *c, *m, *r, *want = NULL, *sa = NULL;
+    BN_ULONG *d;
+
+    if (!TEST_ptr(arena = BN_CTX_new())
+            || !TEST_ptr(plain = BN_CTX_new())
+            || !TEST_ptr(want = BN_new())
+            || !TEST_ptr(sa = BN_new())
+            || !TEST_true(ossl_bn_ctx_set_arena(arena, 256)))
+        goto err;
+
+    BN_CTX_start(arena);
+    a = BN_CTX_get(arena);
+    b = BN_CTX_get(arena);
+    c = BN_CTX_get(arena);
+    m = BN_CTX_get(arena);
+    r = BN_CTX_get(arena);
+    if (!TEST_ptr(r)
+            || !TEST_true(BN_get_flags(a, BN_FLG_ARENA))
+            || !TEST_true(BN_get_flags(r, BN_FLG_ARENA))
+            || !TEST_ptr_eq(b->d, a->d + a->dmax)
+            || !TEST_ptr_eq(c->d, b->d + b->dmax))
+        goto err;
+
+    /* Arithmetic gives the same results as with a plain BN_CTX */
+    if (!TEST_true(BN_rand(m, 256, BN_RAND_TOP_ONE, BN_RAND_BOTTOM_ODD))
+            || !TEST_true(BN_rand_range(a, m))
+            || !TEST_true(BN_rand_range(b, m))
+            || !TEST_true(BN_mod_mul(r, a, b, m, arena))
+            || !TEST_true(BN_mod_mul(want, a, b, m, plain))
+            || !TEST_BN_eq(r, want)
+            || !TEST_true(BN_mod_exp(r, a, b, m, arena))
+            || !TEST_true(BN_mod_exp(want, a, b, m, plain))
+            || !TEST_BN_eq(r, want))
+        goto err;
+
+    /* A bignum that outgrows its words moves to the heap */
+    if (!TEST_ptr(BN_copy(want, a))
+            || !TEST_true(BN_lshift(a, a, 4096))
+            || !TEST_false(BN_get_flags(a, BN_FLG_ARENA))
+            || !TEST_true(BN_rshift(a, a, 4096))
+            || !TEST_BN_eq(a, want))
+        goto err;
+
+    /*
+     * Arena words are swapped between two arena bignums, but only the values
+     * are swapped with any other bignum
+     */
+    if (!TEST_ptr(BN_copy(sa, a))
+            || !TEST_ptr(BN_copy(want, b)))
+        goto err;
+    d = b->d;
+    BN_swap(a, b);
+    if (!TEST_true(BN_get_flags(b, BN_FLG_ARENA))
+            || !TEST_false(BN_get_flags(a, BN_FLG_ARENA))
+            || !TEST_ptr_eq(b->d, d)
+            || !TEST_BN_eq(a, want)
+            || !TEST_BN_eq(b, sa))
+        goto err;
+    BN_swap(b, c);
+    if (!TEST_true(BN_get_flags(b, BN_FLG_ARENA))
+            || !TEST_true(BN_get_flags(c, BN_FLG_ARENA))
+            || !TEST_ptr_eq(c->d, d)
+            || !TEST_BN_eq(c, sa))
+        goto err;
+
+    /* A bignum keeps its words from one frame to the next */
+    d = c->d;
+    BN_CTX_end(arena);
+    BN_CTX_start(arena);
+    if (!TEST_ptr_eq(BN_CTX_get(arena), a)
+            || !TEST_ptr_eq(BN_CTX_get(arena), b)
+            || !TEST_ptr_eq(BN_CTX_get(arena), c)
+            || !TEST_ptr_eq(c->d, d))
+        goto err;
+    BN_CTX_end(arena);
+
+    /* Only a BN_CTX with nothing in use can be put in arena mode */
+    BN_CTX_start(arena);
+    if (!TEST_false(ossl_bn_ctx_set_arena(arena, 256)))
+        goto err;
+    BN_CTX_end(arena);
+    ERR_clear_error();
+
+    /*
+     * A thread keeps its BN_CTX, even when an operation doesn't end its
+     * frames, and nested operations get one of their own.  Everything is
+     * wiped when the operation gives it back.
+     */
+    if (!TEST_ptr(t1 = ossl_bn_ctx_thread_acquire(NULL, 2048))
+            || !TEST_ptr(t2 = ossl_bn_ctx_thread_acquire(NULL, 2048))
+            || !TEST_ptr_ne(t1, t2))
+        goto err;
+    BN_CTX_start(t1);
+    if (!TEST_ptr(c = BN_CTX_get(t1))
+            || !TEST_true(BN_set_word(c, 42)))
+        goto err;
+    d = c->d;
+    ossl_bn_ctx_thread_release(t2);
+    ossl_bn_ctx_thread_release(t1);
+    t2 = NULL;
+    if (!TEST_ptr_null(c->d)
+            || !TEST_ulong_eq(d[0], 0))
+        goto err;
+    if (!TEST_ptr(t3 = ossl_bn_ctx_thread_acquire(NULL, 1024))
+            || !TEST_ptr_eq(t3, t1))
+        goto err;
+    t1 = NULL;
+    BN_CTX_start(t3);
+    if (!TEST_ptr(a = BN_CTX_get(t3))
+            || !TEST_true(BN_get_flags(a, BN_FLG_ARENA)))
+        goto err;
+    BN_CTX_end(t3);
+    ossl_bn_ctx_thread_release(t3);
+    t3 = NULL;
+
+    /* Once the BN_CTX of the thread has warmed up, it doesn't allocate */
+    if (!TEST_true(BN_set_bit(want, 255)))
+        goto err;
+    for (i = 0; i < 2; i++) {
+#ifndef OPENSSL_NO_CRYPTO_MDEBUG
+        CRYPTO_get_alloc_counts(&before, NULL, NULL);
+#endif
+        if (!TEST_ptr(t3 = ossl_bn_ctx_thread_acquire(NULL, 256)))
+            goto err;
+        BN_CTX_start(t3);
+        if (!TEST_ptr(r = BN_CTX_get(t3))
+                || !TEST_true(BN_mod_mul(r, sa, sa, want, t3)))
+            goto err;
+        BN_CTX_end(t3);
+        ossl_bn_ctx_thread_release(t3);
+        t3 = NULL;
+#ifndef OPENSSL_NO_CRYPTO_MDEBUG
+        CRYPTO_get_alloc_counts(&after, NULL, NULL);
+#endif
+    }
+    if (!TEST_int_eq(after, before))
+        goto err;
+    ret = 1;
+ err:
+    ossl_bn_ctx_thread_release(t1);
+    ossl_bn_ctx_thread_release(t2);
+    ossl_bn_ctx_thread_release(t3);
+    BN_free(want);
+    BN_free(sa);
+    BN_CTX_free(arena);
+    BN_CTX_free(plain);
+    return ret;
+}
+
+static int mul_sizes[] = { 9, 17, 24, 25, 31, 33, 47, 64, 65, 100, 191, 256 };
+
+static void set_mul_thresholds(int k, int t3, int sk, int st3)
+{
+    ossl_bn_mul_set_threshold(BN_MUL_THRESHOLD_KARATSUBA, k);
+    ossl_bn_mul_set_threshold(BN_MUL_THRESHOLD_TOOM3, t3);
+    ossl_bn_mul_set_threshold(BN_SQR_THRESHOLD_KARATSUBA, sk);
+    ossl_bn_mul_set_threshold(BN_SQR_THRESHOLD_TOOM3, st3);
+}
+
+/*
+ * Karatsuba and Toom-3 multiplication and squaring, of all ones and random
+ * operands of about |n| words, give the same results as the schoolbook ones
+ */
+static int test_bn_mul_algorithms(int idx)
+{
+    int ret = 0, i, j, n = mul_sizes[idx];
+    int saved[4];
+    BIGNUM *a = NULL, *b = NULL, *r = NULL, *want = NULL;
+
+    for (i = 0; i < 4; i++)
+        saved[i] = ossl_bn_mul_get_threshold(i);
+
+    if (!TEST_ptr(a = BN_new())
+            || !TEST_ptr(b = BN_new())
+            || !TEST_ptr(r = BN_new())
+            || !TEST_ptr(want = BN_new()))
+        goto err;
+
+    for (i = 0; i < 8; i++) {
+        int bn = i < 2 ? n : n + i % 3 - 1 - (i > 5) * (n / 4);
+
+        if (i == 0) {
+            if (!TEST_true(BN_set_bit(a, n * BN_BITS2))
+                    || !TEST_true(BN_sub_word(a, 1))
+                    || !TEST_ptr(BN_copy(b, a)))
+                goto err;
+        } else if (!TEST_true(BN_rand(a, n * BN_BITS2, BN_RAND_TOP_ANY,
+                                      BN_RAND_BOTTOM_ANY))
+                   || !TEST_true(BN_rand(b, bn * BN_BITS2, BN_RAND_TOP_ANY,
+                                         BN_RAND_BOTTOM_ANY))) {
+            goto err;
+        }
+        BN_set_negative(b, i & 1);
+
+        for (j = 0; j < 3; j++) {
+            set_mul_thresholds(INT_MAX, INT_MAX, INT_MAX, INT_MAX);
+            if (!TEST_true(BN_mul(want, a, b, ctx)))
+                goto err;
+            if (j == 0)
+                set_mul_thresholds(saved[0], saved[1], saved[2], saved[3]);
+            else if (j == 1)
+                set_mul_thresholds(8, INT_MAX, 8, INT_MAX);
+            else
+                set_mul_thresholds(8, 24, 8, 24);
+            if (!TEST_true(BN_mul(r, a, b, ctx))
+                    || !TEST_BN_eq(r, want))
+                goto err;
+
+            set_mul_thresholds(INT_MAX, INT_MAX, INT_MAX, INT_MAX);
+            if (!TEST_true(BN_sqr(want, b, ctx)))
+                goto err;
+            if (j == 0)
+                set_mul_thresholds(saved[0], saved[1], saved[2], saved[3]);
+            else if (j == 1)
+                set_mul_thresholds(8, INT_MAX, 8, INT_MAX);
+            else
+                set_mul_thresholds(8, 24, 8, 24);
+            if (!TEST_true(BN_sqr(r, b, ctx))
+                    || !TEST_BN_eq(r, want))
+                goto err;
+        }
+    }
+    ret = 1;
+ err:
+    set_mul_thresholds(saved[0], saved[1], saved[2], saved[3]);
+    BN_free(a);
+    BN_free(b);
+    BN_free(r);
+    BN_free(want);
+    return ret;
+}
+
+static int inverse_bits[] = {
+    2, 17, 45, 46, 63, 64, 65, 255, 256, 521, 1024, 2048, 3072, 4096, 4160
+};
+
+/*
+ * safegcd inverts modulo odd numbers of every size, and finds when there is
+ * no inverse.
+ */
+static int test_bn_mod_inverse_safegcd(int idx)
+{
+    int ret = 0, i, noinv, bits = inverse_bits[idx];
+    BIGNUM *n = NULL, *a = NULL, *r = NULL, *t = NULL;
+
+    if (!TEST_ptr(n = BN_new())
+            || !TEST_ptr(a = BN_new())
+            || !TEST_ptr(r = BN_new())
+            || !TEST_ptr(t = BN_new()))
+        goto err;
+
+    for (i = 0; i < 32; i++) {
+        if (!TEST_true(BN_rand(n, bits, i & 1 ? BN_RAND_TOP_ONE
+                                              : BN_RAND_TOP_ANY,
+                               BN_RAND_BOTTOM_ODD)))
+            goto err;
+        if (BN_is_one(n))
+            continue;
+        if (i % 8 == 0)
+            BN_zero(a);
+        else if (i % 8 == 1 && !TEST_true(BN_sub(a, n, BN_value_one())))
+            goto err;
+        else if (i % 8 > 1
+                 && !TEST_true(BN_rand(a, bits + 32 * (i % 3), BN_RAND_TOP_ANY,
+                                       BN_RAND_BOTTOM_ANY)))
+            goto err;
+        BN_set_negative(a, i % 4 == 3);
+        /* Give some of them a common factor */
+        if (i % 8 == 5
+                && (!TEST_true(BN_mul_word(a, 3))
+                    || !TEST_true(BN_mul_word(n, 3))))
+            goto err;
+
+        if (!TEST_true(BN_gcd(t, a, n, ctx)))
+            goto err;
+        if (!BN_is_one(t)) {
+            if (!TEST_ptr_null(bn_mod_inverse_safegcd(r, a, n, ctx, &noinv))
+                    || !TEST_true(noinv))
+                goto err;
+            continue;
+        }
+        if (!TEST_ptr_eq(bn_mod_inverse_safegcd(r, a, n, ctx, &noinv), r)
+                || !TEST_false(noinv)
+                || !TEST_false(BN_is_negative(r))
+                || !TEST_BN_lt(r, n)
+                || !TEST_true(BN_mod_mul(t, r, a, n, ctx))
+                || !TEST_BN_eq_one(t))
+            goto err;
+    }
+
+    ret = 1;
+ err:
+    BN_free(n);
+    BN_free(a);
+    BN_free(r);
+    BN_free(t);
+    return ret;
+}
+
 int setup_tests(void)
 {
     if (!TEST_ptr(ctx = BN_CTX_new()))
@@ -94,6 +515,11 @@ int setup_tests(void)
     ADD_TEST(test_is_prime_enhanced);
     ADD_ALL_TESTS(test_is_composite_enhanced, (int)OSSL_NELEM(composites));
     ADD_TEST(test_bn_small_factors);
+    ADD_ALL_TESTS(test_bn_sieve, 8);
+    ADD_ALL_TESTS(test_bn_comb, (int)OSSL_NELEM(comb_bits));
+    ADD_TEST(test_bn_ctx_arena);
+    ADD_ALL_TESTS(test_bn_mul_algorithms, (int)OSSL_NELEM(mul_sizes));
+    ADD_ALL_TESTS(test_bn_mod_inverse_safegcd, (int)OSSL_NELEM(inverse_bits));
 
     return 1;
 }
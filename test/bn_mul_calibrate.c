@@ -0,0 +1,122 @@
+/*
+ * Copyright 2023 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * Measures from which operand size Karatsuba and Toom-3 multiplication and
+ * squaring are faster than the algorithm below them, for the compiler,
+ * options and machine of this build.  Sizes that are a power of 2 are
+ * skipped, as they always use Karatsuba.  The results can be given to
+ * Configure, e.g. as -DBN_MUL_TOOM3_SIZE_NORMAL=<words>.
+ *
+ * Usage: bn_mul_calibrate [milliseconds per measurement]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <openssl/bn.h>
+#include <openssl/err.h>
+#include "internal/nelem.h"
+#include "internal/time.h"
+#include "bn_local.h"
+
+static const struct {
+    const char *name, *macro;
+    int which, sqr, from, to, step;
+} thresholds[] = {
+    { "Karatsuba multiplication", "BN_MUL_KARATSUBA_SIZE_NORMAL",
+      BN_MUL_THRESHOLD_KARATSUBA, 0, 17, 96, 2 },
+    { "Karatsuba squaring", "BN_SQR_KARATSUBA_SIZE_NORMAL",
+      BN_SQR_THRESHOLD_KARATSUBA, 1, 17, 96, 2 },
+    { "Toom-3 multiplication", "BN_MUL_TOOM3_SIZE_NORMAL",
+      BN_MUL_THRESHOLD_TOOM3, 0, 48, 1024, 32 },
+    { "Toom-3 squaring", "BN_SQR_TOOM3_SIZE_NORMAL",
+      BN_SQR_THRESHOLD_TOOM3, 1, 48, 1024, 32 }
+};
+
+/* How many times in a row the faster algorithm must win to count */
+#define WINS 3
+
+static OSSL_TIME budget;
+
+/* Returns the time of one multiplication or squaring, in nanoseconds */
+static double time_op(BIGNUM *r, const BIGNUM *a, const BIGNUM *b, int sqr,
+                      BN_CTX *ctx)
+{
+    OSSL_TIME start = ossl_time_now(), spent;
+    uint64_t n = 0, i, batch = 16;
+
+    do {
+        for (i = 0; i < batch; i++)
+            if (!(sqr ? BN_sqr(r, a, ctx) : BN_mul(r, a, b, ctx))) {
+                ERR_print_errors_fp(stderr);
+                exit(EXIT_FAILURE);
+            }
+        n += batch;
+        spent = ossl_time_subtract(ossl_time_now(), start);
+    } while (ossl_time_compare(spent, budget) < 0);
+    return (double)ossl_time2ticks(spent) / OSSL_TIME_NS / n;
+}
+
+int main(int argc, char **argv)
+{
+    BN_CTX *ctx = BN_CTX_new();
+    BIGNUM *a = BN_new(), *b = BN_new(), *r = BN_new();
+    int i, n, wins, found, saved;
+    double off, on;
+
+    budget = ossl_ms2time(argc > 1 ? atoi(argv[1]) : 20);
+    if (ctx == NULL || a == NULL || b == NULL || r == NULL) {
+        ERR_print_errors_fp(stderr);
+        return EXIT_FAILURE;
+    }
+
+    for (i = 0; i < (int)OSSL_NELEM(thresholds); i++) {
+        saved = ossl_bn_mul_get_threshold(thresholds[i].which);
+        found = 0;
+        wins = 0;
+        printf("%s\n", thresholds[i].name);
+        for (n = thresholds[i].from; n <= thresholds[i].to && wins < WINS;
+             n += thresholds[i].step) {
+            if ((n & (n - 1)) == 0)
+                continue;
+            if (!BN_rand(a, n * BN_BITS2, BN_RAND_TOP_ONE, BN_RAND_BOTTOM_ANY)
+                || !BN_rand(b, n * BN_BITS2, BN_RAND_TOP_ONE,
+                            BN_RAND_BOTTOM_ANY)) {
+                ERR_print_errors_fp(stderr);
+                return EXIT_FAILURE;
+            }
+            /* Only the outermost operation uses the algorithm */
+            ossl_bn_mul_set_threshold(thresholds[i].which, INT_MAX);
+            off = time_op(r, a, b, thresholds[i].sqr, ctx);
+            ossl_bn_mul_set_threshold(thresholds[i].which, n);
+            on = time_op(r, a, b, thresholds[i].sqr, ctx);
+            printf("  %4d words: %10.0f ns without, %10.0f ns with\n",
+                   n, off, on);
+            if (on < off) {
+                if (wins++ == 0)
+                    found = n;
+            } else {
+                wins = 0;
+            }
+        }
+        ossl_bn_mul_set_threshold(thresholds[i].which, saved);
+        if (wins == WINS)
+            printf("  %s %d, now %d\n", thresholds[i].macro, found, saved);
+        else
+            printf("  %s more than %d, now %d\n", thresholds[i].macro,
+                   thresholds[i].to, saved);
+    }
+
+    BN_free(a);
+    BN_free(b);
+    BN_free(r);
+    BN_CTX_free(ctx);
+    return EXIT_SUCCESS;
+}
@@ -3200,6 +3200,136 @@ err:
     return res;
 }
 
+/* Test 0 uses an odd modulus and test 1 an even one */
+static int test_mod_inverse_batch(int idx)
+{
+    BIGNUM *m = NULL, *a[7] = { NULL }, *r[7] = { NULL }, *inv = NULL;
+    const BIGNUM *ca[7];
+    size_t i, num = OSSL_NELEM(a);
+    int res = 0;
+
+    if (!TEST_ptr(m = BN_new())
+            || !TEST_ptr(inv = BN_new())
+            || !TEST_true(BN_generate_prime_ex(m, 256, 0, NULL, NULL, NULL))
+            || (idx == 1 && !TEST_true(BN_lshift(m, m, 3))))
+        goto err;
+    for (i = 0; i < num; i++) {
+        if (!TEST_ptr(a[i] = BN_new())
+                || !TEST_ptr(r[i] = BN_new())
+                || !TEST_true(BN_rand(a[i], 256 + 64 * (i % 3),
+                                      BN_RAND_TOP_ANY, BN_RAND_BOTTOM_ODD)))
+            goto err;
+        BN_set_negative(a[i], i % 2);
+        ca[i] = a[i];
+    }
+
+    if (!TEST_true(BN_mod_inverse_batch(r, ca, num, m, ctx)))
+        goto err;
+    for (i = 0; i < num; i++)
+        if (!TEST_ptr(BN_mod_inverse(inv, a[i], m, ctx))
+                || !TEST_BN_eq(r[i], inv))
+            goto err;
+
+    /* In place, then without a BN_CTX */
+    if (!TEST_true(BN_mod_inverse_batch(a, ca, num, m, ctx))
+            || !TEST_true(BN_mod_inverse_batch(a, ca, num, m, NULL)))
+        goto err;
+    for (i = 0; i < num; i++)
+        if (!TEST_ptr(BN_mod_inverse(inv, r[i], m, ctx))
+                || !TEST_BN_eq(a[i], inv))
+            goto err;
+
+    if (!TEST_true(BN_mod_inverse_batch(r, ca, 0, m, ctx))
+            || !TEST_true(BN_mod_inverse_batch(r, ca, 1, m, ctx))
+            || !TEST_true(BN_mod_mul(inv, r[0], a[0], m, ctx))
+            || !TEST_BN_eq_one(inv))
+        goto err;
+
+    /* A number without an inverse makes them all fail */
+    if (!TEST_true(BN_mul(a[3], a[3], m, ctx))
+            || !TEST_false(BN_mod_inverse_batch(r, ca, num, m, ctx)))
+        goto err;
+    ERR_clear_error();
+    BN_zero(a[3]);
+    if (!TEST_false(BN_mod_inverse_batch(r, ca, num, m, ctx)))
+        goto err;
+    ERR_clear_error();
+
+    res = 1;
+ err:
+    for (i = 0; i < num; i++) {
+        BN_free(a[i]);
+        BN_free(r[i]);
+    }
+    BN_free(m);
+    BN_free(inv);
+    return res;
+}
+
+/*
+ * Checks BN_mod_mul_montgomery() against BN_mod_mul() for the modulus sizes
+ * that have fixed size Montgomery multiplication and squaring code, and one
+ * that doesn't. Squaring is in place, and the last round uses m - 1.
+ */
+static const int mont_sizes[] = { 256, 384, 1024, 1536, 2048, 3072 };
+
+static int test_mod_mul_montgomery(int idx)
+{
+    BN_MONT_CTX *mont = NULL;
+    BIGNUM *m = NULL, *a = NULL, *b = NULL, *am = NULL, *bm = NULL;
+    BIGNUM *r = NULL, *want = NULL;
+    int i, st = 0;
+
+    if (!TEST_ptr(mont = BN_MONT_CTX_new())
+            || !TEST_ptr(m = BN_new())
+            || !TEST_ptr(a = BN_new())
+            || !TEST_ptr(b = BN_new())
+            || !TEST_ptr(am = BN_new())
+            || !TEST_ptr(bm = BN_new())
+            || !TEST_ptr(r = BN_new())
+            || !TEST_ptr(want = BN_new())
+            || !TEST_true(BN_rand(m, mont_sizes[idx], BN_RAND_TOP_ONE,
+                                  BN_RAND_BOTTOM_ODD))
+            || !TEST_true(BN_MONT_CTX_set(mont, m, ctx)))
+        goto err;
+
+    for (i = 0; i < 10; i++) {
+        if (i < 9) {
+            if (!TEST_true(BN_rand_range(a, m))
+                    || !TEST_true(BN_rand_range(b, m)))
+                goto err;
+        } else if (!TEST_true(BN_sub(a, m, BN_value_one()))
+                   || !TEST_ptr(BN_copy(b, a))) {
+            goto err;
+        }
+
+        if (!TEST_true(BN_to_montgomery(am, a, mont, ctx))
+                || !TEST_true(BN_to_montgomery(bm, b, mont, ctx))
+                || !TEST_true(BN_mod_mul_montgomery(r, am, bm, mont, ctx))
+                || !TEST_true(BN_from_montgomery(r, r, mont, ctx))
+                || !TEST_true(BN_mod_mul(want, a, b, m, ctx))
+                || !TEST_BN_eq(r, want))
+            goto err;
+
+        if (!TEST_true(BN_mod_mul_montgomery(am, am, am, mont, ctx))
+                || !TEST_true(BN_from_montgomery(r, am, mont, ctx))
+                || !TEST_true(BN_mod_sqr(want, a, m, ctx))
+                || !TEST_BN_eq(r, want))
+            goto err;
+    }
+    st = 1;
+ err:
+    BN_MONT_CTX_free(mont);
+    BN_free(m);
+    BN_free(a);
+    BN_free(b);
+    BN_free(am);
+    BN_free(bm);
+    BN_free(r);
+    BN_free(want);
+    return st;
+}
+
 static int test_mod_exp_alias(int idx)
 {
     int res = 0;
@@ -3377,7 +3507,9 @@ int setup_tests(void)
         ADD_ALL_TESTS(test_signed_mod_replace_ba, OSSL_NELEM(signed_mod_tests));
         ADD_TEST(test_mod);
         ADD_TEST(test_mod_inverse);
+        ADD_ALL_TESTS(test_mod_inverse_batch, 2);
         ADD_ALL_TESTS(test_mod_exp_alias, 2);
+        ADD_ALL_TESTS(test_mod_mul_montgomery, OSSL_NELEM(mont_sizes));
         ADD_TEST(test_modexp_mont5);
         ADD_TEST(test_kronecker);
         ADD_TEST(test_rand);
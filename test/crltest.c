@@ -1,5 +1,5 @@
 /*
- * Copyright 2015-2022 The OpenSSL Project Authors. All Rights Reserved.
+ * Copyright 2015-2023 The OpenSSL Project Authors. All Rights Reserved.
  *
  * Licensed under the Apache License 2.0 (the "License").  You may not use
  * this file except in compliance with the License.  You can obtain a copy
@@ -14,6 +14,7 @@
 #include <openssl/err.h>
 #include <openssl/pem.h>
 #include <openssl/x509.h>
+#include <openssl/x509v3.h>
 
 #include "testutil.h"
 
@@ -391,6 +392,260 @@ static int test_reuse_crl(void)
     return 1;
 }
 
+/*
+ * Make a CRL for the test root numbered |number|, and a delta CRL for base CRL
+ * number |base| if that is not 0, revoking |serials| with |reasons|. The CRL
+ * is returned as decoded from its DER encoding.
+ */
+static X509_CRL *make_crl(EVP_PKEY *key, long number, long base,
+                          const long *serials, const int *reasons, int num)
+{
+    X509_CRL *crl = X509_CRL_new(), *ret = NULL;
+    X509_REVOKED *rev = NULL;
+    ASN1_INTEGER *ai = ASN1_INTEGER_new();
+    ASN1_ENUMERATED *reason = ASN1_ENUMERATED_new();
+    ASN1_TIME *tm = X509_gmtime_adj(NULL, 0);
+    unsigned char *der = NULL;
+    const unsigned char *p;
+    int i, len;
+
+    if (!TEST_ptr(crl) || !TEST_ptr(ai) || !TEST_ptr(reason) || !TEST_ptr(tm)
+        || !TEST_true(X509_CRL_set_version(crl, X509_CRL_VERSION_2))
+        || !TEST_true(X509_CRL_set_issuer_name(crl,
+                                               X509_get_subject_name(test_root)))
+        || !TEST_true(X509_CRL_set1_lastUpdate(crl, tm))
+        || !TEST_true(ASN1_INTEGER_set(ai, number))
+        || !TEST_true(X509_CRL_add1_ext_i2d(crl, NID_crl_number, ai, 0, 0)))
+        goto err;
+    if (base != 0
+        && (!TEST_true(ASN1_INTEGER_set(ai, base))
+            || !TEST_true(X509_CRL_add1_ext_i2d(crl, NID_delta_crl, ai, 1, 0))))
+        goto err;
+
+    for (i = 0; i < num; i++) {
+        if (!TEST_ptr(rev = X509_REVOKED_new())
+            || !TEST_true(ASN1_INTEGER_set(ai, serials[i]))
+            || !TEST_true(X509_REVOKED_set_serialNumber(rev, ai))
+            || !TEST_true(X509_REVOKED_set_revocationDate(rev, tm)))
+            goto err;
+        if (reasons != NULL && reasons[i] != CRL_REASON_NONE
+            && (!TEST_true(ASN1_ENUMERATED_set(reason, reasons[i]))
+                || !TEST_true(X509_REVOKED_add1_ext_i2d(rev, NID_crl_reason,
+                                                        reason, 0, 0))))
+            goto err;
+        if (!TEST_true(X509_CRL_add0_revoked(crl, rev)))
+            goto err;
+        rev = NULL;
+    }
+
+    if (!TEST_int_gt(X509_CRL_sign(crl, key, EVP_sha256()), 0)
+        || !TEST_int_gt(len = i2d_X509_CRL(crl, &der), 0))
+        goto err;
+    p = der;
+    ret = d2i_X509_CRL(NULL, &p, len);
+
+ err:
+    OPENSSL_free(der);
+    X509_REVOKED_free(rev);
+    ASN1_TIME_free(tm);
+    ASN1_ENUMERATED_free(reason);
+    ASN1_INTEGER_free(ai);
+    X509_CRL_free(crl);
+    return ret;
+}
+
+/* Look |serial| up in |crl|, and check the reason of any entry found */
+static int lookup_serial(X509_CRL *crl, long serial, int expected_reason)
+{
+    ASN1_INTEGER *ai = ASN1_INTEGER_new();
+    ASN1_ENUMERATED *reason = NULL;
+    X509_REVOKED *rev = NULL;
+    int r, ret = -1;
+
+    if (ai == NULL || !ASN1_INTEGER_set(ai, serial))
+        goto err;
+    if ((r = X509_CRL_get0_by_serial(crl, &rev, ai)) == 0) {
+        ret = 0;
+        goto err;
+    }
+    if (ASN1_INTEGER_cmp(X509_REVOKED_get0_serialNumber(rev), ai) != 0)
+        goto err;
+    reason = X509_REVOKED_get_ext_d2i(rev, NID_crl_reason, NULL, NULL);
+    if ((reason == NULL ? CRL_REASON_NONE : ASN1_ENUMERATED_get(reason))
+            == expected_reason)
+        ret = r;
+ err:
+    ASN1_ENUMERATED_free(reason);
+    ASN1_INTEGER_free(ai);
+    return ret;
+}
+
+#define INDEX_NUM_REVOKED   2000
+
+static int test_crl_index(void)
+{
+    EVP_PKEY *key = NULL;
+    X509_CRL *crl = NULL;
+    X509_REVOKED *rev = NULL, *added, *first;
+    STACK_OF(X509_REVOKED) *revs;
+    ASN1_INTEGER *ai = NULL;
+    long *serials = NULL;
+    int i, r = 0;
+
+    if (!TEST_ptr(key = EVP_PKEY_Q_keygen(NULL, NULL, "EC", "P-256"))
+        || !TEST_ptr(serials = OPENSSL_malloc(INDEX_NUM_REVOKED
+                                              * sizeof(*serials))))
+        goto err;
+    for (i = 0; i < INDEX_NUM_REVOKED; i++)
+        serials[i] = (i % 2 == 0 ? 1 : -1) * (7L * i + 1);
+    if (!TEST_ptr(crl = make_crl(key, 1, 0, serials, NULL, INDEX_NUM_REVOKED)))
+        goto err;
+
+    for (i = 0; i < INDEX_NUM_REVOKED; i++)
+        if (!TEST_int_eq(lookup_serial(crl, serials[i], CRL_REASON_NONE), 1)
+            || !TEST_int_eq(lookup_serial(crl, -serials[i], CRL_REASON_NONE),
+                            0))
+            goto err;
+
+    /* Entries added after decoding are found as well */
+    if (!TEST_int_eq(lookup_serial(crl, 2, CRL_REASON_NONE), 0)
+        || !TEST_ptr(rev = X509_REVOKED_new())
+        || !TEST_ptr(ai = ASN1_INTEGER_new())
+        || !TEST_true(ASN1_INTEGER_set(ai, 2))
+        || !TEST_true(X509_REVOKED_set_serialNumber(rev, ai))
+        || !TEST_true(X509_CRL_add0_revoked(crl, rev)))
+        goto err;
+    rev = NULL;
+    if (!TEST_int_eq(lookup_serial(crl, 2, CRL_REASON_NONE), 1)
+        || !TEST_int_eq(lookup_serial(crl, serials[INDEX_NUM_REVOKED - 1],
+                                      CRL_REASON_NONE), 1))
+        goto err;
+
+    /*
+     * Changes made directly to the stack are seen, even when they keep the
+     * number of entries or change an entry in place
+     */
+    revs = X509_CRL_get_REVOKED(crl);
+    X509_REVOKED_free(sk_X509_REVOKED_delete(revs, 0));
+    if (!TEST_ptr(added = X509_REVOKED_new())
+        || !TEST_true(ASN1_INTEGER_set(ai, 3))
+        || !TEST_true(X509_REVOKED_set_serialNumber(added, ai))
+        || !TEST_true(sk_X509_REVOKED_push(revs, added))) {
+        X509_REVOKED_free(added);
+        goto err;
+    }
+    first = sk_X509_REVOKED_value(revs, 0);
+    if (!TEST_true(ASN1_INTEGER_set(ai, 4))
+        || !TEST_true(X509_REVOKED_set_serialNumber(first, ai))
+        || !TEST_int_eq(lookup_serial(crl, serials[0], CRL_REASON_NONE), 0)
+        || !TEST_int_eq(lookup_serial(crl, serials[1], CRL_REASON_NONE), 0)
+        || !TEST_int_eq(lookup_serial(crl, 3, CRL_REASON_NONE), 1)
+        || !TEST_int_eq(lookup_serial(crl, 4, CRL_REASON_NONE), 1))
+        goto err;
+
+    rev = sk_X509_REVOKED_delete_ptr(revs, added);
+    if (!TEST_int_eq(lookup_serial(crl, 3, CRL_REASON_NONE), 0)
+        || !TEST_int_eq(lookup_serial(crl, 2, CRL_REASON_NONE), 1)
+        || !TEST_int_eq(lookup_serial(crl, serials[2], CRL_REASON_NONE), 1))
+        goto err;
+
+    r = 1;
+ err:
+    X509_REVOKED_free(rev);
+    ASN1_INTEGER_free(ai);
+    X509_CRL_free(crl);
+    OPENSSL_free(serials);
+    EVP_PKEY_free(key);
+    return r;
+}
+
+static int test_crl_merge_delta(void)
+{
+    static const long base_serials[] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };
+    static const int base_reasons[] = {
+        CRL_REASON_NONE, CRL_REASON_NONE, CRL_REASON_NONE, CRL_REASON_NONE,
+        CRL_REASON_CERTIFICATE_HOLD, CRL_REASON_NONE, CRL_REASON_NONE,
+        CRL_REASON_NONE, CRL_REASON_CERTIFICATE_HOLD, CRL_REASON_NONE
+    };
+    static const long delta_serials[] = { 11, 5, 3, 42 };
+    static const int delta_reasons[] = {
+        CRL_REASON_KEY_COMPROMISE, CRL_REASON_REMOVE_FROM_CRL,
+        CRL_REASON_KEY_COMPROMISE, CRL_REASON_REMOVE_FROM_CRL
+    };
+    EVP_PKEY *key = NULL;
+    X509_CRL *base = NULL, *delta = NULL, *newer = NULL, *merged = NULL;
+    ASN1_INTEGER *number = NULL;
+    unsigned char *der = NULL;
+    unsigned char md_before[SHA_DIGEST_LENGTH], md_after[SHA_DIGEST_LENGTH];
+    const unsigned char *p;
+    int len, r = 0;
+
+    if (!TEST_ptr(key = EVP_PKEY_Q_keygen(NULL, NULL, "EC", "P-256"))
+        || !TEST_ptr(base = make_crl(key, 1, 0, base_serials, base_reasons,
+                                     OSSL_NELEM(base_serials)))
+        || !TEST_ptr(delta = make_crl(key, 2, 1, delta_serials, delta_reasons,
+                                      OSSL_NELEM(delta_serials)))
+        || !TEST_ptr(newer = make_crl(key, 3, 2, NULL, NULL, 0)))
+        goto err;
+
+    /* Only deltas based on at most the CRL number of the base apply */
+    if (!TEST_false(X509_CRL_merge_delta(base, base))
+        || !TEST_false(X509_CRL_merge_delta(delta, delta))
+        || !TEST_false(X509_CRL_merge_delta(base, newer))
+        || !TEST_true(X509_CRL_digest(base, EVP_sha1(), md_before, NULL))
+        || !TEST_true(X509_CRL_merge_delta(base, delta))
+        || !TEST_false(X509_CRL_merge_delta(base, delta)))
+        goto err;
+
+    /* The fingerprint changes along with the contents */
+    if (!TEST_true(X509_CRL_digest(base, EVP_sha1(), md_after, NULL))
+        || !TEST_mem_ne(md_before, sizeof(md_before),
+                        md_after, sizeof(md_after)))
+        goto err;
+
+    if (!TEST_int_eq(sk_X509_REVOKED_num(X509_CRL_get_REVOKED(base)), 10)
+        || !TEST_ptr(number = X509_CRL_get_ext_d2i(base, NID_crl_number,
+                                                   NULL, NULL))
+        || !TEST_long_eq(ASN1_INTEGER_get(number), 2))
+        goto err;
+
+    /* The merged CRL encodes and decodes to the same entries */
+    if (!TEST_int_gt(X509_CRL_sign(base, key, EVP_sha256()), 0)
+        || !TEST_int_gt(len = i2d_X509_CRL(base, &der), 0))
+        goto err;
+    p = der;
+    if (!TEST_ptr(merged = d2i_X509_CRL(NULL, &p, len)))
+        goto err;
+
+    if (!TEST_int_eq(lookup_serial(merged, 3, CRL_REASON_KEY_COMPROMISE), 1)
+        || !TEST_int_eq(lookup_serial(merged, 4, CRL_REASON_NONE), 1)
+        || !TEST_int_eq(lookup_serial(merged, 5, CRL_REASON_NONE), 0)
+        || !TEST_int_eq(lookup_serial(merged, 9, CRL_REASON_CERTIFICATE_HOLD),
+                        1)
+        || !TEST_int_eq(lookup_serial(merged, 11, CRL_REASON_KEY_COMPROMISE),
+                        1)
+        || !TEST_int_eq(lookup_serial(merged, 42, CRL_REASON_NONE), 0)
+        || !TEST_int_eq(lookup_serial(base, 3, CRL_REASON_KEY_COMPROMISE), 1)
+        || !TEST_int_eq(lookup_serial(base, 5, CRL_REASON_NONE), 0)
+        || !TEST_int_eq(lookup_serial(base, 11, CRL_REASON_KEY_COMPROMISE), 1))
+        goto err;
+
+    /* The next delta applies to the merged CRL */
+    if (!TEST_true(X509_CRL_merge_delta(merged, newer)))
+        goto err;
+
+    r = 1;
+ err:
+    OPENSSL_free(der);
+    ASN1_INTEGER_free(number);
+    X509_CRL_free(base);
+    X509_CRL_free(delta);
+    X509_CRL_free(newer);
+    X509_CRL_free(merged);
+    EVP_PKEY_free(key);
+    return r;
+}
+
 int setup_tests(void)
 {
     if (!TEST_ptr(test_root = X509_from_strings(kCRLTestRoot))
@@ -403,6 +658,8 @@ int setup_tests(void)
     ADD_TEST(test_known_critical_crl);
     ADD_ALL_TESTS(test_unknown_critical_crl, OSSL_NELEM(unknown_critical_crls));
     ADD_TEST(test_reuse_crl);
+    ADD_TEST(test_crl_index);
+    ADD_TEST(test_crl_merge_delta);
     return 1;
 }
 
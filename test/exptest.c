@@ -329,10 +329,80 @@ static int test_mod_exp_x2(int idx)
     return ret;
 }
 
+/*
+ * Edge cases of BN_mod_exp_mont_consttime_x2() for each supported size:
+ * zero and one word exponents, and bases of zero and m - 1.
+ */
+static int test_mod_exp_x2_edge(int idx)
+{
+    static const int sizes[] = { 1024, 1536, 2048 };
+    BN_CTX *ctx = NULL;
+    BIGNUM *a1 = NULL, *p1 = NULL, *m1 = NULL, *r1 = NULL, *s1 = NULL;
+    BIGNUM *a2 = NULL, *p2 = NULL, *m2 = NULL, *r2 = NULL, *s2 = NULL;
+    int i, ret = 0;
+
+    if (!TEST_ptr(ctx = BN_CTX_new())
+        || !TEST_ptr(a1 = BN_new())
+        || !TEST_ptr(p1 = BN_new())
+        || !TEST_ptr(m1 = BN_new())
+        || !TEST_ptr(r1 = BN_new())
+        || !TEST_ptr(s1 = BN_new())
+        || !TEST_ptr(a2 = BN_new())
+        || !TEST_ptr(p2 = BN_new())
+        || !TEST_ptr(m2 = BN_new())
+        || !TEST_ptr(r2 = BN_new())
+        || !TEST_ptr(s2 = BN_new())
+        || !TEST_true(BN_rand(m1, sizes[idx], BN_RAND_TOP_ONE,
+                              BN_RAND_BOTTOM_ODD))
+        || !TEST_true(BN_rand(m2, sizes[idx], BN_RAND_TOP_ONE,
+                              BN_RAND_BOTTOM_ODD)))
+        goto err;
+
+    for (i = 0; i < 4; i++) {
+        /* a1 = 0 or m1 - 1, a2 = m2 - 1 or 0 */
+        if (!TEST_true(BN_sub(a1, m1, BN_value_one()))
+            || !TEST_true(BN_sub(a2, m2, BN_value_one())))
+            goto err;
+        BN_zero((i & 1) == 0 ? a1 : a2);
+
+        /* p1 = 0 or one word, p2 = one word or 0 */
+        if (!TEST_true(BN_set_word(p1, (i & 2) == 0 ? 0 : 0x10001))
+            || !TEST_true(BN_set_word(p2, (i & 2) == 0 ? 0x10001 : 0)))
+            goto err;
+
+        if (!TEST_true(BN_mod_exp_simple(s1, a1, p1, m1, ctx))
+            || !TEST_true(BN_mod_exp_simple(s2, a2, p2, m2, ctx))
+            || !TEST_true(BN_mod_exp_mont_consttime_x2(r1, a1, p1, m1, NULL,
+                                                       r2, a2, p2, m2, NULL,
+                                                       ctx))
+            || !TEST_BN_eq(r1, s1)
+            || !TEST_BN_eq(r2, s2)) {
+            TEST_info("case %d", i);
+            goto err;
+        }
+    }
+
+    ret = 1;
+ err:
+    BN_free(a1);
+    BN_free(p1);
+    BN_free(m1);
+    BN_free(r1);
+    BN_free(s1);
+    BN_free(a2);
+    BN_free(p2);
+    BN_free(m2);
+    BN_free(r2);
+    BN_free(s2);
+    BN_CTX_free(ctx);
+    return ret;
+}
+
 int setup_tests(void)
 {
     ADD_TEST(test_mod_exp_zero);
     ADD_ALL_TESTS(test_mod_exp, 200);
     ADD_ALL_TESTS(test_mod_exp_x2, 300);
+    ADD_ALL_TESTS(test_mod_exp_x2_edge, 3);
     return 1;
 }
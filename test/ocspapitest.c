@@ -16,6 +16,7 @@
 #include <openssl/asn1.h>
 #include <openssl/pem.h>
 
+#include "../crypto/ocsp/ocsp_local.h" /* for tbsResponseData.responderId */
 #include "testutil.h"
 
 static const char *certstr;
@@ -154,6 +155,167 @@ static int test_resp_signer(void)
     return ret;
 }
 
+/* Encodes |bs| and decodes it again, as a client would receive it */
+static OCSP_BASICRESP *reencode_resp(OCSP_BASICRESP *bs, unsigned char **der,
+                                     int *len)
+{
+    const unsigned char *p;
+
+    OPENSSL_free(*der);
+    *der = NULL;
+    if (!TEST_int_gt(*len = i2d_OCSP_BASICRESP(bs, der), 0))
+        return NULL;
+    p = *der;
+    return d2i_OCSP_BASICRESP(NULL, &p, *len);
+}
+
+static int test_resp_verify_pinned(void)
+{
+    OCSP_BASICRESP *bs = NULL, *rcvd = NULL, *tampered = NULL;
+    X509 *signer = NULL;
+    EVP_PKEY *key = NULL;
+    STACK_OF(X509) *pinned = NULL, *none = NULL;
+    unsigned char *der = NULL;
+    const unsigned char *p;
+    const unsigned long flags = OCSP_TRUSTOTHER | OCSP_NOINTERN;
+    int i, len = 0, ret = 0;
+
+    if (!TEST_ptr(bs = make_dummy_resp())
+        || !TEST_true(get_cert_and_key(&signer, &key))
+        || !TEST_ptr(pinned = sk_X509_new_null())
+        || !TEST_ptr(none = sk_X509_new_null())
+        || !TEST_true(sk_X509_push(pinned, signer))
+        || !TEST_true(OCSP_basic_sign(bs, signer, key, EVP_sha256(), NULL,
+                                      OCSP_NOCERTS | OCSP_RESPID_KEY))
+        || !TEST_ptr(rcvd = reencode_resp(bs, &der, &len)))
+        goto err;
+
+    /* A response from the pinned responder needs no trust store */
+    if (!TEST_int_eq(OCSP_basic_verify(rcvd, pinned, NULL, flags), 1)
+        || !TEST_int_le(OCSP_basic_verify(rcvd, none, NULL, flags), 0))
+        goto err;
+
+    /*
+     * The signature is checked over the received response data, so changing
+     * the first digit of producedAt, the first GeneralizedTime, breaks it
+     */
+    for (i = 0; i + 2 < len && (der[i] != V_ASN1_GENERALIZEDTIME
+                                || der[i + 1] != 15); i++)
+        continue;
+    if (!TEST_int_lt(i + 2, len))
+        goto err;
+    der[i + 2] ^= 1;
+    p = der;
+    if (!TEST_ptr(tampered = d2i_OCSP_BASICRESP(NULL, &p, len))
+        || !TEST_int_le(OCSP_basic_verify(tampered, pinned, NULL, flags), 0))
+        goto err;
+
+    /* Changes to a received response are included when it is signed again */
+    if (!TEST_true(OCSP_basic_add1_nonce(rcvd, NULL, -1))
+        || !TEST_true(OCSP_basic_sign(rcvd, signer, key, EVP_sha256(), NULL,
+                                      OCSP_NOCERTS | OCSP_RESPID_KEY)))
+        goto err;
+    OCSP_BASICRESP_free(bs);
+    if (!TEST_ptr(bs = reencode_resp(rcvd, &der, &len))
+        || !TEST_int_ge(OCSP_BASICRESP_get_ext_by_NID(bs,
+                                                      NID_id_pkix_OCSP_Nonce,
+                                                      -1), 0)
+        || !TEST_int_eq(OCSP_basic_verify(bs, pinned, NULL, flags), 1))
+        goto err;
+
+    ret = 1;
+ err:
+    OCSP_BASICRESP_free(bs);
+    OCSP_BASICRESP_free(rcvd);
+    OCSP_BASICRESP_free(tampered);
+    OPENSSL_free(der);
+    sk_X509_free(pinned);
+    sk_X509_free(none);
+    X509_free(signer);
+    EVP_PKEY_free(key);
+    return ret;
+}
+
+/* Changes to a parsed response show up when it is encoded again */
+static int test_resp_modify_reencode(void)
+{
+    OCSP_BASICRESP *bs = NULL, *rcvd = NULL, *out = NULL;
+    OCSP_CERTID *cid = NULL;
+    X509 *signer = NULL;
+    EVP_PKEY *key = NULL;
+    ASN1_TIME *thisupd = NULL;
+    ASN1_GENERALIZEDTIME *cutoff = NULL;
+    unsigned char *der = NULL;
+    int len = 0, ret = 0;
+
+    if (!TEST_ptr(bs = make_dummy_resp())
+        || !TEST_true(get_cert_and_key(&signer, &key))
+        || !TEST_true(OCSP_basic_sign(bs, signer, key, EVP_sha256(), NULL,
+                                      OCSP_NOCERTS))
+        || !TEST_ptr(rcvd = reencode_resp(bs, &der, &len))
+        || !TEST_int_eq(OCSP_resp_count(rcvd), 1))
+        goto err;
+
+    if (!TEST_true(OCSP_basic_add1_nonce(rcvd, NULL, -1))
+        || !TEST_ptr(out = reencode_resp(rcvd, &der, &len))
+        || !TEST_int_eq(OCSP_BASICRESP_get_ext_by_NID(out,
+                                                      NID_id_pkix_OCSP_Nonce,
+                                                      -1), 0))
+        goto err;
+    OCSP_BASICRESP_free(out);
+    out = NULL;
+
+    OCSP_BASICRESP_free(rcvd);
+    rcvd = NULL;
+    if (!TEST_ptr(rcvd = reencode_resp(bs, &der, &len))
+        || !TEST_ptr(cutoff = ASN1_GENERALIZEDTIME_set(NULL, time(NULL)))
+        || !TEST_true(OCSP_BASICRESP_add1_ext_i2d(rcvd,
+                                                  NID_id_pkix_OCSP_archiveCutoff,
+                                                  cutoff, 0, 0))
+        || !TEST_ptr(out = reencode_resp(rcvd, &der, &len))
+        || !TEST_int_eq(OCSP_BASICRESP_get_ext_count(out), 1))
+        goto err;
+    OCSP_BASICRESP_free(out);
+    out = NULL;
+    X509_EXTENSION_free(OCSP_BASICRESP_delete_ext(rcvd, 0));
+    if (!TEST_ptr(out = reencode_resp(rcvd, &der, &len))
+        || !TEST_int_eq(OCSP_BASICRESP_get_ext_count(out), 0))
+        goto err;
+    OCSP_BASICRESP_free(out);
+    out = NULL;
+
+    if (!TEST_ptr(thisupd = ASN1_TIME_set(NULL, time(NULL)))
+        || !TEST_ptr(cid = OCSP_cert_to_id(NULL, signer, signer))
+        || !TEST_ptr(OCSP_basic_add1_status(rcvd, cid, V_OCSP_CERTSTATUS_GOOD,
+                                            0, NULL, thisupd, NULL))
+        || !TEST_ptr(out = reencode_resp(rcvd, &der, &len))
+        || !TEST_int_eq(OCSP_resp_count(out), 2))
+        goto err;
+    OCSP_BASICRESP_free(out);
+    out = NULL;
+
+    /* The responder ID starts out by name, switch it to the key hash */
+    if (!TEST_true(OCSP_RESPID_set_by_key(&rcvd->tbsResponseData.responderId,
+                                          signer))
+        || !TEST_ptr(out = reencode_resp(rcvd, &der, &len))
+        || !TEST_int_eq(out->tbsResponseData.responderId.type,
+                        V_OCSP_RESPID_KEY))
+        goto err;
+
+    ret = 1;
+ err:
+    OCSP_BASICRESP_free(bs);
+    OCSP_BASICRESP_free(rcvd);
+    OCSP_BASICRESP_free(out);
+    OCSP_CERTID_free(cid);
+    ASN1_TIME_free(thisupd);
+    ASN1_GENERALIZEDTIME_free(cutoff);
+    OPENSSL_free(der);
+    X509_free(signer);
+    EVP_PKEY_free(key);
+    return ret;
+}
+
 static int test_access_description(int testcase)
 {
     ACCESS_DESCRIPTION *ad = ACCESS_DESCRIPTION_new();
@@ -229,6 +391,8 @@ int setup_tests(void)
         return 0;
 #ifndef OPENSSL_NO_OCSP
     ADD_TEST(test_resp_signer);
+    ADD_TEST(test_resp_verify_pinned);
+    ADD_TEST(test_resp_modify_reencode);
     ADD_ALL_TESTS(test_access_description, 3);
     ADD_TEST(test_ocsp_url_svcloc_new);
 #endif
@@ -1079,6 +1079,92 @@ err:
     return testresult;
 }
 
+/*
+ * TX ACK Frames With Many Ranges
+ * ******************************************************************
+ */
+static const size_t tx_ack_num_ranges[] = { 1, 16, 256 };
+
+/*
+ * Send packets in rounds of twice the given number of ranges and acknowledge
+ * every odd packet of each round with a single ACK frame, so that each frame
+ * carries the full number of ranges. The even packets are eventually declared
+ * lost. Check every packet is accounted for once.
+ */
+static int test_tx_ack_ranges(int idx)
+{
+    int testresult = 0;
+    struct helper h;
+    size_t i, j, num_ranges = tx_ack_num_ranges[idx];
+    size_t num_pkts = 1 << 15;
+    size_t num_rounds = num_pkts / (2 * num_ranges), num_acked = 0;
+    OSSL_ACKM_TX_PKT *tx;
+    OSSL_QUIC_FRAME_ACK ack = {0};
+    OSSL_QUIC_ACK_RANGE *ranges = NULL;
+
+    if (!TEST_int_eq(helper_init(&h, num_pkts), 1)
+        || !TEST_ptr(ranges = OPENSSL_malloc(num_ranges * sizeof(*ranges))))
+        goto err;
+
+    for (i = 0; i < num_pkts; ++i) {
+        h.pkts[i].pkt = tx = OPENSSL_zalloc(sizeof(*tx));
+        if (!TEST_ptr(tx))
+            goto err;
+
+        tx->pkt_num             = i;
+        tx->pkt_space           = QUIC_PN_SPACE_APP;
+        tx->is_inflight         = 1;
+        tx->is_ack_eliciting    = 1;
+        tx->num_bytes           = 123;
+        tx->largest_acked       = QUIC_PN_INVALID;
+        tx->on_lost             = on_lost;
+        tx->on_acked            = on_acked;
+        tx->on_discarded        = on_discarded;
+        tx->cb_arg              = &h.pkts[i];
+    }
+
+    ack.ack_ranges      = ranges;
+    ack.num_ack_ranges  = num_ranges;
+
+    for (i = 0; i < num_rounds; ++i) {
+        for (j = 0; j < 2 * num_ranges; ++j) {
+            tx = h.pkts[i * 2 * num_ranges + j].pkt;
+            tx->time = fake_time;
+            if (!TEST_int_eq(ossl_ackm_on_tx_packet(h.ackm, tx), 1))
+                goto err;
+        }
+
+        /* ACK ranges are given in descending order. */
+        for (j = 0; j < num_ranges; ++j)
+            ranges[j].start = ranges[j].end
+                = (i + 1) * 2 * num_ranges - 1 - 2 * j;
+
+        if (!TEST_int_eq(ossl_ackm_on_rx_ack_frame(h.ackm, &ack,
+                                                   QUIC_PN_SPACE_APP,
+                                                   fake_time), 1))
+            goto err;
+
+        fake_time = ossl_time_add(fake_time, ossl_ms2time(1));
+    }
+
+    for (i = 0; i < num_rounds * 2 * num_ranges; ++i) {
+        if (!TEST_int_le(h.pkts[i].acked + h.pkts[i].lost, 1)
+            || !TEST_int_eq(h.pkts[i].acked, (int)(i % 2)))
+            goto err;
+
+        num_acked += h.pkts[i].acked;
+    }
+
+    if (!TEST_size_t_eq(num_acked, num_rounds * num_ranges))
+        goto err;
+
+    testresult = 1;
+err:
+    OPENSSL_free(ranges);
+    helper_destroy(&h);
+    return testresult;
+}
+
 /*
  * Driver
  * ******************************************************************
@@ -1112,5 +1198,6 @@ int setup_tests(void)
                   OSSL_NELEM(tx_ack_cases) * MODE_NUM * QUIC_PN_SPACE_NUM);
     ADD_ALL_TESTS(test_tx_ack_time_script, OSSL_NELEM(tx_ack_time_scripts));
     ADD_ALL_TESTS(test_rx_ack, OSSL_NELEM(rx_test_scripts) * QUIC_PN_SPACE_NUM);
+    ADD_ALL_TESTS(test_tx_ack_ranges, OSSL_NELEM(tx_ack_num_ranges));
     return 1;
 }
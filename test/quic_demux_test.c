@@ -0,0 +1,176 @@
+/*
+ * Copyright 2023 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+#include "internal/quic_demux.h"
+#include "testutil.h"
+
+#define TEST_CID_LEN    8
+#define TEST_DGRAM_LEN  64
+
+static QUIC_DEMUX *demux;
+static size_t *hits, other_hits, default_hits;
+
+static void make_cid(QUIC_CONN_ID *cid, size_t i)
+{
+    size_t j;
+
+    cid->id_len = TEST_CID_LEN;
+    for (j = 0; j < TEST_CID_LEN; ++j)
+        cid->id[j] = (unsigned char)((i >> ((j % 4) * 8)) ^ (j * 0x5b));
+}
+
+static int inject_cid(size_t i)
+{
+    unsigned char dgram[TEST_DGRAM_LEN] = {0};
+    QUIC_CONN_ID cid;
+
+    make_cid(&cid, i);
+    dgram[0] = 0x40; /* short header with fixed bit set */
+    memcpy(dgram + 1, cid.id, cid.id_len);
+    return ossl_quic_demux_inject(demux, dgram, sizeof(dgram), NULL, NULL);
+}
+
+static void rx_cb(QUIC_URXE *e, void *arg)
+{
+    ++*(size_t *)arg;
+    ossl_quic_demux_release_urxe(demux, e);
+}
+
+static void default_cb(QUIC_URXE *e, void *arg)
+{
+    ++default_hits;
+    ossl_quic_demux_release_urxe(demux, e);
+}
+
+static void demux_cleanup(void)
+{
+    ossl_quic_demux_free(demux);
+    demux = NULL;
+    OPENSSL_free(hits);
+    hits = NULL;
+    other_hits = 0;
+    default_hits = 0;
+}
+
+static int demux_setup(size_t num_cids)
+{
+    if (!TEST_ptr(demux = ossl_quic_demux_new(NULL, NULL, TEST_CID_LEN,
+                                              NULL, NULL))
+        || !TEST_ptr(hits = OPENSSL_zalloc(num_cids * sizeof(*hits))))
+        return 0;
+
+    ossl_quic_demux_set_default_handler(demux, default_cb, NULL);
+    return 1;
+}
+
+/*
+ * Register, look up and unregister enough connection IDs to exercise growing
+ * and shrinking of the connection ID table and removal from long probe runs.
+ */
+static int test_demux_cids(void)
+{
+    int testresult = 0;
+    const size_t n = 5000;
+    size_t i;
+    QUIC_CONN_ID cid;
+
+    if (!demux_setup(n))
+        goto err;
+
+    for (i = 0; i < n; ++i) {
+        make_cid(&cid, i);
+        if (!TEST_true(ossl_quic_demux_register(demux, &cid, rx_cb, &hits[i])))
+            goto err;
+    }
+
+    /* Duplicates are rejected */
+    make_cid(&cid, n / 2);
+    if (!TEST_false(ossl_quic_demux_register(demux, &cid, rx_cb, &hits[0])))
+        goto err;
+
+    for (i = 0; i < n; ++i)
+        if (!TEST_true(inject_cid(i)) || !TEST_size_t_eq(hits[i], 1))
+            goto err;
+
+    if (!TEST_true(inject_cid(n)) || !TEST_size_t_eq(default_hits, 1))
+        goto err;
+
+    /*
+     * Retire every even connection ID and hand every sixth one over to a
+     * different handler shared between all of them.
+     */
+    for (i = 0; i < n; i += 2) {
+        make_cid(&cid, i);
+        if (!TEST_true(ossl_quic_demux_unregister(demux, &cid)))
+            goto err;
+    }
+
+    make_cid(&cid, 0);
+    if (!TEST_false(ossl_quic_demux_unregister(demux, &cid)))
+        goto err;
+
+    for (i = 0; i < n; i += 6) {
+        make_cid(&cid, i);
+        if (!TEST_true(ossl_quic_demux_register(demux, &cid, rx_cb,
+                                                &other_hits)))
+            goto err;
+    }
+
+    for (i = 0, default_hits = 0; i < n; ++i)
+        if (!TEST_true(inject_cid(i))
+            || !TEST_size_t_eq(hits[i], i % 2 != 0 ? 2 : 1))
+            goto err;
+
+    if (!TEST_size_t_eq(other_hits, (n + 5) / 6)
+        || !TEST_size_t_eq(default_hits, n / 2 - (n + 5) / 6))
+        goto err;
+
+    /* Remove everything registered with the shared handler */
+    ossl_quic_demux_unregister_by_cb(demux, rx_cb, &other_hits);
+
+    for (i = 0; i < n; i += 6) {
+        make_cid(&cid, i);
+        if (!TEST_false(ossl_quic_demux_unregister(demux, &cid)))
+            goto err;
+    }
+
+    for (i = 0, default_hits = 0; i < n; ++i)
+        if (!TEST_true(inject_cid(i))
+            || !TEST_size_t_eq(hits[i], i % 2 != 0 ? 3 : 1))
+            goto err;
+
+    if (!TEST_size_t_eq(default_hits, n / 2))
+        goto err;
+
+    /* Retire the rest, shrinking the table, and check it is still usable */
+    for (i = 1; i < n; i += 2) {
+        make_cid(&cid, i);
+        if (!TEST_true(ossl_quic_demux_unregister(demux, &cid)))
+            goto err;
+    }
+
+    make_cid(&cid, 1);
+    if (!TEST_true(ossl_quic_demux_register(demux, &cid, rx_cb, &hits[1]))
+        || !TEST_true(inject_cid(1))
+        || !TEST_size_t_eq(hits[1], 4)
+        || !TEST_true(inject_cid(3))
+        || !TEST_size_t_eq(hits[3], 3))
+        goto err;
+
+    testresult = 1;
+err:
+    demux_cleanup();
+    return testresult;
+}
+
+int setup_tests(void)
+{
+    ADD_TEST(test_demux_cids);
+    return 1;
+}
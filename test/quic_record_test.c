@@ -1763,7 +1763,7 @@ static OSSL_TIME fake_time(void *arg)
 static int rx_state_ensure(struct rx_state *s)
 {
     if (s->demux == NULL
-        && !TEST_ptr(s->demux = ossl_quic_demux_new(NULL,
+        && !TEST_ptr(s->demux = ossl_quic_demux_new(NULL, NULL,
                                                     s->args.short_conn_id_len,
                                                     fake_time,
                                                     NULL)))
@@ -477,6 +477,8 @@ static int test_rstream_random(int idx)
     unsigned char *bulk_data = NULL;
     unsigned char *read_buf = NULL;
     QUIC_RSTREAM *rstream = NULL;
+    SFRAME_POOL *pool = NULL;
+    SFRAME_POOL_STATS stats;
     size_t i, read_off, queued_min, queued_max;
     const size_t data_size = 10000;
     int r, s, fin = 0, fin_set = 0;
@@ -491,6 +493,11 @@ static int test_rstream_random(int idx)
     if (idx % 3 == 0)
         ossl_quic_rstream_set_cleanse(rstream, 1);
 
+    if ((idx / 2) % 2 == 0
+        && (!TEST_ptr(pool = ossl_sframe_pool_new())
+            || !TEST_true(ossl_quic_rstream_set_sframe_pool(rstream, pool))))
+        goto err;
+
     for (i = 0; i < data_size; ++i)
         bulk_data[i] = (unsigned char)(test_random() & 0xFF);
 
@@ -586,20 +593,158 @@ static int test_rstream_random(int idx)
             goto err;
     }
 
+    if (pool != NULL) {
+        ossl_quic_rstream_free(rstream);
+        rstream = NULL;
+
+        /* Everything is returned and only a few spare slabs are retained */
+        ossl_sframe_pool_get_stats(pool, &stats);
+        if (!TEST_size_t_eq(stats.num_frames_used, 0)
+            || !TEST_size_t_le(stats.num_slabs, 4))
+            goto err;
+    }
+
     ret = 1;
 
  err:
     ossl_quic_rstream_free(rstream);
+    ossl_sframe_pool_free(pool);
     OPENSSL_free(bulk_data);
     OPENSSL_free(read_buf);
     return ret;
 }
 
+/*
+ * Stress test of many rstreams sharing a stream frame pool, as they do within
+ * a QUIC channel. Data is delivered to the streams interleaved in packet sized
+ * frames with some reordering, and the number of heap allocations needed for
+ * stream frames per MB transferred is reported.
+ */
+#define POOL_TEST_STREAMS       64
+#define POOL_TEST_FRAME_LEN     1200
+#define POOL_TEST_STREAM_LEN    (64 * POOL_TEST_FRAME_LEN)
+
+static int test_rstream_pool(int idx)
+{
+    QUIC_RSTREAM *rstreams[POOL_TEST_STREAMS] = { NULL };
+    uint64_t offsets[POOL_TEST_STREAMS] = { 0 };
+    int swapped[POOL_TEST_STREAMS] = { 0 };
+    SFRAME_POOL *pool = NULL;
+    SFRAME_POOL_STATS stats;
+    unsigned char *data = NULL, *read_buf = NULL;
+    size_t i, readbytes, total = 0, max_used = 0;
+    size_t read_off[POOL_TEST_STREAMS] = { 0 };
+    int fin, round, ret = 0;
+    /* How many rounds of frames to queue before the application reads */
+    int read_interval = idx == 0 ? 1 : 8;
+
+    if (!TEST_ptr(data = OPENSSL_malloc(POOL_TEST_STREAM_LEN))
+        || !TEST_ptr(read_buf = OPENSSL_malloc(POOL_TEST_STREAM_LEN))
+        || !TEST_ptr(pool = ossl_sframe_pool_new()))
+        goto err;
+
+    for (i = 0; i < POOL_TEST_STREAM_LEN; ++i)
+        data[i] = (unsigned char)(test_random() & 0xFF);
+
+    for (i = 0; i < POOL_TEST_STREAMS; ++i)
+        if (!TEST_ptr(rstreams[i] = ossl_quic_rstream_new(NULL, NULL, 0))
+            || !TEST_true(ossl_quic_rstream_set_sframe_pool(rstreams[i],
+                                                            pool)))
+            goto err;
+
+    for (round = 0; offsets[0] < POOL_TEST_STREAM_LEN; ++round) {
+        for (i = 0; i < POOL_TEST_STREAMS; ++i) {
+            uint64_t off = offsets[i], next = off + POOL_TEST_FRAME_LEN;
+
+            /*
+             * Every other pair of frames arrives swapped, to exercise
+             * insertion into the middle of the list and not just appends.
+             */
+            if (swapped[i]) {
+                swapped[i] = 0;
+                next = off + 2 * POOL_TEST_FRAME_LEN;
+            } else if (round % 4 == 0
+                       && off + 2 * POOL_TEST_FRAME_LEN <= POOL_TEST_STREAM_LEN) {
+                off += POOL_TEST_FRAME_LEN;
+                next = offsets[i];
+                swapped[i] = 1;
+            }
+
+            if (!TEST_true(ossl_quic_rstream_queue_data(rstreams[i], NULL, off,
+                                                        data + off,
+                                                        POOL_TEST_FRAME_LEN,
+                                                        0)))
+                goto err;
+
+            offsets[i] = next;
+        }
+
+        ossl_sframe_pool_get_stats(pool, &stats);
+        if (stats.num_frames_used > max_used)
+            max_used = stats.num_frames_used;
+
+        if ((round + 1) % read_interval != 0)
+            continue;
+
+        for (i = 0; i < POOL_TEST_STREAMS; ++i) {
+            if (!TEST_true(ossl_quic_rstream_read(rstreams[i], read_buf,
+                                                  POOL_TEST_STREAM_LEN,
+                                                  &readbytes, &fin))
+                || !TEST_mem_eq(read_buf, readbytes, data + read_off[i],
+                                readbytes))
+                goto err;
+
+            read_off[i] += readbytes;
+            total += readbytes;
+        }
+    }
+
+    for (i = 0; i < POOL_TEST_STREAMS; ++i) {
+        if (!TEST_true(ossl_quic_rstream_read(rstreams[i], read_buf,
+                                              POOL_TEST_STREAM_LEN,
+                                              &readbytes, &fin)))
+            goto err;
+
+        read_off[i] += readbytes;
+        total += readbytes;
+        if (!TEST_size_t_eq(read_off[i], POOL_TEST_STREAM_LEN))
+            goto err;
+    }
+
+    ossl_sframe_pool_get_stats(pool, &stats);
+    TEST_info("%zu bytes over %d streams: %llu frames, %llu heap allocations"
+              " (%.2f per MB), peak %zu frames in use",
+              total, POOL_TEST_STREAMS,
+              (unsigned long long)stats.num_frame_allocs,
+              (unsigned long long)stats.num_slab_allocs,
+              (double)stats.num_slab_allocs * 1024 * 1024 / total, max_used);
+
+    /*
+     * Every frame would have needed its own allocation without the pool; with
+     * it we should only need enough slabs to cover the peak number of frames
+     * held at once.
+     */
+    if (!TEST_uint64_t_eq(stats.num_frames_used, 0)
+        || !TEST_uint64_t_lt(stats.num_slab_allocs,
+                             stats.num_frame_allocs / 8))
+        goto err;
+
+    ret = 1;
+ err:
+    for (i = 0; i < POOL_TEST_STREAMS; ++i)
+        ossl_quic_rstream_free(rstreams[i]);
+    ossl_sframe_pool_free(pool);
+    OPENSSL_free(data);
+    OPENSSL_free(read_buf);
+    return ret;
+}
+
 int setup_tests(void)
 {
     ADD_TEST(test_sstream_simple);
     ADD_ALL_TESTS(test_sstream_bulk, 100);
     ADD_ALL_TESTS(test_rstream_simple, 4);
     ADD_ALL_TESTS(test_rstream_random, 100);
+    ADD_ALL_TESTS(test_rstream_pool, 2);
     return 1;
 }
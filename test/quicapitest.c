@@ -1345,6 +1345,198 @@ static int test_alpn(int idx)
     return testresult;
 }
 
+/*
+ * Test that SSL_handle_events_many() can drive several nonblocking connections
+ * at once and reports the earliest event timeout of those it processed.
+ */
+static int test_handle_events_many(void)
+{
+    SSL_CTX *cctx = SSL_CTX_new_ex(libctx, NULL, OSSL_QUIC_client_method());
+    QUIC_TSERVER *qtserv[2] = { NULL, NULL };
+    /* The final entry is deliberately left NULL and must be skipped */
+    SSL *clientquic[3] = { NULL, NULL, NULL };
+    int connected[2] = { 0, 0 };
+    struct timeval tv, tv2;
+    int isinf, isinf2, i, j, ret, err, testresult = 0;
+
+    if (!TEST_ptr(cctx))
+        goto err;
+
+    for (i = 0; i < 2; i++)
+        if (!TEST_true(qtest_create_quic_objects(libctx, cctx, NULL, cert,
+                                                 privkey, QTEST_FLAG_FAKE_TIME,
+                                                 &qtserv[i], &clientquic[i],
+                                                 NULL, NULL)))
+            goto err;
+
+    for (j = 0; j < 1000 && (!connected[0] || !connected[1]); j++) {
+        for (i = 0; i < 2; i++) {
+            if (connected[i])
+                continue;
+
+            ret = SSL_connect(clientquic[i]);
+            if (ret == 1) {
+                connected[i] = 1;
+                continue;
+            }
+
+            err = SSL_get_error(clientquic[i], ret);
+            if (!TEST_true(err == SSL_ERROR_WANT_READ
+                           || err == SSL_ERROR_WANT_WRITE))
+                goto err;
+        }
+
+        qtest_add_time(1);
+        if (!TEST_true(SSL_handle_events_many(clientquic,
+                                              OSSL_NELEM(clientquic),
+                                              &tv, &isinf)))
+            goto err;
+
+        for (i = 0; i < 2; i++)
+            ossl_quic_tserver_tick(qtserv[i]);
+    }
+
+    if (!TEST_true(connected[0]) || !TEST_true(connected[1]))
+        goto err;
+
+    /* Both connections have an idle timeout so a timeout must be reported */
+    if (!TEST_true(SSL_handle_events_many(clientquic, OSSL_NELEM(clientquic),
+                                          &tv, &isinf))
+            || !TEST_false(isinf))
+        goto err;
+
+    for (i = 0; i < 2; i++) {
+        if (!TEST_true(SSL_get_event_timeout(clientquic[i], &tv2, &isinf2))
+                || !TEST_false(isinf2))
+            goto err;
+
+        if (!TEST_true(tv.tv_sec < tv2.tv_sec
+                       || (tv.tv_sec == tv2.tv_sec
+                           && tv.tv_usec <= tv2.tv_usec)))
+            goto err;
+    }
+
+    /* An empty set of objects is not an error, but has no timeout */
+    if (!TEST_true(SSL_handle_events_many(clientquic + 2, 1, &tv, &isinf))
+            || !TEST_true(isinf))
+        goto err;
+
+    /* Asking for only half of the timeout is refused */
+    if (!TEST_false(SSL_handle_events_many(clientquic, 2, &tv, NULL))
+            || !TEST_false(SSL_handle_events_many(clientquic, 2, NULL, &isinf))
+            || !TEST_true(SSL_handle_events_many(clientquic, 2, NULL, NULL)))
+        goto err;
+    ERR_clear_error();
+
+    testresult = 1;
+ err:
+    for (i = 0; i < 2; i++) {
+        ossl_quic_tserver_free(qtserv[i]);
+        SSL_free(clientquic[i]);
+    }
+    SSL_CTX_free(cctx);
+
+    return testresult;
+}
+
+/*
+ * Test zero-copy reads using SSL_get0_read_buffer() and
+ * SSL_release_read_buffer().
+ */
+static int test_read_buffer(void)
+{
+    SSL_CTX *cctx = SSL_CTX_new_ex(libctx, NULL, OSSL_QUIC_client_method());
+    SSL *clientquic = NULL;
+    QUIC_TSERVER *qtserv = NULL;
+    int testresult = 0, i;
+    static const unsigned char msg[] = "A test message";
+    size_t msglen = sizeof(msg) - 1;
+    const unsigned char *rbuf = NULL;
+    unsigned char buf[20];
+    size_t numbytes = 0, rlen = 0;
+
+    if (!TEST_ptr(cctx)
+            || !TEST_true(qtest_create_quic_objects(libctx, cctx, NULL, cert,
+                                                    privkey, 0, &qtserv,
+                                                    &clientquic, NULL, NULL))
+            || !TEST_true(qtest_create_quic_connection(qtserv, clientquic)))
+        goto err;
+
+    /* Nothing held yet */
+    if (!TEST_false(SSL_release_read_buffer(clientquic, 0)))
+        goto err;
+
+    /* Create the default stream and have the server echo back and conclude */
+    if (!TEST_true(SSL_write_ex(clientquic, msg, msglen, &numbytes))
+            || !TEST_size_t_eq(numbytes, msglen))
+        goto err;
+
+    for (i = 0, numbytes = 0; i < 10 && numbytes == 0; i++) {
+        ossl_quic_tserver_tick(qtserv);
+        if (!TEST_true(ossl_quic_tserver_read(qtserv, 0, buf, sizeof(buf),
+                                              &numbytes)))
+            goto err;
+        SSL_handle_events(clientquic);
+    }
+
+    if (!TEST_mem_eq(buf, numbytes, msg, msglen)
+            || !TEST_true(ossl_quic_tserver_write(qtserv, 0, msg, msglen,
+                                                  &numbytes))
+            || !TEST_size_t_eq(numbytes, msglen)
+            || !TEST_true(ossl_quic_tserver_conclude(qtserv, 0)))
+        goto err;
+
+    for (i = 0; i < 10; i++) {
+        ossl_quic_tserver_tick(qtserv);
+        if (SSL_get0_read_buffer(clientquic, &rbuf, &rlen))
+            break;
+        if (!TEST_int_eq(SSL_get_error(clientquic, 0), SSL_ERROR_WANT_READ))
+            goto err;
+    }
+
+    if (!TEST_int_lt(i, 10)
+            || !TEST_mem_eq(rbuf, rlen, msg, msglen))
+        goto err;
+
+    /* No other reads are permitted while the buffer is held */
+    if (!TEST_false(SSL_read_ex(clientquic, buf, sizeof(buf), &numbytes))
+            || !TEST_false(SSL_peek_ex(clientquic, buf, sizeof(buf), &numbytes))
+            || !TEST_false(SSL_get0_read_buffer(clientquic, &rbuf, &rlen)))
+        goto err;
+
+    /* Can't consume more than we were given */
+    if (!TEST_false(SSL_release_read_buffer(clientquic, msglen + 1)))
+        goto err;
+
+    /* Consume part of the data; the rest must be returned again */
+    if (!TEST_true(SSL_release_read_buffer(clientquic, 2))
+            || !TEST_size_t_eq(SSL_pending(clientquic), msglen - 2)
+            || !TEST_true(SSL_get0_read_buffer(clientquic, &rbuf, &rlen))
+            || !TEST_mem_eq(rbuf, rlen, msg + 2, msglen - 2)
+            || !TEST_true(SSL_release_read_buffer(clientquic, rlen)))
+        goto err;
+
+    /* The stream was concluded so we should now see the end of it */
+    if (!TEST_false(SSL_get0_read_buffer(clientquic, &rbuf, &rlen))
+            || !TEST_int_eq(SSL_get_error(clientquic, 0),
+                            SSL_ERROR_ZERO_RETURN)
+            || !TEST_ptr_null(rbuf)
+            || !TEST_size_t_eq(rlen, 0)
+            || !TEST_false(SSL_read_ex(clientquic, buf, sizeof(buf),
+                                       &numbytes))
+            || !TEST_int_eq(SSL_get_error(clientquic, 0),
+                            SSL_ERROR_ZERO_RETURN))
+        goto err;
+
+    testresult = 1;
+ err:
+    SSL_free(clientquic);
+    ossl_quic_tserver_free(qtserv);
+    SSL_CTX_free(cctx);
+
+    return testresult;
+}
+
 /*
  * Test SSL_get_shutdown() behavior.
  */
@@ -2154,6 +2346,8 @@ int setup_tests(void)
     ADD_ALL_TESTS(test_alpn, 2);
     ADD_ALL_TESTS(test_noisy_dgram, 2);
     ADD_TEST(test_get_shutdown);
+    ADD_TEST(test_handle_events_many);
+    ADD_TEST(test_read_buffer);
     ADD_ALL_TESTS(test_tparam, OSSL_NELEM(tparam_tests));
 
     return 1;
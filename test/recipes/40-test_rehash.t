@@ -1,5 +1,5 @@
 #! /usr/bin/env perl
-# Copyright 2015-2018 The OpenSSL Project Authors. All Rights Reserved.
+# Copyright 2015-2023 The OpenSSL Project Authors. All Rights Reserved.
 #
 # Licensed under the Apache License 2.0 (the "License").  You may not use
 # this file except in compliance with the License.  You can obtain a copy
@@ -23,7 +23,7 @@ setup("test_rehash");
 plan skip_all => "test_rehash is not available on this platform"
     unless run(app(["openssl", "rehash", "-help"]));
 
-plan tests => 4;
+plan tests => 9;
 
 indir "rehash.$$" => sub {
     prepare();
@@ -56,6 +56,25 @@ indir "rehash.$$" => sub {
     chmod 0700, curdir();       # make it writable again, so cleanup works
 }, create => 1, cleanup => 1;
 
+indir "rehash.$$" => sub {
+    copy(srctop_file('test', 'certs', 'root-cert.pem'), curdir());
+    copy(srctop_file('test', 'certs', 'ca-cert.pem'), curdir());
+    ok(run(app(["openssl", "rehash", "-index", curdir()])),
+       'Testing rehash operations writing an index');
+    ok(-f "openssl-rehash.idx", 'Checking that the index was written');
+
+    # With a current index, lookups do not need the hashed links
+    unlink glob("*.[0-9]");
+    utime undef, undef, "openssl-rehash.idx";
+    ok(run(app(["openssl", "verify", "-CApath", curdir(),
+                srctop_file('test', 'certs', 'ee-cert.pem')])),
+       'Testing verification using the index');
+
+    ok(run(app(["openssl", "rehash", curdir()])),
+       'Testing rehash operations without an index');
+    ok(! -e "openssl-rehash.idx", 'Checking that the index was removed');
+}, create => 1, cleanup => 1;
+
 sub prepare {
     my @pemsourcefiles = sort glob(srctop_file('test', "*.pem"));
     my @destfiles = ();
@@ -24,6 +24,7 @@
 #include <openssl/err.h>
 #include <openssl/rand.h>
 #include <openssl/bn.h>
+#include <openssl/sha.h>
 
 #include "testutil.h"
 
@@ -709,12 +710,93 @@ err:
     return ret;
 }
 
+static const char *rsa_verify_exponents[] = { "3", "10001", "10000000000000001" };
+
+/* Verifies |sig| over |md| with a copy of the public key of |key| */
+static int rsa_verify_with(const RSA *key, const unsigned char *md,
+                           const unsigned char *sig, unsigned int siglen)
+{
+    RSA *pub = NULL;
+    BIGNUM *n, *e;
+    int ret = 0;
+
+    n = BN_dup(RSA_get0_n(key));
+    e = BN_dup(RSA_get0_e(key));
+    if (!TEST_ptr(n) || !TEST_ptr(e) || !TEST_ptr(pub = RSA_new())
+        || !TEST_true(RSA_set0_key(pub, n, e, NULL))) {
+        BN_free(n);
+        BN_free(e);
+        goto err;
+    }
+    ret = TEST_true(RSA_verify(NID_sha256, md, SHA256_DIGEST_LENGTH,
+                               sig, siglen, pub));
+ err:
+    RSA_free(pub);
+    return ret;
+}
+
+/*
+ * Verify a signature several times, as the first public key operation sets up
+ * what the next ones use, and check that changing the key is noticed.
+ */
+static int test_rsa_verify(int idx)
+{
+    int ret = 0, i;
+    unsigned int siglen = 0;
+    RSA *key = NULL, *other = NULL;
+    BIGNUM *e = NULL;
+    unsigned char md[SHA256_DIGEST_LENGTH] = { 0 };
+    unsigned char sig[128];
+
+    if (!TEST_true(BN_hex2bn(&e, rsa_verify_exponents[idx]))
+        || !TEST_ptr(key = RSA_new())
+        || !TEST_ptr(other = RSA_new())
+        || !TEST_true(RSA_generate_key_ex(key, 1024, e, NULL))
+        || !TEST_true(RSA_generate_key_ex(other, 1024, e, NULL))
+        || !TEST_true(RSA_sign(NID_sha256, md, sizeof(md), sig, &siglen, key)))
+        goto err;
+
+    for (i = 0; i < 3; i++)
+        if (!TEST_true(RSA_verify(NID_sha256, md, sizeof(md), sig, siglen,
+                                  key)))
+            goto err;
+    sig[0] ^= 1;
+    if (!TEST_false(RSA_verify(NID_sha256, md, sizeof(md), sig, siglen, key)))
+        goto err;
+    sig[0] ^= 1;
+    if (!rsa_verify_with(key, md, sig, siglen))
+        goto err;
+
+    /* The key of |other| must not verify with anything set up for |key| */
+    if (!TEST_true(RSA_set0_key(key, BN_dup(RSA_get0_n(other)), NULL, NULL))
+        || !TEST_false(RSA_verify(NID_sha256, md, sizeof(md), sig, siglen,
+                                  key))
+        || !TEST_true(RSA_sign(NID_sha256, md, sizeof(md), sig, &siglen,
+                               other))
+        || !TEST_true(RSA_verify(NID_sha256, md, sizeof(md), sig, siglen,
+                                 key))
+        || !TEST_true(BN_add_word(e, 2))
+        || !TEST_true(RSA_set0_key(key, NULL, e, NULL)))
+        goto err;
+    e = NULL;
+    if (!TEST_false(RSA_verify(NID_sha256, md, sizeof(md), sig, siglen, key)))
+        goto err;
+
+    ret = 1;
+ err:
+    BN_free(e);
+    RSA_free(key);
+    RSA_free(other);
+    return ret;
+}
+
 int setup_tests(void)
 {
     ADD_ALL_TESTS(test_rsa_pkcs1, 3);
     ADD_ALL_TESTS(test_rsa_oaep, 3);
     ADD_ALL_TESTS(test_rsa_security_bit, OSSL_NELEM(rsa_security_bits_cases));
     ADD_TEST(test_rsa_saos);
+    ADD_ALL_TESTS(test_rsa_verify, OSSL_NELEM(rsa_verify_exponents));
     ADD_TEST(test_EVP_rsa_legacy_key);
     return 1;
 }
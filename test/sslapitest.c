@@ -1985,6 +1985,178 @@ static int test_tlsext_status_type(void)
 
     return testresult;
 }
+
+static unsigned char *staple_rcvd = NULL;
+static long staple_rcvd_len = -1;
+static int staple_refreshes = 0;
+
+static int staple_client_cb(SSL *s, void *arg)
+{
+    const unsigned char *resp;
+
+    OPENSSL_free(staple_rcvd);
+    staple_rcvd = NULL;
+    staple_rcvd_len = SSL_get_tlsext_status_ocsp_resp(s, &resp);
+    if (staple_rcvd_len > 0
+            && !TEST_ptr(staple_rcvd = OPENSSL_memdup(resp, staple_rcvd_len)))
+        return 0;
+    return 1;
+}
+
+static void staple_refresh_cb(SSL_CTX *ctx, X509 *x, void *arg)
+{
+    if (x == (X509 *)arg)
+        staple_refreshes++;
+}
+
+/*
+ * Returns the length of a successful OCSP response for |x| signed by it, valid
+ * from |this_off| seconds from now until |next_off| seconds from now.
+ */
+static int make_staple(X509 *x, EVP_PKEY *key, long this_off, long next_off,
+                       unsigned char **der)
+{
+    OCSP_BASICRESP *bs = NULL;
+    OCSP_RESPONSE *rsp = NULL;
+    OCSP_CERTID *cid = NULL;
+    ASN1_TIME *thisupd = NULL, *nextupd = NULL;
+    EVP_MD *md = NULL;
+    const int successful = OCSP_RESPONSE_STATUS_SUCCESSFUL;
+    int len = 0;
+
+    *der = NULL;
+    if (TEST_ptr(md = EVP_MD_fetch(libctx, "SHA256", NULL))
+            && TEST_ptr(bs = OCSP_BASICRESP_new())
+            && TEST_ptr(cid = OCSP_cert_to_id(md, x, x))
+            && TEST_ptr(thisupd = X509_time_adj_ex(NULL, 0, this_off, NULL))
+            && TEST_ptr(nextupd = X509_time_adj_ex(NULL, 0, next_off, NULL))
+            && TEST_ptr(OCSP_basic_add1_status(bs, cid, V_OCSP_CERTSTATUS_GOOD,
+                                               0, NULL, thisupd, nextupd))
+            && TEST_true(OCSP_basic_sign(bs, x, key, md, NULL, 0))
+            && TEST_ptr(rsp = OCSP_response_create(successful, bs)))
+        len = i2d_OCSP_RESPONSE(rsp, der);
+    OCSP_RESPONSE_free(rsp);
+    OCSP_BASICRESP_free(bs);
+    OCSP_CERTID_free(cid);
+    ASN1_TIME_free(thisupd);
+    ASN1_TIME_free(nextupd);
+    EVP_MD_free(md);
+    return len;
+}
+
+static int staple_handshake(SSL_CTX *sctx, SSL_CTX *cctx)
+{
+    SSL *clientssl = NULL, *serverssl = NULL;
+    int ret;
+
+    staple_rcvd_len = -1;
+    ret = TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                       NULL, NULL))
+        && TEST_true(create_ssl_connection(serverssl, clientssl,
+                                           SSL_ERROR_NONE));
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    return ret;
+}
+
+/*
+ * Test the cache of OCSP responses to staple, with TLSv1.2 (idx == 0) or
+ * TLSv1.3 (idx == 1)
+ */
+static int test_ocsp_staple_cache(int idx)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    X509 *x;
+    EVP_PKEY *key;
+    unsigned char *fresh = NULL, *due = NULL, *expired = NULL;
+    int fresh_len, due_len, expired_len, testresult = 0;
+    int version = idx == 0 ? TLS1_2_VERSION : TLS1_3_VERSION;
+
+#ifdef OPENSSL_NO_TLS1_2
+    if (idx == 0)
+        return TEST_skip("TLSv1.2 is disabled");
+#endif
+#ifdef OSSL_NO_USABLE_TLS1_3
+    if (idx == 1)
+        return TEST_skip("No usable TLSv1.3");
+#endif
+
+    staple_refreshes = 0;
+    if (!TEST_true(create_ssl_ctx_pair(libctx, TLS_server_method(),
+                                       TLS_client_method(), version, version,
+                                       &sctx, &cctx, cert, privkey))
+            || !TEST_ptr(x = SSL_CTX_get0_certificate(sctx))
+            || !TEST_ptr(key = SSL_CTX_get0_privatekey(sctx))
+            || !TEST_int_gt(fresh_len = make_staple(x, key, -60, 86400,
+                                                    &fresh), 0)
+            || !TEST_int_gt(due_len = make_staple(x, key, -7200, 3600,
+                                                  &due), 0)
+            || !TEST_int_gt(expired_len = make_staple(x, key, -7200, -60,
+                                                      &expired), 0))
+        goto end;
+
+    SSL_CTX_set_tlsext_status_type(cctx, TLSEXT_STATUSTYPE_ocsp);
+    SSL_CTX_set_tlsext_status_cb(cctx, staple_client_cb);
+    SSL_CTX_set_ocsp_staple_refresh_cb(sctx, staple_refresh_cb, x);
+
+    /* Nothing is stapled without a cached response or a status callback */
+    if (!TEST_true(staple_handshake(sctx, cctx))
+            || !TEST_long_le(staple_rcvd_len, 0))
+        goto end;
+
+    /* A cached response is stapled without a status callback */
+    if (!TEST_true(SSL_CTX_set1_ocsp_staple(sctx, x, fresh, fresh_len))
+            || !TEST_true(staple_handshake(sctx, cctx))
+            || !TEST_mem_eq(staple_rcvd, staple_rcvd_len, fresh, fresh_len)
+            || !TEST_int_eq(staple_refreshes, 0))
+        goto end;
+
+    /*
+     * One that is past halfway to its nextUpdate is still stapled, and a
+     * refresh is asked for once
+     */
+    if (!TEST_true(SSL_CTX_set1_ocsp_staple(sctx, x, due, due_len))
+            || !TEST_true(staple_handshake(sctx, cctx))
+            || !TEST_mem_eq(staple_rcvd, staple_rcvd_len, due, due_len)
+            || !TEST_int_eq(staple_refreshes, 1)
+            || !TEST_true(staple_handshake(sctx, cctx))
+            || !TEST_mem_eq(staple_rcvd, staple_rcvd_len, due, due_len)
+            || !TEST_int_eq(staple_refreshes, 1))
+        goto end;
+
+    /* Expired and malformed responses are refused and don't replace it */
+    if (!TEST_false(SSL_CTX_set1_ocsp_staple(sctx, x, expired, expired_len))
+            || !TEST_false(SSL_CTX_set1_ocsp_staple(sctx, x, orespder,
+                                                    sizeof(orespder)))
+            || !TEST_true(staple_handshake(sctx, cctx))
+            || !TEST_mem_eq(staple_rcvd, staple_rcvd_len, due, due_len))
+        goto end;
+
+    /* Once removed, the status callback is used again */
+    ERR_clear_error();
+    cdummyarg = 1;
+    ocsp_server_called = 0;
+    SSL_CTX_set_tlsext_status_cb(sctx, ocsp_server_cb);
+    SSL_CTX_set_tlsext_status_arg(sctx, &cdummyarg);
+    if (!TEST_true(SSL_CTX_set1_ocsp_staple(sctx, x, NULL, 0))
+            || !TEST_true(staple_handshake(sctx, cctx))
+            || !TEST_true(ocsp_server_called)
+            || !TEST_mem_eq(staple_rcvd, staple_rcvd_len, orespder,
+                            sizeof(orespder)))
+        goto end;
+
+    testresult = 1;
+
+ end:
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+    OPENSSL_free(fresh);
+    OPENSSL_free(due);
+    OPENSSL_free(expired);
+    OPENSSL_free(staple_rcvd);
+    staple_rcvd = NULL;
+    return testresult;
+}
 #endif
 
 #if !defined(OSSL_NO_USABLE_TLS1_3) || !defined(OPENSSL_NO_TLS1_2)
@@ -11346,6 +11518,7 @@ int setup_tests(void)
     ADD_TEST(test_cleanse_plaintext);
 #ifndef OPENSSL_NO_OCSP
     ADD_TEST(test_tlsext_status_type);
+    ADD_ALL_TESTS(test_ocsp_staple_cache, 2);
 #endif
     ADD_TEST(test_session_with_only_int_cache);
     ADD_TEST(test_session_with_only_ext_cache);
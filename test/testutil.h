@@ -44,6 +44,9 @@
  *
  * int global_init(void);
  *
+ * It is called before anything has been allocated, so it may change the
+ * memory functions, e.g. with test_alloc_count_init().
+ *
  * This function should return zero if there is an unrecoverable error and
  * non-zero if the initialization was successful.
  */
@@ -640,6 +643,14 @@ void fake_rand_set_callback(EVP_RAND_CTX *ctx,
 void fake_rand_set_public_private_callbacks(OSSL_LIB_CTX *libctx,
                                             fake_random_generate_cb *cb);
 
+/*
+ * Counts the allocations made through OPENSSL_malloc() and friends.
+ * test_alloc_count_init() must be called from global_init(), and
+ * test_alloc_count() returns how many allocations there have been since.
+ */
+int test_alloc_count_init(void);
+int test_alloc_count(void);
+
 /* Create a file path from a directory and a filename */
 char *test_mk_file_path(const char *dir, const char *file);
 
@@ -0,0 +1,44 @@
+/*
+ * Copyright 2023 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+#include <stdlib.h>
+#include <openssl/crypto.h>
+#include "internal/tsan_assist.h"
+#include "../testutil.h"
+
+static TSAN_QUALIFIER int alloc_count;
+
+static void *count_malloc(size_t num, const char *file, int line)
+{
+    tsan_counter(&alloc_count);
+    return malloc(num);
+}
+
+static void *count_realloc(void *addr, size_t num, const char *file,
+                           int line)
+{
+    if (addr == NULL)
+        tsan_counter(&alloc_count);
+    return realloc(addr, num);
+}
+
+static void count_free(void *addr, const char *file, int line)
+{
+    free(addr);
+}
+
+int test_alloc_count_init(void)
+{
+    return CRYPTO_set_mem_functions(count_malloc, count_realloc, count_free);
+}
+
+int test_alloc_count(void)
+{
+    return tsan_load(&alloc_count);
+}
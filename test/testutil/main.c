@@ -7,6 +7,7 @@
  * https://www.openssl.org/source/license.html
  */
 
+#include <stdio.h>
 #include "../testutil.h"
 #include "output.h"
 #include "tu_local.h"
@@ -17,13 +18,14 @@ int main(int argc, char *argv[])
     int ret = EXIT_FAILURE;
     int setup_res;
 
-    test_open_streams();
-
+    /* Before the streams, so that it may still change the memory functions */
     if (!global_init()) {
-        test_printf_stderr("Global init failed - aborting\n");
+        fprintf(stderr, "Global init failed - aborting\n");
         return ret;
     }
 
+    test_open_streams();
+
     if (!setup_test_framework(argc, argv))
         goto end;
 
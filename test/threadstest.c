@@ -27,6 +27,7 @@
 #include <openssl/rand.h>
 #include <openssl/pem.h>
 #include <openssl/evp.h>
+#include <openssl/thread.h>
 #include "internal/tsan_assist.h"
 #include "internal/nelem.h"
 #include "testutil.h"
@@ -564,6 +565,114 @@ static int test_multi_shared_pkey(void)
     return test_multi_shared_pkey_common(&thread_shared_evp_pkey);
 }
 
+/*
+ * Signs with the shared RSA key from all threads at once, each of which
+ * needs blinding of its own for it.
+ */
+static int rsa_sign_rounds = 20;
+
+static void thread_rsa_sign(void)
+{
+    static const unsigned char tbs[32] = "threadstest RSA signing";
+    unsigned char sig[512];
+    size_t siglen;
+    EVP_PKEY_CTX *sctx = NULL, *vctx = NULL;
+    int i, success = 0;
+
+    if (!TEST_ptr(sctx = EVP_PKEY_CTX_new_from_pkey(multi_libctx,
+                                                    shared_evp_pkey, NULL))
+            || !TEST_ptr(vctx = EVP_PKEY_CTX_new_from_pkey(multi_libctx,
+                                                           shared_evp_pkey,
+                                                           NULL))
+            || !TEST_int_gt(EVP_PKEY_sign_init(sctx), 0)
+            || !TEST_int_gt(EVP_PKEY_verify_init(vctx), 0))
+        goto err;
+
+    for (i = 0; i < rsa_sign_rounds; i++) {
+        siglen = sizeof(sig);
+        if (!TEST_int_gt(EVP_PKEY_sign(sctx, sig, &siglen, tbs, sizeof(tbs)),
+                         0)
+                || !TEST_int_gt(EVP_PKEY_verify(vctx, sig, siglen, tbs,
+                                                sizeof(tbs)), 0))
+            goto err;
+    }
+    success = 1;
+ err:
+    EVP_PKEY_CTX_free(sctx);
+    EVP_PKEY_CTX_free(vctx);
+    if (!success)
+        multi_set_success(0);
+}
+
+static int test_multi_rsa_sign(void)
+{
+    int testresult = 0;
+
+    multi_intialise();
+    if (!thread_setup_libctx(1, default_provider)
+            || !TEST_ptr(shared_evp_pkey = load_pkey_pem(privkey, multi_libctx)))
+        goto err;
+
+    if (!start_threads(MAXIMUM_THREADS - 1, &thread_rsa_sign))
+        goto err;
+    thread_rsa_sign();
+    if (!teardown_threads()
+            || !TEST_true(multi_success))
+        goto err;
+    testresult = 1;
+ err:
+    EVP_PKEY_free(shared_evp_pkey);
+    shared_evp_pkey = NULL;
+    thead_teardown_libctx();
+    return testresult;
+}
+
+#ifndef OPENSSL_NO_DEFAULT_THREAD_POOL
+static int test_rsa_prime_pool(void)
+{
+    OSSL_LIB_CTX *libctx = NULL;
+    EVP_PKEY *pkey = NULL;
+    EVP_PKEY_CTX *ctx = NULL;
+    uint64_t hits = 0, misses = 0;
+    size_t num = 0;
+    int i, testresult = 0;
+
+    if (!TEST_ptr(libctx = OSSL_LIB_CTX_new())
+            || !TEST_true(OSSL_set_max_threads(libctx, 1))
+            || !TEST_false(OSSL_RSA_prime_pool_start(libctx, 1024, NULL, 2, 1))
+            || !TEST_false(OSSL_RSA_prime_pool_start(libctx, 2048, NULL, 2, 2))
+            || !TEST_true(OSSL_RSA_prime_pool_start(libctx, 2048, NULL, 2, 1)))
+        goto err;
+
+    /* Give the worker up to a minute to find the two primes of a key */
+    for (i = 0; i < 600 && num < 2; i++) {
+        OSSL_sleep(100);
+        if (!TEST_true(OSSL_RSA_prime_pool_get_stats(libctx, &num, NULL,
+                                                     NULL)))
+            goto err;
+    }
+    if (!TEST_size_t_eq(num, 2)
+            || !TEST_ptr(pkey = EVP_PKEY_Q_keygen(libctx, NULL, "RSA",
+                                                  (size_t)2048))
+            || !TEST_true(OSSL_RSA_prime_pool_get_stats(libctx, NULL, &hits,
+                                                        &misses))
+            || !TEST_uint64_t_eq(hits, 2)
+            || !TEST_uint64_t_eq(misses, 0)
+            || !TEST_ptr(ctx = EVP_PKEY_CTX_new_from_pkey(libctx, pkey, NULL))
+            || !TEST_int_eq(EVP_PKEY_pairwise_check(ctx), 1)
+            || !TEST_true(OSSL_RSA_prime_pool_stop(libctx)))
+        goto err;
+
+    testresult = 1;
+ err:
+    OSSL_RSA_prime_pool_stop(libctx);
+    EVP_PKEY_CTX_free(ctx);
+    EVP_PKEY_free(pkey);
+    OSSL_LIB_CTX_free(libctx);
+    return testresult;
+}
+#endif
+
 static int test_multi_load_unload_provider(void)
 {
     EVP_MD *sha256 = NULL;
@@ -860,6 +969,10 @@ int setup_tests(void)
     ADD_TEST(test_multi_shared_pkey);
 #ifndef OPENSSL_NO_DEPRECATED_3_0
     ADD_TEST(test_multi_downgrade_shared_pkey);
+#endif
+    ADD_TEST(test_multi_rsa_sign);
+#ifndef OPENSSL_NO_DEFAULT_THREAD_POOL
+    ADD_TEST(test_rsa_prime_pool);
 #endif
     ADD_TEST(test_multi_load_unload_provider);
     ADD_TEST(test_obj_add);
@@ -0,0 +1,564 @@
+/*
+ * Copyright 2023 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * Measures the rate of operations whose correctness the unit tests check,
+ * with sizes too big for the test suite.  It is not run by "make test":
+ *
+ *     timing_internal [name...]
+ *
+ * runs the named measurements, or all of them when none is named.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <openssl/bio.h>
+#include <openssl/bn.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/x509v3.h>
+#include "internal/nelem.h"
+#include "internal/time.h"
+#include "internal/quic_demux.h"
+#include "internal/quic_ackm.h"
+#include "internal/quic_cc.h"
+#include "threadstest.h"
+
+/* Prints the rate at which |num| |unit|s were done in |elapsed| */
+static void report(const char *what, uint64_t num, const char *unit,
+                   OSSL_TIME elapsed)
+{
+    uint64_t ticks = ossl_time2ticks(elapsed);
+
+    if (ticks == 0)
+        ticks = 1;
+    printf("%s: %llu %s/s\n", what,
+           (unsigned long long)(num * OSSL_TIME_SECOND / ticks), unit);
+}
+
+#ifndef OPENSSL_NO_QUIC
+
+# define DEMUX_CID_LEN      8
+# define DEMUX_DGRAM_LEN    64
+
+static void demux_make_cid(QUIC_CONN_ID *cid, size_t i)
+{
+    size_t j;
+
+    cid->id_len = DEMUX_CID_LEN;
+    for (j = 0; j < DEMUX_CID_LEN; ++j)
+        cid->id[j] = (unsigned char)((i >> ((j % 4) * 8)) ^ (j * 0x5b));
+}
+
+static void demux_rx_cb(QUIC_URXE *e, void *arg)
+{
+    ossl_quic_demux_release_urxe((QUIC_DEMUX *)arg, e);
+}
+
+/* Datagrams dispatched by connection ID, with many of them registered */
+static int time_quic_demux(void)
+{
+    static const size_t sizes[] = { 10000, 100000, 1000000 };
+    const size_t num_lookups = 1 << 22;
+    unsigned char dgram[DEMUX_DGRAM_LEN] = { 0 };
+    QUIC_DEMUX *demux = NULL;
+    QUIC_CONN_ID cid;
+    OSSL_TIME start;
+    char what[64];
+    size_t i, n, s;
+    int ret = 0;
+
+    dgram[0] = 0x40; /* short header with fixed bit set */
+    for (s = 0; s < OSSL_NELEM(sizes); s++) {
+        n = sizes[s];
+        if ((demux = ossl_quic_demux_new(NULL, NULL, DEMUX_CID_LEN,
+                                         NULL, NULL)) == NULL)
+            goto err;
+        for (i = 0; i < n; ++i) {
+            demux_make_cid(&cid, i);
+            if (!ossl_quic_demux_register(demux, &cid, demux_rx_cb, demux))
+                goto err;
+        }
+
+        start = ossl_time_now();
+        for (i = 0; i < num_lookups; ++i) {
+            /* Visit connection IDs in an order unrelated to registration */
+            demux_make_cid(&cid, (i * 7919) % n);
+            memcpy(dgram + 1, cid.id, cid.id_len);
+            if (!ossl_quic_demux_inject(demux, dgram, sizeof(dgram),
+                                        NULL, NULL))
+                goto err;
+        }
+        BIO_snprintf(what, sizeof(what), "%zu connection IDs", n);
+        report(what, num_lookups, "lookups",
+               ossl_time_subtract(ossl_time_now(), start));
+
+        ossl_quic_demux_free(demux);
+        demux = NULL;
+    }
+    ret = 1;
+ err:
+    ossl_quic_demux_free(demux);
+    return ret;
+}
+
+static OSSL_TIME ackm_time;
+
+static OSSL_TIME ackm_now(void *arg)
+{
+    return ackm_time;
+}
+
+static void ackm_pkt_cb(void *arg)
+{
+}
+
+/*
+ * ACK frames processed, each acknowledging every odd packet of a round of
+ * twice as many packets as the frame has ranges
+ */
+static int time_quic_ackm(void)
+{
+    static const size_t sizes[] = { 1, 16, 256 };
+    const size_t num_pkts = 1 << 20;
+    OSSL_ACKM *ackm = NULL;
+    OSSL_CC_DATA *ccdata = NULL;
+    OSSL_STATM statm;
+    OSSL_ACKM_TX_PKT *pkts = NULL, *tx;
+    OSSL_QUIC_FRAME_ACK ack = { 0 };
+    OSSL_QUIC_ACK_RANGE *ranges = NULL;
+    OSSL_TIME start, spent;
+    char what[64];
+    size_t i, j, s, num_ranges, num_rounds;
+    int ret = 0, have_statm = 0;
+
+    for (s = 0; s < OSSL_NELEM(sizes); s++) {
+        num_ranges = sizes[s];
+        num_rounds = num_pkts / (2 * num_ranges);
+        ackm_time = ossl_ticks2time(OSSL_TIME_SECOND);
+        if (!ossl_statm_init(&statm))
+            goto err;
+        have_statm = 1;
+        if ((ccdata = ossl_cc_dummy_method.new(ackm_now, NULL)) == NULL
+                || (ackm = ossl_ackm_new(ackm_now, NULL, &statm,
+                                         &ossl_cc_dummy_method,
+                                         ccdata)) == NULL
+                || (pkts = OPENSSL_zalloc(num_pkts * sizeof(*pkts))) == NULL
+                || (ranges = OPENSSL_malloc(num_ranges
+                                            * sizeof(*ranges))) == NULL)
+            goto err;
+
+        ack.ack_ranges = ranges;
+        ack.num_ack_ranges = num_ranges;
+        spent = ossl_time_zero();
+        for (i = 0; i < num_rounds; ++i) {
+            for (j = 0; j < 2 * num_ranges; ++j) {
+                tx = &pkts[i * 2 * num_ranges + j];
+                tx->pkt_num = i * 2 * num_ranges + j;
+                tx->pkt_space = QUIC_PN_SPACE_APP;
+                tx->is_inflight = 1;
+                tx->is_ack_eliciting = 1;
+                tx->num_bytes = 123;
+                tx->largest_acked = QUIC_PN_INVALID;
+                tx->time = ackm_time;
+                tx->on_lost = tx->on_acked = tx->on_discarded = ackm_pkt_cb;
+                if (!ossl_ackm_on_tx_packet(ackm, tx))
+                    goto err;
+            }
+
+            /* ACK ranges are given in descending order */
+            for (j = 0; j < num_ranges; ++j)
+                ranges[j].start = ranges[j].end
+                    = (i + 1) * 2 * num_ranges - 1 - 2 * j;
+
+            start = ossl_time_now();
+            if (!ossl_ackm_on_rx_ack_frame(ackm, &ack, QUIC_PN_SPACE_APP,
+                                           ackm_time))
+                goto err;
+            spent = ossl_time_add(spent,
+                                  ossl_time_subtract(ossl_time_now(), start));
+            ackm_time = ossl_time_add(ackm_time, ossl_ms2time(1));
+        }
+        BIO_snprintf(what, sizeof(what), "%zu ranges per ACK frame",
+                     num_ranges);
+        report(what, num_rounds, "frames", spent);
+
+        ossl_ackm_free(ackm);
+        ackm = NULL;
+        ossl_cc_dummy_method.free(ccdata);
+        ccdata = NULL;
+        ossl_statm_destroy(&statm);
+        have_statm = 0;
+        OPENSSL_free(pkts);
+        pkts = NULL;
+        OPENSSL_free(ranges);
+        ranges = NULL;
+    }
+    ret = 1;
+ err:
+    ossl_ackm_free(ackm);
+    if (ccdata != NULL)
+        ossl_cc_dummy_method.free(ccdata);
+    if (have_statm)
+        ossl_statm_destroy(&statm);
+    OPENSSL_free(pkts);
+    OPENSSL_free(ranges);
+    return ret;
+}
+#endif
+
+/*
+ * Returns a certificate for |cn| issued by |issuer_cn|, with |dns| as its
+ * subject alternative name unless NULL, signed with |key| which it also holds
+ */
+static X509 *make_cert(const char *cn, const char *issuer_cn, const char *dns,
+                       EVP_PKEY *key)
+{
+    X509 *x = X509_new();
+    X509_NAME *subject = X509_NAME_new(), *issuer = X509_NAME_new();
+    X509_EXTENSION *ext = NULL;
+    char san[256];
+    int ok;
+
+    ok = x != NULL && subject != NULL && issuer != NULL
+        && X509_NAME_add_entry_by_txt(subject, "CN", MBSTRING_ASC,
+                                      (const unsigned char *)cn, -1, -1, 0)
+        && X509_NAME_add_entry_by_txt(issuer, "CN", MBSTRING_ASC,
+                                      (const unsigned char *)issuer_cn,
+                                      -1, -1, 0)
+        && X509_set_subject_name(x, subject)
+        && X509_set_issuer_name(x, issuer)
+        && ASN1_INTEGER_set(X509_get_serialNumber(x), 1)
+        && X509_gmtime_adj(X509_getm_notBefore(x), -3600) != NULL
+        && X509_gmtime_adj(X509_getm_notAfter(x), 3600) != NULL
+        && X509_set_pubkey(x, key);
+    if (ok && dns != NULL) {
+        BIO_snprintf(san, sizeof(san), "DNS:%s", dns);
+        ok = (ext = X509V3_EXT_nconf_nid(NULL, NULL, NID_subject_alt_name,
+                                         san)) != NULL
+            && X509_add_ext(x, ext, -1);
+    }
+    ok = ok && X509_sign(x, key, EVP_sha256()) > 0;
+    X509_EXTENSION_free(ext);
+    X509_NAME_free(subject);
+    X509_NAME_free(issuer);
+    if (!ok) {
+        X509_free(x);
+        return NULL;
+    }
+    return x;
+}
+
+/*
+ * Certificates decoded for what an inventory of them would keep: names,
+ * validity and subject alternative names
+ */
+static int time_x509_parse(void)
+{
+    const size_t num = 1000000;
+    EVP_PKEY *key = NULL;
+    X509 *x = NULL;
+    GENERAL_NAMES *gens;
+    unsigned char *der = NULL;
+    const unsigned char *p;
+    OSSL_TIME start;
+    char what[64];
+    size_t i;
+    int len, ok, ret = 0;
+
+    if ((key = EVP_PKEY_Q_keygen(NULL, NULL, "EC", "P-256")) == NULL
+            || (x = make_cert("leaf.example", "Root", "leaf.example",
+                              key)) == NULL
+            || (len = i2d_X509(x, &der)) <= 0)
+        goto err;
+    X509_free(x);
+    x = NULL;
+
+    start = ossl_time_now();
+    for (i = 0; i < num; i++) {
+        p = der;
+        if ((x = d2i_X509(NULL, &p, len)) == NULL)
+            goto err;
+        gens = X509_get_ext_d2i(x, NID_subject_alt_name, NULL, NULL);
+        ok = gens != NULL && sk_GENERAL_NAME_num(gens) == 1
+            && X509_get_subject_name(x) != NULL
+            && X509_get_issuer_name(x) != NULL
+            && X509_get0_notBefore(x) != NULL
+            && X509_get0_notAfter(x) != NULL;
+        GENERAL_NAMES_free(gens);
+        X509_free(x);
+        x = NULL;
+        if (!ok)
+            goto err;
+    }
+    BIO_snprintf(what, sizeof(what), "%zu certificates", num);
+    report(what, num, "parsed", ossl_time_subtract(ossl_time_now(), start));
+    ret = 1;
+ err:
+    X509_free(x);
+    OPENSSL_free(der);
+    EVP_PKEY_free(key);
+    return ret;
+}
+
+/*
+ * Chains built to one of many roots in a store, with every other root also
+ * offered as an untrusted certificate and searched first, so that nearly all
+ * issuer candidates are rejected on their names
+ */
+static int time_x509_chain_build(void)
+{
+    const size_t num_roots = 10000, num = 1000;
+    EVP_PKEY *key = NULL;
+    X509_STORE *store = NULL;
+    X509_STORE_CTX *ctx = NULL;
+    STACK_OF(X509) *untrusted = NULL;
+    X509 *root = NULL, *leaf = NULL;
+    OSSL_TIME start;
+    char cn[64], what[64];
+    size_t i;
+    int ret = 0;
+
+    if ((key = EVP_PKEY_Q_keygen(NULL, NULL, "EC", "P-256")) == NULL
+            || (store = X509_STORE_new()) == NULL
+            || (untrusted = sk_X509_new_null()) == NULL
+            || (ctx = X509_STORE_CTX_new()) == NULL)
+        goto err;
+
+    for (i = 0; i < num_roots; i++) {
+        BIO_snprintf(cn, sizeof(cn),
+                     "Example Trust Services Root Certification Authority %05zu",
+                     i);
+        if ((root = make_cert(cn, cn, NULL, key)) == NULL
+                || !X509_STORE_add_cert(store, root))
+            goto err;
+        if (i == num_roots - 1)
+            break;
+        if (!sk_X509_push(untrusted, root))
+            goto err;
+        root = NULL;
+    }
+    if ((leaf = make_cert("leaf.example", cn, NULL, key)) == NULL)
+        goto err;
+
+    start = ossl_time_now();
+    for (i = 0; i < num; i++) {
+        if (!X509_STORE_CTX_init(ctx, store, leaf, untrusted))
+            goto err;
+        X509_VERIFY_PARAM_clear_flags(X509_STORE_CTX_get0_param(ctx),
+                                      X509_V_FLAG_TRUSTED_FIRST);
+        if (X509_verify_cert(ctx) <= 0
+                || sk_X509_num(X509_STORE_CTX_get0_chain(ctx)) != 2)
+            goto err;
+        X509_STORE_CTX_cleanup(ctx);
+    }
+    BIO_snprintf(what, sizeof(what), "%zu roots", num_roots);
+    report(what, num, "chains", ossl_time_subtract(ossl_time_now(), start));
+    ret = 1;
+ err:
+    X509_STORE_CTX_free(ctx);
+    X509_STORE_free(store);
+    OSSL_STACK_OF_X509_free(untrusted);
+    X509_free(root);
+    X509_free(leaf);
+    EVP_PKEY_free(key);
+    return ret;
+}
+
+/*
+ * Signatures made with one RSA key shared by all threads, each of which
+ * needs blinding of its own for it
+ */
+#define RSA_SIGN_THREADS    8
+#define RSA_SIGN_ROUNDS     100
+
+static EVP_PKEY *rsa_sign_key;
+static int rsa_sign_failed;
+
+static void rsa_sign_thread(void)
+{
+    static const unsigned char tbs[32] = "timing_internal RSA signing";
+    unsigned char sig[512];
+    size_t siglen;
+    EVP_PKEY_CTX *ctx;
+    int i;
+
+    if ((ctx = EVP_PKEY_CTX_new_from_pkey(NULL, rsa_sign_key, NULL)) == NULL
+            || EVP_PKEY_sign_init(ctx) <= 0)
+        rsa_sign_failed = 1;
+    for (i = 0; !rsa_sign_failed && i < RSA_SIGN_ROUNDS; i++) {
+        siglen = sizeof(sig);
+        if (EVP_PKEY_sign(ctx, sig, &siglen, tbs, sizeof(tbs)) <= 0)
+            rsa_sign_failed = 1;
+    }
+    EVP_PKEY_CTX_free(ctx);
+}
+
+static int time_rsa_sign(void)
+{
+    thread_t threads[RSA_SIGN_THREADS - 1];
+    OSSL_TIME start;
+    char what[64];
+    size_t i, started = 0;
+    int ret = 0;
+
+    if ((rsa_sign_key = EVP_PKEY_Q_keygen(NULL, NULL, "RSA",
+                                          (size_t)2048)) == NULL)
+        return 0;
+
+    start = ossl_time_now();
+    rsa_sign_thread();
+    if (rsa_sign_failed)
+        goto err;
+    report("RSA-2048, 1 thread", RSA_SIGN_ROUNDS, "signatures",
+           ossl_time_subtract(ossl_time_now(), start));
+
+    start = ossl_time_now();
+    for (; started < OSSL_NELEM(threads); started++)
+        if (!run_thread(&threads[started], rsa_sign_thread))
+            goto err;
+    rsa_sign_thread();
+    for (i = 0; i < started; i++)
+        if (!wait_for_thread(threads[i]))
+            goto err;
+    started = 0;
+    BIO_snprintf(what, sizeof(what), "RSA-2048, %d threads", RSA_SIGN_THREADS);
+    report(what, RSA_SIGN_THREADS * RSA_SIGN_ROUNDS, "signatures",
+           ossl_time_subtract(ossl_time_now(), start));
+    ret = !rsa_sign_failed;
+ err:
+    for (i = 0; i < started; i++)
+        wait_for_thread(threads[i]);
+    EVP_PKEY_free(rsa_sign_key);
+    rsa_sign_key = NULL;
+    return ret;
+}
+
+/*
+ * Modular inverses of random values modulo a random odd number, one at a time
+ * and in batches which share a single inversion
+ */
+#define BN_INVERSE_NUM      256
+#define BN_INVERSE_BATCH    64
+
+static int time_bn_inverse(void)
+{
+    static const int bits[] = { 256, 521, 1024, 2048, 3072, 4096 };
+    BN_CTX *ctx = NULL;
+    BIGNUM *n = NULL, *r = NULL, *t = NULL, *a[BN_INVERSE_NUM] = { NULL };
+    BIGNUM *batch[BN_INVERSE_BATCH] = { NULL };
+    OSSL_TIME start;
+    char what[64];
+    size_t i, j;
+    int ret = 0;
+
+    if ((ctx = BN_CTX_new()) == NULL
+            || (n = BN_new()) == NULL
+            || (r = BN_new()) == NULL
+            || (t = BN_new()) == NULL)
+        goto err;
+    for (i = 0; i < OSSL_NELEM(a); i++)
+        if ((a[i] = BN_new()) == NULL)
+            goto err;
+    for (i = 0; i < OSSL_NELEM(batch); i++)
+        if ((batch[i] = BN_new()) == NULL)
+            goto err;
+
+    for (i = 0; i < OSSL_NELEM(bits); i++) {
+        if (!BN_rand(n, bits[i], BN_RAND_TOP_ONE, BN_RAND_BOTTOM_ODD))
+            goto err;
+        for (j = 0; j < OSSL_NELEM(a); j++)
+            do {
+                if (!BN_rand_range(a[j], n) || !BN_gcd(t, a[j], n, ctx))
+                    goto err;
+            } while (!BN_is_one(t));
+
+        start = ossl_time_now();
+        for (j = 0; j < OSSL_NELEM(a); j++)
+            if (BN_mod_inverse(r, a[j], n, ctx) == NULL)
+                goto err;
+        BIO_snprintf(what, sizeof(what), "%d bits", bits[i]);
+        report(what, OSSL_NELEM(a), "inversions",
+               ossl_time_subtract(ossl_time_now(), start));
+
+        start = ossl_time_now();
+        for (j = 0; j < OSSL_NELEM(a); j += OSSL_NELEM(batch))
+            if (!BN_mod_inverse_batch(batch, (const BIGNUM **)&a[j],
+                                      OSSL_NELEM(batch), n, ctx))
+                goto err;
+        BIO_snprintf(what, sizeof(what), "%d bits, batches of %d", bits[i],
+                     BN_INVERSE_BATCH);
+        report(what, OSSL_NELEM(a), "inversions",
+               ossl_time_subtract(ossl_time_now(), start));
+    }
+    ret = 1;
+ err:
+    for (i = 0; i < OSSL_NELEM(a); i++)
+        BN_free(a[i]);
+    for (i = 0; i < OSSL_NELEM(batch); i++)
+        BN_free(batch[i]);
+    BN_free(n);
+    BN_free(r);
+    BN_free(t);
+    BN_CTX_free(ctx);
+    return ret;
+}
+
+static const struct {
+    const char *name;
+    int (*fn)(void);
+} timings[] = {
+#ifndef OPENSSL_NO_QUIC
+    { "quic_demux", time_quic_demux },
+    { "quic_ackm", time_quic_ackm },
+#endif
+    { "x509_parse", time_x509_parse },
+    { "x509_chain_build", time_x509_chain_build },
+    { "rsa_sign", time_rsa_sign },
+    { "bn_inverse", time_bn_inverse },
+    { NULL, NULL }
+};
+
+static int run_timing(size_t i)
+{
+    printf("%s\n", timings[i].name);
+    if (timings[i].fn())
+        return 1;
+    fprintf(stderr, "%s failed\n", timings[i].name);
+    ERR_print_errors_fp(stderr);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t i;
+    int j, ret = 1;
+
+    if (argc < 2) {
+        for (i = 0; timings[i].name != NULL; i++)
+            ret &= run_timing(i);
+        return ret ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    for (j = 1; j < argc; j++) {
+        for (i = 0; timings[i].name != NULL; i++)
+            if (strcmp(argv[j], timings[i].name) == 0)
+                break;
+        if (timings[i].name == NULL) {
+            fprintf(stderr, "%s: unknown timing %s, use one of:\n",
+                    argv[0], argv[j]);
+            for (i = 0; timings[i].name != NULL; i++)
+                fprintf(stderr, "    %s\n", timings[i].name);
+            return EXIT_FAILURE;
+        }
+        ret &= run_timing(i);
+    }
+    return ret ? EXIT_SUCCESS : EXIT_FAILURE;
+}
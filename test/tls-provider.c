@@ -2164,6 +2164,13 @@ struct X509_pubkey_st {
     /* extra data for the callback, used by d2i_PUBKEY_ex */
     OSSL_LIB_CTX *libctx;
     char *propq;
+
+    /* public key decoding state, released by X509_PUBKEY_free() */
+    int decode_pending;
+    CRYPTO_RWLOCK *lock;
+
+    /* Flag to force legacy keys */
+    unsigned int flag_force_legacy : 1;
 };
 
 ASN1_SEQUENCE(X509_PUBKEY_INTERNAL) = {
@@ -16,6 +16,8 @@
 #include <openssl/x509v3.h>
 #include "testutil.h"
 #include "internal/nelem.h"
+#include "crypto/x509.h"
+#include "../crypto/x509/x509_local.h"
 
 /**********************************************************************
  *
@@ -102,9 +104,483 @@ static int test_a2i_ipaddress(int idx)
     return good;
 }
 
+/**********************************************************************
+ *
+ * Test of the verified chain cache
+ *
+ ***/
+
+static X509 *make_cert(const char *cn, const char *issuer_cn, EVP_PKEY *key,
+                       EVP_PKEY *signkey)
+{
+    X509 *x = X509_new();
+    X509_NAME *subject = X509_NAME_new(), *issuer = X509_NAME_new();
+    int ok;
+
+    ok = x != NULL && subject != NULL && issuer != NULL
+        && X509_NAME_add_entry_by_txt(subject, "CN", MBSTRING_ASC,
+                                      (const unsigned char *)cn, -1, -1, 0)
+        && X509_NAME_add_entry_by_txt(issuer, "CN", MBSTRING_ASC,
+                                      (const unsigned char *)issuer_cn,
+                                      -1, -1, 0)
+        && X509_set_subject_name(x, subject)
+        && X509_set_issuer_name(x, issuer)
+        && ASN1_INTEGER_set(X509_get_serialNumber(x), 1)
+        && X509_gmtime_adj(X509_getm_notBefore(x), -3600) != NULL
+        && X509_gmtime_adj(X509_getm_notAfter(x), 3600) != NULL
+        && X509_set_pubkey(x, key)
+        && X509_sign(x, signkey, EVP_sha256()) > 0;
+    X509_NAME_free(subject);
+    X509_NAME_free(issuer);
+    if (!ok) {
+        X509_free(x);
+        return NULL;
+    }
+    return x;
+}
+
+static int accept_all_cb(int ok, X509_STORE_CTX *ctx)
+{
+    X509_STORE_CTX_set_error(ctx, X509_V_OK);
+    return 1;
+}
+
+/* Returns 1 if |leaf| verifies to a chain of length 2 */
+static int verify_leaf(X509_STORE *store, X509 *leaf, const char *host,
+                       X509_STORE_CTX_verify_cb cb)
+{
+    X509_STORE_CTX *ctx = X509_STORE_CTX_new();
+    X509_VERIFY_PARAM *vpm;
+    int ret = 0;
+
+    if (!TEST_ptr(ctx)
+            || !TEST_true(X509_STORE_CTX_init(ctx, store, leaf, NULL)))
+        goto err;
+    vpm = X509_STORE_CTX_get0_param(ctx);
+    if (host != NULL && !TEST_true(X509_VERIFY_PARAM_set1_host(vpm, host, 0)))
+        goto err;
+    if (cb != NULL)
+        X509_STORE_CTX_set_verify_cb(ctx, cb);
+    ret = X509_verify_cert(ctx) > 0
+        && X509_STORE_CTX_get_error(ctx) == X509_V_OK
+        && sk_X509_num(X509_STORE_CTX_get0_chain(ctx)) == 2
+        && sk_X509_value(X509_STORE_CTX_get0_chain(ctx), 0) == leaf
+        && (host == NULL
+            || strcmp(X509_VERIFY_PARAM_get0_peername(vpm), host) == 0);
+err:
+    X509_STORE_CTX_free(ctx);
+    return ret;
+}
+
+static size_t cache_hits(X509_STORE *store)
+{
+    return ossl_x509_verify_cache_hits(store->verify_cache);
+}
+
+static int test_verify_cache(void)
+{
+    EVP_PKEY *key = NULL, *otherkey = NULL;
+    X509 *root = NULL, *leaf = NULL, *other = NULL, *forged = NULL;
+    X509 *copy = NULL;
+    X509_STORE *store = NULL;
+    int testresult = 0;
+
+    if (!TEST_ptr(key = EVP_PKEY_Q_keygen(NULL, NULL, "EC", "P-256"))
+            || !TEST_ptr(root = make_cert("Root", "Root", key, key))
+            || !TEST_ptr(leaf = make_cert("leaf.example", "Root", key, key))
+            || !TEST_ptr(copy = X509_dup(leaf))
+            || !TEST_ptr(other = make_cert("Other", "Other", key, key))
+            || !TEST_ptr(otherkey = EVP_PKEY_Q_keygen(NULL, NULL, "EC",
+                                                      "P-256"))
+            || !TEST_ptr(forged = make_cert("forged.example", "Root", key,
+                                            otherkey))
+            || !TEST_ptr(store = X509_STORE_new())
+            || !TEST_true(X509_STORE_add_cert(store, root))
+            || !TEST_true(X509_STORE_set_verify_cache(store, 4, 3600)))
+        goto err;
+
+    /* A repeated verification is answered from the cache */
+    if (!TEST_true(verify_leaf(store, leaf, NULL, NULL))
+            || !TEST_size_t_eq(cache_hits(store), 0)
+            || !TEST_true(verify_leaf(store, leaf, NULL, NULL))
+            || !TEST_size_t_eq(cache_hits(store), 1))
+        goto err;
+
+    /* Another object with the same encoding hits, and heads its own chain */
+    if (!TEST_true(verify_leaf(store, copy, NULL, NULL))
+            || !TEST_size_t_eq(cache_hits(store), 2))
+        goto err;
+
+    /* Parameters are part of the key, and the peer name is set on a hit */
+    if (!TEST_true(verify_leaf(store, leaf, "leaf.example", NULL))
+            || !TEST_true(verify_leaf(store, leaf, "leaf.example", NULL))
+            || !TEST_size_t_eq(cache_hits(store), 3)
+            || !TEST_false(verify_leaf(store, leaf, "other.example", NULL))
+            || !TEST_size_t_eq(cache_hits(store), 3))
+        goto err;
+
+    /* Adding to the store retires cached verifications */
+    if (!TEST_true(X509_STORE_add_cert(store, other))
+            || !TEST_true(verify_leaf(store, leaf, NULL, NULL))
+            || !TEST_size_t_eq(cache_hits(store), 3)
+            || !TEST_true(verify_leaf(store, leaf, NULL, NULL))
+            || !TEST_size_t_eq(cache_hits(store), 4))
+        goto err;
+
+    /* Verifications only accepted by the verify callback are not cached */
+    if (!TEST_true(verify_leaf(store, forged, NULL, accept_all_cb))
+            || !TEST_true(verify_leaf(store, forged, NULL, accept_all_cb))
+            || !TEST_false(verify_leaf(store, forged, NULL, NULL))
+            || !TEST_size_t_eq(cache_hits(store), 4))
+        goto err;
+
+    testresult = 1;
+err:
+    X509_STORE_free(store);
+    X509_free(root);
+    X509_free(leaf);
+    X509_free(copy);
+    X509_free(other);
+    X509_free(forged);
+    EVP_PKEY_free(key);
+    EVP_PKEY_free(otherkey);
+    return testresult;
+}
+
+/**********************************************************************
+ *
+ * Test of deferred public key decoding
+ *
+ ***/
+
+/* Returns the DER encoding of a certificate for "leaf.example" */
+static int make_san_cert_der(EVP_PKEY *key, unsigned char **der)
+{
+    X509 *x = NULL;
+    GENERAL_NAMES *gens = NULL;
+    GENERAL_NAME *gen = NULL;
+    ASN1_IA5STRING *dns = NULL;
+    int len = 0;
+
+    if (!TEST_ptr(x = make_cert("leaf.example", "Root", key, key))
+        || !TEST_ptr(gens = sk_GENERAL_NAME_new_null())
+        || !TEST_ptr(gen = GENERAL_NAME_new())
+        || !TEST_ptr(dns = ASN1_IA5STRING_new())
+        || !TEST_true(ASN1_STRING_set(dns, "leaf.example", -1)))
+        goto err;
+    GENERAL_NAME_set0_value(gen, GEN_DNS, dns);
+    dns = NULL;
+    if (!TEST_true(sk_GENERAL_NAME_push(gens, gen)))
+        goto err;
+    gen = NULL;
+    if (!TEST_true(X509_add1_ext_i2d(x, NID_subject_alt_name, gens, 0, 0))
+        || !TEST_int_gt(X509_sign(x, key, EVP_sha256()), 0))
+        goto err;
+    len = i2d_X509(x, der);
+err:
+    ASN1_IA5STRING_free(dns);
+    GENERAL_NAME_free(gen);
+    GENERAL_NAMES_free(gens);
+    X509_free(x);
+    return len;
+}
+
+/* Decodes |der| and reads what an inventory of certificates would keep */
+static int parse_and_read_san(const unsigned char *der, int len)
+{
+    X509 *x;
+    GENERAL_NAMES *gens;
+    int ok;
+
+    if ((x = d2i_X509(NULL, &der, len)) == NULL)
+        return 0;
+    gens = X509_get_ext_d2i(x, NID_subject_alt_name, NULL, NULL);
+    ok = gens != NULL && sk_GENERAL_NAME_num(gens) == 1
+        && X509_get_subject_name(x) != NULL
+        && X509_get_issuer_name(x) != NULL
+        && X509_get0_notBefore(x) != NULL
+        && X509_get0_notAfter(x) != NULL;
+    GENERAL_NAMES_free(gens);
+    X509_free(x);
+    return ok;
+}
+
+static int test_deferred_pubkey(void)
+{
+    EVP_PKEY *key = NULL;
+    X509 *x = NULL;
+    X509_PUBKEY *xpk = NULL, *setpk = NULL, *berpk = NULL;
+    unsigned char *der = NULL, *spki = NULL, *ber = NULL;
+    const unsigned char *p;
+    int len, spkilen, testresult = 0;
+
+    if (!TEST_ptr(key = EVP_PKEY_Q_keygen(NULL, NULL, "EC", "P-256"))
+        || !TEST_int_gt(len = make_san_cert_der(key, &der), 0)
+        || !TEST_true(parse_and_read_san(der, len)))
+        goto err;
+
+    /* A key not decoded yet is decoded when it is used or copied */
+    p = der;
+    if (!TEST_ptr(x = d2i_X509(NULL, &p, len))
+        || !TEST_ptr(xpk = X509_PUBKEY_dup(X509_get_X509_PUBKEY(x)))
+        || !TEST_int_eq(EVP_PKEY_eq(X509_PUBKEY_get0(xpk), key), 1)
+        || !TEST_int_eq(EVP_PKEY_eq(X509_get0_pubkey(x), key), 1)
+        || !TEST_ptr_eq(X509_get0_pubkey(x), X509_get0_pubkey(x))
+        || !TEST_int_eq(X509_verify(x, key), 1))
+        goto err;
+
+    /* A key that is set is not replaced by decoding its encoding */
+    if (!TEST_true(X509_PUBKEY_set(&setpk, key))
+        || !TEST_ptr_eq(X509_PUBKEY_get0(setpk), key))
+        goto err;
+
+    /* Input that is not DER, here a long form length, is decoded at once */
+    if (!TEST_int_gt(spkilen = i2d_X509_PUBKEY(xpk, &spki), 2)
+        || !TEST_int_lt(spki[1], 0x80)
+        || !TEST_ptr(ber = OPENSSL_malloc(spkilen + 1)))
+        goto err;
+    ber[0] = spki[0];
+    ber[1] = 0x81;
+    memcpy(ber + 2, spki + 1, spkilen - 1);
+    p = ber;
+    if (!TEST_ptr(berpk = d2i_X509_PUBKEY(NULL, &p, spkilen + 1))
+        || !TEST_ptr_eq(p, ber + spkilen + 1)
+        || !TEST_int_eq(EVP_PKEY_eq(X509_PUBKEY_get0(berpk), key), 1))
+        goto err;
+
+    testresult = 1;
+err:
+    X509_PUBKEY_free(xpk);
+    X509_PUBKEY_free(setpk);
+    X509_PUBKEY_free(berpk);
+    OPENSSL_free(spki);
+    OPENSSL_free(ber);
+    X509_free(x);
+    OPENSSL_free(der);
+    EVP_PKEY_free(key);
+    return testresult;
+}
+
+/**********************************************************************
+ *
+ * Test of decoding DER Names without the intermediate template form
+ *
+ ***/
+
+/* Returns the number of allocations made by decoding |der|, or -1 */
+static int decode_name(X509_NAME **nm, const unsigned char *der, int len)
+{
+    int before = test_alloc_count();
+
+    *nm = d2i_X509_NAME(NULL, &der, len);
+    return *nm == NULL ? -1 : test_alloc_count() - before;
+}
+
+static int test_name_der_decode(void)
+{
+    static const char *const rdns[][2] = {
+        { "C", "AU" }, { "O", "Example" }, { "OU", "Example Unit" },
+        { "CN", "Example" }, { "UID", "example" }
+    };
+    X509_NAME *nm = NULL, *der_nm = NULL, *ber_nm = NULL;
+    unsigned char *der = NULL, *ber = NULL;
+    int i, len, der_allocs, ber_allocs, testresult = 0;
+
+    if (!TEST_ptr(nm = X509_NAME_new()))
+        goto err;
+    for (i = 0; i < (int)OSSL_NELEM(rdns); i++)
+        if (!TEST_true(X509_NAME_add_entry_by_txt(nm, rdns[i][0], MBSTRING_ASC,
+                                                  (unsigned char *)rdns[i][1],
+                                                  -1, -1, i == 4 ? -1 : 0)))
+            goto err;
+
+    /* Make a BER copy with a needlessly long form length for the SEQUENCE */
+    if (!TEST_int_gt(len = i2d_X509_NAME(nm, &der), 0)
+        || !TEST_int_lt(der[1], 0x80)
+        || !TEST_ptr(ber = OPENSSL_malloc(len + 1)))
+        goto err;
+    ber[0] = der[0];
+    ber[1] = 0x81;
+    memcpy(ber + 2, der + 1, len - 1);
+
+    /* The two must decode alike, the BER one with the template decoder */
+    if (!TEST_int_ge(der_allocs = decode_name(&der_nm, der, len), 0)
+        || !TEST_int_ge(ber_allocs = decode_name(&ber_nm, ber, len + 1), 0)
+        || !TEST_int_eq(X509_NAME_cmp(der_nm, nm), 0)
+        || !TEST_int_eq(X509_NAME_cmp(ber_nm, nm), 0)
+        || !TEST_int_eq(X509_NAME_entry_count(der_nm), OSSL_NELEM(rdns)))
+        goto err;
+    for (i = 0; i < (int)OSSL_NELEM(rdns); i++)
+        if (!TEST_int_eq(X509_NAME_ENTRY_set(X509_NAME_get_entry(der_nm, i)),
+                         X509_NAME_ENTRY_set(X509_NAME_get_entry(ber_nm, i))))
+            goto err;
+
+    /*
+     * Going without the template form must save at least the allocation of
+     * a stack per RDN.
+     */
+    TEST_info("Name decoded with %d allocations, %d with the template decoder",
+              der_allocs, ber_allocs);
+    if (!TEST_int_le(der_allocs
+                     + X509_NAME_ENTRY_set(X509_NAME_get_entry(nm, 4)) + 1,
+                     ber_allocs))
+        goto err;
+
+    /* A truncated Name is still an error */
+    der[1]++;
+    X509_NAME_free(der_nm);
+    if (!TEST_int_lt(decode_name(&der_nm, der, len), 0))
+        goto err;
+
+    testresult = 1;
+err:
+    X509_NAME_free(nm);
+    X509_NAME_free(der_nm);
+    X509_NAME_free(ber_nm);
+    OPENSSL_free(der);
+    OPENSSL_free(ber);
+    return testresult;
+}
+
+/**********************************************************************
+ *
+ * Test of the canonical Name hash
+ *
+ ***/
+
+static X509_NAME *make_name(const char *cn)
+{
+    X509_NAME *nm = X509_NAME_new();
+
+    if (nm != NULL
+            && !X509_NAME_add_entry_by_txt(nm, "CN", MBSTRING_ASC,
+                                           (const unsigned char *)cn,
+                                           -1, -1, 0)) {
+        X509_NAME_free(nm);
+        nm = NULL;
+    }
+    return nm;
+}
+
+static int test_name_canon_hash(void)
+{
+    static const unsigned char org[] = "Org", org_spaced[] = " ORG";
+    X509_NAME *a = NULL, *b = NULL, *c = NULL, *empty1 = NULL, *empty2 = NULL;
+    uint64_t hash;
+    int testresult = 0;
+
+    /* Names that only differ in case and spacing are canonically equal */
+    if (!TEST_ptr(a = make_name("Example Name"))
+            || !TEST_ptr(b = make_name("  example   NAME "))
+            || !TEST_ptr(c = make_name("Example Namf"))
+            || !TEST_ptr(empty1 = X509_NAME_new())
+            || !TEST_ptr(empty2 = X509_NAME_new())
+            || !TEST_true(ossl_x509_name_equal(a, b))
+            || !TEST_int_eq(X509_NAME_cmp(a, b), 0)
+            || !TEST_uint64_t_eq(a->canon_hash, b->canon_hash)
+            || !TEST_false(ossl_x509_name_equal(a, c))
+            || !TEST_int_ne(X509_NAME_cmp(a, c), 0)
+            || !TEST_uint64_t_ne(a->canon_hash, c->canon_hash)
+            || !TEST_true(ossl_x509_name_equal(empty1, empty2))
+            || !TEST_false(ossl_x509_name_equal(empty1, a))
+            || !TEST_false(ossl_x509_name_equal(a, NULL))
+            || !TEST_true(ossl_x509_name_equal(NULL, NULL)))
+        goto err;
+
+    /* Modifying a Name refreshes its hash */
+    hash = a->canon_hash;
+    if (!TEST_true(X509_NAME_add_entry_by_txt(a, "O", MBSTRING_ASC, org,
+                                              -1, -1, 0))
+            || !TEST_false(ossl_x509_name_equal(a, b))
+            || !TEST_uint64_t_ne(a->canon_hash, hash)
+            || !TEST_true(X509_NAME_add_entry_by_txt(b, "O", MBSTRING_ASC,
+                                                     org_spaced, -1, -1, 0))
+            || !TEST_true(ossl_x509_name_equal(a, b))
+            || !TEST_uint64_t_eq(a->canon_hash, b->canon_hash))
+        goto err;
+
+    testresult = 1;
+err:
+    X509_NAME_free(a);
+    X509_NAME_free(b);
+    X509_NAME_free(c);
+    X509_NAME_free(empty1);
+    X509_NAME_free(empty2);
+    return testresult;
+}
+
+/*
+ * Build a chain to one of many roots in a store, with every other root also
+ * offered as an untrusted certificate and searched first, so that nearly all
+ * issuer candidates are rejected on their names.
+ */
+static int test_chain_build_many_roots(void)
+{
+    EVP_PKEY *key = NULL;
+    X509_STORE *store = NULL;
+    X509_STORE_CTX *ctx = NULL;
+    STACK_OF(X509) *untrusted = NULL, *chain;
+    X509 *root = NULL, *leaf = NULL;
+    size_t i, num_roots = 100;
+    char cn[64];
+    int testresult = 0;
+
+    if (!TEST_ptr(key = EVP_PKEY_Q_keygen(NULL, NULL, "EC", "P-256"))
+            || !TEST_ptr(store = X509_STORE_new())
+            || !TEST_ptr(untrusted = sk_X509_new_null())
+            || !TEST_ptr(ctx = X509_STORE_CTX_new()))
+        goto err;
+
+    for (i = 0; i < num_roots; i++) {
+        BIO_snprintf(cn, sizeof(cn),
+                     "Example Trust Services Root Certification Authority %05zu",
+                     i);
+        if (!TEST_ptr(root = make_cert(cn, cn, key, key))
+                || !TEST_true(X509_STORE_add_cert(store, root)))
+            goto err;
+        if (i == num_roots - 1)
+            break;
+        if (!TEST_true(sk_X509_push(untrusted, root)))
+            goto err;
+        root = NULL;
+    }
+    if (!TEST_ptr(leaf = make_cert("leaf.example", cn, key, key)))
+        goto err;
+
+    if (!TEST_true(X509_STORE_CTX_init(ctx, store, leaf, untrusted)))
+        goto err;
+    X509_VERIFY_PARAM_clear_flags(X509_STORE_CTX_get0_param(ctx),
+                                  X509_V_FLAG_TRUSTED_FIRST);
+    if (!TEST_int_gt(X509_verify_cert(ctx), 0)
+            || !TEST_ptr(chain = X509_STORE_CTX_get0_chain(ctx))
+            || !TEST_int_eq(sk_X509_num(chain), 2)
+            || !TEST_int_eq(X509_cmp(sk_X509_value(chain, 1), root), 0))
+        goto err;
+
+    testresult = 1;
+err:
+    X509_STORE_CTX_free(ctx);
+    X509_STORE_free(store);
+    OSSL_STACK_OF_X509_free(untrusted);
+    X509_free(root);
+    X509_free(leaf);
+    EVP_PKEY_free(key);
+    return testresult;
+}
+
+int global_init(void)
+{
+    return test_alloc_count_init();
+}
+
 int setup_tests(void)
 {
     ADD_TEST(test_standard_exts);
     ADD_ALL_TESTS(test_a2i_ipaddress, OSSL_NELEM(a2i_ipaddress_tests));
+    ADD_TEST(test_verify_cache);
+    ADD_TEST(test_deferred_pubkey);
+    ADD_TEST(test_name_der_decode);
+    ADD_TEST(test_name_canon_hash);
+    ADD_TEST(test_chain_build_many_roots);
     return 1;
 }
@@ -7,7 +7,9 @@
  * https://www.openssl.org/source/license.html
  */
 
+#include <openssl/core_names.h>
 #include <openssl/x509.h>
+#include <openssl/x509_vfy.h>
 #include "testutil.h"
 
 static EVP_PKEY *pubkey = NULL;
@@ -114,6 +116,209 @@ static int test_x509_crl_tbs_cache(void)
     return ret;
 }
 
+/* Creates a copy of certdata with the given subject CN and serial number */
+static X509 *make_named_cert(int name, long serial)
+{
+    X509 *x = NULL;
+    X509_NAME *nm = NULL;
+    const unsigned char *p = certdata;
+    char cn[32];
+
+    BIO_snprintf(cn, sizeof(cn), "Test %d", name);
+    if (!TEST_ptr(x = d2i_X509(NULL, &p, sizeof(certdata)))
+        || !TEST_ptr(nm = X509_NAME_new())
+        || !TEST_true(X509_NAME_add_entry_by_txt(nm, "CN", MBSTRING_ASC,
+                                                 (unsigned char *)cn, -1, -1,
+                                                 0))
+        || !TEST_true(X509_set_subject_name(x, nm))
+        || !TEST_true(ASN1_INTEGER_set(X509_get_serialNumber(x), serial))
+        || !TEST_int_gt(X509_sign(x, privkey, signmd), 0)) {
+        X509_free(x);
+        x = NULL;
+    }
+    X509_NAME_free(nm);
+    return x;
+}
+
+/*
+ * A decoded certificate remembers the key its signature verified with, but
+ * must not vouch for it with other keys or once it has been modified.
+ */
+static int test_x509_verify_memo(void)
+{
+    int ret = 0, len;
+    X509 *signed_x = NULL, *x = NULL;
+    EVP_PKEY *otherkey = NULL;
+    unsigned char *der = NULL;
+    const unsigned char *p;
+
+    if (!TEST_ptr(signed_x = make_named_cert(1, 1))
+        || !TEST_int_gt(len = i2d_X509(signed_x, &der), 0))
+        goto err;
+    p = der;
+    if (!TEST_ptr(x = d2i_X509(NULL, &p, len))
+        || !TEST_ptr(otherkey = EVP_PKEY_Q_keygen(NULL, NULL, "EC", "P-256")))
+        goto err;
+
+    ret = TEST_int_eq(X509_verify(x, pubkey), 1)
+          && TEST_int_eq(X509_verify(x, pubkey), 1)
+          && TEST_int_le(X509_verify(x, otherkey), 0)
+          && TEST_int_eq(X509_verify(x, pubkey), 1)
+          && TEST_true(X509_set_issuer_name(x, X509_get_subject_name(x)))
+          && TEST_int_le(X509_verify(x, pubkey), 0);
+err:
+    OPENSSL_free(der);
+    X509_free(signed_x);
+    X509_free(x);
+    EVP_PKEY_free(otherkey);
+    return ret;
+}
+
+/* What is remembered no longer holds once the key or the signature changes */
+static int test_x509_verify_memo_changes(void)
+{
+    int ret = 0, len;
+    X509 *signed_x = NULL, *x = NULL;
+    EVP_PKEY *key = NULL, *otherkey = NULL;
+    unsigned char *der = NULL, *sigdata;
+    unsigned char pub[256];
+    size_t publen;
+    const char *pubname = OSSL_PKEY_PARAM_ENCODED_PUBLIC_KEY;
+    const ASN1_BIT_STRING *sig;
+    const unsigned char *p;
+
+    if (!TEST_ptr(key = EVP_PKEY_Q_keygen(NULL, NULL, "EC", "P-256"))
+        || !TEST_ptr(otherkey = EVP_PKEY_Q_keygen(NULL, NULL, "EC", "P-256"))
+        || !TEST_ptr(signed_x = X509_new())
+        || !TEST_true(X509_set_pubkey(signed_x, key))
+        || !TEST_ptr(X509_gmtime_adj(X509_getm_notBefore(signed_x), 0))
+        || !TEST_ptr(X509_gmtime_adj(X509_getm_notAfter(signed_x), 60))
+        || !TEST_int_gt(X509_sign(signed_x, key, EVP_sha256()), 0)
+        || !TEST_int_gt(len = i2d_X509(signed_x, &der), 0))
+        goto err;
+
+    p = der;
+    if (!TEST_ptr(x = d2i_X509(NULL, &p, len))
+        || !TEST_int_eq(X509_verify(x, key), 1))
+        goto err;
+    X509_get0_signature(&sig, NULL, x);
+    sigdata = (unsigned char *)ASN1_STRING_get0_data(sig);
+    sigdata[ASN1_STRING_length(sig) - 1] ^= 1;
+    if (!TEST_int_le(X509_verify(x, key), 0))
+        goto err;
+    X509_free(x);
+
+    p = der;
+    if (!TEST_ptr(x = d2i_X509(NULL, &p, len))
+        || !TEST_int_eq(X509_verify(x, key), 1)
+        || !TEST_true(EVP_PKEY_get_octet_string_param(otherkey, pubname,
+                                                      pub, sizeof(pub),
+                                                      &publen))
+        || !TEST_true(EVP_PKEY_set_octet_string_param(key, pubname,
+                                                      pub, publen))
+        || !TEST_int_le(X509_verify(x, key), 0))
+        goto err;
+
+    ret = 1;
+err:
+    OPENSSL_free(der);
+    X509_free(signed_x);
+    X509_free(x);
+    EVP_PKEY_free(key);
+    EVP_PKEY_free(otherkey);
+    return ret;
+}
+
+#define STORE_NUM_CERTS     100
+#define STORE_NUM_NAMES     40
+
+/*
+ * Checks that |expected| certificates named |name| are found, in the order
+ * they were added, which is that of their serial numbers
+ */
+static int count_certs_by_name(X509_STORE_CTX *ctx, int name, int expected)
+{
+    int ret, i;
+    X509 *x = make_named_cert(name, 0);
+    STACK_OF(X509) *sk = NULL;
+
+    ret = TEST_ptr(x)
+          && TEST_ptr(sk = X509_STORE_CTX_get1_certs(ctx,
+                                                     X509_get_subject_name(x)))
+          && TEST_int_eq(sk_X509_num(sk), expected);
+    for (i = 1; ret && i < sk_X509_num(sk); i++)
+        ret = TEST_long_lt(ASN1_INTEGER_get(X509_get0_serialNumber(
+                                                sk_X509_value(sk, i - 1))),
+                           ASN1_INTEGER_get(X509_get0_serialNumber(
+                                                sk_X509_value(sk, i))));
+    OSSL_STACK_OF_X509_free(sk);
+    X509_free(x);
+    return ret;
+}
+
+/*
+ * Fill a store with certificates sharing subject names, so that lookups have
+ * to find several matches, and check they are all found both through the
+ * store's index and after X509_STORE_get0_objects() has disabled it.
+ */
+static int test_x509_store_lookup(void)
+{
+    int ret = 0, i;
+    X509_STORE *store = NULL;
+    X509_STORE_CTX *ctx = NULL;
+    X509 *certs[STORE_NUM_CERTS] = { NULL }, *extra = NULL;
+
+    if (!TEST_ptr(store = X509_STORE_new())
+        || !TEST_ptr(ctx = X509_STORE_CTX_new())
+        || !TEST_true(X509_STORE_CTX_init(ctx, store, NULL, NULL)))
+        goto err;
+
+    for (i = 0; i < STORE_NUM_CERTS; i++)
+        if (!TEST_ptr(certs[i] = make_named_cert(i % STORE_NUM_NAMES, i))
+            || !TEST_true(X509_STORE_add_cert(store, certs[i])))
+            goto err;
+
+    /* Adding the same certificates again is a no-op */
+    for (i = 0; i < STORE_NUM_CERTS; i++)
+        if (!TEST_true(X509_STORE_add_cert(store, certs[i])))
+            goto err;
+
+    for (i = 0; i < STORE_NUM_NAMES; i++)
+        if (!count_certs_by_name(ctx, i, i < STORE_NUM_CERTS % STORE_NUM_NAMES
+                                         ? STORE_NUM_CERTS / STORE_NUM_NAMES + 1
+                                         : STORE_NUM_CERTS / STORE_NUM_NAMES))
+            goto err;
+
+    if (!count_certs_by_name(ctx, STORE_NUM_NAMES, 0))
+        goto err;
+
+    /* Applications look at the objects with the store locked */
+    if (!TEST_true(X509_STORE_lock(store)))
+        goto err;
+    i = sk_X509_OBJECT_num(X509_STORE_get0_objects(store));
+    X509_STORE_unlock(store);
+    if (!TEST_int_eq(i, STORE_NUM_CERTS))
+        goto err;
+
+    /* The store must still work once the application has seen its objects */
+    if (!TEST_ptr(extra = make_named_cert(0, STORE_NUM_CERTS))
+        || !TEST_true(X509_STORE_add_cert(store, extra))
+        || !TEST_true(X509_STORE_add_cert(store, certs[0]))
+        || !count_certs_by_name(ctx, 0, STORE_NUM_CERTS / STORE_NUM_NAMES + 2)
+        || !count_certs_by_name(ctx, STORE_NUM_NAMES - 1,
+                                STORE_NUM_CERTS / STORE_NUM_NAMES))
+        goto err;
+
+    ret = 1;
+ err:
+    for (i = 0; i < STORE_NUM_CERTS; i++)
+        X509_free(certs[i]);
+    X509_free(extra);
+    X509_STORE_CTX_free(ctx);
+    X509_STORE_free(store);
+    return ret;
+}
+
 int setup_tests(void)
 {
     const unsigned char *p;
@@ -138,6 +343,9 @@ int setup_tests(void)
 
     ADD_TEST(test_x509_tbs_cache);
     ADD_TEST(test_x509_crl_tbs_cache);
+    ADD_TEST(test_x509_verify_memo);
+    ADD_TEST(test_x509_verify_memo_changes);
+    ADD_TEST(test_x509_store_lookup);
     return 1;
 }
 